@@ -18,6 +18,7 @@ extern "C" {
 }
 
 #include "cAdc.h"
+#include "cAdcDma.h"
 
 // cAdcChannel static memebers
 adc_bits_width_t cAdcChannel::bits; // common for all adc channels
@@ -45,17 +46,16 @@ cSemaphore cAdcAverage::adcSemaphore;
 bool  cAdcAverage::bAdcWidthConfigured = false;
 bool  cAdcAverage::bWasInit = false;
 xQueueHandle  cAdcAverage::timer_queue = 0;
-uint16_t  cAdcAverage::sampleCntr = 0;
+volatile uint16_t  cAdcAverage::sampleCntr = 0;
 int	 cAdcAverage::value = 0;
 int	 cAdcAverage::lastValue = 0;
 timer_config_t cAdcAverage::timer_config;
 
+// the task, the queue and the timer are common, they are created once by the first Start()
 cAdcAverage::cAdcAverage(const adc_bits_width_t _bw)
 {
-	sampleCntr = 0;
 	if(!bAdcWidthConfigured)
 		bits_width = _bw;
-	bWasInit = false;
 }
 
 cAdcAverage::~cAdcAverage() {}
@@ -91,14 +91,26 @@ int cAdcAverage::Start(const adc1_channel_t _ch, const adc_atten_t _atten)
 	adcSemaphore.Wait();
 	adcSemaphore.Lock(200 / portTICK_PERIOD_MS);	//20ms (50Hz filter)
 
+	// the registers are switched directly, it would break the DMA pattern of cAdcDma
+	cAdcDma::s_lock.Lock();
+	bool bDma = cAdcDma::s_bRunning;
+	if(!bDma)
+		sampleCntr = ADC_SAMPLES_PER_PERIOD;	// cAdcDma::Start() refuses until the end of the measurement
+	cAdcDma::s_lock.Unlock();
+	if(bDma) {
+		ESP_LOGE(TAG, "ADC1 is used by cAdcDma\n");
+		adcSemaphore.Unlock();
+		return ESP_ERR_INVALID_STATE;
+	}
+
 	if(ESP_OK != (result = adc1_config_channel_atten(adcChannel, adcAtten))) {
 		ESP_LOGE(TAG, "ADC channel atten config: error\n");
+		sampleCntr = 0;
 		adcSemaphore.Unlock();
 		return result;
 	}
 
 	value = ADC_SAMPLES_PER_PERIOD / 2;
-	sampleCntr = ADC_SAMPLES_PER_PERIOD;
     /*Start timer counter*/
 	adcSwitchChannel(adcChannel);
 
@@ -110,6 +122,7 @@ int cAdcAverage::Start(const adc1_channel_t _ch, const adc_atten_t _atten)
     timer_config.counter_en = TIMER_PAUSE;
     if(ESP_OK != (result = timer_init(TIMER_GROUP, TIMER_IDX, &timer_config))) {	//Configure timer
 		ESP_LOGE(TAG, "Timer init: error\n");
+		sampleCntr = 0;
 		adcSemaphore.Unlock();
 		return result;
     }
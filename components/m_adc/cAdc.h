@@ -21,8 +21,11 @@ public:
 	cAdcAverage(const adc_bits_width_t _bw = ADC_WIDTH_12Bit);
 	~cAdcAverage();
 	//
+	// ESP_ERR_INVALID_STATE while cAdcDma runs
 	int Start(const adc1_channel_t _ch, const adc_atten_t _atten = ADC_ATTEN_11db);
 	int Get(void);
+	// the timer ISR drives ADC1, cAdcDma::Start() refuses meanwhile
+	static bool IsMeasuring(){return sampleCntr != 0;}
 private:
 	void Init(void);
 
@@ -32,7 +35,7 @@ private:
 	static bool bWasInit;
 	//static portMUX_TYPE rtc_spinlock;
 	static xQueueHandle timer_queue;
-	static uint16_t sampleCntr;
+	static volatile uint16_t sampleCntr; // samples left of the measurement
 	static int	value;
 	static int	lastValue;
 	static timer_config_t timer_config;
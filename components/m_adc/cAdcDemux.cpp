@@ -0,0 +1,85 @@
+/*
+ * cAdcDemux.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cAdcDemux.h"
+
+cAdcDemux::cAdcDemux():SwapPairs(true), m_frameLen(0), m_mask(0), m_pCallbacks(nullptr),
+		m_pending(0), m_bPending(false), m_unknown(0) {
+	for(int i = 0; i < ADC_DEMUX_MAX_CH; i++)
+		m_fill[i] = 0;
+}
+
+void cAdcDemux::Configure(uint32_t channelMask, size_t frameLen){
+	m_mask = channelMask & ((1 << ADC_DEMUX_MAX_CH) - 1);
+	m_frameLen = frameLen ? frameLen : 1;
+	for(int i = 0; i < ADC_DEMUX_MAX_CH; i++){
+		if(m_mask & (1 << i))
+			m_frames[i].resize(m_frameLen);
+		else
+			std::vector<uint16_t>().swap(m_frames[i]);
+	}
+	Reset();
+}
+
+void cAdcDemux::Reset(){
+	for(int i = 0; i < ADC_DEMUX_MAX_CH; i++)
+		m_fill[i] = 0;
+	m_bPending = false;
+	m_unknown = 0;
+}
+
+// returns 1 if the frame is completed
+size_t cAdcDemux::put(uint16_t word){
+	unsigned ch = ADC_DMA_CHANNEL(word);
+	if(ch >= ADC_DEMUX_MAX_CH || !(m_mask & (1 << ch))){
+		m_unknown++;
+		return 0;
+	}
+	m_frames[ch][m_fill[ch]++] = ADC_DMA_VALUE(word);
+	if(m_fill[ch] < m_frameLen)
+		return 0;
+	m_fill[ch] = 0;
+	if(m_pCallbacks)
+		m_pCallbacks->OnFrame(ch, m_frames[ch].data(), m_frameLen);
+	return 1;
+}
+
+size_t cAdcDemux::Feed(const uint16_t *words, size_t count){
+	size_t frames = 0;
+	if(!SwapPairs){
+		for(size_t i = 0; i < count; i++)
+			frames += put(words[i]);
+		return frames;
+	}
+	for(size_t i = 0; i < count; i++){
+		if(!m_bPending){
+			m_pending = words[i];
+			m_bPending = true;
+			continue;
+		}
+		m_bPending = false;
+		frames += put(words[i]);
+		frames += put(m_pending);
+	}
+	return frames;
+}
+
+void cAdcDemux::Stats(const uint16_t *samples, size_t count, sAdcFrameStats &stats){
+	stats.min = 0xffff;
+	stats.max = 0;
+	uint32_t sum = 0;
+	for(size_t i = 0; i < count; i++){
+		uint16_t v = samples[i];
+		if(v < stats.min)
+			stats.min = v;
+		if(v > stats.max)
+			stats.max = v;
+		sum += v;
+	}
+	if(!count)
+		stats.min = 0;
+	stats.mean = count ? (sum + count / 2) / count : 0;
+}
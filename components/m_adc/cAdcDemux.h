@@ -0,0 +1,65 @@
+/*
+ * cAdcDemux.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Splitting of the I2S ADC DMA samples into the frames of every channel
+ */
+
+#ifndef COMPONENTS_M_ADC_CADCDEMUX_H_
+#define COMPONENTS_M_ADC_CADCDEMUX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// DMA sample word: bits 12..15 - channel, bits 0..11 - value
+#define ADC_DMA_CHANNEL(w)		((w) >> 12)
+#define ADC_DMA_VALUE(w)		((w) & 0xfff)
+#define ADC_DEMUX_MAX_CH		8 // ADC1 channels
+
+class cAdcFrameCallbacks{
+public:
+	virtual ~cAdcFrameCallbacks(){}
+	// frame of the channel is complete, the samples are valid during the call only
+	virtual void OnFrame(int channel, const uint16_t *samples, size_t count) = 0;
+};
+
+struct sAdcFrameStats{
+	uint16_t min;
+	uint16_t max;
+	uint16_t mean; // rounded
+};
+
+// No driver calls here, the words come from i2s_read() or a recorded file.
+class cAdcDemux {
+public:
+	// the DMA stores every two 16 bit samples in the reversed order, default true
+	bool SwapPairs;
+
+	cAdcDemux();
+	// channels by the bit mask, frameLen samples of every channel in the frame; allocates the buffers
+	void Configure(uint32_t channelMask, size_t frameLen);
+	void SetCallbacks(cAdcFrameCallbacks *pCallbacks){m_pCallbacks = pCallbacks;}
+	// drop the incomplete frames
+	void Reset();
+	// process the DMA words, returns the number of completed frames
+	size_t Feed(const uint16_t *words, size_t count);
+	// words of the channels not configured
+	uint32_t Unknown()const{return m_unknown;}
+
+	static void Stats(const uint16_t *samples, size_t count, sAdcFrameStats &stats);
+
+private:
+	std::vector<uint16_t> m_frames[ADC_DEMUX_MAX_CH];
+	size_t m_fill[ADC_DEMUX_MAX_CH];
+	size_t m_frameLen;
+	uint32_t m_mask;
+	cAdcFrameCallbacks *m_pCallbacks;
+	uint16_t m_pending; // the first word of the pair
+	bool m_bPending;
+	uint32_t m_unknown;
+
+	size_t put(uint16_t word);
+};
+
+#endif /* COMPONENTS_M_ADC_CADCDEMUX_H_ */
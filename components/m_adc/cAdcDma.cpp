@@ -0,0 +1,163 @@
+/*
+ * cAdcDma.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include <esp_log.h>
+#include <string.h>
+#include "soc/syscon_struct.h"
+
+#include "cAdcDma.h"
+#include "cAdc.h"
+
+static const char *TAG = "cAdcDma";
+
+#define ADC_DMA_I2S			I2S_NUM_0
+#define ADC_DMA_BUF_COUNT	4
+#define ADC_DMA_BUF_LEN		256 // samples
+#define ADC_PATT_WIDTH_12	3 // bit width code of the pattern table
+#define ADC_PATT_MAX		16 // entries of the pattern table
+
+cMutex cAdcDma::s_lock;
+bool cAdcDma::s_bRunning = false;
+
+cAdcDma::cAdcDma():m_pCallbacks(nullptr), m_mask(0), m_bStarted(false)
+{
+	for(int i = 0; i < ADC1_CHANNEL_MAX; i++){
+		m_atten[i] = ADC_ATTEN_11db;
+		m_mean[i] = -1;
+	}
+	SampleRate = 16000;
+	FrameLen = 32;
+}
+
+cAdcDma::~cAdcDma() {
+	Stop();
+}
+
+bool cAdcDma::Add(const adc1_channel_t _ch, const adc_atten_t _atten)
+{
+	if(_ch >= ADC1_CHANNEL_MAX || m_bStarted)
+		return false;
+	m_mask |= 1 << _ch;
+	m_atten[_ch] = _atten;
+	return true;
+}
+
+int cAdcDma::Get(const adc1_channel_t _ch)const
+{
+	if(_ch >= ADC1_CHANNEL_MAX)
+		return -1;
+	return m_mean[_ch];
+}
+
+// ADC1 converts the channels by the pattern table, every entry (byte): channel (4 bits), bit width (2 bits),
+// attenuation (2 bits); 4 entries in a register, the first one in the high byte
+void cAdcDma::setPattern()
+{
+	uint32_t tab[ADC_PATT_MAX / 4] = {0};
+	int n = 0;
+	for(int ch = 0; ch < ADC1_CHANNEL_MAX; ch++){
+		if(!(m_mask & (1 << ch)))
+			continue;
+		uint32_t entry = (ch << 4) | (ADC_PATT_WIDTH_12 << 2) | (m_atten[ch] & 3);
+		tab[n / 4] |= entry << (24 - 8 * (n % 4));
+		n++;
+	}
+	SYSCON.saradc_ctrl.sar1_patt_len = n - 1;
+	for(int i = 0; i < ADC_PATT_MAX / 4; i++)
+		SYSCON.saradc_sar1_patt_tab[i] = tab[i];
+}
+
+bool cAdcDma::Start()
+{
+	if(m_bStarted || !m_mask)
+		return false;
+	s_lock.Lock();
+	bool bBusy = s_bRunning || cAdcAverage::IsMeasuring();
+	if(!bBusy)
+		s_bRunning = true;
+	s_lock.Unlock();
+	if(bBusy){
+		ESP_LOGE(TAG, "ADC1 is in use");
+		return false;
+	}
+
+	i2s_config_t cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+	cfg.sample_rate = SampleRate;
+	cfg.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+	cfg.channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT;
+	cfg.communication_format = I2S_COMM_FORMAT_I2S_MSB;
+	cfg.intr_alloc_flags = 0;
+	cfg.dma_buf_count = ADC_DMA_BUF_COUNT;
+	cfg.dma_buf_len = ADC_DMA_BUF_LEN;
+	cfg.use_apll = false;
+	esp_err_t result;
+	if(ESP_OK != (result = i2s_driver_install(ADC_DMA_I2S, &cfg, 0, NULL))){
+		ESP_LOGE(TAG, "i2s_driver_install: rc=%d", result);
+		s_bRunning = false;
+		return false;
+	}
+
+	adc1_channel_t first = ADC1_CHANNEL_MAX;
+	for(int ch = ADC1_CHANNEL_MAX - 1; ch >= 0; ch--){
+		if(m_mask & (1 << ch)){
+			adc1_config_channel_atten((adc1_channel_t)ch, m_atten[ch]);
+			first = (adc1_channel_t)ch;
+		}
+	}
+	i2s_set_adc_mode(ADC_UNIT_1, first);
+	if(ESP_OK != (result = i2s_adc_enable(ADC_DMA_I2S))){
+		ESP_LOGE(TAG, "i2s_adc_enable: rc=%d", result);
+		i2s_driver_uninstall(ADC_DMA_I2S);
+		s_bRunning = false;
+		return false;
+	}
+	// i2s_adc_enable() sets the pattern of one channel, all of them are set now;
+	// the first samples may be of the first channel only, they are still sorted correctly
+	setPattern();
+
+	for(int i = 0; i < ADC1_CHANNEL_MAX; i++)
+		m_mean[i] = -1;
+	m_buf.resize(ADC_DMA_BUF_LEN);
+	m_demux.Configure(m_mask, FrameLen);
+	m_demux.SetCallbacks(this);
+	m_bStarted = true;
+	TaskCreate("cAdcDma", 5, 3072);
+	return true;
+}
+
+void cAdcDma::Stop()
+{
+	if(!m_bStarted)
+		return;
+	TaskDelete();
+	i2s_adc_disable(ADC_DMA_I2S);
+	i2s_driver_uninstall(ADC_DMA_I2S);
+	m_bStarted = false;
+	s_bRunning = false;
+}
+
+void cAdcDma::TaskHandler()
+{
+	while(true){
+		size_t bytes = 0;
+		if(ESP_OK != i2s_read(ADC_DMA_I2S, m_buf.data(), m_buf.size() * sizeof(uint16_t), &bytes, portMAX_DELAY)){
+			vTaskDelay(1);
+			continue;
+		}
+		m_demux.Feed(m_buf.data(), bytes / sizeof(uint16_t));
+	}
+}
+
+void cAdcDma::OnFrame(int channel, const uint16_t *samples, size_t count)
+{
+	sAdcFrameStats stats;
+	cAdcDemux::Stats(samples, count, stats);
+	m_mean[channel] = stats.mean;
+	if(m_pCallbacks)
+		m_pCallbacks->OnFrame(channel, samples, count);
+}
@@ -0,0 +1,54 @@
+/*
+ * cAdcDma.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Continuous ADC1 sampling of several channels by I2S DMA, the samples are delivered in frames
+ */
+
+#ifndef COMPONENTS_M_ADC_CADCDMA_H_
+#define COMPONENTS_M_ADC_CADCDMA_H_
+#include <driver/adc.h>
+#include <driver/i2s.h>
+#include <vector>
+#include "../../main/common/cBaseTask.h"
+#include "cAdcDemux.h"
+
+// The ADC converts the channels one after another without the CPU, the task gets the DMA buffers
+// and splits them into the frames. Uses I2S0 and ADC1: Start() refuses during a cAdcAverage measurement
+// and cAdcAverage::Start() refuses while it runs; cAdcChannel reads wait for Stop() by the driver lock.
+class cAdcDma: private cBaseTask, private cAdcFrameCallbacks {
+	friend class cAdcAverage;
+	static cMutex s_lock; // s_bRunning and the start of the cAdcAverage measurement
+	static bool s_bRunning; // I2S0 and ADC1 are taken by an instance
+	cAdcDemux m_demux;
+	cAdcFrameCallbacks *m_pCallbacks;
+	uint32_t m_mask; // channels
+	adc_atten_t m_atten[ADC1_CHANNEL_MAX];
+	volatile int m_mean[ADC1_CHANNEL_MAX]; // of the last frame, -1 if none yet
+	bool m_bStarted;
+	std::vector<uint16_t> m_buf;
+
+public:
+	uint32_t SampleRate; // conversions per second of all channels together, default 16000
+	size_t FrameLen; // samples of every channel in the frame, default 32
+
+	cAdcDma();
+	~cAdcDma();
+	// add the channel before Start()
+	bool Add(const adc1_channel_t _ch, const adc_atten_t _atten = ADC_ATTEN_11db);
+	// frames are passed from the ADC task, they should be processed fast
+	void SetCallbacks(cAdcFrameCallbacks *pCallbacks){m_pCallbacks = pCallbacks;}
+	// false if ADC1 or I2S0 is in use
+	bool Start();
+	void Stop();
+	static bool IsRunning(){return s_bRunning;}
+	// mean of the last frame of the channel, raw value, -1 if there is none yet
+	int Get(const adc1_channel_t _ch)const;
+
+private:
+	void TaskHandler();
+	void OnFrame(int channel, const uint16_t *samples, size_t count);
+	void setPattern();
+};
+
+#endif /* COMPONENTS_M_ADC_CADCDMA_H_ */
@@ -42,17 +42,46 @@ BLEAdvertising::BLEAdvertising() {
 	m_advParams.channel_map       = ADV_CHNL_ALL;
 	m_advParams.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
 
+	m_advDataChanged              = true;
 	m_customAdvData               = false;   // No custom advertising data
 	m_customScanResponseData      = false;   // No custom scan response data
+	m_bStarted                    = false;
 } // BLEAdvertising
 
 
+/**
+ * @brief Set the advertising interval.
+ * @param [in] minInterval Minimum interval, 0.625 ms units.
+ * @param [in] maxInterval Maximum interval, 0.625 ms units.
+ */
+void BLEAdvertising::setInterval(uint16_t minInterval, uint16_t maxInterval) {
+	m_advParams.adv_int_min = minInterval;
+	m_advParams.adv_int_max = maxInterval;
+} // setInterval
+
+
+/**
+ * @brief Set the advertising type.
+ * @param [in] bConnectable false for the broadcast only advertising, e.g. when no more clients may connect.
+ */
+void BLEAdvertising::setConnectable(bool bConnectable) {
+	m_advParams.adv_type = bConnectable ? ADV_TYPE_IND : ADV_TYPE_NONCONN_IND;
+} // setConnectable
+
+
 /**
  * @brief Add a service uuid to exposed list of services.
  * @param [in] serviceUUID The UUID of the service to expose.
  */
 void BLEAdvertising::addServiceUUID(BLEUUID serviceUUID) {
 	m_serviceUUIDs.push_back(serviceUUID);
+	// In order to use the ESP-IDF framework, the UUIDs must be supplied in a contiguous array of their
+	// 128bit (16 byte) representations. It is built here once, not by every start().
+	m_serviceUUIDData.resize(16 * m_serviceUUIDs.size());
+	serviceUUID.get128(&m_serviceUUIDData[m_serviceUUIDData.size() - 16]);
+	m_advData.service_uuid_len = m_serviceUUIDData.size();
+	m_advData.p_service_uuid   = m_serviceUUIDData.data();
+	m_advDataChanged           = true;
 } // addServiceUUID
 
 
@@ -74,6 +103,7 @@ void BLEAdvertising::addServiceUUID(const char* serviceUUID) {
  */
 void BLEAdvertising::setAppearance(uint16_t appearance) {
 	m_advData.appearance = appearance;
+	m_advDataChanged     = true;
 } // setAppearance
 
 
@@ -114,8 +144,8 @@ void BLEAdvertising::setScanFilter(bool scanRequestWhitelistOnly,	bool connectWh
 void BLEAdvertising::setAdvertisementData(BLEAdvertisementData& advertisementData) {
 	ESP_LOGD(LOG_TAG, ">> setAdvertisementData");
 	esp_err_t errRc = esp_ble_gap_config_adv_data_raw(
-		(uint8_t*)advertisementData.getPayload().data(),
-		advertisementData.getPayload().length());
+		(uint8_t*)advertisementData.getData(),
+		advertisementData.getLength());
 	if (errRc != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "esp_ble_gap_config_adv_data_raw: %d", errRc);
 	}
@@ -131,7 +161,7 @@ void BLEAdvertising::setAdvertisementData(BLEAdvertisementData& advertisementDat
 void BLEAdvertising::setScanResponseData(BLEAdvertisementData& advertisementData) {
 	ESP_LOGD(LOG_TAG, ">> setScanResponseData");
 	esp_err_t errRc = esp_ble_gap_config_scan_rsp_data_raw(
-		(uint8_t*)advertisementData.getPayload().data(), advertisementData.getPayload().length());
+		(uint8_t*)advertisementData.getData(), advertisementData.getLength());
 	if (errRc != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "esp_ble_gap_config_scan_rsp_data_raw: %d", errRc);
 	}
@@ -148,29 +178,10 @@ void BLEAdvertising::start() {
 	ESP_LOGD(LOG_TAG, ">> start: customAdvData: %d, customScanResponseData: %d", m_customAdvData, m_customScanResponseData);
 
 
-	// We have a vector of service UUIDs that we wish to advertise.  In order to use the
-	// ESP-IDF framework, these must be supplied in a contiguous array of their 128bit (16 byte)
-	// representations.  If we have 1 or more services to advertise then we allocate enough
-	// storage to host them and then copy them in one at a time into the contiguous storage.
-	int numServices = m_serviceUUIDs.size();
-	if (numServices > 0) {
-		m_advData.service_uuid_len = 16*numServices;
-		m_advData.p_service_uuid   = new uint8_t[m_advData.service_uuid_len];
-		uint8_t* p = m_advData.p_service_uuid;
-		for (int i=0; i<numServices; i++) {
-			ESP_LOGD(LOG_TAG, "- advertising service: %s", m_serviceUUIDs[i].toString().c_str());
-			BLEUUID serviceUUID128 = m_serviceUUIDs[i].to128();
-			memcpy(p, serviceUUID128.getNative()->uuid.uuid128, 16);
-			p+=16;
-		}
-	} else {
-		m_advData.service_uuid_len = 0;
-		ESP_LOGD(LOG_TAG, "- no services advertised");
-	}
-
 	esp_err_t errRc;
 
-	if (m_customAdvData == false) {
+	// The data is kept by the stack, so it is configured only when changed, not by every restart.
+	if (m_customAdvData == false && m_advDataChanged) {
 	// Set the configuration for advertising.
 		m_advData.set_scan_rsp = false;
 		errRc = ::esp_ble_gap_config_adv_data(&m_advData);
@@ -180,7 +191,7 @@ void BLEAdvertising::start() {
 		}
 	}
 
-	if (m_customScanResponseData == false) {
+	if (m_customScanResponseData == false && m_advDataChanged) {
 		m_advData.set_scan_rsp = true;
 		errRc = ::esp_ble_gap_config_adv_data(&m_advData);
 		if (errRc != ESP_OK) {
@@ -188,20 +199,22 @@ void BLEAdvertising::start() {
 			return;
 		}
 	}
-
-	// If we had services to advertise then we previously allocated some storage for them.
-	// Here we release that storage.
-	if (m_advData.service_uuid_len > 0) {
-		delete[] m_advData.p_service_uuid;
-		m_advData.p_service_uuid = nullptr;
+	m_advDataChanged = false;
+
+	// Start advertising, the non-connectable one has the min interval 100 ms.
+	esp_ble_adv_params_t advParams = m_advParams;
+	if (advParams.adv_type == ADV_TYPE_NONCONN_IND && advParams.adv_int_min < 0xa0) {
+		advParams.adv_int_min = 0xa0;
+		if (advParams.adv_int_max < advParams.adv_int_min) {
+			advParams.adv_int_max = advParams.adv_int_min;
+		}
 	}
-
-	// Start advertising.
-	errRc = ::esp_ble_gap_start_advertising(&m_advParams);
+	errRc = ::esp_ble_gap_start_advertising(&advParams);
 	if (errRc != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "<< esp_ble_gap_start_advertising: rc=%d", errRc);
 		return;
 	}
+	m_bStarted = true;
 	ESP_LOGD(LOG_TAG, "<< start");
 } // start
 
@@ -213,6 +226,7 @@ void BLEAdvertising::start() {
  */
 void BLEAdvertising::stop() {
 	ESP_LOGD(LOG_TAG, ">> stop");
+	m_bStarted = false;
 	esp_err_t errRc = ::esp_ble_gap_stop_advertising();
 	if (errRc != ESP_OK) {
 		ESP_LOGE(LOG_TAG, "esp_ble_gap_stop_advertising: rc=%d", errRc);
@@ -221,16 +235,81 @@ void BLEAdvertising::stop() {
 	ESP_LOGD(LOG_TAG, "<< stop");
 } // stop
 
+
 /**
- * @brief Add data to the payload to be advertised.
- * @param [in] data The data to be added to the payload.
+ * @brief Construct an empty advertisement data.
  */
-void BLEAdvertisementData::addData(std::string data) {
-	if ((m_payload.length() + data.length()) > ESP_BLE_ADV_DATA_LEN_MAX) {
-		return;
+BLEAdvertisementData::BLEAdvertisementData() {
+	m_length = 0;
+} // BLEAdvertisementData
+
+
+/**
+ * @brief Replace the payload, e.g. by the one assembled at compile time.
+ * @param [in] payload The AD structures.
+ * @param [in] length The length of the payload, up to 31 bytes.
+ */
+void BLEAdvertisementData::setPayload(const uint8_t *payload, size_t length) {
+	if (length > ESP_BLE_ADV_DATA_LEN_MAX) {
+		ESP_LOGE(LOG_TAG, "Advertising payload is too long: %d", length);
+		length = ESP_BLE_ADV_DATA_LEN_MAX;
 	}
-	m_payload.append(data);
-} // addData
+	memcpy(m_payload, payload, length);
+	m_length = length;
+} // setPayload
+
+
+/**
+ * @brief Add an AD structure to the payload to be advertised.
+ * @param [in] type The AD type.
+ * @param [in] data The data of the structure.
+ * @param [in] length The length of the data.
+ * @return The offset of the data in the payload or -1 if it does not fit.
+ */
+int BLEAdvertisementData::addField(uint8_t type, const uint8_t *data, size_t length) {
+	if (m_length + 2 + length > ESP_BLE_ADV_DATA_LEN_MAX) {
+		ESP_LOGE(LOG_TAG, "No room for the AD type 0x%.2x", type);
+		return -1;
+	}
+	m_payload[m_length++] = length + 1;
+	m_payload[m_length++] = type;
+	memcpy(m_payload + m_length, data, length);
+	m_length += length;
+	return m_length - length;
+} // addField
+
+
+/**
+ * @brief Find the AD structure in the payload.
+ * @param [in] type The AD type.
+ * @return The offset of its data or -1 if there is no such structure.
+ */
+int BLEAdvertisementData::findField(uint8_t type) const {
+	size_t pos = 0;
+	while (pos + 1 < m_length && m_payload[pos] != 0) {
+		if (m_payload[pos + 1] == type) {
+			return pos + 2;
+		}
+		pos += m_payload[pos] + 1;
+	}
+	return -1;
+} // findField
+
+
+/**
+ * @brief Overwrite the payload data in place.
+ * @param [in] offset The offset returned by addField() or findField().
+ * @param [in] data The new data.
+ * @param [in] length The length of the data.
+ * @return false if the data is out of the payload.
+ */
+bool BLEAdvertisementData::patch(int offset, const uint8_t *data, size_t length) {
+	if (offset < 0 || offset + length > m_length) {
+		return false;
+	}
+	memcpy(m_payload + offset, data, length);
+	return true;
+} // patch
 
 
 /**
@@ -241,47 +320,54 @@ void BLEAdvertisementData::addData(std::string data) {
  * https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.gap.appearance.xml
  */
 void BLEAdvertisementData::setAppearance(uint16_t appearance) {
-	char cdata[2];
-	cdata[0] = 3;
-	cdata[1] = ESP_BLE_AD_TYPE_APPEARANCE;
-	addData(std::string(cdata, 2) + std::string((char *)&appearance,2));
+	uint8_t data[2] = {(uint8_t)(appearance & 0xff), (uint8_t)(appearance >> 8)};
+	addField(ESP_BLE_AD_TYPE_APPEARANCE, data, 2);
 } // setAppearance
 
 
 /**
- * @brief Set the complete services.
- * @param [in] uuid The single service to advertise.
+ * @brief Add the UUID as the AD structure of the given type for every UUID size.
+ * @param [in] pData The advertisement data to add to.
+ * @param [in] uuid The service UUID.
+ * @param [in] types The AD types for 16, 32 and 128 bit UUIDs.
  */
-void BLEAdvertisementData::setCompleteServices(BLEUUID uuid) {
-	char cdata[2];
+static void addServices(BLEAdvertisementData *pData, BLEUUID &uuid, const uint8_t types[3]) {
+	esp_bt_uuid_t *pNative = uuid.getNative();
 	switch(uuid.bitSize()) {
 		case 16: {
 			// [Len] [0x02] [LL] [HH]
-			cdata[0] = 3;
-			cdata[1] = ESP_BLE_AD_TYPE_16SRV_CMPL;
-			addData(std::string(cdata, 2) + std::string((char *)&uuid.getNative()->uuid.uuid16,2));
+			uint8_t data[2] = {(uint8_t)(pNative->uuid.uuid16 & 0xff), (uint8_t)(pNative->uuid.uuid16 >> 8)};
+			pData->addField(types[0], data, 2);
 			break;
 		}
 
 		case 32: {
 			// [Len] [0x04] [LL] [LL] [HH] [HH]
-			cdata[0] = 5;
-			cdata[1] = ESP_BLE_AD_TYPE_32SRV_CMPL;
-			addData(std::string(cdata, 2) + std::string((char *)&uuid.getNative()->uuid.uuid32,4));
+			uint32_t v = pNative->uuid.uuid32;
+			uint8_t data[4] = {(uint8_t)(v & 0xff), (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+			pData->addField(types[1], data, 4);
 			break;
 		}
 
 		case 128: {
-			// [Len] [0x04] [0] [1] ... [15]
-			cdata[0] = 17;
-			cdata[1] = ESP_BLE_AD_TYPE_128SRV_CMPL;
-			addData(std::string(cdata, 2) + std::string((char *)uuid.getNative()->uuid.uuid128,16));
+			// [Len] [0x06] [0] [1] ... [15]
+			pData->addField(types[2], pNative->uuid.uuid128, 16);
 			break;
 		}
 
 		default:
 			return;
 	}
+} // addServices
+
+
+/**
+ * @brief Set the complete services.
+ * @param [in] uuid The single service to advertise.
+ */
+void BLEAdvertisementData::setCompleteServices(BLEUUID uuid) {
+	static const uint8_t types[3] = {ESP_BLE_AD_TYPE_16SRV_CMPL, ESP_BLE_AD_TYPE_32SRV_CMPL, ESP_BLE_AD_TYPE_128SRV_CMPL};
+	addServices(this, uuid, types);
 } // setCompleteServices
 
 
@@ -297,11 +383,7 @@ void BLEAdvertisementData::setCompleteServices(BLEUUID uuid) {
  * * ESP_BLE_ADV_FLAG_NON_LIMIT_DISC
  */
 void BLEAdvertisementData::setFlags(uint8_t flag) {
-	char cdata[3];
-	cdata[0] = 2;
-	cdata[1] = ESP_BLE_AD_TYPE_FLAG;
-	cdata[2] = flag;
-	addData(std::string(cdata, 3));
+	addField(ESP_BLE_AD_TYPE_FLAG, &flag, 1);
 } // setFlag
 
 
@@ -312,10 +394,7 @@ void BLEAdvertisementData::setFlags(uint8_t flag) {
  */
 void BLEAdvertisementData::setManufacturerData(std::string data) {
 	ESP_LOGD("BLEAdvertisementData", ">> setManufacturerData");
-	char cdata[2];
-	cdata[0] = data.length() + 1;
-	cdata[1] = ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE;
-	addData(std::string(cdata, 2)  + data);
+	addField(ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, (const uint8_t*)data.data(), data.length());
 	ESP_LOGD("BLEAdvertisementData", "<< setManufacturerData");
 } // setManufacturerData
 
@@ -326,10 +405,7 @@ void BLEAdvertisementData::setManufacturerData(std::string data) {
  */
 void BLEAdvertisementData::setName(std::string name) {
 	ESP_LOGD("BLEAdvertisementData", ">> setName: %s", name.c_str());
-	char cdata[2];
-	cdata[0] = name.length() + 1;
-	cdata[1] = ESP_BLE_AD_TYPE_NAME_CMPL;
-	addData(std::string(cdata, 2)  + name);
+	addField(ESP_BLE_AD_TYPE_NAME_CMPL, (const uint8_t*)name.data(), name.length());
 	ESP_LOGD("BLEAdvertisementData", "<< setName");
 } // setName
 
@@ -339,35 +415,8 @@ void BLEAdvertisementData::setName(std::string name) {
  * @param [in] uuid The single service to advertise.
  */
 void BLEAdvertisementData::setPartialServices(BLEUUID uuid) {
-	char cdata[2];
-	switch(uuid.bitSize()) {
-		case 16: {
-			// [Len] [0x02] [LL] [HH]
-			cdata[0] = 3;
-			cdata[1] = ESP_BLE_AD_TYPE_16SRV_PART;
-			addData(std::string(cdata, 2) + std::string((char *)&uuid.getNative()->uuid.uuid16,2));
-			break;
-		}
-
-		case 32: {
-			// [Len] [0x04] [LL] [LL] [HH] [HH]
-			cdata[0] = 5;
-			cdata[1] = ESP_BLE_AD_TYPE_32SRV_PART;
-			addData(std::string(cdata, 2) + std::string((char *)&uuid.getNative()->uuid.uuid32,4));
-			break;
-		}
-
-		case 128: {
-			// [Len] [0x04] [0] [1] ... [15]
-			cdata[0] = 17;
-			cdata[1] = ESP_BLE_AD_TYPE_128SRV_PART;
-			addData(std::string(cdata, 2) + std::string((char *)uuid.getNative()->uuid.uuid128,16));
-			break;
-		}
-
-		default:
-			return;
-	}
+	static const uint8_t types[3] = {ESP_BLE_AD_TYPE_16SRV_PART, ESP_BLE_AD_TYPE_32SRV_PART, ESP_BLE_AD_TYPE_128SRV_PART};
+	addServices(this, uuid, types);
 } // setPartialServices
 
 
@@ -377,19 +426,6 @@ void BLEAdvertisementData::setPartialServices(BLEUUID uuid) {
  */
 void BLEAdvertisementData::setShortName(std::string name) {
 	ESP_LOGD("BLEAdvertisementData", ">> setShortName: %s", name.c_str());
-	char cdata[2];
-	cdata[0] = name.length() + 1;
-	cdata[1] = ESP_BLE_AD_TYPE_NAME_SHORT;
-	addData(std::string(cdata, 2)  + name);
+	addField(ESP_BLE_AD_TYPE_NAME_SHORT, (const uint8_t*)name.data(), name.length());
 	ESP_LOGD("BLEAdvertisementData", "<< setShortName");
 } // setShortName
-
-
-
-/**
- * @brief Retrieve the payload that is to be advertised.
- * @return The payload that is to be advertised.
- */
-std::string &BLEAdvertisementData::getPayload() {
-	return m_payload;
-} // getPayload
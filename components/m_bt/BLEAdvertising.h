@@ -12,15 +12,35 @@
 #include <esp_gap_ble_api.h>
 #include "BLEUUID.h"
 #include <vector>
+#include <string>
+
+// AD structures of the payloads assembled at compile time, e.g.
+// static const uint8_t advPayload[] = {
+//	BLE_AD_FLAGS(ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+//	BLE_AD_UUID16(ESP_BLE_AD_TYPE_16SRV_PART, 0xafff),
+//	BLE_AD_HEADER(ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, 3), 0xff, 0xff, 0 // the last byte is patched later
+// };
+#define BLE_AD_HEADER(type, len)		(uint8_t)((len) + 1), (uint8_t)(type) // followed by len data bytes
+#define BLE_AD_FLAGS(flags)				BLE_AD_HEADER(ESP_BLE_AD_TYPE_FLAG, 1), (uint8_t)(flags)
+#define BLE_AD_UUID16(type, uuid)		BLE_AD_HEADER(type, 2), (uint8_t)((uuid) & 0xff), (uint8_t)(((uuid) >> 8) & 0xff)
+#define BLE_AD_APPEARANCE(appearance)	BLE_AD_UUID16(ESP_BLE_AD_TYPE_APPEARANCE, appearance)
 
 
 // Advertisement data set by the programmer to be published by the %BLE server.
+// The payload is kept in a fixed buffer, the dynamic fields are patched in place.
 
 class BLEAdvertisementData {
 	// Only a subset of the possible BLE architected advertisement fields are currently exposed.  Others will
 	// be exposed on demand/request or as time permits.
 	//
 public:
+	BLEAdvertisementData();
+	// the payload assembled at compile time by the BLE_AD_xxx macros
+	template<size_t N> BLEAdvertisementData(const uint8_t (&payload)[N]) {
+		static_assert(N <= ESP_BLE_ADV_DATA_LEN_MAX, "the advertising payload is longer than 31 bytes");
+		setPayload(payload, N);
+	}
+	void setPayload(const uint8_t *payload, size_t length);
 	void setAppearance(uint16_t appearance);
 	void setCompleteServices(BLEUUID uuid);
 	void setFlags(uint8_t);
@@ -28,13 +48,18 @@ public:
 	void setName(std::string name);
 	void setPartialServices(BLEUUID uuid);
 	void setShortName(std::string name);
+	// add an AD structure, returns the offset of its data for patch() or -1 if it does not fit
+	int  addField(uint8_t type, const uint8_t *data, size_t length);
+	// offset of the data of the first AD structure of the type, -1 if there is none
+	int  findField(uint8_t type) const;
+	// overwrite the data in place, e.g. the alarm state in the manufacturer data
+	bool patch(int offset, const uint8_t *data, size_t length);
+	const uint8_t* getData() const {return m_payload;}
+	size_t         getLength() const {return m_length;}
 
 private:
-	friend class BLEAdvertising;
-	std::string m_payload;   // The payload of the advertisement.
-
-	void        addData(std::string data);  // Add data to the payload.
-	std::string &getPayload();               // Retrieve the current advert payload.
+	uint8_t m_payload[ESP_BLE_ADV_DATA_LEN_MAX]; // The payload of the advertisement.
+	uint8_t m_length;
 }; // BLEAdvertisementData
 
  // Perform and manage BLE advertising.
@@ -47,15 +72,25 @@ public:
 	void start();
 	void stop();
 	void setAppearance(uint16_t appearance);
+	// the raw data is configured at once, the running advertising is not restarted;
+	// so the content may be changed (or rotated between several objects) while advertising
 	void setAdvertisementData(BLEAdvertisementData& advertisementData);
 	void setScanFilter(bool scanRequertWhitelistOnly, bool connectWhitelistOnly);
 	void setScanResponseData(BLEAdvertisementData& advertisementData);
+	// advertising interval in 0.625 ms units, applied by the next start()
+	void setInterval(uint16_t minInterval, uint16_t maxInterval);
+	bool isStarted(){return m_bStarted;}
+	// ADV_TYPE_IND or ADV_TYPE_NONCONN_IND (broadcast only), applied by the next start()
+	void setConnectable(bool bConnectable);
 
 private:
 	esp_ble_adv_data_t   m_advData;
 	esp_ble_adv_params_t m_advParams;
 	std::vector<BLEUUID> m_serviceUUIDs;
+	std::vector<uint8_t> m_serviceUUIDData; // 128 bit forms of m_serviceUUIDs for m_advData
+	bool                 m_advDataChanged; // m_advData has to be configured by the next start()
 	bool                 m_customAdvData;  // Are we using custom advertising data?
 bool m_customScanResponseData; // Are we using custom scan response data?
+	bool                 m_bStarted; // start() is called, the connection stops the advertising as well
 };
 #endif /* COMPONENTS_CPP_UTILS_BLEADVERTISING_H_ */
@@ -15,6 +15,42 @@
 static const char* LOG_TAG = "BLEUUID";
 
 
+/**
+ * @brief Called by the constexpr parser on a bad character or length.
+ *
+ * It is not constexpr, so a bad UUID literal in a constant expression is a compile error.
+ * A string parsed at run time gets the zero value.
+ */
+uint8_t bleUuidParseError() {
+	ESP_LOGE(LOG_TAG, "ERROR: bad UUID literal");
+	return 0;
+} // bleUuidParseError
+
+
+/**
+ * @brief Get the shortest native form of the UUID.
+ *
+ * @return 16 or 32 bit UUID if based on the Bluetooth base UUID, otherwise 128 bit.
+ */
+esp_bt_uuid_t BLEUUIDLiteral::toNative() const {
+	esp_bt_uuid_t uuid;
+	if (isShort() && shortValue() <= 0xffff) {
+		uuid.len         = ESP_UUID_LEN_16;
+		uuid.uuid.uuid16 = shortValue();
+	} else if (isShort()) {
+		uuid.len         = ESP_UUID_LEN_32;
+		uuid.uuid.uuid32 = shortValue();
+	} else {
+		uuid.len = ESP_UUID_LEN_128;
+		for (int i = 0; i < 8; i++) {
+			uuid.uuid.uuid128[i]     = m_lo >> (8 * i);
+			uuid.uuid.uuid128[i + 8] = m_hi >> (8 * i);
+		}
+	}
+	return uuid;
+} // toNative
+
+
 /**
  * @brief Copy memory from source to target but in reverse order.
  *
@@ -64,12 +100,13 @@ static void memrcpy(uint8_t* target, uint8_t* source, uint32_t size) {
  */
 BLEUUID::BLEUUID(const std::string &value) {
 	m_valueSet = true;
+	const uint8_t *pData = (const uint8_t*)value.data(); // char is signed
 	if (value.length() == 2) {
 		m_uuid.len = ESP_UUID_LEN_16;
-		m_uuid.uuid.uuid16 = value[0] | (value[1] << 8);
+		m_uuid.uuid.uuid16 = pData[0] | (pData[1] << 8);
 	} else if (value.length() == 4) {
 		m_uuid.len = ESP_UUID_LEN_32;
-		m_uuid.uuid.uuid32 = value[0] | (value[1] << 8) | (value[2] << 16) | (value[3] << 24);
+		m_uuid.uuid.uuid32 = pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((uint32_t)pData[3] << 24);
 	} else if (value.length() == 16) {
 		m_uuid.len = ESP_UUID_LEN_128;
 		memrcpy(m_uuid.uuid.uuid128, (uint8_t*)value.data(), 16);
@@ -106,6 +143,7 @@ BLEUUID::BLEUUID(const std::string &value) {
 		ESP_LOGE(LOG_TAG, "ERROR: UUID value not 2, 4, 16 or 36 bytes");
 		m_valueSet = false;
 	}
+	normalize();
 } //BLEUUID(std::string)
 
 
@@ -140,6 +178,8 @@ int BLEUUID::bitSize() {
 BLEUUID::BLEUUID(uint8_t* pData, size_t size, bool msbFirst) {
 	if (size != 16) {
 		ESP_LOGE(LOG_TAG, "ERROR: UUID length not 16 bytes");
+		m_valueSet = false;
+		normalize();
 		return;
 	}
 	m_uuid.len = ESP_UUID_LEN_128;
@@ -149,6 +189,7 @@ BLEUUID::BLEUUID(uint8_t* pData, size_t size, bool msbFirst) {
 		memcpy(m_uuid.uuid.uuid128, pData, 16);
 	}
 	m_valueSet         = true;
+	normalize();
 } // BLEUUID
 
 /**
@@ -160,6 +201,7 @@ BLEUUID::BLEUUID(uint16_t uuid) {
 	m_uuid.len         = ESP_UUID_LEN_16;
 	m_uuid.uuid.uuid16 = uuid;
 	m_valueSet         = true;
+	normalize();
 } // BLEUUID
 
 
@@ -172,6 +214,7 @@ BLEUUID::BLEUUID(uint32_t uuid) {
 	m_uuid.len         = ESP_UUID_LEN_32;
 	m_uuid.uuid.uuid32 = uuid;
 	m_valueSet         = true;
+	normalize();
 } // BLEUUID
 
 
@@ -183,6 +226,20 @@ BLEUUID::BLEUUID(uint32_t uuid) {
 BLEUUID::BLEUUID(const esp_bt_uuid_t &uuid) {
 	m_uuid     = uuid;
 	m_valueSet = true;
+	normalize();
+} // BLEUUID
+
+
+/**
+ * @brief Create a UUID from the compile time UUID.
+ *
+ * @param [in] uuid The UUID literal, e.g. "0000180d-0000-1000-8000-00805f9b34fb"_uuid.
+ */
+BLEUUID::BLEUUID(const BLEUUIDLiteral &uuid) {
+	m_uuid     = uuid.toNative();
+	m_valueSet = true;
+	m_lo       = uuid.lo();
+	m_hi       = uuid.hi();
 } // BLEUUID
 
 
@@ -197,9 +254,40 @@ BLEUUID::BLEUUID(const esp_gatt_srvc_id_t &srcvId) : BLEUUID(srcvId.id.uuid) {
 
 BLEUUID::BLEUUID() {
 	m_valueSet = false;
+	normalize();
 } // BLEUUID
 
 
+/**
+ * @brief Calculate the normalized 128 bit form used by equals() and hash().
+ */
+void BLEUUID::normalize() {
+	if (m_valueSet == false) {
+		m_lo = 0;
+		m_hi = 0;
+		return;
+	}
+	switch (m_uuid.len) {
+		case ESP_UUID_LEN_16:
+			m_lo = BLE_UUID_BASE_LO;
+			m_hi = ((uint64_t)m_uuid.uuid.uuid16 << 32) | BLE_UUID_BASE_HI;
+			break;
+		case ESP_UUID_LEN_32:
+			m_lo = BLE_UUID_BASE_LO;
+			m_hi = ((uint64_t)m_uuid.uuid.uuid32 << 32) | BLE_UUID_BASE_HI;
+			break;
+		default:
+			m_lo = 0;
+			m_hi = 0;
+			for (int i = 7; i >= 0; i--) {
+				m_lo = (m_lo << 8) | m_uuid.uuid.uuid128[i];
+				m_hi = (m_hi << 8) | m_uuid.uuid.uuid128[i + 8];
+			}
+			break;
+	}
+} // normalize
+
+
 /**
  * @brief Compare a UUID against this UUID.
  *
@@ -211,21 +299,23 @@ bool BLEUUID::equals(const BLEUUID &uuid) const {
 	if (m_valueSet == false || uuid.m_valueSet == false) {
 		return false;
 	}
+	return m_lo == uuid.m_lo && m_hi == uuid.m_hi;
+} // equals
 
-	if (uuid.m_uuid.len != m_uuid.len) {
-		return uuid.toString() == toString();
-	}
-
-	if (uuid.m_uuid.len == ESP_UUID_LEN_16) {
-		return uuid.m_uuid.uuid.uuid16 == m_uuid.uuid.uuid16;
-	}
 
-	if (uuid.m_uuid.len == ESP_UUID_LEN_32) {
-		return uuid.m_uuid.uuid.uuid32 == m_uuid.uuid.uuid32;
+/**
+ * @brief Get the hash of the UUID.
+ *
+ * The hash is calculated from the normalized 128 bit form, so the UUIDs which are equal by equals()
+ * have the same hash. It is the same as BLEUUIDLiteral::hash().
+ * @return The hash value.
+ */
+uint32_t BLEUUID::hash() const {
+	if (m_valueSet == false) {
+		return 0;
 	}
-
-	return memcmp(uuid.m_uuid.uuid.uuid128, m_uuid.uuid.uuid128, 16) == 0;
-} // equals
+	return BLEUUIDLiteral(m_lo, m_hi).hash();
+} // hash
 
 
 /**
@@ -298,6 +388,19 @@ BLEUUID BLEUUID::to128() {
 } // to128
 
 
+/**
+ * @brief Write the 128 bit form without converting the UUID.
+ *
+ * @param [out] p 16 bytes, LSB first as in esp_bt_uuid_t.
+ */
+void BLEUUID::get128(uint8_t *p) const {
+	for (int i = 0; i < 8; i++) {
+		p[i]     = m_lo >> (8 * i);
+		p[i + 8] = m_hi >> (8 * i);
+	}
+} // get128
+
+
 //01234567 8901 2345 6789 012345678901
 //0000180d-0000-1000-8000-00805f9b34fb
 //0 1 2 3  4 5  6 7  8 9  0 1 2 3 4 5
@@ -12,9 +12,76 @@
 #include <esp_gatt_defs.h>
 #include <string>
 
+// Bluetooth base UUID 00000000-0000-1000-8000-00805f9b34fb as two 64 bit words of the LSB first 128 bit form,
+// the short UUID is in the upper half of the high word
+#define BLE_UUID_BASE_LO	0x800000805f9b34fbULL
+#define BLE_UUID_BASE_HI	0x0000000000001000ULL
+
+uint8_t bleUuidParseError(); // not constexpr, so a bad literal fails to compile
+
+// UUID known at compile time, parsed from "180d", "0000180d" or "0000180d-0000-1000-8000-00805f9b34fb".
+// Keeps the normalized 128 bit form (lo - bytes 0..7, hi - bytes 8..15, LSB first).
+class BLEUUIDLiteral {
+public:
+	constexpr BLEUUIDLiteral(const char *str, size_t len):
+		m_lo(len == 36 ? parseWord(str, 16) : BLE_UUID_BASE_LO),
+		m_hi(len == 36 ? (checkDashes(str) | parseWord(str, 0)) :
+			(len == 4 || len == 8) ? (parseShort(str, len, 0, 0) << 32) | BLE_UUID_BASE_HI :
+			bleUuidParseError()) {}
+	constexpr BLEUUIDLiteral(uint16_t uuid):m_lo(BLE_UUID_BASE_LO), m_hi(((uint64_t)uuid << 32) | BLE_UUID_BASE_HI) {}
+	constexpr BLEUUIDLiteral(uint64_t lo, uint64_t hi):m_lo(lo), m_hi(hi) {}
+
+	constexpr uint64_t lo()const{return m_lo;}
+	constexpr uint64_t hi()const{return m_hi;}
+	// based on the Bluetooth base UUID, so it has a 16 or 32 bit form
+	constexpr bool isShort()const{return m_lo == BLE_UUID_BASE_LO && (uint32_t)m_hi == BLE_UUID_BASE_HI;}
+	constexpr uint32_t shortValue()const{return m_hi >> 32;}
+	constexpr bool operator ==(const BLEUUIDLiteral &uuid)const{return m_lo == uuid.m_lo && m_hi == uuid.m_hi;}
+	constexpr bool operator !=(const BLEUUIDLiteral &uuid)const{return !(*this == uuid);}
+	constexpr uint32_t hash()const{return fold(m_lo ^ (m_hi * 0x9e3779b97f4a7c15ULL));}
+	// the shortest native form
+	esp_bt_uuid_t toNative()const;
+
+private:
+	uint64_t m_lo;
+	uint64_t m_hi;
+
+	static constexpr uint64_t hexDigit(char c){
+		return c >= '0' && c <= '9' ? c - '0' :
+			c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+			c >= 'A' && c <= 'F' ? c - 'A' + 10 : bleUuidParseError();
+	}
+	// position of the hex digit in the canonical string
+	static constexpr size_t digitPos(size_t i){
+		return i + (i >= 8) + (i >= 12) + (i >= 16) + (i >= 20);
+	}
+	static constexpr uint64_t parseDigits(const char *str, size_t i, size_t end, uint64_t acc){
+		return i == end ? acc : parseDigits(str, i + 1, end, (acc << 4) | hexDigit(str[digitPos(i)]));
+	}
+	// 16 digits from the digit 'first', the first half of the string is the high word
+	static constexpr uint64_t parseWord(const char *str, size_t first){
+		return parseDigits(str, first, first + 16, 0);
+	}
+	static constexpr uint64_t parseShort(const char *str, size_t len, size_t i, uint64_t acc){
+		return i == len ? acc : parseShort(str, len, i + 1, (acc << 4) | hexDigit(str[i]));
+	}
+	static constexpr uint64_t checkDashes(const char *str){
+		return str[8] == '-' && str[13] == '-' && str[18] == '-' && str[23] == '-' ? 0 : bleUuidParseError();
+	}
+	static constexpr uint32_t fold(uint64_t v){
+		return (uint32_t)(v >> 32) ^ (uint32_t)v;
+	}
+}; // BLEUUIDLiteral
+
+// "0000180d-0000-1000-8000-00805f9b34fb"_uuid
+constexpr BLEUUIDLiteral operator "" _uuid(const char *str, size_t len){
+	return BLEUUIDLiteral(str, len);
+}
+
 // A model of a BLE UUID.
 class BLEUUID {
 public:
+	BLEUUID(const BLEUUIDLiteral &uuid);
 	BLEUUID(const std::string &uuid);
 	BLEUUID(uint16_t uuid);
 	BLEUUID(uint32_t uuid);
@@ -22,17 +89,33 @@ public:
 	BLEUUID(uint8_t* pData, size_t size, bool msbFirst);
 	BLEUUID(const esp_gatt_srvc_id_t &srcvId);
 	BLEUUID();
+	// two word compares of the normalized 128 bit forms
 	bool           equals(const BLEUUID &uuid) const;
 	bool operator ==(const BLEUUID &uuid) const{
 		return equals(uuid);
 	}
+	// same for the equal UUIDs of different lengths (16 bit UUID and its 128 bit form)
+	uint32_t       hash() const;
 	int bitSize(); // Get the number of bits in this uuid.
 	esp_bt_uuid_t* getNative();
 	BLEUUID        to128() ;
+	// write the 128 bit form LSB first, 16 bytes
+	void           get128(uint8_t *p) const;
 	std::string    toString() const;
 
 private:
 	esp_bt_uuid_t m_uuid;
 	bool          m_valueSet;
+	uint64_t      m_lo; // normalized 128 bit form, see BLEUUIDLiteral
+	uint64_t      m_hi;
+
+	void normalize();
 }; // BLEUUID
+
+// hasher for the unordered containers
+struct BLEUUIDHash {
+	size_t operator()(const BLEUUID &uuid) const{
+		return uuid.hash();
+	}
+};
 #endif /* CONFIG_BT_ENABLED */
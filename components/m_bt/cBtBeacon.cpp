@@ -0,0 +1,163 @@
+/*
+ * cBtBeacon.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtBeacon.h"
+#include "../m_flash/cFlash.h"
+
+#include <string.h>
+#include <vector>
+#include <esp_log.h>
+#include <mbedtls/sha256.h>
+
+static const char* LOG_TAG = "cBtBeacon";
+
+#define SHA256_BLOCK_LEN	64
+#define SHA256_LEN			32
+#define BEACON_KEY_KEY		"key"
+#define BEACON_SEQ_KEY		"seq"
+
+cBtBeacon::cBtBeacon():MinPeriodMs(500), RefreshMs(10000), m_keyLen(0), m_bChanged(true), m_bValid(false), m_lastBuild(0),
+		m_pFlash(nullptr), m_seqReserved(0) {
+	m_state.flags = 0;
+	m_state.battery = BT_BEACON_BATTERY_UNKNOWN;
+	m_state.seq = 0;
+}
+
+cBtBeacon::~cBtBeacon() {
+	delete m_pFlash;
+}
+
+bool cBtBeacon::Open(const std::string &storageName){
+	if(m_pFlash)
+		return true;
+	m_pFlash = new cFlash(storageName);
+	if(!m_pFlash->IsHandleOk()){
+		delete m_pFlash;
+		m_pFlash = nullptr;
+		return false;
+	}
+	std::vector<uint8_t> data;
+	if(m_pFlash->GetVal(BEACON_KEY_KEY, data) && data.size() && data.size() <= BT_BEACON_KEY_MAX){
+		memcpy(m_key, data.data(), data.size());
+		m_keyLen = data.size();
+		m_bChanged = true;
+	}
+	// the numbers up to the saved one may have been broadcast before the reboot
+	if(m_pFlash->GetVal(BEACON_SEQ_KEY, data) && data.size() == 4){
+		uint32_t seq = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+		if(seq > m_state.seq)
+			m_state.seq = seq;
+	}
+	m_seqReserved = m_state.seq;
+	return true;
+}
+
+void cBtBeacon::SetKey(const uint8_t *key, size_t len){
+	len = len < BT_BEACON_KEY_MAX ? len : BT_BEACON_KEY_MAX;
+	if(len == m_keyLen && memcmp(m_key, key, len) == 0)
+		return;
+	m_keyLen = len;
+	memcpy(m_key, key, m_keyLen);
+	m_bChanged = true;
+	if(!m_keyLen)
+		m_bValid = false;
+	if(m_pFlash){
+		bool bOk = m_keyLen ? m_pFlash->SetVal(BEACON_KEY_KEY, std::vector<uint8_t>(m_key, m_key + m_keyLen)) :
+				m_pFlash->Erase(BEACON_KEY_KEY);
+		if(!m_pFlash->Commit() || !bOk)
+			ESP_LOGE(LOG_TAG, "The key is not saved");
+	}
+}
+
+void cBtBeacon::SetState(uint8_t flags, uint8_t battery){
+	if(flags == m_state.flags && battery == m_state.battery)
+		return;
+	m_state.flags = flags;
+	m_state.battery = battery;
+	m_bChanged = true;
+}
+
+bool cBtBeacon::Poll(uint32_t now, uint8_t *payload){
+	if(m_bValid){
+		uint32_t elapsed = now - m_lastBuild;
+		if(!(m_bChanged && elapsed >= MinPeriodMs) && elapsed < RefreshMs)
+			return false;
+	}
+	if(!m_keyLen)
+		return false;
+	m_state.seq++;
+	if(m_pFlash && m_state.seq > m_seqReserved)
+		seqReserve();
+	Encode(m_state, m_key, m_keyLen, payload);
+	m_bChanged = false;
+	m_bValid = true;
+	m_lastBuild = now;
+	return true;
+}
+
+// one NVS write per BT_BEACON_SEQ_BLOCK payloads; if it fails the payloads go on, after a reboot the receivers
+// drop them until the sequence passes the numbers broadcast now
+void cBtBeacon::seqReserve(){
+	m_seqReserved = m_state.seq + BT_BEACON_SEQ_BLOCK - 1;
+	std::vector<uint8_t> data(4);
+	for(int i = 0; i < 4; i++)
+		data[i] = m_seqReserved >> (8 * i);
+	bool bOk = m_pFlash->SetVal(BEACON_SEQ_KEY, data);
+	if(!m_pFlash->Commit() || !bOk)
+		ESP_LOGE(LOG_TAG, "The sequence is not saved");
+}
+
+void cBtBeacon::Encode(const sBtBeaconState &state, const uint8_t *key, size_t keyLen, uint8_t *payload){
+	payload[0] = BT_BEACON_COMPANY_ID & 0xff;
+	payload[1] = BT_BEACON_COMPANY_ID >> 8;
+	payload[2] = BT_BEACON_VERSION;
+	payload[3] = state.flags;
+	payload[4] = state.battery;
+	for(int i = 0; i < 4; i++)
+		payload[5 + i] = state.seq >> (8 * i);
+	mac(payload, BT_BEACON_LEN - BT_BEACON_MAC_LEN, key, keyLen, payload + BT_BEACON_LEN - BT_BEACON_MAC_LEN);
+}
+
+bool cBtBeacon::Decode(const uint8_t *payload, size_t len, const uint8_t *key, size_t keyLen, sBtBeaconState &state){
+	if(len != BT_BEACON_LEN || payload[0] != (BT_BEACON_COMPANY_ID & 0xff) || payload[1] != (BT_BEACON_COMPANY_ID >> 8) ||
+			payload[2] != BT_BEACON_VERSION)
+		return false;
+	uint8_t m[BT_BEACON_MAC_LEN];
+	mac(payload, BT_BEACON_LEN - BT_BEACON_MAC_LEN, key, keyLen, m);
+	if(memcmp(m, payload + BT_BEACON_LEN - BT_BEACON_MAC_LEN, BT_BEACON_MAC_LEN) != 0)
+		return false;
+	state.flags = payload[3];
+	state.battery = payload[4];
+	state.seq = payload[5] | (payload[6] << 8) | (payload[7] << 16) | ((uint32_t)payload[8] << 24);
+	return true;
+}
+
+// HMAC-SHA256 (RFC 2104) truncated to BT_BEACON_MAC_LEN, the key is not longer than the block
+void cBtBeacon::mac(const uint8_t *data, size_t len, const uint8_t *key, size_t keyLen, uint8_t *out){
+	uint8_t pad[SHA256_BLOCK_LEN];
+	uint8_t digest[SHA256_LEN];
+	mbedtls_sha256_context ctx;
+
+	memset(pad, 0x36, sizeof(pad));
+	for(size_t i = 0; i < keyLen; i++)
+		pad[i] ^= key[i];
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	mbedtls_sha256_update(&ctx, pad, sizeof(pad));
+	mbedtls_sha256_update(&ctx, data, len);
+	mbedtls_sha256_finish(&ctx, digest);
+
+	memset(pad, 0x5c, sizeof(pad));
+	for(size_t i = 0; i < keyLen; i++)
+		pad[i] ^= key[i];
+	mbedtls_sha256_starts(&ctx, 0);
+	mbedtls_sha256_update(&ctx, pad, sizeof(pad));
+	mbedtls_sha256_update(&ctx, digest, sizeof(digest));
+	mbedtls_sha256_finish(&ctx, digest);
+	mbedtls_sha256_free(&ctx);
+
+	memcpy(out, digest, BT_BEACON_MAC_LEN);
+}
@@ -0,0 +1,85 @@
+/*
+ * cBtBeacon.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Device status broadcast in the manufacturer data of the advertising, readable without a connection
+ */
+
+#ifndef COMPONENTS_M_BT_CBTBEACON_H_
+#define COMPONENTS_M_BT_CBTBEACON_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+class cFlash;
+
+// Manufacturer data: company ID (2, LE), version (1), flags (1), battery (1), sequence (4, LE), MAC (4).
+// The MAC is HMAC-SHA256 of the preceding bytes truncated to 4 bytes, the key is shared with the phone.
+// The key is a dedicated secret, never readable over GATT: anybody who can read it can forge the status.
+// Without a key nothing is broadcast.
+#define BT_BEACON_COMPANY_ID	0xffff // no company ID assigned, internal use
+#define BT_BEACON_VERSION		1
+#define BT_BEACON_MAC_LEN		4
+#define BT_BEACON_LEN			13
+#define BT_BEACON_KEY_MAX		32 // longer keys are cut
+#define BT_BEACON_SEQ_BLOCK		1024 // sequence numbers reserved in NVS by one write
+
+// status flags
+#define BT_BEACON_ALARM			(1 << 0)
+#define BT_BEACON_MOTION		(1 << 1)
+#define BT_BEACON_SMOKE			(1 << 2)
+#define BT_BEACON_ERROR			(1 << 3)
+#define BT_BEACON_CHARGING		(1 << 4)
+#define BT_BEACON_GUARD			(1 << 5)
+
+#define BT_BEACON_BATTERY_UNKNOWN	0xff // otherwise 0..100 %
+
+struct sBtBeaconState{
+	uint8_t flags; // BT_BEACON_xxx
+	uint8_t battery;
+	uint32_t seq; // grows with every payload also across reboots, the receivers drop the older ones (replay)
+};
+
+// Builds the payload from the status at a limited rate, no BT calls here.
+class cBtBeacon {
+public:
+	uint32_t MinPeriodMs; // min time between the payloads, the status changes are collected meanwhile, default 500
+	uint32_t RefreshMs; // a new sequence number without the status change, default 10000
+
+	cBtBeacon();
+	~cBtBeacon();
+
+	// keep the key and the sequence in NVS and load them; the sequence goes on after a reboot from the end
+	// of the last reserved block. Not opened, both are forgotten at reboot and the receivers drop the payloads
+	// until the sequence passes the last one they have seen.
+	bool Open(const std::string &storageName = "btbeacon");
+	// the key is saved when opened, an empty key stops the broadcast
+	void SetKey(const uint8_t *key, size_t len);
+	bool HasKey()const{return m_keyLen > 0;}
+	void SetState(uint8_t flags, uint8_t battery);
+	// build the new payload (BT_BEACON_LEN bytes) when it is time, returns false if the current one is still valid
+	// or there is no key
+	bool Poll(uint32_t now, uint8_t *payload);
+	uint32_t Seq()const{return m_state.seq;}
+
+	static void Encode(const sBtBeaconState &state, const uint8_t *key, size_t keyLen, uint8_t *payload);
+	// check the company ID, version and MAC, false if the payload is not ours or forged
+	static bool Decode(const uint8_t *payload, size_t len, const uint8_t *key, size_t keyLen, sBtBeaconState &state);
+
+private:
+	uint8_t m_key[BT_BEACON_KEY_MAX];
+	size_t m_keyLen;
+	sBtBeaconState m_state;
+	bool m_bChanged;
+	bool m_bValid; // a payload is built
+	uint32_t m_lastBuild;
+	cFlash *m_pFlash; // nullptr if not opened
+	uint32_t m_seqReserved; // the last sequence number saved in NVS
+
+	void seqReserve();
+
+	static void mac(const uint8_t *data, size_t len, const uint8_t *key, size_t keyLen, uint8_t *out);
+};
+
+#endif /* COMPONENTS_M_BT_CBTBEACON_H_ */
@@ -0,0 +1,149 @@
+/*
+ * cBtBondStore.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtBondStore.h"
+#include "../m_flash/cFlash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtBondStore";
+
+#define BOND_INDEX_KEY		"index"
+#define BOND_VERSION		1
+#define BOND_ADDR_LEN		6
+
+// serialization helpers
+static void put_u16(std::vector<uint8_t> &buf, uint16_t v){
+	buf.push_back(v & 0xff);
+	buf.push_back(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p){
+	return p[0] | (p[1] << 8);
+}
+
+cBtBondStore::cBtBondStore(const std::string &storageName):m_bIndexLoaded(false) {
+	m_pFlash = new cFlash(storageName);
+}
+
+cBtBondStore::~cBtBondStore() {
+	delete m_pFlash;
+}
+
+// NVS keys are up to 15 characters: 'p' and 12 hex digits of the address
+std::string cBtBondStore::key(const esp_bd_addr_t bda){
+	char buf[16];
+	snprintf(buf, sizeof buf, "p%02x%02x%02x%02x%02x%02x", bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+	return buf;
+}
+
+void cBtBondStore::Encode(const sBtBond &bond, std::vector<uint8_t> &data){
+	data.clear();
+	data.push_back(BOND_VERSION);
+	data.insert(data.end(), bond.bda, bond.bda + BOND_ADDR_LEN);
+	put_u16(data, bond.dbHash & 0xffff);
+	put_u16(data, bond.dbHash >> 16);
+	put_u16(data, bond.mtu);
+	put_u16(data, bond.params.min_int);
+	put_u16(data, bond.params.max_int);
+	put_u16(data, bond.params.latency);
+	put_u16(data, bond.params.timeout);
+	data.push_back(bond.cccd.size());
+	for(auto &it : bond.cccd){
+		put_u16(data, it.first);
+		put_u16(data, it.second);
+	}
+}
+
+bool cBtBondStore::Decode(const std::vector<uint8_t> &data, sBtBond &bond){
+	const size_t hdrLen = 1 + BOND_ADDR_LEN + 4 + 2 + 8 + 1;
+	if(data.size() < hdrLen || data[0] != BOND_VERSION)
+		return false;
+	const uint8_t *p = &data[1];
+	memcpy(bond.bda, p, BOND_ADDR_LEN);
+	p += BOND_ADDR_LEN;
+	bond.dbHash = get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+	bond.mtu = get_u16(p + 4);
+	bond.params.min_int = get_u16(p + 6);
+	bond.params.max_int = get_u16(p + 8);
+	bond.params.latency = get_u16(p + 10);
+	bond.params.timeout = get_u16(p + 12);
+	size_t count = p[14];
+	p += 15;
+	if(data.size() != hdrLen + count * 4)
+		return false;
+	bond.cccd.clear();
+	for(size_t i = 0; i < count; i++, p += 4)
+		bond.cccd[get_u16(p)] = get_u16(p + 2);
+	return true;
+}
+
+void cBtBondStore::indexLoad(){
+	if(m_bIndexLoaded)
+		return;
+	if(!m_pFlash->GetVal(BOND_INDEX_KEY, m_index) || m_index.size() % BOND_ADDR_LEN)
+		m_index.clear();
+	m_bIndexLoaded = true;
+}
+
+int cBtBondStore::indexFind(const esp_bd_addr_t bda){
+	for(size_t i = 0; i < m_index.size(); i += BOND_ADDR_LEN){
+		if(memcmp(&m_index[i], bda, BOND_ADDR_LEN) == 0)
+			return i;
+	}
+	return -1;
+}
+
+bool cBtBondStore::Load(const esp_bd_addr_t bda, sBtBond &bond){
+	std::vector<uint8_t> data;
+	if(!m_pFlash->GetVal(key(bda), data))
+		return false;
+	if(!Decode(data, bond) || memcmp(bond.bda, bda, BOND_ADDR_LEN) != 0){
+		ESP_LOGE(LOG_TAG, "Bad record %s", key(bda).c_str());
+		return false;
+	}
+	return true;
+}
+
+bool cBtBondStore::Save(const sBtBond &bond){
+	indexLoad();
+	int pos = indexFind(bond.bda);
+	if(pos >= 0)
+		m_index.erase(m_index.begin() + pos, m_index.begin() + pos + BOND_ADDR_LEN);
+	m_index.insert(m_index.end(), bond.bda, bond.bda + BOND_ADDR_LEN);
+	while(m_index.size() > BT_BOND_MAX_PEERS * BOND_ADDR_LEN){
+		m_pFlash->Erase(key(&m_index[0]));
+		m_index.erase(m_index.begin(), m_index.begin() + BOND_ADDR_LEN);
+	}
+
+	std::vector<uint8_t> data;
+	Encode(bond, data);
+	bool bOk = m_pFlash->SetVal(key(bond.bda), data) && m_pFlash->SetVal(BOND_INDEX_KEY, m_index);
+	return m_pFlash->Commit() && bOk;
+}
+
+bool cBtBondStore::Erase(const esp_bd_addr_t bda){
+	indexLoad();
+	int pos = indexFind(bda);
+	if(pos >= 0){
+		m_index.erase(m_index.begin() + pos, m_index.begin() + pos + BOND_ADDR_LEN);
+		if(m_index.empty())
+			m_pFlash->Erase(BOND_INDEX_KEY);
+		else
+			m_pFlash->SetVal(BOND_INDEX_KEY, m_index);
+	}
+	bool bOk = m_pFlash->Erase(key(bda));
+	return m_pFlash->Commit() && bOk;
+}
+
+void cBtBondStore::EraseAll(){
+	m_pFlash->EraseAll();
+	m_pFlash->Commit();
+	m_index.clear();
+	m_bIndexLoaded = true;
+}
@@ -0,0 +1,55 @@
+/*
+ * cBtBondStore.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Persistent state of the bonded clients: CCCD subscriptions, MTU and connection parameters
+ */
+
+#ifndef COMPONENTS_M_BT_CBTBONDSTORE_H_
+#define COMPONENTS_M_BT_CBTBONDSTORE_H_
+
+#include <stdint.h>
+#include <esp_bt_defs.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "cBtConnPolicy.h"
+
+class cFlash;
+
+#define BT_BOND_MAX_PEERS		8 // the least recently saved peer is dropped
+
+struct sBtBond{
+	esp_bd_addr_t bda; // identity address
+	uint32_t dbHash; // attribute table of the server when saved, the handles are valid only for the same table
+	uint16_t mtu; // the last negotiated
+	sBtConnParams params; // the last accepted, interval in min_int and max_int, 0 if unknown
+	std::map<uint16_t, uint16_t> cccd; // CCCD values by the descriptor handle
+};
+
+// NVS backed store of the bonds
+class cBtBondStore {
+public:
+	cBtBondStore(const std::string &storageName = "btbonds");
+	~cBtBondStore();
+
+	bool Load(const esp_bd_addr_t bda, sBtBond &bond);
+	bool Save(const sBtBond &bond);
+	bool Erase(const esp_bd_addr_t bda);
+	void EraseAll();
+
+	// record format, no flash access
+	static void Encode(const sBtBond &bond, std::vector<uint8_t> &data);
+	static bool Decode(const std::vector<uint8_t> &data, sBtBond &bond);
+
+private:
+	cFlash *m_pFlash;
+	std::vector<uint8_t> m_index; // addresses of the saved peers, 6 bytes each, the last saved at the end
+	bool m_bIndexLoaded;
+
+	static std::string key(const esp_bd_addr_t bda);
+	void indexLoad();
+	int indexFind(const esp_bd_addr_t bda);
+};
+
+#endif /* COMPONENTS_M_BT_CBTBONDSTORE_H_ */
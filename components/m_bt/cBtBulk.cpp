@@ -0,0 +1,193 @@
+/*
+ * cBtBulk.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtBulk.h"
+
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtBulk";
+
+static void put16(std::vector<uint8_t> &v, uint16_t val){
+	v.push_back(val & 0xff);
+	v.push_back(val >> 8);
+}
+
+static void put32(std::vector<uint8_t> &v, uint32_t val){
+	put16(v, val & 0xffff);
+	put16(v, val >> 16);
+}
+
+static uint16_t get16(const uint8_t *p){
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p){
+	return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+void sBtBulkCtrl::Encode(std::vector<uint8_t> &frame)const{
+	frame.clear();
+	frame.push_back((uint8_t)op);
+	frame.push_back(obj);
+	frame.push_back(status);
+	frame.push_back(window);
+	put16(frame, chunk);
+	put32(frame, total);
+	put32(frame, offset);
+}
+
+bool sBtBulkCtrl::Decode(const uint8_t *frame, size_t len){
+	if(len < BT_BULK_CTRL_LEN || frame[0] < (uint8_t)eBtBulkOp::e_get || frame[0] > (uint8_t)eBtBulkOp::e_abort)
+		return false;
+	op = (eBtBulkOp)frame[0];
+	obj = frame[1];
+	status = frame[2];
+	window = frame[3];
+	chunk = get16(frame + 4);
+	total = get32(frame + 6);
+	offset = get32(frame + 10);
+	return true;
+}
+
+uint16_t BtBulkCrc16(const uint8_t *data, size_t len, uint16_t crc){
+	while(len--){
+		crc ^= (uint16_t)*data++ << 8;
+		for(int i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+//===================================== cBtBulkSender =============================
+
+cBtBulkSender::cBtBulkSender():TimeoutMs(1000), MaxRetries(5), m_pCb(nullptr), m_total(0), m_start(0), m_acked(0), m_next(0),
+		m_sent(0), m_lastProgress(0), m_chunk(0), m_window(0), m_obj(0), m_retries(0), m_bActive(false) {
+}
+
+void cBtBulkSender::Start(cBtBulkCallbacks *pCb, uint8_t obj, uint32_t total, uint32_t offset, uint16_t chunk, uint8_t window, uint32_t now){
+	m_pCb = pCb;
+	m_obj = obj;
+	m_total = total;
+	m_start = m_acked = m_next = m_sent = offset > total ? total : offset;
+	m_chunk = chunk ? chunk : 1;
+	m_window = window ? window : 1;
+	m_lastProgress = now;
+	m_retries = 0;
+	m_bActive = true;
+}
+
+void cBtBulkSender::Stop(){
+	m_bActive = false;
+}
+
+bool cBtBulkSender::Next(uint32_t now, std::vector<uint8_t> &pkt){
+	if(!m_bActive || m_next >= m_total || m_next - m_acked >= (uint32_t)m_window * m_chunk)
+		return false;
+	size_t len = m_total - m_next < m_chunk ? m_total - m_next : m_chunk;
+	uint16_t seq = (m_next - m_start) / m_chunk;
+	pkt.resize(BT_BULK_SEQ_LEN + len);
+	pkt[0] = seq & 0xff;
+	pkt[1] = seq >> 8;
+	if(m_pCb->Read(m_obj, m_next, pkt.data() + BT_BULK_SEQ_LEN, len) != len){
+		ESP_LOGE(LOG_TAG, "Read of %d bytes at %d failed", len, m_next);
+		return false;
+	}
+	put16(pkt, BtBulkCrc16(pkt.data(), pkt.size()));
+	m_next += len;
+	if(m_next > m_sent)
+		m_sent = m_next;
+	return true;
+}
+
+void cBtBulkSender::OnAck(uint32_t offset, uint32_t now){
+	if(!m_bActive || offset > m_sent)
+		return;
+	if(offset > m_acked){
+		m_acked = offset;
+		m_retries = 0;
+		m_lastProgress = now;
+		// the receiver got the packets sent before the go back
+		if(m_next < m_acked)
+			m_next = m_acked;
+	}else if(offset == m_acked && m_next > m_acked){
+		// the receiver has missed a packet, go back
+		m_next = m_acked;
+	}
+}
+
+bool cBtBulkSender::Tick(uint32_t now){
+	if(!m_bActive || m_acked == m_total)
+		return true;
+	if(now - m_lastProgress < TimeoutMs)
+		return true;
+	if(++m_retries > MaxRetries){
+		ESP_LOGE(LOG_TAG, "No ack at %d", m_acked);
+		m_bActive = false;
+		return false;
+	}
+	m_next = m_acked;
+	m_lastProgress = now;
+	return true;
+}
+
+//===================================== cBtBulkReceiver =============================
+
+cBtBulkReceiver::cBtBulkReceiver():AckEvery(0), m_pCb(nullptr), m_total(0), m_start(0), m_offset(0), m_chunk(0), m_obj(0),
+		m_ackEvery(1), m_sinceAck(0), m_lastSeq(0), m_bNakSent(false), m_bFailed(false), m_bActive(false) {
+}
+
+void cBtBulkReceiver::Start(cBtBulkCallbacks *pCb, uint8_t obj, uint32_t total, uint32_t offset, uint16_t chunk, uint8_t window){
+	m_pCb = pCb;
+	m_obj = obj;
+	m_total = total;
+	m_start = m_offset = offset > total ? total : offset;
+	m_chunk = chunk ? chunk : 1;
+	m_ackEvery = AckEvery ? AckEvery : window > 1 ? window / 2 : 1;
+	m_sinceAck = 0;
+	m_lastSeq = 0xffff;
+	m_bNakSent = false;
+	m_bFailed = false;
+	m_bActive = true;
+}
+
+void cBtBulkReceiver::Stop(){
+	m_bActive = false;
+}
+
+bool cBtBulkReceiver::OnPacket(const uint8_t *pkt, size_t len){
+	if(!m_bActive || len < BT_BULK_OVERHEAD)
+		return false;
+	if(m_offset == m_total)
+		return true; // the last ack is lost, repeat it
+	uint16_t seq = get16(pkt);
+	uint16_t expected = (m_offset - m_start) / m_chunk;
+	size_t dataLen = len - BT_BULK_OVERHEAD;
+	size_t expectedLen = m_total - m_offset < m_chunk ? m_total - m_offset : m_chunk;
+	uint16_t lastSeq = m_lastSeq;
+	m_lastSeq = seq;
+	if(BtBulkCrc16(pkt, len - BT_BULK_CRC_LEN) != get16(pkt + len - BT_BULK_CRC_LEN) || seq != expected || dataLen != expectedLen){
+		// repeat the ack once per gap, the following packets of the window are dropped silently;
+		// the resend after the timeout (the repeated ack is lost) is answered again
+		if(m_bNakSent && (int16_t)(seq - lastSeq) > 0)
+			return false;
+		m_bNakSent = true;
+		m_sinceAck = 0;
+		return true;
+	}
+	if(!m_pCb->Write(m_obj, m_offset, pkt + BT_BULK_SEQ_LEN, dataLen)){
+		ESP_LOGE(LOG_TAG, "Write of %d bytes at %d failed", dataLen, m_offset);
+		m_bFailed = true;
+		m_bActive = false;
+		return false;
+	}
+	m_offset += dataLen;
+	m_bNakSent = false;
+	if(++m_sinceAck >= m_ackEvery || m_offset == m_total){
+		m_sinceAck = 0;
+		return true;
+	}
+	return false;
+}
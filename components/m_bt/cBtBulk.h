@@ -0,0 +1,142 @@
+/*
+ * cBtBulk.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Bulk transfer protocol: sequence numbered packets with CRC, sliding window acks, resumable offsets
+ */
+
+#ifndef COMPONENTS_M_BT_CBTBULK_H_
+#define COMPONENTS_M_BT_CBTBULK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Data packet: sequence number (2 bytes, LE), data, CRC-16 of the sequence number and data (2 bytes, LE).
+// The sequence number is the packet index from the start offset, the packets have the same size except the last one.
+#define BT_BULK_SEQ_LEN			2
+#define BT_BULK_CRC_LEN			2
+#define BT_BULK_OVERHEAD		(BT_BULK_SEQ_LEN + BT_BULK_CRC_LEN)
+#define BT_BULK_CTRL_LEN		14 // control frame length, fits the default MTU
+
+// Control frame: op, obj, status, window, chunk (2), total (4), offset (4), little endian
+//  e_get   client -> device: read the object obj from offset
+//  e_put   client -> device: write the object obj of total bytes, offset - data the client assumes as received,
+//          chunk - data bytes per packet the client wants to send
+//  e_start device -> client: the transfer parameters, offset - where the data starts (resume point)
+//  e_ack   receiver -> sender: all data before offset are received
+//  e_done  device -> client: the object is transferred (after the last ack of both directions)
+//  e_abort any side: the transfer is stopped, status - reason
+enum class eBtBulkOp : uint8_t {e_get = 1, e_put = 2, e_start = 3, e_ack = 4, e_done = 5, e_abort = 6};
+
+// abort reasons
+#define BT_BULK_ERR_NO_OBJECT	1
+#define BT_BULK_ERR_PARAM		2
+#define BT_BULK_ERR_IO			3
+#define BT_BULK_ERR_TIMEOUT		4
+#define BT_BULK_ERR_CANCEL		5
+
+struct sBtBulkCtrl{
+	eBtBulkOp op;
+	uint8_t obj;
+	uint8_t status;
+	uint8_t window;
+	uint16_t chunk;
+	uint32_t total;
+	uint32_t offset;
+
+	void Encode(std::vector<uint8_t> &frame)const;
+	bool Decode(const uint8_t *frame, size_t len);
+};
+
+// CRC-16/CCITT-FALSE
+uint16_t BtBulkCrc16(const uint8_t *data, size_t len, uint16_t crc = 0xffff);
+
+// Access to the transferred objects, called by the sender and the receiver.
+// inherit this class and define required methods
+class cBtBulkCallbacks{
+public:
+	// size of the object to send, 0 if there is no such object
+	virtual uint32_t GetSize(uint8_t obj){return 0;}
+	virtual size_t Read(uint8_t obj, uint32_t offset, uint8_t *pBuf, size_t len){return 0;}
+	// prepare to receive the object, offset may be changed to the data already received (resume)
+	virtual bool Open(uint8_t obj, uint32_t total, uint32_t &offset){return false;}
+	virtual bool Write(uint8_t obj, uint32_t offset, const uint8_t *pData, size_t len){return false;}
+	// the object is transferred or the transfer is stopped
+	virtual void Done(uint8_t obj, bool bOk){}
+	virtual ~cBtBulkCallbacks(){}
+};
+
+// Sending side, go-back-N: up to window packets are sent without the ack, the sender returns to the acked offset
+// when the receiver repeats the ack (lost or damaged packet) or no ack comes in time. No BT calls here.
+class cBtBulkSender {
+public:
+	uint32_t TimeoutMs; // no progress during this time - resend from the acked offset, default 1000
+	uint8_t MaxRetries; // resends without progress before the transfer fails, default 5
+
+	cBtBulkSender();
+
+	void Start(cBtBulkCallbacks *pCb, uint8_t obj, uint32_t total, uint32_t offset, uint16_t chunk, uint8_t window, uint32_t now);
+	void Stop();
+	bool Busy()const{return m_bActive;}
+	bool Complete()const{return m_bActive && m_acked == m_total;}
+	uint32_t Acked()const{return m_acked;}
+	// offset of the next packet, goes back when the packets are resent
+	uint32_t Sent()const{return m_next;}
+
+	// build the next packet, false if the window is full, everything is sent or the data can't be read
+	bool Next(uint32_t now, std::vector<uint8_t> &pkt);
+	// ack from the receiver
+	void OnAck(uint32_t offset, uint32_t now);
+	// ack timeout check, returns false if the transfer has failed
+	bool Tick(uint32_t now);
+
+private:
+	cBtBulkCallbacks *m_pCb;
+	uint32_t m_total;
+	uint32_t m_start; // offset of the packet with sequence number 0
+	uint32_t m_acked; // received by the receiver
+	uint32_t m_next; // offset of the next packet to send
+	uint32_t m_sent; // end of the data sent so far, the receiver may be ahead of m_next after a go back
+	uint32_t m_lastProgress;
+	uint16_t m_chunk;
+	uint8_t m_window;
+	uint8_t m_obj;
+	uint8_t m_retries;
+	bool m_bActive;
+};
+
+// Receiving side, accepts only the next expected packet. No BT calls here.
+class cBtBulkReceiver {
+public:
+	uint8_t AckEvery; // ack after this number of packets, 0 (default) - half of the window
+
+	cBtBulkReceiver();
+
+	void Start(cBtBulkCallbacks *pCb, uint8_t obj, uint32_t total, uint32_t offset, uint16_t chunk, uint8_t window);
+	void Stop();
+	bool Busy()const{return m_bActive;}
+	bool Complete()const{return m_bActive && m_offset == m_total;}
+	bool Failed()const{return m_bFailed;}
+	// data before this offset are received and written
+	uint32_t Offset()const{return m_offset;}
+
+	// process the data packet, returns true if the ack of Offset() should be sent now
+	bool OnPacket(const uint8_t *pkt, size_t len);
+
+private:
+	cBtBulkCallbacks *m_pCb;
+	uint32_t m_total;
+	uint32_t m_start;
+	uint32_t m_offset;
+	uint16_t m_chunk;
+	uint8_t m_obj;
+	uint8_t m_ackEvery;
+	uint8_t m_sinceAck; // packets received after the last ack
+	uint16_t m_lastSeq; // sequence number of the last packet, a lower one means the sender has gone back
+	bool m_bNakSent; // the repeated ack for the current gap is sent
+	bool m_bFailed; // write error
+	bool m_bActive;
+};
+
+#endif /* COMPONENTS_M_BT_CBTBULK_H_ */
@@ -0,0 +1,200 @@
+/*
+ * cBtBulkService.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtBulkService.h"
+#include "BLE2902.h"
+
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtBulkService";
+
+#define BULK_WINDOW_DEF			8
+#define BULK_POLL_MS			20		// sending pace while the stack is congested
+#define BULK_RX_TIMEOUT_MS		10000	// no data from the client - the transfer is dropped
+#define BULK_MAX_PAYLOAD		(ESP_GATT_MAX_MTU_SIZE - 3)
+
+cBtBulkService::cBtBulkService():m_pServ(nullptr), m_pCtrl(nullptr), m_pData(nullptr), m_pCb(nullptr), m_bPkt(false), m_bActive(false),
+		m_obj(0), m_lastRx(0), Window(BULK_WINDOW_DEF) {
+	m_wake = xSemaphoreCreateBinary();
+}
+
+cBtBulkService::~cBtBulkService() {
+	Abort();
+	if(IsTaskExists())
+		TaskDelete();
+	vSemaphoreDelete(m_wake);
+}
+
+void cBtBulkService::Init(cBtService *pSvc, const BLEUUID &ctrlUuid, const BLEUUID &dataUuid, cBtBulkCallbacks *pCb){
+	m_pCb = pCb;
+	m_pServ = pSvc->pServ;
+
+	m_pCtrl = pSvc->CharCreate(ctrlUuid);
+	m_pCtrl->setProperties(cBtCharacteristic::PROPERTY_WRITE | cBtCharacteristic::PROPERTY_NOTIFY);
+	m_pCtrl->setMaxLength(BT_BULK_CTRL_LEN);
+	m_pCtrl->DescAdd(new BLE2902());
+	m_pCtrl->setCallbacks(this);
+
+	m_pData = pSvc->CharCreate(dataUuid);
+	m_pData->setProperties(cBtCharacteristic::PROPERTY_WRITE_NR | cBtCharacteristic::PROPERTY_NOTIFY);
+	m_pData->setMaxLength(BULK_MAX_PAYLOAD);
+	m_pData->DescAdd(new BLE2902());
+	m_pData->setCallbacks(this);
+}
+
+void cBtBulkService::Abort(){
+	cAutoLock lock(m_lock);
+	finish(false, BT_BULK_ERR_CANCEL);
+}
+
+void cBtBulkService::wake(){
+	if(!IsTaskExists()){
+		TaskCreate("BT Bulk", 5, 3072);
+	}
+	xSemaphoreGive(m_wake);
+}
+
+void cBtBulkService::reply(eBtBulkOp op, uint8_t status, uint8_t window, uint16_t chunk, uint32_t total, uint32_t offset){
+	sBtBulkCtrl ctrl{op, m_obj, status, window, chunk, total, offset};
+	std::vector<uint8_t> frame;
+	ctrl.Encode(frame);
+	m_pCtrl->setValue(frame.data(), frame.size());
+	m_pCtrl->notify();
+}
+
+// stop the transfer, the lock is taken
+void cBtBulkService::finish(bool bOk, uint8_t status, bool bReply){
+	m_tx.Stop();
+	m_rx.Stop();
+	m_bPkt = false;
+	if(!m_bActive)
+		return;
+	m_bActive = false;
+	m_pServ->setLinkActivity(BT_LINK_BULK, false);
+	if(bReply)
+		reply(bOk ? eBtBulkOp::e_done : eBtBulkOp::e_abort, status);
+	m_pCb->Done(m_obj, bOk);
+}
+
+void cBtBulkService::AftereWrite(cBtCharacteristic *pCaller){
+	if(pCaller == m_pData){
+		cAutoLock lock(m_lock);
+		m_lastRx = GetTickCount();
+		if(m_rx.OnPacket(pCaller->getData(), pCaller->getLength()))
+			reply(eBtBulkOp::e_ack, 0, 0, 0, 0, m_rx.Offset());
+		if(m_rx.Failed())
+			finish(false, BT_BULK_ERR_IO);
+		else if(m_rx.Complete())
+			finish(true, 0);
+		return;
+	}
+	sBtBulkCtrl ctrl;
+	if(pCaller != m_pCtrl || !ctrl.Decode(pCaller->getData(), pCaller->getLength())){
+		ESP_LOGE(LOG_TAG, "Wrong control frame");
+		return;
+	}
+	cAutoLock lock(m_lock);
+	onControl(ctrl);
+}
+
+// control frame from the client, the lock is taken
+void cBtBulkService::onControl(const sBtBulkCtrl &ctrl){
+	uint8_t window = ctrl.window && ctrl.window < Window ? ctrl.window : Window;
+	switch(ctrl.op){
+	case eBtBulkOp::e_get: {
+		finish(false, BT_BULK_ERR_CANCEL); // a new request replaces the current one
+		m_obj = ctrl.obj;
+		uint32_t total = m_pCb->GetSize(ctrl.obj);
+		uint16_t payload = m_pData->getNotifyPayload(); // the client has to subscribe to the data first
+		if(!total){
+			reply(eBtBulkOp::e_abort, BT_BULK_ERR_NO_OBJECT);
+			break;
+		}
+		if(ctrl.offset > total || payload <= BT_BULK_OVERHEAD){
+			reply(eBtBulkOp::e_abort, BT_BULK_ERR_PARAM);
+			break;
+		}
+		uint16_t chunk = payload - BT_BULK_OVERHEAD;
+		ESP_LOGD(LOG_TAG, "Sending object %d: %d bytes from %d by %d", ctrl.obj, total, ctrl.offset, chunk);
+		m_tx.Start(m_pCb, ctrl.obj, total, ctrl.offset, chunk, window, GetTickCount());
+		m_bActive = true;
+		m_pServ->setLinkActivity(BT_LINK_BULK, true);
+		reply(eBtBulkOp::e_start, 0, window, chunk, total, ctrl.offset);
+		wake();
+		break;
+	}
+	case eBtBulkOp::e_put: {
+		finish(false, BT_BULK_ERR_CANCEL);
+		m_obj = ctrl.obj;
+		uint32_t offset = ctrl.offset;
+		if(!m_pCb->Open(ctrl.obj, ctrl.total, offset)){
+			reply(eBtBulkOp::e_abort, BT_BULK_ERR_NO_OBJECT);
+			break;
+		}
+		if(offset > ctrl.total || !ctrl.chunk){
+			reply(eBtBulkOp::e_abort, BT_BULK_ERR_PARAM);
+			break;
+		}
+		uint16_t chunk = ctrl.chunk < BULK_MAX_PAYLOAD - BT_BULK_OVERHEAD ? ctrl.chunk : BULK_MAX_PAYLOAD - BT_BULK_OVERHEAD;
+		ESP_LOGD(LOG_TAG, "Receiving object %d: %d bytes from %d by %d", ctrl.obj, ctrl.total, offset, chunk);
+		m_rx.Start(m_pCb, ctrl.obj, ctrl.total, offset, chunk, window);
+		m_bActive = true;
+		m_pServ->setLinkActivity(BT_LINK_BULK, true);
+		m_lastRx = GetTickCount();
+		reply(eBtBulkOp::e_start, 0, window, chunk, ctrl.total, offset);
+		if(m_rx.Complete())
+			finish(true, 0);
+		else
+			wake(); // receiving timeout
+		break;
+	}
+	case eBtBulkOp::e_ack: {
+		uint32_t sent = m_tx.Sent();
+		m_tx.OnAck(ctrl.offset, GetTickCount());
+		if(m_tx.Sent() < sent)
+			m_bPkt = false; // resent from the acked offset
+		xSemaphoreGive(m_wake);
+		break;
+	}
+	case eBtBulkOp::e_abort:
+		finish(false, ctrl.status, false);
+		break;
+	default:
+		break;
+	}
+}
+
+void cBtBulkService::TaskHandler(){
+	while(true){
+		uint32_t waitMs = portMAX_DELAY;
+		{
+			cAutoLock lock(m_lock);
+			uint32_t now = GetTickCount();
+			if(m_tx.Busy()){
+				while(m_bPkt || m_tx.Next(now, m_pkt)){
+					m_bPkt = true;
+					if(!m_pData->notifyData(m_pkt.data(), m_pkt.size()))
+						break; // congested, the packet is kept
+					m_bPkt = false;
+				}
+				uint32_t sent = m_tx.Sent();
+				if(m_tx.Complete()){
+					finish(true, 0);
+				}else if(!m_tx.Tick(now)){
+					finish(false, BT_BULK_ERR_TIMEOUT);
+				}else if(m_tx.Sent() < sent){
+					m_bPkt = false;
+				}
+				waitMs = BULK_POLL_MS;
+			}else if(m_rx.Busy()){
+				if(now - m_lastRx > BULK_RX_TIMEOUT_MS)
+					finish(false, BT_BULK_ERR_TIMEOUT);
+				waitMs = 1000;
+			}
+		}
+		xSemaphoreTake(m_wake, waitMs == portMAX_DELAY ? portMAX_DELAY : waitMs / portTICK_PERIOD_MS);
+	}
+}
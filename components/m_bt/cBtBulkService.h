@@ -0,0 +1,54 @@
+/*
+ * cBtBulkService.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Bulk transfer of the objects (firmware, reports, logs) over the control and data characteristics
+ */
+
+#ifndef COMPONENTS_M_BT_CBTBULKSERVICE_H_
+#define COMPONENTS_M_BT_CBTBULKSERVICE_H_
+
+#include "../../main/common/cBaseTask.h"
+#include "cBtServer.h"
+#include "cBtBulk.h"
+
+// The client controls the transfer by writing the control frames (sBtBulkCtrl) to the control characteristic,
+// the device answers by its notifications. The data packets go by the notifications of the data characteristic
+// (device -> client) or by the writes without response to it (client -> device).
+// The packets are sent from the own task, it runs while a transfer is active.
+// cBtBulkCallbacks are called from the BT and the service task, one at a time.
+class cBtBulkService: private cBaseTask, private cBtCharCallbacks {
+	cBtServer *m_pServ;
+	cBtCharacteristic *m_pCtrl;
+	cBtCharacteristic *m_pData;
+	cBtBulkCallbacks *m_pCb;
+	cBtBulkSender m_tx;
+	cBtBulkReceiver m_rx;
+	cMutex m_lock; // the transfer state is changed by the BT events and the task
+	SemaphoreHandle_t m_wake;
+	std::vector<uint8_t> m_pkt; // packet not sent because of the congestion
+	bool m_bPkt;
+	bool m_bActive; // a transfer is started and Done() is not called yet
+	uint8_t m_obj;
+	uint32_t m_lastRx; // time of the last received packet
+public:
+	uint8_t Window; // max packets without ack, default 8
+
+	cBtBulkService();
+	~cBtBulkService();
+
+	// add the characteristics to the service, call it before cBtServer::Start()
+	void Init(cBtService *pSvc, const BLEUUID &ctrlUuid, const BLEUUID &dataUuid, cBtBulkCallbacks *pCb);
+	// stop the current transfer
+	void Abort();
+
+private:
+	void AftereWrite(cBtCharacteristic *pCaller);
+	void TaskHandler();
+	void onControl(const sBtBulkCtrl &ctrl);
+	void reply(eBtBulkOp op, uint8_t status, uint8_t window = 0, uint16_t chunk = 0, uint32_t total = 0, uint32_t offset = 0);
+	void finish(bool bOk, uint8_t status, bool bReply = true);
+	void wake();
+};
+
+#endif /* COMPONENTS_M_BT_CBTBULKSERVICE_H_ */
@@ -0,0 +1,97 @@
+/*
+ * cBtCharValue.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtCharValue.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtCharValue";
+
+cBtCharValue::cBtCharValue():m_pData(nullptr), m_len(0), m_maxLen(BT_VALUE_MAX_LEN), m_version(0) {
+}
+
+cBtCharValue::~cBtCharValue(){
+	free(m_pData);
+}
+
+bool cBtCharValue::allocate(){
+	if(m_pData)
+		return true;
+	m_pData = (uint8_t*)malloc(m_maxLen);
+	if(!m_pData){
+		ESP_LOGE(LOG_TAG, "No memory for the value: %d", m_maxLen);
+		return false;
+	}
+	return true;
+}
+
+void cBtCharValue::setMaxLength(size_t maxLen){
+	if(maxLen < 1)
+		maxLen = 1;
+	if(maxLen > BT_VALUE_MAX_LEN)
+		maxLen = BT_VALUE_MAX_LEN;
+	if(maxLen == m_maxLen)
+		return;
+	uint8_t *pData = nullptr;
+	if(m_pData){
+		pData = (uint8_t*)malloc(maxLen);
+		if(!pData){
+			ESP_LOGE(LOG_TAG, "No memory for the value: %d", maxLen);
+			return;
+		}
+		if(m_len > maxLen)
+			m_len = maxLen;
+		memcpy(pData, m_pData, m_len);
+		free(m_pData);
+	}
+	m_pData = pData;
+	m_maxLen = maxLen;
+	m_version++;
+}
+
+bool cBtCharValue::setValue(const uint8_t *pData, size_t length){
+	if(!allocate())
+		return false;
+	bool bFits = length <= m_maxLen;
+	if(!bFits){
+		ESP_LOGE(LOG_TAG, "Value is truncated: %d > %d", length, m_maxLen);
+		length = m_maxLen;
+	}
+	memcpy(m_pData, pData, length);
+	m_len = length;
+	m_version++;
+	return bFits;
+}
+
+void cBtCharValue::clear(){
+	m_len = 0;
+	m_version++;
+}
+
+eBtValueResult cBtCharValue::read(size_t offset, size_t maxLen, uint8_t *pDst, size_t &len)const{
+	len = 0;
+	if(offset > m_len)
+		return eBtValueResult::e_invalid_offset;
+	len = m_len - offset < maxLen ? m_len - offset : maxLen;
+	if(len)
+		memcpy(pDst, m_pData + offset, len);
+	return eBtValueResult::e_ok;
+}
+
+eBtValueResult cBtCharValue::append(size_t offset, const uint8_t *pData, size_t length){
+	if(offset != m_len)
+		return eBtValueResult::e_invalid_offset;
+	if(m_len + length > m_maxLen)
+		return eBtValueResult::e_invalid_len;
+	if(!allocate())
+		return eBtValueResult::e_invalid_len;
+	memcpy(m_pData + m_len, pData, length);
+	m_len += length;
+	m_version++;
+	return eBtValueResult::e_ok;
+}
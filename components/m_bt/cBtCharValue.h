@@ -0,0 +1,55 @@
+/*
+ * cBtCharValue.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Fixed capacity storage of the characteristic value, offset reads and prepared writes
+ */
+
+#ifndef COMPONENTS_M_BT_CBTCHARVALUE_H_
+#define COMPONENTS_M_BT_CBTCHARVALUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BT_VALUE_MAX_LEN		600 // the biggest attribute value, ESP_GATT_MAX_ATTR_LEN
+
+// result of the value access, the caller maps it to the ATT error
+enum class eBtValueResult{e_ok, e_invalid_offset, e_invalid_len};
+
+// The buffer is allocated once (by setMaxLength() or the first setValue()) and is not reallocated
+// by the value updates. No BT calls here.
+class cBtCharValue {
+public:
+	cBtCharValue();
+	~cBtCharValue();
+	cBtCharValue(const cBtCharValue&) = delete;
+	cBtCharValue& operator=(const cBtCharValue&) = delete;
+
+	// capacity of the buffer, 1..BT_VALUE_MAX_LEN, default BT_VALUE_MAX_LEN; the current value is kept if it fits
+	void setMaxLength(size_t maxLen);
+	size_t getMaxLength()const{return m_maxLen;}
+
+	const uint8_t* getData()const{return m_pData;}
+	size_t getLength()const{return m_len;}
+	// changed by every update, a value read in parts must have the same version
+	uint32_t getVersion()const{return m_version;}
+
+	// the longer value is truncated, returns false then
+	bool setValue(const uint8_t *pData, size_t length);
+	void clear();
+
+	// copy up to maxLen bytes from offset (offset equal to the length gives 0 bytes)
+	eBtValueResult read(size_t offset, size_t maxLen, uint8_t *pDst, size_t &len)const;
+	// prepared write: the part is appended, its offset must be the current length
+	eBtValueResult append(size_t offset, const uint8_t *pData, size_t length);
+
+private:
+	uint8_t *m_pData;
+	size_t m_len;
+	size_t m_maxLen;
+	uint32_t m_version;
+
+	bool allocate();
+};
+
+#endif /* COMPONENTS_M_BT_CBTCHARVALUE_H_ */
@@ -16,128 +16,14 @@
 
 static const char* LOG_TAG = "cBtCharacteristic";
 
-cBtCharValue::cBtCharValue() {
-	m_accumulation = "";
-	m_value        = "";
-	m_readOffset   = 0;
-	b_accumulation_ongoing = false;
-} // cBtCharValue
-
-
-/**
- * @brief Add a message part to the accumulation.
- * The accumulation is a growing set of data that is added to until a commit or cancel.
- * @param [in] part A message part being added.
- */
-void cBtCharValue::addPart(const std::string &part) {
-	ESP_LOGD(LOG_TAG, ">> addPart: length=%d", part.length());
-	m_accumulation += part;
-	b_accumulation_ongoing = true;
-} // addPart
-
-
-/**
- * @brief Add a message part to the accumulation.
- * The accumulation is a growing set of data that is added to until a commit or cancel.
- * @param [in] pData A message part being added.
- * @param [in] length The number of bytes being added.
- */
-void cBtCharValue::addPart(uint8_t* pData, size_t length) {
-	ESP_LOGD(LOG_TAG, ">> addPart: length=%d", length);
-	m_accumulation += std::string((char *)pData, length);
-	b_accumulation_ongoing = true;
-} // addPart
-
-
-/**
- * @brief Cancel the current accumulation.
- */
-void cBtCharValue::cancel() {
-	ESP_LOGD(LOG_TAG, ">> cancel");
-	m_accumulation = "";
-	m_readOffset   = 0;
-	b_accumulation_ongoing = false;
-} // cancel
-
-
-/**
- * @brief Commit the current accumulation.
- * When writing a value, we may find that we write it in "parts" meaning that the writes come in in pieces
- * of the overall message.  After the last part has been received, we may perform a commit which means that
- * we now have the complete message and commit the change as a unit.
- */
-void cBtCharValue::commit() {
-	ESP_LOGD(LOG_TAG, ">> commit");
-	// If there is nothing to commit, do nothing.
-	if (m_accumulation.length() == 0) {
-		return;
-	}
-	setValue(m_accumulation);
-	m_accumulation = "";
-	m_readOffset   = 0;
-	b_accumulation_ongoing = false;
-} // commit
-
-/**
- * @brief True if BLE execute write is allowed for this value.
- * When doing multi-packet writes (prepare write), the individual packets
- * are accumulated. To finalize the write an exec_write event is sent.
- * This method answers whether or not an exec write is allowed/possible for this value.
- */
-bool cBtCharValue::execAllowed(void){
-	return this->b_accumulation_ongoing;
-}
-
-/**
- * @brief Get the read offset.
- * @return The read offset into the read.
- */
-uint16_t cBtCharValue::getReadOffset() {
-	return m_readOffset;
-} // getReadOffset
-
-
-/**
- * @brief Get the current value.
- */
-const std::string& cBtCharValue::getValue() {
-	return m_value;
-} // getValue
-
-
-/**
- * @brief Set the read offset
- * @param [in] readOffset The offset into the read.
- */
-void cBtCharValue::setReadOffset(uint16_t readOffset) {
-	m_readOffset = readOffset;
-} // setReadOffset
-
-
-/**
- * @brief Set the current value.
- */
-void cBtCharValue::setValue(const std::string &value) {
-	m_value = value;
-} // setValue
-
-
-/**
- * @brief Set the current value.
- * @param [in] pData The data for the current value.
- * @param [in] The length of the new current value.
- */
-void cBtCharValue::setValue(uint8_t* pData, size_t length) {
-	m_value = std::string((char*)pData, length);
-} // setValue
-
-
 //===================================== cBtCharacteristic =============================
 
 cBtCharacteristic::cBtCharacteristic(): m_pCallbacks(nullptr), m_pService(nullptr),
-	m_semaphoreCreateEvt("cBtCharacteristic::CreateEvt"),
-	m_semaphoreConfEvt("cBtCharacteristic::ConfEvt") {
+	m_bFramed(false), m_bStreamPending(false),
+	m_semaphoreCreateEvt("cBtCharacteristic::CreateEvt") {
 	m_properties = (esp_gatt_char_prop_t)0;
+	m_permissions = (esp_gatt_perm_t)0;
+	m_bPermissions = false;
 	m_handle  = uint16_t(-1);
 }
 
@@ -159,6 +45,22 @@ void cBtCharacteristic::setProperties(uint32_t properties){
 	setWriteNoResponseProperty((properties & PROPERTY_WRITE_NR) !=0);
 }
 
+void cBtCharacteristic::setPermissions(esp_gatt_perm_t perm){
+	m_permissions = perm;
+	m_bPermissions = true;
+}
+
+esp_gatt_perm_t cBtCharacteristic::getPermissions(){
+	if(m_bPermissions)
+		return m_permissions;
+	uint16_t perm = 0;
+	if(m_properties & ESP_GATT_CHAR_PROP_BIT_READ)
+		perm |= ESP_GATT_PERM_READ;
+	if(m_properties & (ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR))
+		perm |= ESP_GATT_PERM_WRITE;
+	return (esp_gatt_perm_t)perm;
+}
+
 cBtCharDescriptor* cBtCharacteristic::DescFind(const BLEUUID &uuid){
 	for(auto &d : descriptors){
 		if(d->uuid == uuid)
@@ -206,17 +108,15 @@ void cBtCharacteristic::executeCreate(cBtService* pService) {
 
 	m_semaphoreCreateEvt.Lock();
 
-	const std::string& strValue = m_value.getValue();
-
 	esp_attr_value_t value;
-	value.attr_len     = strValue.length() + 1;
+	value.attr_len     = m_value.getLength();
 	value.attr_max_len = 0; //ESP_GATT_MAX_ATTR_LEN / 4;
-	value.attr_value   = (uint8_t*)strValue.data();
+	value.attr_value   = (uint8_t*)m_value.getData();
 
 	esp_err_t errRc = ::esp_ble_gatts_add_char(
 		m_pService->m_handle,
 		uuid.getNative(),
-		esp_gatt_perm_t(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
+		getPermissions(),
 		getProperties(),
 		&value,
 		&control); // Whether to auto respond or not.
@@ -262,19 +162,51 @@ cBtService* cBtCharacteristic::getService() {
 } // getService
 
 
+cBtServer* cBtCharacteristic::getServer() {
+	return m_pService ? m_pService->pServ : nullptr;
+} // getServer
+
+
 /**
  * @brief Retrieve the current value of the characteristic.
- * @return A pointer to storage containing the current characteristic value.
+ * @return A copy of the current characteristic value.
  */
-const std::string& cBtCharacteristic::getValue() {
-	return m_value.getValue();
+std::string cBtCharacteristic::getValue() {
+	if (m_value.getLength() == 0) {
+		return std::string();
+	}
+	return std::string((const char*)m_value.getData(), m_value.getLength());
 } // getValue
 
 
+/**
+ * @brief Set the capacity of the value storage.
+ * The storage is allocated once and is not reallocated by setValue(), the longer values are rejected.
+ * @param [in] maxLen The maximal value length, up to ESP_GATT_MAX_ATTR_LEN (default).
+ */
+void cBtCharacteristic::setMaxLength(size_t maxLen) {
+	m_value.setMaxLength(maxLen);
+} // setMaxLength
+
+
 void cBtCharacteristic::handleGATTServerEvent(
 		esp_gatts_cb_event_t      event,
 		esp_gatt_if_t             gatts_if,
 		esp_ble_gatts_cb_param_t* param) {
+	handleAttrEvent(event, gatts_if, param);
+
+	// Give each of the descriptors associated with this characteristic the opportunity to handle the
+	// event.
+	for(auto &desc : descriptors){
+		desc->handleGATTServerEvent(event, gatts_if, param);
+	}
+} // handleGATTServerEvent
+
+
+void cBtCharacteristic::handleAttrEvent(
+		esp_gatts_cb_event_t      event,
+		esp_gatt_if_t             gatts_if,
+		esp_ble_gatts_cb_param_t* param) {
 	switch(event) {
 	// Events handled:
 	// ESP_GATTS_ADD_CHAR_EVT
@@ -291,32 +223,8 @@ void cBtCharacteristic::handleGATTServerEvent(
 		// - esp_bd_addr_t bda
 		// - uint8_t exec_write_flag
 		//
-		// param does not provide a characteristic handle or uuid for exec_write
-		// we cannot simply call handleGATTServerEvent for every characteristic when an exec_write
-		// occurs, because AfterWrite callbacks will be triggered on characteristics that weren't even
-		// written. handled by b_accumulation_ongoing of cBtCharValue 
-		case ESP_GATTS_EXEC_WRITE_EVT: {
-			if(m_value.execAllowed()){
-				if (param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC){
-					m_value.commit();
-					if (m_pCallbacks != nullptr) {
-						m_pCallbacks->AftereWrite(this); // Invoke the onWrite callback handler.
-					}
-				}else{
-					// ESP_GATT_PREP_WRITE_CANCEL
-					m_value.cancel();
-				}
-
-				esp_err_t errRc = ::esp_ble_gatts_send_response(
-					gatts_if,
-					param->write.conn_id,
-					param->write.trans_id, ESP_GATT_OK, nullptr);
-				if (errRc != ESP_OK) {
-					ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
-				}
-			}
-			break;
-		} // ESP_GATTS_EXEC_WRITE_EVT
+		// param does not provide a characteristic handle or uuid for exec_write,
+		// the server executes the prepared writes of the client with execWrite() and sends the response.
 
 
 		// ESP_GATTS_ADD_CHAR_EVT - Indicate that a characteristic was added to the service.
@@ -354,10 +262,49 @@ void cBtCharacteristic::handleGATTServerEvent(
 // we save the new value.  Next we look at the need_rsp flag which indicates whether or not we need
 // to send a response.  If we do, then we formulate a response and send it.
 			if (param->write.handle == m_handle) {
+				if (m_fragmenter.CreditsEnabled() && !param->write.is_prep && param->write.len == 1) {
+					// credits for the stream fragments
+					m_streamLock.Lock();
+					m_fragmenter.AddCredits(param->write.value[0]);
+					m_streamLock.Unlock();
+					if (param->write.need_rsp) {
+						esp_err_t errRc = ::esp_ble_gatts_send_response(
+								gatts_if, param->write.conn_id, param->write.trans_id, ESP_GATT_OK, nullptr);
+						if (errRc != ESP_OK) {
+							ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
+						}
+					}
+					streamSend();
+					break;
+				}
+				esp_gatt_status_t status = ESP_GATT_OK;
 				if (param->write.is_prep) {
-					m_value.addPart(param->write.value, param->write.len);
+					// the parts are collected for every client separately, one characteristic at a time
+					cAutoLock lock(getService()->pServ->m_connLock);
+					sBtConnection *pConn = getService()->pServ->getConnection(param->write.conn_id);
+					if (pConn == nullptr) {
+						status = ESP_GATT_ERROR;
+					} else if (pConn->prepHandle != uint16_t(-1) && pConn->prepHandle != m_handle) {
+						status = ESP_GATT_PREPARE_Q_FULL;
+					} else if (param->write.offset + param->write.len > m_value.getMaxLength()) {
+						status = ESP_GATT_INVALID_ATTR_LEN;
+					} else {
+						switch (pConn->prepare.append(param->write.offset, param->write.value, param->write.len)) {
+						case eBtValueResult::e_ok:
+							pConn->prepHandle = m_handle;
+							break;
+						case eBtValueResult::e_invalid_offset:
+							status = ESP_GATT_INVALID_OFFSET;
+							break;
+						default:
+							status = ESP_GATT_INVALID_ATTR_LEN;
+							break;
+						}
+					}
+				} else if (param->write.len > m_value.getMaxLength()) {
+					status = ESP_GATT_INVALID_ATTR_LEN;
 				} else {
-					setValue(param->write.value, param->write.len);
+					m_value.setValue(param->write.value, param->write.len);
 				}
 
 				ESP_LOGD(LOG_TAG, " - Response to write event: New value: handle: %.2x, uuid: %s",
@@ -377,13 +324,13 @@ void cBtCharacteristic::handleGATTServerEvent(
 					esp_err_t errRc = ::esp_ble_gatts_send_response(
 							gatts_if,
 							param->write.conn_id,
-							param->write.trans_id, ESP_GATT_OK, &rsp);
+							param->write.trans_id, status, &rsp);
 					if (errRc != ESP_OK) {
 						ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
 					}
 				} // Response needed
 
-				if (m_pCallbacks != nullptr && param->write.is_prep != true) {
+				if (m_pCallbacks != nullptr && param->write.is_prep != true && status == ESP_GATT_OK) {
 					m_pCallbacks->AftereWrite(this); // Invoke the onWrite callback handler.
 				}
 			} // Match on handles.
@@ -406,62 +353,47 @@ void cBtCharacteristic::handleGATTServerEvent(
 			//ESP_LOGD(LOG_TAG, "- Testing: 0x%.2x == 0x%.2x", param->read.handle, m_handle);
 			if (param->read.handle == m_handle) {
 				ESP_LOGD(LOG_TAG, "- Testing: 0x%.2x == 0x%.2x", param->read.handle, m_handle);
-				if (m_pCallbacks != nullptr) {
-					m_pCallbacks->BeforeRead(this); // Invoke the read callback.
+				if (m_pCallbacks != nullptr && !param->read.is_long) {
+					m_pCallbacks->BeforeRead(this); // Invoke the read callback, the value must not change between the parts.
 				}
 
-// Here's an interesting thing.  The read request has the option of saying whether we need a response
-// or not.  What would it "mean" to receive a read request and NOT send a response back?  That feels like
-// a very strange read.
-//
-// We have to handle the case where the data we wish to send back to the client is greater than the maximum
-// packet size of 22 bytes.  In this case, we become responsible for chunking the data into uints of 22 bytes.
-// The apparent algorithm is as follows.
-// If the is_long flag is set then this is a follow on from an original read and we will already have sent at least 22 bytes.
-// If the is_long flag is not set then we need to check how much data we are going to send.  If we are sending LESS than
-// 22 bytes, then we "just" send it and thats the end of the story.
-// If we are sending 22 bytes exactly, we just send it BUT we will get a follow on request.
-// If we are sending more than 22 bytes, we send the first 22 bytes and we will get a follow on request.
-// Because of follow on request processing, we need to maintain an offset of how much data we have already sent
-// so that when a follow on request arrives, we know where to start in the data to send the next sequence.
-// Note that the indication that the client will send a follow on request is that we sent exactly 22 bytes as a response.
-// If our payload is divisible by 22 then the last response will be a response of 0 bytes in length.
-//
-// The following code has deliberately not been factored to make it fewer statements because this would cloud
-// the logic flow comprehension.
-//
+// The value longer than MTU-1 is read by the client in parts: the first read returns MTU-1 bytes,
+// the following "read blob" requests (is_long) come with the offset of the next part.
+// The response shorter than MTU-1 ends the reading. The parts are copied from the value directly,
+// if the value is changed between the parts the client gets an error and reads it again.
 				if (param->read.need_rsp) {
 					ESP_LOGD(LOG_TAG, "Sending a response (esp_ble_gatts_send_response)");
 					esp_gatt_rsp_t rsp;
-					std::string value = m_value.getValue();
-					if (param->read.is_long) {
-						if (value.length() - m_value.getReadOffset() < 22) {
-							// This is the last in the chain
-							rsp.attr_value.len    = value.length() - m_value.getReadOffset();
-							rsp.attr_value.offset = m_value.getReadOffset();
-							memcpy(rsp.attr_value.value, value.data() + rsp.attr_value.offset, rsp.attr_value.len);
-							m_value.setReadOffset(0);
-						} else {
-							// There will be more to come.
-							rsp.attr_value.len    = 22;
-							rsp.attr_value.offset = m_value.getReadOffset();
-							memcpy(rsp.attr_value.value, value.data() + rsp.attr_value.offset, rsp.attr_value.len);
-							m_value.setReadOffset(rsp.attr_value.offset + 22);
-						}
-					} else {
-						if (value.length() > 21) {
-							// Too big for a single shot entry.
-							m_value.setReadOffset(22);
-							rsp.attr_value.len    = 22;
-							rsp.attr_value.offset = 0;
-							memcpy(rsp.attr_value.value, value.data(), rsp.attr_value.len);
-						} else {
-							// Will fit in a single packet with no callbacks required.
-							rsp.attr_value.len    = value.length();
-							rsp.attr_value.offset = 0;
-							memcpy(rsp.attr_value.value, value.data(), rsp.attr_value.len);
+					esp_gatt_status_t status = ESP_GATT_OK;
+					cBtServer *pServ = getService()->pServ;
+					// the read state of the connection is changed under the lock, the response is sent without it
+					pServ->m_connLock.Lock();
+					sBtConnection *pConn = pServ->getConnection(param->read.conn_id);
+					size_t maxLen = (pConn != nullptr ? pConn->mtu : ESP_GATT_DEF_BLE_MTU_SIZE) - 1;
+					if (maxLen > sizeof(rsp.attr_value.value)) {
+						maxLen = sizeof(rsp.attr_value.value);
+					}
+					uint16_t offset = param->read.is_long ? param->read.offset : 0;
+					if (pConn != nullptr) {
+						if (!param->read.is_long) {
+							pConn->readHandle  = m_handle;
+							pConn->readVersion = m_value.getVersion();
+						} else if (pConn->readHandle == m_handle && pConn->readVersion != m_value.getVersion()) {
+							ESP_LOGE(LOG_TAG, "Value is changed while being read, handle: 0x%.2x", m_handle);
+							status = ESP_GATT_ERROR;
 						}
 					}
+					size_t len = 0;
+					if (status == ESP_GATT_OK &&
+							m_value.read(offset, maxLen, rsp.attr_value.value, len) != eBtValueResult::e_ok) {
+						status = ESP_GATT_INVALID_OFFSET;
+					}
+					if (pConn != nullptr && (status != ESP_GATT_OK || len < maxLen)) {
+						pConn->readHandle = uint16_t(-1); // the last part
+					}
+					pServ->m_connLock.Unlock();
+					rsp.attr_value.len      = len;
+					rsp.attr_value.offset   = offset;
 					rsp.attr_value.handle   = param->read.handle;
 					rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
 
@@ -470,7 +402,7 @@ void cBtCharacteristic::handleGATTServerEvent(
 					esp_err_t errRc = ::esp_ble_gatts_send_response(
 							gatts_if, param->read.conn_id,
 							param->read.trans_id,
-							ESP_GATT_OK,
+							status,
 							&rsp);
 					if (errRc != ESP_OK) {
 						ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
@@ -480,14 +412,17 @@ void cBtCharacteristic::handleGATTServerEvent(
 			break;
 		} // ESP_GATTS_READ_EVT
 
-		// ESP_GATTS_CONF_EVT
+		// ESP_GATTS_CONGEST_EVT
 		//
-		// conf:
-		// - esp_gatt_status_t status  � The status code.
-		// - uint16_t          conn_id � The connection used.
+		// congest:
+		// - uint16_t conn_id
+		// - bool     congested
 		//
-		case ESP_GATTS_CONF_EVT: {
-			m_semaphoreConfEvt.Unlock();
+		case ESP_GATTS_CONGEST_EVT: {
+			// the connection state is updated by the server
+			if (!param->congest.congested) {
+				streamSend();
+			}
 			break;
 		}
 
@@ -496,120 +431,245 @@ void cBtCharacteristic::handleGATTServerEvent(
 		} // default
 
 	} // switch event
-
-	// Give each of the descriptors associated with this characteristic the opportunity to handle the
-	// event.
-	for(auto &desc : descriptors){
-		desc->handleGATTServerEvent(event, gatts_if, param);
-	}
-
-} // handleGATTServerEvent
+} // handleAttrEvent
 
 /**
  * @brief Send an indication.
- * An indication is a transmission of up to the first 20 bytes of the characteristic value.  An indication
- * will block waiting a positive confirmation from the client.
+ * An indication is a transmission of up to the first MTU-3 bytes of the characteristic value.  An indication
+ * is queued for every client which enabled the indications and does not block; the queue of the client sends
+ * the next indication when the previous one is confirmed. A newer value replaces the queued one.
  * @return N/A
  */
 void cBtCharacteristic::indicate() {
 
-	ESP_LOGD(LOG_TAG, ">> indicate: length: %d", m_value.getValue().length());
+	ESP_LOGD(LOG_TAG, ">> indicate: length: %d", m_value.getLength());
 
 	assert(getService() != nullptr);
 	assert(getService()->pServ != nullptr);
 
-	//GeneralUtils::hexDump((uint8_t*)m_value.getValue().data(), m_value.getValue().length());
-
-	if (getService()->pServ->getConnectedCount() == 0) {
-		ESP_LOGD(LOG_TAG, "<< indicate: No connected clients.");
-		return;
-	}
-
-	// Test to see if we have a 0x2902 descriptor.  If we do, then check to see if indications are enabled
-	// and, if not, prevent the indication.
+	//GeneralUtils::hexDump((uint8_t*)m_value.getData(), m_value.getLength());
 
-	BLE2902 *p2902 = (BLE2902*)DescFind((uint16_t)0x2902);
-	if (p2902 != nullptr && !p2902->getIndications()) {
-		ESP_LOGD(LOG_TAG, "<< indications disabled; ignoring");
+	// Without the 0x2902 descriptor the indication goes to all the clients,
+	// otherwise only to the clients which enabled the indications.
+	std::vector<sBtPeer> peers;
+	getService()->pServ->getSubscribers(getCccdHandle(), BT_CCCD_INDICATE, peers);
+	if (peers.empty()) {
+		ESP_LOGD(LOG_TAG, "<< indicate: No subscribed clients.");
 		return;
 	}
 
-	if (m_value.getValue().length() > 20) {
-		ESP_LOGD(LOG_TAG, "- Truncating to 20 bytes (maximum notify size)");
+	for (auto &peer : peers) {
+		getService()->pServ->queueValue(peer.conn_id, getHandle(), true, m_value.getData(), m_value.getLength());
 	}
-
-	size_t length = m_value.getValue().length();
-	if (length > 20) {
-		length = 20;
-	}
-
-	m_semaphoreConfEvt.Lock();
-
-	esp_err_t errRc = ::esp_ble_gatts_send_indicate(
-			getService()->pServ->getGattsIf(),
-			getService()->pServ->getConnId(),
-			getHandle(), length, (uint8_t*)m_value.getValue().data(), true); // The need_confirm = true makes this an indication.
-
-	if (errRc != ESP_OK) {
-		ESP_LOGE(LOG_TAG, "<< esp_ble_gatts_send_indicate: rc=%d", errRc);
-		return;
-	}
-
-	m_semaphoreConfEvt.Wait();
 	ESP_LOGD(LOG_TAG, "<< indicate");
 } // indicate
 
 
 /**
  * @brief Send a notify.
- * A notification is a transmission of up to the first 20 bytes of the characteristic value.  An notification
- * will not block; it is a fire and forget.
+ * A notification is a transmission of up to the first MTU-3 bytes of the characteristic value.  An notification
+ * will not block; it is queued for every client which enabled the notifications.
+ * In the stream mode the longer values are sent as several framed notifications, the rest of them is sent
+ * from the BT events when the stack is not congested.
  * @return N/A.
  */
 void cBtCharacteristic::notify() {
-	ESP_LOGD(LOG_TAG, ">> notify: length: %d", m_value.getValue().length());
+	ESP_LOGD(LOG_TAG, ">> notify: length: %d", m_value.getLength());
 
 
 	assert(getService() != nullptr);
 	assert(getService()->pServ != nullptr);
 
 
-	//GeneralUtils::hexDump((uint8_t*)m_value.getValue().data(), m_value.getValue().length());
+	//GeneralUtils::hexDump((uint8_t*)m_value.getData(), m_value.getLength());
 
-	if (getService()->pServ->getConnectedCount() == 0) {
-		ESP_LOGD(LOG_TAG, "<< notify: No connected clients.");
+	// Without the 0x2902 descriptor the notification goes to all the clients,
+	// otherwise only to the clients which enabled the notifications.
+	std::vector<sBtPeer> peers;
+	getService()->pServ->getSubscribers(getCccdHandle(), BT_CCCD_NOTIFY, peers);
+	if (peers.empty()) {
+		ESP_LOGD(LOG_TAG, "<< notify: No subscribed clients.");
 		return;
 	}
 
-	// Test to see if we have a 0x2902 descriptor.  If we do, then check to see if notification is enabled
-	// and, if not, prevent the notification.
-
-	BLE2902 *p2902 = (BLE2902*)DescFind((uint16_t)0x2902);
-	if (p2902 != nullptr && !p2902->getNotifications()) {
-		ESP_LOGD(LOG_TAG, "<< notifications disabled; ignoring");
+	if (m_bFramed) {
+		m_streamLock.Lock();
+		if (m_fragmenter.Busy() || !m_frame.empty()) {
+			// the current value will be sent after the previous one
+			m_bStreamPending = true;
+		} else {
+			m_fragmenter.Start(m_value.getData(), m_value.getLength());
+		}
+		m_streamLock.Unlock();
+		streamSend();
+		ESP_LOGD(LOG_TAG, "<< notify");
 		return;
 	}
 
-	if (m_value.getValue().length() > 20) {
-		ESP_LOGD(LOG_TAG, "- Truncating to 20 bytes (maximum notify size)");
+	// the queue keeps the notification while the client is congested
+	for (auto &peer : peers) {
+		getService()->pServ->queueValue(peer.conn_id, getHandle(), false, m_value.getData(), m_value.getLength());
 	}
 
-	size_t length = m_value.getValue().length();
-	if (length > 20) {
-		length = 20;
+	ESP_LOGD(LOG_TAG, "<< notify");
+} // Notify
+
+
+/**
+ * @brief Send the data as a notification, the value of the characteristic is not changed.
+ * The data must fit getNotifyPayload(). Nothing is sent when a subscribed client is congested,
+ * the caller repeats it later.
+ * @param [in] pData The data to send.
+ * @param [in] length The length of the data in bytes.
+ * @return false if nothing is sent.
+ */
+bool cBtCharacteristic::notifyData(const uint8_t *pData, size_t length) {
+	std::vector<sBtPeer> peers;
+	getService()->pServ->getSubscribers(getCccdHandle(), BT_CCCD_NOTIFY, peers);
+	if (peers.empty()) {
+		return false;
+	}
+	for (auto &peer : peers) {
+		if (peer.congested || length > (size_t)(peer.mtu - 3)) {
+			return false;
+		}
+	}
+	bool bSent = true;
+	for (auto &peer : peers) {
+		esp_err_t errRc = ::esp_ble_gatts_send_indicate(
+				getService()->pServ->getGattsIf(),
+				peer.conn_id,
+				getHandle(), length, (uint8_t*)pData, false);
+		if (errRc != ESP_OK) {
+			ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_indicate: rc=%d", errRc);
+			bSent = false;
+		}
 	}
+	return bSent;
+} // notifyData
 
-	esp_err_t errRc = ::esp_ble_gatts_send_indicate(
-			getService()->pServ->getGattsIf(),
-			getService()->pServ->getConnId(),
-			getHandle(), length, (uint8_t*)m_value.getValue().data(), false); // The need_confirm = false makes this a notify.
-	if (errRc != ESP_OK) {
-		ESP_LOGE(LOG_TAG, "<< esp_ble_gatts_send_indicate: rc=%d", errRc);
-		return;
+
+/**
+ * @brief Get the longest notification all the subscribed clients can receive.
+ * @return MTU-3 of the smallest MTU, 0 if there are no subscribed clients.
+ */
+uint16_t cBtCharacteristic::getNotifyPayload() {
+	std::vector<sBtPeer> peers;
+	getService()->pServ->getSubscribers(getCccdHandle(), BT_CCCD_NOTIFY, peers);
+	uint16_t payload = 0;
+	for (auto &peer : peers) {
+		if (payload == 0 || peer.mtu - 3 < payload) {
+			payload = peer.mtu - 3;
+		}
 	}
+	return payload;
+} // getNotifyPayload
 
-	ESP_LOGD(LOG_TAG, "<< notify");
-} // Notify
+
+/**
+ * @brief Enable the framed notifications of the long values.
+ * @param [in] bFramed Split the long values into frames.
+ * @param [in] bCredits The client controls the number of frames sent by writing the credits.
+ */
+void cBtCharacteristic::setStreamMode(bool bFramed, bool bCredits) {
+	m_streamLock.Lock();
+	m_bFramed = bFramed;
+	m_fragmenter.Reset();
+	m_fragmenter.EnableCredits(bFramed && bCredits);
+	m_frame.clear();
+	m_bStreamPending = false;
+	m_streamLock.Unlock();
+} // setStreamMode
+
+
+/**
+ * @brief Check whether the framed value is being sent.
+ */
+bool cBtCharacteristic::isStreamBusy() {
+	m_streamLock.Lock();
+	bool bBusy = m_fragmenter.Busy() || !m_frame.empty() || m_bStreamPending;
+	m_streamLock.Unlock();
+	return bBusy;
+} // isStreamBusy
+
+
+/**
+ * @brief Get the handle of the 0x2902 descriptor.
+ * @return The handle or -1 if there is no such descriptor.
+ */
+uint16_t cBtCharacteristic::getCccdHandle() {
+	cBtCharDescriptor *p2902 = DescFind((uint16_t)0x2902);
+	return p2902 != nullptr ? p2902->getHandle() : (uint16_t)-1;
+} // getCccdHandle
+
+
+/**
+ * @brief Apply the prepared write, called without the connection lock.
+ * @param [in] pData The value collected from the prepared writes of the client.
+ * @param [in] length Its length.
+ */
+void cBtCharacteristic::execWrite(const uint8_t *pData, size_t length) {
+	m_value.setValue(pData, length);
+	if (m_pCallbacks != nullptr) {
+		m_pCallbacks->AftereWrite(this); // Invoke the onWrite callback handler.
+	}
+} // execWrite
+
+
+/**
+ * @brief Send the stream fragments to the subscribed clients until the stack is congested or credits are over.
+ * With several clients the fragments are sized for the smallest MTU. Called from notify() and from the BT events.
+ */
+void cBtCharacteristic::streamSend() {
+	std::vector<sBtPeer> peers;
+	m_streamLock.Lock();
+	while (true) {
+		getService()->pServ->getSubscribers(getCccdHandle(), BT_CCCD_NOTIFY, peers);
+		if (peers.empty()) {
+			// nobody to send to, the client will read the value after reconnection
+			m_fragmenter.Reset();
+			m_frame.clear();
+			m_bStreamPending = false;
+			break;
+		}
+		uint16_t payload = ESP_GATT_MAX_MTU_SIZE;
+		bool bCongested = false;
+		for (auto &peer : peers) {
+			if (peer.mtu - 3 < payload) {
+				payload = peer.mtu - 3;
+			}
+			bCongested |= peer.congested;
+		}
+		if (bCongested) {
+			break;
+		}
+		if (m_frame.empty() && !m_fragmenter.Next(payload, m_frame)) {
+			if (m_fragmenter.Busy() || !m_bStreamPending) {
+				break; // waiting for credits or all sent
+			}
+			m_bStreamPending = false;
+			m_fragmenter.Start(m_value.getData(), m_value.getLength());
+			continue;
+		}
+		bool bSent = true;
+		for (auto &peer : peers) {
+			esp_err_t errRc = ::esp_ble_gatts_send_indicate(
+					getService()->pServ->getGattsIf(),
+					peer.conn_id,
+					getHandle(), m_frame.size(), m_frame.data(), false);
+			if (errRc != ESP_OK) {
+				ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_indicate: rc=%d", errRc);
+				bSent = false;
+			}
+		}
+		if (!bSent) {
+			// keep the frame, it will be sent on the next event
+			break;
+		}
+		m_frame.clear();
+	}
+	m_streamLock.Unlock();
+} // streamSend
 
 
 /**
@@ -642,6 +702,7 @@ void cBtCharacteristic::setBroadcastProperty(bool value) {
 void cBtCharacteristic::setHandle(uint16_t handle) {
 	ESP_LOGD(LOG_TAG, ">> setHandle: handle=0x%.2x, characteristic uuid=%s", handle, uuid.toString().c_str());
 	m_handle = handle;
+	getService()->pServ->registerAttr(handle, this, nullptr);
 	ESP_LOGD(LOG_TAG, "<< setHandle");
 } // setHandle
 
@@ -696,8 +757,8 @@ void cBtCharacteristic::setReadProperty(bool value) {
 void cBtCharacteristic::setValue(uint8_t* data, size_t length) {
 	ESP_LOGD(LOG_TAG, ">> setValue: length=%d, characteristic UUID=%s", length, uuid.toString().c_str());
 
-	if (length > ESP_GATT_MAX_ATTR_LEN) {
-		ESP_LOGE(LOG_TAG, "Size %d too large, must be no bigger than %d", length, ESP_GATT_MAX_ATTR_LEN);
+	if (length > m_value.getMaxLength()) {
+		ESP_LOGE(LOG_TAG, "Size %d too large, must be no bigger than %d", length, m_value.getMaxLength());
 		return;
 	}
 	m_value.setValue(data, length);
@@ -773,6 +834,8 @@ cBtCharDescriptor::cBtCharDescriptor() {
 	m_value.attr_max_len = ESP_GATT_MAX_ATTR_LEN;
 	m_handle             = -1;
 	m_pCharacteristic    = nullptr; // No initial characteristic.
+	m_permissions        = (esp_gatt_perm_t)0;
+	m_bPermissions       = false;
 
 } // cBtCharDescriptor
 
@@ -805,7 +868,7 @@ void cBtCharDescriptor::executeCreate(cBtCharacteristic* pCharacteristic) {
 	esp_err_t errRc = esp_ble_gatts_add_char_descr(
 			pCharacteristic->getService()->m_handle,
 			uuid.getNative(),
-			(esp_gatt_perm_t)(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
+			getPermissions(),
 			&m_value,
 			&control);
 	if (errRc != ESP_OK) {
@@ -953,6 +1016,7 @@ void cBtCharDescriptor::handleGATTServerEvent(
 void cBtCharDescriptor::setHandle(uint16_t handle) {
 	ESP_LOGD(LOG_TAG, ">> setHandle(0x%.2x): Setting descriptor handle to be 0x%.2x", handle, handle);
 	m_handle = handle;
+	m_pCharacteristic->getService()->pServ->registerAttr(handle, m_pCharacteristic, this);
 	ESP_LOGD(LOG_TAG, "<< setHandle()");
 } // setHandle
 
@@ -981,6 +1045,22 @@ void cBtCharDescriptor::setValue(std::string value) {
 } // setValue
 
 
+void cBtCharDescriptor::setPermissions(esp_gatt_perm_t perm) {
+	m_permissions  = perm;
+	m_bPermissions = true;
+} // setPermissions
+
+
+esp_gatt_perm_t cBtCharDescriptor::getPermissions() {
+	if(m_bPermissions)
+		return m_permissions;
+	// the client configuration is written by the client, the other descriptors are read only
+	if(uuid == BLEUUID((uint16_t)0x2902))
+		return (esp_gatt_perm_t)(ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE);
+	return (esp_gatt_perm_t)ESP_GATT_PERM_READ;
+} // getPermissions
+
+
 /**
  * @brief Return a string representation of the descriptor.
  * @return A string representation of the descriptor.
@@ -10,36 +10,16 @@
 #include "sdkconfig.h"
 #include "cBtServer.h"
 #include "BLEUUID.h"
+#include "cBtFragmenter.h"
+#include "cBtCharValue.h"
 
 class cBtService;
 class cBtCharacteristic;
 
-// BT Characteristic Value
-class cBtCharValue {
-public:
-	cBtCharValue();
-	void        addPart(const std::string &part);
-	void        addPart(uint8_t* pData, size_t length);
-	void        cancel();
-	void        commit();
-	bool		execAllowed(void);
-	uint16_t    getReadOffset();
-	const std::string& getValue();
-	void        setReadOffset(uint16_t readOffset);
-	void        setValue(const std::string &value);
-	void        setValue(uint8_t* pData, size_t length);
-
-private:
-	std::string m_accumulation;
-	uint16_t    m_readOffset;
-	std::string m_value;
-	// flag to remember whether multi-package write is ongoing (prepare / execute write)
-	bool		b_accumulation_ongoing;
-};
-
 // BT Characteristic Descriptor
 class cBtCharDescriptor{
 	friend class cBtCharacteristic;
+	friend class cBtService;
 public:
 	BLEUUID  uuid;
 	cBtCharDescriptor();
@@ -53,11 +33,16 @@ public:
 			esp_ble_gatts_cb_param_t* param);
 	void setValue(uint8_t* data, size_t size);
 	void setValue(std::string value);
+	// permissions of the descriptor, default read and write for the CCCD (0x2902), read for the others
+	void setPermissions(esp_gatt_perm_t perm);
+	esp_gatt_perm_t getPermissions();
 	std::string toString();
 
 private:
 
 	esp_attr_value_t     m_value;
+	esp_gatt_perm_t      m_permissions;
+	bool                 m_bPermissions; // set by setPermissions()
 	uint16_t             m_handle;
 	cBtCharacteristic*   m_pCharacteristic;
 	void executeCreate(cBtCharacteristic* pCharacteristic);
@@ -93,10 +78,16 @@ public:
 	cBtCharacteristic();
 	~cBtCharacteristic();
 
-	const std::string& getValue();
+	std::string getValue();
+	const uint8_t* getData(){return m_value.getData();}
+	size_t getLength(){return m_value.getLength();}
 
 	void indicate();
 	void notify();
+	// notification of the data instead of the value, false if nothing is sent (no subscribers or congested)
+	bool notifyData(const uint8_t *pData, size_t length);
+	// the longest notification for all the subscribed clients, 0 if there are no subscribers
+	uint16_t getNotifyPayload();
 	void setBroadcastProperty(bool value);
 	void setCallbacks(cBtCharCallbacks* pCallbacks){m_pCallbacks = pCallbacks;}
 	void setIndicateProperty(bool value);
@@ -104,9 +95,23 @@ public:
 	void setReadProperty(bool value);
 	void setValue(uint8_t* data, size_t size);
 	void setValue(std::string value);
+	// capacity of the value, set it before the value is used, default ESP_GATT_MAX_ATTR_LEN
+	void setMaxLength(size_t maxLen);
 	void setWriteProperty(bool value);
 	void setWriteNoResponseProperty(bool value);
+	// permissions of the value, set them before the service is started. By default they follow the properties:
+	// read - ESP_GATT_PERM_READ, write or write without response - ESP_GATT_PERM_WRITE, none for notify only.
+	// Use the _ENCRYPTED or _ENC_MITM variants for the values of bonded clients only.
+	void setPermissions(esp_gatt_perm_t perm);
+	esp_gatt_perm_t getPermissions();
+	// Values longer than MTU-3 are sent by notify() as framed fragments (see cBtFragmenter) when bFramed is set,
+	// otherwise they are truncated. With bCredits the client allows the next fragments by writing
+	// their count (1 byte) to this characteristic.
+	void setStreamMode(bool bFramed, bool bCredits = false);
+	bool isStreamBusy();
 	std::string toString();
+	// server of the characteristic, nullptr before the service is started
+	cBtServer* getServer();
 
 	void setProperties(uint32_t properties);
 
@@ -121,14 +126,33 @@ private:
 
 	uint16_t                    m_handle;
 	esp_gatt_char_prop_t        m_properties;
+	esp_gatt_perm_t             m_permissions;
+	bool                        m_bPermissions; // set by setPermissions()
 	cBtCharCallbacks* 			m_pCallbacks;
 	cBtService*                 m_pService;
-	cBtCharValue                m_value;
+	cBtCharValue                m_value; // read offsets and prepared writes are in the connection context (sBtConnection)
 
+	bool                        m_bFramed;
+	bool                        m_bStreamPending; // value was notified while the previous stream was busy
+	cBtFragmenter               m_fragmenter;
+	std::vector<uint8_t>        m_frame; // built fragment not sent yet
+	cMutex                      m_streamLock;
+
+	void                 streamSend();
+	uint16_t             getCccdHandle();
+	// apply the prepared write of the client
+	void                 execWrite(const uint8_t *pData, size_t length);
+
+	// events of the characteristic and its descriptors
 	void handleGATTServerEvent(
 			esp_gatts_cb_event_t      event,
 			esp_gatt_if_t             gatts_if,
 			esp_ble_gatts_cb_param_t* param);
+	// events of the characteristic only, attribute access events are passed here by the server directly
+	void handleAttrEvent(
+			esp_gatts_cb_event_t      event,
+			esp_gatt_if_t             gatts_if,
+			esp_ble_gatts_cb_param_t* param);
 
 	void                 executeCreate(cBtService* pService);
 	uint16_t             getHandle();
@@ -136,7 +160,6 @@ private:
 	cBtService*          getService();
 	void                 setHandle(uint16_t handle);
 	cSemaphore m_semaphoreCreateEvt;
-	cSemaphore m_semaphoreConfEvt;
 };
 
 #endif /* COMPONENTS_M_BT_CBTCHARACTERISTIC_H_ */
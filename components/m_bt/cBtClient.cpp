@@ -0,0 +1,570 @@
+/*
+ * cBtClient.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtClient.h"
+
+#include <string.h>
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtClient";
+
+static const BLEUUID s_cccdUuid = "2902"_uuid;
+
+cBtClient::cBtClient():pDevice(nullptr), m_pCallbacks(nullptr), m_pCache(nullptr), m_appId(0), m_gattc_if(-1),
+		m_connId(-1), m_mtu(ESP_GATT_DEF_BLE_MTU_SIZE), m_bOpening(false), m_bConnected(false), m_bReady(false),
+		m_hashRead(eHashRead::e_none), m_bBusy(false), m_semaphoreRegisterAppEvt("cBtClient::RegisterAppEvt"){
+	memset(m_bda, 0, sizeof(m_bda));
+	UseCache = true;
+}
+
+cBtClient::~cBtClient() {
+	Deinit();
+}
+
+void cBtClient::Init(cBtDevice *pDev){
+	pDevice = pDev;
+	pDev->pClient = this;
+	if(UseCache && !m_pCache)
+		m_pCache = new cBtGattCache;
+	registerApp();
+}
+
+void cBtClient::Deinit(){
+	Close();
+	delete m_pCache;
+	m_pCache = nullptr;
+	if(pDevice) pDevice->pClient = nullptr;
+	if(m_gattc_if == -1) return;
+	esp_ble_gattc_app_unregister(m_gattc_if);
+	m_gattc_if = -1;
+}
+
+void cBtClient::registerApp() {
+	ESP_LOGD(LOG_TAG, ">> registerApp - %d", m_appId);
+	m_semaphoreRegisterAppEvt.Lock(); // Take the mutex, will be released by ESP_GATTC_REG_EVT event.
+	esp_ble_gattc_app_register(m_appId);
+	m_semaphoreRegisterAppEvt.Wait();
+	ESP_LOGD(LOG_TAG, "<< registerApp");
+}
+
+bool cBtClient::Open(const esp_bd_addr_t bda, esp_ble_addr_type_t addrType){
+	cAutoLock lock(m_lock);
+	if(m_gattc_if == -1 || m_bOpening || m_bConnected)
+		return false;
+	memcpy(m_bda, bda, sizeof(esp_bd_addr_t));
+	esp_err_t errRc = ::esp_ble_gattc_open(m_gattc_if, m_bda, addrType, true);
+	if(errRc != ESP_OK){
+		ESP_LOGE(LOG_TAG, "esp_ble_gattc_open: rc=%d", errRc);
+		return false;
+	}
+	m_bOpening = true;
+	return true;
+}
+
+void cBtClient::Close(){
+	cAutoLock lock(m_lock);
+	m_ops.clear();
+	if(m_bConnected)
+		::esp_ble_gattc_close(m_gattc_if, m_connId);
+}
+
+bool cBtClient::Read(uint16_t handle){
+	sBtClientOp op;
+	op.type = eBtClientOp::e_read;
+	op.handles.push_back(handle);
+	return queue(op);
+}
+
+bool cBtClient::ReadMultiple(const uint16_t *handles, size_t count){
+	if(!count)
+		return true;
+	sBtClientOp op;
+	op.type = eBtClientOp::e_read_multi;
+	op.handles.assign(handles, handles + count);
+	return queue(op);
+}
+
+bool cBtClient::Write(uint16_t handle, const uint8_t *data, size_t len, bool bResponse){
+	sBtClientOp op;
+	op.type = eBtClientOp::e_write;
+	op.handles.push_back(handle);
+	op.data.assign(data, data + len);
+	op.bResponse = bResponse;
+	return queue(op);
+}
+
+bool cBtClient::Subscribe(uint16_t handle, cBtGattHandler *pHandler, bool bIndicate){
+	sBtClientOp op;
+	op.type = eBtClientOp::e_subscribe;
+	op.handles.push_back(handle);
+	op.bResponse = bIndicate;
+	op.pHandler = pHandler;
+	return queue(op);
+}
+
+bool cBtClient::Unsubscribe(uint16_t handle){
+	sBtClientOp op;
+	op.type = eBtClientOp::e_unsubscribe;
+	op.handles.push_back(handle);
+	return queue(op);
+}
+
+void cBtClient::Forget(const esp_bd_addr_t bda){
+	cAutoLock lock(m_lock);
+	if(!m_pCache)
+		return;
+	m_pCache->Erase(bda);
+}
+
+void cBtClient::ForgetAll(){
+	cAutoLock lock(m_lock);
+	if(!m_pCache)
+		return;
+	m_pCache->EraseAll();
+}
+
+bool cBtClient::queue(sBtClientOp &op){
+	m_lock.Lock();
+	if(!m_bConnected && !m_bOpening){
+		m_lock.Unlock();
+		return false;
+	}
+	m_ops.push_back(op);
+	m_lock.Unlock();
+	next();
+	return true;
+}
+
+void cBtClient::next(){
+	cAutoLock lock(m_lock);
+	while(!m_bBusy && m_bReady && !m_ops.empty()){
+		m_op = m_ops.front();
+		m_ops.pop_front();
+		m_bBusy = execute(m_op);
+	}
+}
+
+// start the request, m_lock is taken; returns false if it is not started
+bool cBtClient::execute(sBtClientOp &op){
+	esp_err_t errRc = ESP_OK;
+	uint16_t handle = op.handles[0];
+	switch(op.type){
+	case eBtClientOp::e_read:
+		errRc = ::esp_ble_gattc_read_char(m_gattc_if, m_connId, handle, ESP_GATT_AUTH_REQ_NONE);
+		break;
+	case eBtClientOp::e_read_multi: {
+		// the first request is executed, the rest are queued before the other requests
+		std::vector<std::vector<uint16_t> > reads;
+		m_db.PlanReads(&op.handles[0], op.handles.size(), m_mtu - 1, reads);
+		for(size_t i = reads.size() - 1; i > 0; i--){
+			sBtClientOp rest;
+			rest.type = reads[i].size() > 1 ? eBtClientOp::e_read_multi : eBtClientOp::e_read;
+			rest.handles = reads[i];
+			m_ops.push_front(rest);
+		}
+		op.handles = reads[0];
+		if(op.handles.size() == 1){
+			op.type = eBtClientOp::e_read;
+			return execute(op);
+		}
+		esp_gattc_multi_t multi;
+		multi.num_attr = op.handles.size();
+		memcpy(multi.handles, &op.handles[0], op.handles.size() * sizeof(uint16_t));
+		errRc = ::esp_ble_gattc_read_multiple(m_gattc_if, m_connId, &multi, ESP_GATT_AUTH_REQ_NONE);
+		break;
+	}
+	case eBtClientOp::e_write:
+		errRc = ::esp_ble_gattc_write_char(m_gattc_if, m_connId, handle, op.data.size(), op.data.data(),
+				op.bResponse ? ESP_GATT_WRITE_TYPE_RSP : ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE);
+		break;
+	case eBtClientOp::e_subscribe:
+		errRc = ::esp_ble_gattc_register_for_notify(m_gattc_if, m_bda, handle);
+		break;
+	case eBtClientOp::e_unsubscribe:
+		errRc = ::esp_ble_gattc_unregister_for_notify(m_gattc_if, m_bda, handle);
+		break;
+	}
+	if(errRc != ESP_OK){
+		ESP_LOGE(LOG_TAG, "Request %d of handle %d: rc=%d", (int)op.type, handle, errRc);
+		return false;
+	}
+	return true;
+}
+
+// the second step of the (un)subscription, m_lock is taken; returns false if there is no CCCD
+static bool write_cccd(esp_gatt_if_t gattc_if, uint16_t connId, sBtGattChar *pChr, uint16_t value){
+	if(!pChr || !pChr->cccd)
+		return false;
+	uint8_t data[2] = {(uint8_t)(value & 0xff), (uint8_t)(value >> 8)};
+	esp_err_t errRc = ::esp_ble_gattc_write_char_descr(gattc_if, connId, pChr->cccd, sizeof(data), data,
+			ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+	if(errRc != ESP_OK){
+		ESP_LOGE(LOG_TAG, "esp_ble_gattc_write_char_descr: rc=%d", errRc);
+		return false;
+	}
+	return true;
+}
+
+// find the services, their characteristics are collected when the search is complete; m_lock is taken
+void cBtClient::discover(){
+	ESP_LOGD(LOG_TAG, "Discovery of the peer database");
+	m_bReady = false;
+	m_hashRead = eHashRead::e_none;
+	m_db.Clear();
+	m_svcs.clear();
+	esp_err_t errRc = ::esp_ble_gattc_search_service(m_gattc_if, m_connId, nullptr);
+	if(errRc != ESP_OK)
+		ESP_LOGE(LOG_TAG, "esp_ble_gattc_search_service: rc=%d", errRc);
+}
+
+// read the characteristics and CCCDs of the found services from the stack, m_lock is taken
+void cBtClient::collect(){
+	for(auto &svc : m_svcs){
+		uint16_t count = 0;
+		if(::esp_ble_gattc_get_attr_count(m_gattc_if, m_connId, ESP_GATT_DB_CHARACTERISTIC, svc.start, svc.end,
+				0, &count) != ESP_GATT_OK || !count) // char_handle is not used for the characteristics
+			continue;
+		std::vector<esp_gattc_char_elem_t> chars(count);
+		if(::esp_ble_gattc_get_all_char(m_gattc_if, m_connId, svc.start, svc.end, chars.data(), &count, 0) != ESP_GATT_OK)
+			continue;
+		for(size_t i = 0; i < count; i++){
+			sBtGattChar chr;
+			chr.svc = svc.uuid;
+			chr.uuid = BLEUUID(chars[i].uuid);
+			chr.handle = chars[i].char_handle;
+			chr.props = chars[i].properties;
+			chr.cccd = 0;
+			chr.len = 0;
+			uint16_t descrCount = 0;
+			if((chr.props & (ESP_GATT_CHAR_PROP_BIT_NOTIFY | ESP_GATT_CHAR_PROP_BIT_INDICATE)) &&
+					::esp_ble_gattc_get_attr_count(m_gattc_if, m_connId, ESP_GATT_DB_DESCRIPTOR, svc.start, svc.end,
+							chr.handle, &descrCount) == ESP_GATT_OK && descrCount){
+				std::vector<esp_gattc_descr_elem_t> descrs(descrCount);
+				if(::esp_ble_gattc_get_all_descr(m_gattc_if, m_connId, chr.handle, descrs.data(), &descrCount, 0) == ESP_GATT_OK){
+					for(size_t j = 0; j < descrCount; j++){
+						if(BLEUUID(descrs[j].uuid) == s_cccdUuid)
+							chr.cccd = descrs[j].handle;
+					}
+				}
+			}
+			m_db.Add(chr);
+		}
+	}
+	m_svcs.clear();
+	ESP_LOGD(LOG_TAG, "Discovered %d characteristics", m_db.Chars().size());
+}
+
+// m_lock is taken
+bool cBtClient::cacheLoad(){
+	if(!m_pCache || !m_pCache->Load(m_bda, m_db)){
+		m_db.Clear();
+		return false;
+	}
+	return true;
+}
+
+// m_lock is taken
+void cBtClient::cacheSave(){
+	if(m_pCache && !m_pCache->Save(m_bda, m_db))
+		ESP_LOGE(LOG_TAG, "Cache is not saved");
+}
+
+// m_lock is taken
+void cBtClient::readHash(eHashRead mode){
+	uint16_t handle = m_db.HashHandle();
+	// a cached database without the hash (its read failed) is used as it is
+	if(handle && (mode == eHashRead::e_learn || !m_db.Hash().empty())){
+		esp_err_t errRc = ::esp_ble_gattc_read_char(m_gattc_if, m_connId, handle, ESP_GATT_AUTH_REQ_NONE);
+		if(errRc == ESP_OK){
+			m_hashRead = mode;
+			return;
+		}
+		ESP_LOGE(LOG_TAG, "esp_ble_gattc_read_char: rc=%d", errRc);
+	}
+	if(mode == eHashRead::e_learn)
+		cacheSave();
+	m_bReady = true;
+}
+
+// the connection is lost, m_lock is taken
+void cBtClient::onClosed(){
+	for(auto &chr : m_db.Chars()){
+		if(m_db.Handler(chr.handle))
+			::esp_ble_gattc_unregister_for_notify(m_gattc_if, m_bda, chr.handle);
+	}
+	m_db.ClearHandlers();
+	m_db.Clear();
+	m_ops.clear();
+	m_bBusy = false;
+	m_bOpening = false;
+	m_bConnected = false;
+	m_bReady = false;
+	m_hashRead = eHashRead::e_none;
+	m_connId = -1;
+	m_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+}
+
+// value for the handler, called without the lock
+struct sBtDelivery{
+	cBtGattHandler *pHandler;
+	uint16_t handle;
+	size_t offset;
+	size_t len;
+};
+
+void cBtClient::handleGATTClientEvent(
+		esp_gattc_cb_event_t event,
+		esp_gatt_if_t gattc_if,
+		esp_ble_gattc_cb_param_t *param) {
+	ESP_LOGD(LOG_TAG, ">> handleGATTClientEvent: %d", event);
+
+	if(event == ESP_GATTC_REG_EVT){
+		if(param->reg.app_id == m_appId){
+			m_gattc_if = gattc_if;
+			m_semaphoreRegisterAppEvt.Unlock();
+		}
+		return;
+	}
+	if(gattc_if != m_gattc_if && gattc_if != ESP_GATT_IF_NONE)
+		return;
+
+	// the callbacks may make new requests, they are called without the lock
+	enum {e_none, e_open, e_open_failed, e_ready, e_closed, e_write} result = e_none;
+	uint16_t writeHandle = 0;
+	bool bOk = false;
+	std::vector<sBtDelivery> deliveries;
+	const uint8_t *value = nullptr;
+	bool bNotify = false;
+	bool bDone = false; // the executed request is finished
+
+	m_lock.Lock();
+	bool bWasReady = m_bReady;
+	switch(event) {
+	// ESP_GATTC_OPEN_EVT
+	// open:
+	// - esp_gatt_status_t status
+	// - uint16_t conn_id
+	// - esp_bd_addr_t remote_bda
+	// - uint16_t mtu
+	case ESP_GATTC_OPEN_EVT: {
+		m_bOpening = false;
+		if(param->open.status != ESP_GATT_OK){
+			ESP_LOGE(LOG_TAG, "Connection failed: %d", param->open.status);
+			m_ops.clear();
+			result = e_open_failed;
+			break;
+		}
+		m_connId = param->open.conn_id;
+		m_bConnected = true;
+		result = e_open;
+		esp_err_t errRc = ::esp_ble_gattc_send_mtu_req(m_gattc_if, m_connId);
+		if(errRc != ESP_OK)
+			ESP_LOGE(LOG_TAG, "esp_ble_gattc_send_mtu_req: rc=%d", errRc);
+		if(cacheLoad()){
+			ESP_LOGD(LOG_TAG, "Database of the peer is cached: %d characteristics", m_db.Chars().size());
+			readHash(eHashRead::e_check);
+		}else{
+			discover();
+		}
+		break;
+	}
+	case ESP_GATTC_CFG_MTU_EVT: {
+		if(param->cfg_mtu.status == ESP_GATT_OK && param->cfg_mtu.conn_id == m_connId)
+			m_mtu = param->cfg_mtu.mtu;
+		break;
+	}
+	case ESP_GATTC_SEARCH_RES_EVT: {
+		sBtSvcRange svc;
+		svc.uuid = BLEUUID(param->search_res.srvc_id.uuid);
+		svc.start = param->search_res.start_handle;
+		svc.end = param->search_res.end_handle;
+		m_svcs.push_back(svc);
+		break;
+	}
+	case ESP_GATTC_SEARCH_CMPL_EVT: {
+		if(param->search_cmpl.status != ESP_GATT_OK){
+			ESP_LOGE(LOG_TAG, "Discovery failed: %d", param->search_cmpl.status);
+			::esp_ble_gattc_close(m_gattc_if, m_connId);
+			break;
+		}
+		collect();
+		readHash(eHashRead::e_learn);
+		break;
+	}
+	// a changed database of the peer is discovered again
+	case ESP_GATTC_SRVC_CHG_EVT: {
+		if(m_bConnected && memcmp(param->srvc_chg.remote_bda, m_bda, sizeof(esp_bd_addr_t)) == 0)
+			discover();
+		break;
+	}
+	case ESP_GATTC_READ_CHAR_EVT: {
+		if(m_hashRead != eHashRead::e_none && param->read.handle == m_db.HashHandle()){
+			bool bRead = param->read.status == ESP_GATT_OK;
+			eHashRead mode = m_hashRead;
+			m_hashRead = eHashRead::e_none;
+			if(mode == eHashRead::e_check && !(bRead && m_db.HashMatches(param->read.value, param->read.value_len))){
+				ESP_LOGD(LOG_TAG, "Database Hash of the peer is changed, status %d", param->read.status);
+				discover();
+				break;
+			}
+			if(mode == eHashRead::e_learn){
+				if(bRead)
+					m_db.SetHash(param->read.value, param->read.value_len);
+				cacheSave();
+			}
+			m_bReady = true;
+			break;
+		}
+		if(!m_bBusy || m_op.type != eBtClientOp::e_read)
+			break;
+		bDone = true;
+		if(param->read.status == ESP_GATT_INVALID_HANDLE){
+			discover();
+			break;
+		}
+		if(param->read.status != ESP_GATT_OK){
+			ESP_LOGE(LOG_TAG, "Read of %d failed: %d", param->read.handle, param->read.status);
+			break;
+		}
+		if(m_db.SetLength(param->read.handle, param->read.value_len))
+			cacheSave();
+		value = param->read.value;
+		deliveries.push_back({m_db.Handler(param->read.handle, m_pCallbacks), param->read.handle, 0, param->read.value_len});
+		break;
+	}
+	case ESP_GATTC_READ_MULTIPLE_EVT: {
+		if(!m_bBusy || m_op.type != eBtClientOp::e_read_multi)
+			break;
+		bDone = true;
+		if(param->read.status == ESP_GATT_INVALID_HANDLE){
+			discover();
+			break;
+		}
+		if(param->read.status != ESP_GATT_OK){
+			ESP_LOGE(LOG_TAG, "Read multiple failed: %d", param->read.status);
+			break;
+		}
+		std::vector<uint16_t> lens;
+		if(!m_db.SplitMultiple(&m_op.handles[0], m_op.handles.size(), param->read.value_len, lens)){
+			// a length has changed, they are learned again by the single reads
+			ESP_LOGD(LOG_TAG, "Read multiple does not match the lengths");
+			for(auto it = m_op.handles.rbegin(); it != m_op.handles.rend(); ++it){
+				m_db.SetLength(*it, 0);
+				sBtClientOp op;
+				op.type = eBtClientOp::e_read;
+				op.handles.push_back(*it);
+				m_ops.push_front(op);
+			}
+			break;
+		}
+		value = param->read.value;
+		size_t offset = 0;
+		for(size_t i = 0; i < lens.size(); i++){
+			deliveries.push_back({m_db.Handler(m_op.handles[i], m_pCallbacks), m_op.handles[i], offset, lens[i]});
+			offset += lens[i];
+		}
+		break;
+	}
+	case ESP_GATTC_WRITE_CHAR_EVT: {
+		if(!m_bBusy || m_op.type != eBtClientOp::e_write)
+			break;
+		bDone = true;
+		result = e_write;
+		writeHandle = m_op.handles[0];
+		bOk = param->write.status == ESP_GATT_OK;
+		break;
+	}
+	// the notifications are registered, the CCCD is written then
+	case ESP_GATTC_REG_FOR_NOTIFY_EVT:
+	case ESP_GATTC_UNREG_FOR_NOTIFY_EVT: {
+		bool bSubscribe = event == ESP_GATTC_REG_FOR_NOTIFY_EVT;
+		if(!m_bBusy || m_op.type != (bSubscribe ? eBtClientOp::e_subscribe : eBtClientOp::e_unsubscribe))
+			break;
+		esp_gatt_status_t status = bSubscribe ? param->reg_for_notify.status : param->unreg_for_notify.status;
+		writeHandle = m_op.handles[0];
+		m_db.SetHandler(writeHandle, bSubscribe && status == ESP_GATT_OK ? m_op.pHandler : nullptr);
+		uint16_t cccd = bSubscribe ? (m_op.bResponse ? 0x0002 : 0x0001) : 0;
+		if(status == ESP_GATT_OK && write_cccd(m_gattc_if, m_connId, m_db.FindByHandle(writeHandle), cccd)){
+			m_op.bStarted = true;
+			break;
+		}
+		bDone = true;
+		result = e_write;
+		bOk = status == ESP_GATT_OK && !bSubscribe; // the subscription needs the CCCD
+		break;
+	}
+	case ESP_GATTC_WRITE_DESCR_EVT: {
+		if(!m_bBusy || !m_op.bStarted ||
+				(m_op.type != eBtClientOp::e_subscribe && m_op.type != eBtClientOp::e_unsubscribe))
+			break;
+		bDone = true;
+		result = e_write;
+		writeHandle = m_op.handles[0];
+		bOk = param->write.status == ESP_GATT_OK;
+		break;
+	}
+	// ESP_GATTC_NOTIFY_EVT
+	// notify:
+	// - uint16_t conn_id
+	// - esp_bd_addr_t remote_bda
+	// - uint16_t handle
+	// - uint16_t value_len
+	// - uint8_t *value
+	// - bool is_notify
+	case ESP_GATTC_NOTIFY_EVT: {
+		if(param->notify.conn_id != m_connId)
+			break;
+		if(param->notify.handle == m_db.ServiceChangedHandle()){
+			discover();
+			break;
+		}
+		value = param->notify.value;
+		bNotify = true;
+		deliveries.push_back({m_db.Handler(param->notify.handle, m_pCallbacks), param->notify.handle, 0, param->notify.value_len});
+		break;
+	}
+	case ESP_GATTC_DISCONNECT_EVT: {
+		if(param->disconnect.conn_id != m_connId)
+			break;
+		onClosed();
+		result = e_closed;
+		break;
+	}
+	default:
+		break;
+	}
+	if(bDone)
+		m_bBusy = false;
+	bool bReady = m_bReady;
+	m_lock.Unlock();
+
+	if(m_pCallbacks){
+		switch(result){
+		case e_open:
+			m_pCallbacks->OnOpen(this, true);
+			break;
+		case e_open_failed:
+			m_pCallbacks->OnOpen(this, false);
+			break;
+		case e_closed:
+			m_pCallbacks->OnClose(this);
+			break;
+		case e_write:
+			m_pCallbacks->OnWrite(this, writeHandle, bOk);
+			break;
+		default:
+			break;
+		}
+		if(bReady && !bWasReady)
+			m_pCallbacks->OnReady(this);
+	}
+	for(auto &d : deliveries){
+		if(d.pHandler)
+			d.pHandler->OnValue(d.handle, value + d.offset, d.len, bNotify);
+	}
+	next();
+	ESP_LOGD(LOG_TAG, "<< handleGATTClientEvent");
+}
@@ -0,0 +1,129 @@
+/*
+ * cBtClient.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  BT GATT client for the peripheral sensors: async connection, cached discovery, batched reads and notifications
+ */
+
+#ifndef COMPONENTS_M_BT_CBTCLIENT_H_
+#define COMPONENTS_M_BT_CBTCLIENT_H_
+#include "sdkconfig.h"
+#include <esp_gattc_api.h>
+#include <list>
+#include <vector>
+#include "../../main/common/cBaseTask.h"
+#include "cBtDevice.h"
+#include "cBtGattDb.h"
+#include "cBtGattCache.h"
+
+class cBtClient;
+
+// Called from the BT task. The cBtClient methods may be called from here.
+class cBtClientCallbacks: public cBtGattHandler{
+public:
+	virtual ~cBtClientCallbacks(){}
+	virtual void OnOpen(cBtClient *pClient, bool bOk){}
+	// the database of the peer is known (from the cache or discovered), the requests are executed from now
+	virtual void OnReady(cBtClient *pClient){}
+	virtual void OnClose(cBtClient *pClient){}
+	// write or subscription result
+	virtual void OnWrite(cBtClient *pClient, uint16_t handle, bool bOk){}
+	// values of the handles without own handler
+	virtual void OnValue(uint16_t handle, const uint8_t *data, size_t len, bool bNotify){}
+};
+
+enum class eBtClientOp{e_read, e_read_multi, e_write, e_subscribe, e_unsubscribe};
+
+// request to the peer, they are executed one by one
+struct sBtClientOp{
+	eBtClientOp type;
+	std::vector<uint16_t> handles; // one except e_read_multi
+	std::vector<uint8_t> data; // e_write
+	bool bResponse; // e_write with the response, e_subscribe for the indications
+	cBtGattHandler *pHandler; // e_subscribe
+	bool bStarted; // e_subscribe, e_unsubscribe: the CCCD write is pending
+
+	sBtClientOp():type(eBtClientOp::e_read), bResponse(false), pHandler(nullptr), bStarted(false){}
+};
+
+// One peer at a time. The discovered database is cached in flash by the peer address, the following
+// connections skip the discovery. A peer with the Database Hash characteristic is checked by reading it,
+// a different hash means the database is changed and it is discovered again.
+class cBtClient {
+	friend class cBtDevice;
+
+	cBtDevice *pDevice;
+	cBtClientCallbacks *m_pCallbacks;
+	cBtGattCache *m_pCache; // created by Init(), NVS is not ready earlier
+	uint16_t m_appId;
+	int m_gattc_if;
+	uint16_t m_connId;
+	esp_bd_addr_t m_bda;
+	uint16_t m_mtu;
+	bool m_bOpening;
+	bool m_bConnected;
+	bool m_bReady; // the database is known
+	enum class eHashRead{e_none, e_check, e_learn};
+	eHashRead m_hashRead; // the Database Hash is read to check the cached database or to cache it
+	cBtGattDb m_db; // changed by the BT events only, the handlers as well
+	struct sBtSvcRange{
+		BLEUUID uuid;
+		uint16_t start;
+		uint16_t end;
+	};
+	std::vector<sBtSvcRange> m_svcs; // found by the discovery
+	std::list<sBtClientOp> m_ops; // waiting requests
+	sBtClientOp m_op; // the executed one
+	bool m_bBusy; // m_op is executed
+	cMutex m_lock; // m_ops, m_bBusy and the connection state
+	cSemaphore m_semaphoreRegisterAppEvt;
+
+public:
+	bool UseCache; // keep the discovered databases in flash, default true
+
+	cBtClient();
+	~cBtClient();
+	void Init(cBtDevice *pDev);
+	void Deinit();
+	void setCallbacks(cBtClientCallbacks *pCallbacks){m_pCallbacks = pCallbacks;}
+
+	// connect to the peer, the result comes by OnOpen() and OnReady()
+	bool Open(const esp_bd_addr_t bda, esp_ble_addr_type_t addrType = BLE_ADDR_TYPE_PUBLIC);
+	void Close();
+	bool IsConnected()const{return m_bConnected;}
+	bool IsReady()const{return m_bReady;}
+	// characteristics of the peer, valid after OnReady()
+	cBtGattDb& getDb(){return m_db;}
+	uint16_t getMtu()const{return m_mtu;}
+
+	// the requests are queued until OnReady() and executed one by one, return false if not connected;
+	// the read values come to the handler of the handle or to the callbacks
+	bool Read(uint16_t handle);
+	// the values of the known length are read by one request up to BT_GATT_MULTI_MAX together
+	bool ReadMultiple(const uint16_t *handles, size_t count);
+	bool Write(uint16_t handle, const uint8_t *data, size_t len, bool bResponse = true);
+	// enable the notifications (or indications) of the characteristic and pass them to pHandler
+	bool Subscribe(uint16_t handle, cBtGattHandler *pHandler, bool bIndicate = false);
+	bool Unsubscribe(uint16_t handle);
+
+	// drop the cached database of the peer, it is discovered by the next connection
+	void Forget(const esp_bd_addr_t bda);
+	void ForgetAll();
+
+private:
+	void registerApp();
+	void handleGATTClientEvent(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
+	bool queue(sBtClientOp &op);
+	// start the next request if none is executed
+	void next();
+	bool execute(sBtClientOp &op);
+	void discover();
+	void collect();
+	bool cacheLoad();
+	void cacheSave();
+	// the discovered or cached database is ready after the Database Hash is read, at once if there is none
+	void readHash(eHashRead mode);
+	void onClosed();
+};
+
+#endif /* COMPONENTS_M_BT_CBTCLIENT_H_ */
@@ -0,0 +1,107 @@
+/*
+ * cBtConnPolicy.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtConnPolicy.h"
+
+#define REQUEST_TIMEOUT_FACTOR		10 // the request without the answer is rejected after this number of request intervals
+
+cBtConnPolicy::cBtConnPolicy():IdleDelayMs(5000), RequestIntervalMs(2000), MaxRejects(3),
+		AdvFastMin(0x20), AdvFastMax(0x30), AdvSlowMin(0x664), AdvSlowMax(0x808), AdvFastMs(30000),
+		m_active(0), m_lastActive(0), m_lastRequest(0), m_advFastStart(0), m_requested(eMode::e_none), m_rejected(eMode::e_none),
+		m_rejects(0), m_bConnected(false), m_bRequestPending(false), m_bAdvFast(false), m_bAdvValid(false) {
+	Fast.min_int = 6; // 7.5 ms
+	Fast.max_int = 12; // 15 ms
+	Fast.latency = 0;
+	Fast.timeout = 200; // 2 s
+	Idle.min_int = 80; // 100 ms
+	Idle.max_int = 100; // 125 ms
+	Idle.latency = 4;
+	Idle.timeout = 600; // 6 s, must be longer than (1 + latency) * interval * 2
+}
+
+void cBtConnPolicy::SetActive(uint32_t mask, bool bActive, uint32_t now){
+	uint32_t prev = m_active;
+	if(bActive)
+		m_active |= mask;
+	else
+		m_active &= ~mask;
+	if(prev && !m_active)
+		m_lastActive = now;
+}
+
+void cBtConnPolicy::OnConnect(uint32_t now){
+	if(!m_bConnected){
+		// the service discovery goes faster with the short interval
+		m_lastActive = now;
+		m_requested = eMode::e_none;
+		m_rejected = eMode::e_none;
+		m_rejects = 0;
+		m_bRequestPending = false;
+		m_lastRequest = now - RequestIntervalMs;
+	}
+	m_bConnected = true;
+}
+
+void cBtConnPolicy::OnDisconnect(uint32_t now, bool bLast){
+	if(!bLast)
+		return;
+	m_bConnected = false;
+	m_requested = eMode::e_none;
+	m_bRequestPending = false;
+}
+
+void cBtConnPolicy::OnUpdate(bool bOk, uint32_t now){
+	if(!m_bRequestPending)
+		return; // the update is initiated by the central
+	m_bRequestPending = false;
+	if(bOk){
+		m_rejects = 0;
+		return;
+	}
+	// request it again later, give up after MaxRejects
+	if(++m_rejects >= MaxRejects){
+		m_rejected = m_requested;
+		m_rejects = 0;
+	}
+	m_requested = eMode::e_none;
+}
+
+cBtConnPolicy::eMode cBtConnPolicy::desired(uint32_t now)const{
+	if(m_active || now - m_lastActive < IdleDelayMs)
+		return eMode::e_fast;
+	return eMode::e_idle;
+}
+
+bool cBtConnPolicy::Poll(uint32_t now, sBtConnParams &params){
+	if(m_bRequestPending && now - m_lastRequest > REQUEST_TIMEOUT_FACTOR * RequestIntervalMs)
+		OnUpdate(false, now); // no answer
+	if(!m_bConnected || m_bRequestPending)
+		return false;
+	eMode mode = desired(now);
+	if(mode != m_rejected)
+		m_rejected = eMode::e_none;
+	if(mode == m_requested || mode == m_rejected || now - m_lastRequest < RequestIntervalMs)
+		return false;
+	params = mode == eMode::e_fast ? Fast : Idle;
+	m_requested = mode;
+	m_lastRequest = now;
+	m_bRequestPending = true;
+	return true;
+}
+
+void cBtConnPolicy::KickAdvertising(uint32_t now){
+	m_advFastStart = now;
+}
+
+bool cBtConnPolicy::AdvInterval(uint32_t now, uint16_t &min, uint16_t &max){
+	bool bFast = now - m_advFastStart < AdvFastMs;
+	min = bFast ? AdvFastMin : AdvSlowMin;
+	max = bFast ? AdvFastMax : AdvSlowMax;
+	bool bChanged = !m_bAdvValid || bFast != m_bAdvFast;
+	m_bAdvFast = bFast;
+	m_bAdvValid = true;
+	return bChanged;
+}
@@ -0,0 +1,76 @@
+/*
+ * cBtConnPolicy.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Connection and advertising interval policy: short intervals during the activity, long ones when idle
+ */
+
+#ifndef COMPONENTS_M_BT_CBTCONNPOLICY_H_
+#define COMPONENTS_M_BT_CBTCONNPOLICY_H_
+
+#include <stdint.h>
+
+// activity sources for SetActive(), the application may add its own bits
+#define BT_LINK_BULK			(1 << 0) // bulk transfer
+#define BT_LINK_CALIBRATION		(1 << 1) // interactive calibration
+
+// connection parameters in BT units: interval 1.25 ms, supervision timeout 10 ms
+struct sBtConnParams{
+	uint16_t min_int;
+	uint16_t max_int;
+	uint16_t latency; // connection events the peripheral may skip
+	uint16_t timeout;
+};
+
+// Decides which connection parameters to request and which advertising interval to use, no BT calls here.
+// The owner passes the events and polls the decisions periodically.
+class cBtConnPolicy {
+public:
+	sBtConnParams Fast; // during the activity, default 7.5..15 ms, latency 0, timeout 2 s
+	sBtConnParams Idle; // default 100..125 ms, latency 4, timeout 6 s
+	uint32_t IdleDelayMs; // the fast parameters are kept this time after the activity, default 5000
+	uint32_t RequestIntervalMs; // min time between the requests, default 2000
+	uint8_t MaxRejects; // rejected requests of the same parameters before giving up, default 3
+
+	uint16_t AdvFastMin, AdvFastMax; // 0.625 ms units, default 20..30 ms
+	uint16_t AdvSlowMin, AdvSlowMax; // default 1022.5..1285 ms
+	uint32_t AdvFastMs; // fast advertising after boot or a button press, default 30000
+
+	cBtConnPolicy();
+
+	// activity bits (BT_LINK_xxx) are set and cleared by their sources
+	void SetActive(uint32_t mask, bool bActive, uint32_t now);
+	uint32_t Active()const{return m_active;}
+
+	void OnConnect(uint32_t now);
+	void OnDisconnect(uint32_t now, bool bLast);
+	// result of the parameters update
+	void OnUpdate(bool bOk, uint32_t now);
+
+	// parameters to request now, false if nothing to request
+	bool Poll(uint32_t now, sBtConnParams &params);
+
+	// restart the fast advertising period
+	void KickAdvertising(uint32_t now);
+	// advertising interval for now, returns true if it differs from the previous call
+	bool AdvInterval(uint32_t now, uint16_t &min, uint16_t &max);
+
+private:
+	enum class eMode{e_none, e_fast, e_idle};
+
+	uint32_t m_active;
+	uint32_t m_lastActive; // time when the activity has ended
+	uint32_t m_lastRequest;
+	uint32_t m_advFastStart;
+	eMode m_requested; // requested parameters
+	eMode m_rejected; // parameters given up after MaxRejects
+	uint8_t m_rejects;
+	bool m_bConnected;
+	bool m_bRequestPending;
+	bool m_bAdvFast; // the interval of the last AdvInterval() call
+	bool m_bAdvValid;
+
+	eMode desired(uint32_t now)const;
+};
+
+#endif /* COMPONENTS_M_BT_CBTCONNPOLICY_H_ */
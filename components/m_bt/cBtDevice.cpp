@@ -15,11 +15,14 @@
 #include <freertos/event_groups.h>
 #include <esp_bt.h>
 #include <esp_bt_main.h>
+#include <esp_gatt_common_api.h>
 #include <esp_err.h>
 #include <esp_log.h>
 
 #include "cBtDevice.h"
 #include "cBtServer.h"
+#include "cBtClient.h"
+#include "cBtScanner.h"
 
 
 
@@ -27,7 +30,7 @@ static const char* LOG_TAG = "cBtDevice";
 
 cBtDevice* cBtDevice::pActiveInst(nullptr);
 
-cBtDevice::cBtDevice() : pServer(nullptr) {
+cBtDevice::cBtDevice() : pServer(nullptr), pClient(nullptr), pScanner(nullptr) {
 	pActiveInst = this;
 }
 
@@ -52,11 +55,8 @@ void cBtDevice::gattClientEventHandler(
 	ESP_LOGD(LOG_TAG, "gattClientEventHandler [esp_gatt_if: %d] ... %d",
 			gattc_if, event);
 
-	switch(event) {
-	default: {
-		break;
-	}
-	} // switch
+	if(pClient)
+		pClient->handleGATTClientEvent(event, gattc_if, param);
 
 }
 
@@ -94,6 +94,8 @@ void cBtDevice::gapEventHandler(
 
 	if(pServer)
 		pServer->handleGAPEvent(event, param);
+	if(pScanner)
+		pScanner->handleGAPEvent(event, param);
 
 }
 
@@ -161,6 +163,12 @@ void cBtDevice::Init(const char *deviceName){
 		return;
 	};
 
+	// allow the clients to negotiate the maximal MTU, the default local MTU is 23
+	errRc = ::esp_ble_gatt_set_local_mtu(ESP_GATT_MAX_MTU_SIZE);
+	if (errRc != ESP_OK) {
+		ESP_LOGE(LOG_TAG, "esp_ble_gatt_set_local_mtu: rc=%d", errRc);
+	}
+
 	esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;
 	errRc = ::esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
 	if (errRc != ESP_OK) {
@@ -168,6 +176,16 @@ void cBtDevice::Init(const char *deviceName){
 		return;
 	};
 
+	// keep the keys, so the reconnecting clients are encrypted without the pairing
+	esp_ble_auth_req_t authReq = ESP_LE_AUTH_BOND;
+	errRc = ::esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &authReq, sizeof(uint8_t));
+	if (errRc != ESP_OK) {
+		ESP_LOGE(LOG_TAG, "esp_ble_gap_set_security_param: rc=%d", errRc);
+	};
+	uint8_t keyMask = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+	::esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &keyMask, sizeof(uint8_t));
+	::esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &keyMask, sizeof(uint8_t));
+
 	vTaskDelay(300/portTICK_PERIOD_MS); // Delay for at least 200 msecs as a workaround to some hw issues.
 
 }
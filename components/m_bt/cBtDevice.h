@@ -14,11 +14,17 @@
 #include <esp_gatts_api.h>   // ESP32 BLE
 
 class cBtServer;
+class cBtClient;
+class cBtScanner;
 
 class cBtDevice {
 	friend class cBtServer;
+	friend class cBtClient;
+	friend class cBtScanner;
 	static cBtDevice *pActiveInst; // instance of this class (must be only one, because we have only one BT device)
 	cBtServer *pServer; // our device will be used as a BT Server
+	cBtClient *pClient; // and as a BT Client
+	cBtScanner *pScanner; // the advertisements of other devices
 public:
 	cBtDevice();
 	~cBtDevice();
@@ -0,0 +1,123 @@
+/*
+ * cBtFragmenter.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtFragmenter.h"
+
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtFragmenter";
+
+#define FRAG_MAX_LEN		0xffff // the total length field is 16 bit
+
+cBtFragmenter::cBtFragmenter():m_pos(0), m_seq(0), m_bActive(false), m_bCredits(false), m_credits(0) {
+}
+
+void cBtFragmenter::Start(const uint8_t *data, size_t len){
+	if(len > FRAG_MAX_LEN){
+		ESP_LOGE(LOG_TAG, "Value is too long: %d", len);
+		len = FRAG_MAX_LEN;
+	}
+	m_data.assign(data, data + len);
+	m_pos = 0;
+	m_seq = 0;
+	m_bActive = true;
+}
+
+void cBtFragmenter::Reset(){
+	m_data.clear();
+	m_pos = 0;
+	m_seq = 0;
+	m_bActive = false;
+}
+
+bool cBtFragmenter::Next(size_t payload, std::vector<uint8_t> &frame){
+	if(!m_bActive || payload < BT_FRAG_MIN_PAYLOAD)
+		return false;
+	if(m_bCredits){
+		if(m_credits <= 0)
+			return false;
+		m_credits--;
+	}
+	bool bFirst = m_pos == 0;
+	size_t room = payload - (bFirst ? 3 : 1);
+	size_t chunk = m_data.size() - m_pos < room ? m_data.size() - m_pos : room;
+	bool bLast = m_pos + chunk == m_data.size();
+
+	frame.clear();
+	frame.push_back((bFirst ? BT_FRAG_FIRST : 0) | (bLast ? BT_FRAG_LAST : 0) | (m_seq & BT_FRAG_SEQ_MASK));
+	if(bFirst){
+		frame.push_back(m_data.size() & 0xff);
+		frame.push_back(m_data.size() >> 8);
+	}
+	frame.insert(frame.end(), m_data.begin() + m_pos, m_data.begin() + m_pos + chunk);
+	m_pos += chunk;
+	m_seq++;
+	if(bLast)
+		Reset();
+	return true;
+}
+
+void cBtFragmenter::EnableCredits(bool bEnable){
+	m_bCredits = bEnable;
+	m_credits = 0;
+}
+
+void cBtFragmenter::AddCredits(int count){
+	m_credits += count;
+	if(m_credits > 0xff)
+		m_credits = 0xff;
+}
+
+//===================================== cBtReassembler =============================
+
+cBtReassembler::cBtReassembler():MaxLen(4096), m_total(0), m_seq(0), m_bActive(false) {
+}
+
+void cBtReassembler::Reset(){
+	m_data.clear();
+	m_total = 0;
+	m_seq = 0;
+	m_bActive = false;
+}
+
+eBtFragResult cBtReassembler::Feed(const uint8_t *frame, size_t len){
+	if(len < 1)
+		return eBtFragResult::e_error;
+	uint8_t hdr = frame[0];
+	size_t pos = 1;
+	if(hdr & BT_FRAG_FIRST){
+		// a new value restarts the previous unfinished one
+		if(len < 3 || (hdr & BT_FRAG_SEQ_MASK) != 0){
+			Reset();
+			return eBtFragResult::e_error;
+		}
+		m_data.clear();
+		m_total = frame[1] | (frame[2] << 8);
+		if(m_total > MaxLen){
+			ESP_LOGE(LOG_TAG, "Value is too long: %d", m_total);
+			Reset();
+			return eBtFragResult::e_error;
+		}
+		m_data.reserve(m_total);
+		m_seq = 0;
+		m_bActive = true;
+		pos = 3;
+	}else if(!m_bActive || (hdr & BT_FRAG_SEQ_MASK) != (m_seq & BT_FRAG_SEQ_MASK)){
+		// lost frame
+		Reset();
+		return eBtFragResult::e_error;
+	}
+	if(m_data.size() + len - pos > m_total){
+		Reset();
+		return eBtFragResult::e_error;
+	}
+	m_data.insert(m_data.end(), frame + pos, frame + len);
+	m_seq++;
+	if(!(hdr & BT_FRAG_LAST))
+		return eBtFragResult::e_more;
+	m_bActive = false;
+	return m_data.size() == m_total ? eBtFragResult::e_done : eBtFragResult::e_error;
+}
@@ -0,0 +1,73 @@
+/*
+ * cBtFragmenter.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Framing of long characteristic values into several notifications and their reassembly
+ */
+
+#ifndef COMPONENTS_M_BT_CBTFRAGMENTER_H_
+#define COMPONENTS_M_BT_CBTFRAGMENTER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Frame format: 1 byte header, the first frame has also the total value length (2 bytes, LE), then data.
+// Header: bit 7 - first frame, bit 6 - last frame, bits 0..5 - sequence number, starts from 0 with every value.
+#define BT_FRAG_FIRST			0x80
+#define BT_FRAG_LAST			0x40
+#define BT_FRAG_SEQ_MASK		0x3f
+#define BT_FRAG_MIN_PAYLOAD		4 // header, length and at least one data byte
+
+// Splits the value into frames, no BT calls here.
+// With the credits enabled every frame takes one credit, the receiver gives new ones.
+class cBtFragmenter {
+public:
+	cBtFragmenter();
+
+	// start a new value, the data is copied
+	void Start(const uint8_t *data, size_t len);
+	void Reset();
+	bool Busy()const{return m_bActive;}
+	size_t Remaining()const{return m_bActive ? m_data.size() - m_pos : 0;}
+
+	// build the next frame not longer than payload (ATT MTU - 3),
+	// returns false if all frames are built or no credits are left
+	bool Next(size_t payload, std::vector<uint8_t> &frame);
+
+	void EnableCredits(bool bEnable);
+	bool CreditsEnabled()const{return m_bCredits;}
+	void AddCredits(int count);
+	int Credits()const{return m_credits;}
+
+private:
+	std::vector<uint8_t> m_data;
+	size_t m_pos; // position of the next frame data
+	uint8_t m_seq;
+	bool m_bActive;
+	bool m_bCredits;
+	int m_credits;
+};
+
+enum class eBtFragResult{e_more, e_done, e_error};
+
+// Receiving side of cBtFragmenter
+class cBtReassembler {
+public:
+	size_t MaxLen; // longer values are rejected, default 4096
+
+	cBtReassembler();
+
+	// process the received frame, the value is in Data() after e_done
+	eBtFragResult Feed(const uint8_t *frame, size_t len);
+	void Reset();
+	const std::vector<uint8_t>& Data()const{return m_data;}
+
+private:
+	std::vector<uint8_t> m_data;
+	size_t m_total; // expected value length
+	uint8_t m_seq; // expected sequence number
+	bool m_bActive;
+};
+
+#endif /* COMPONENTS_M_BT_CBTFRAGMENTER_H_ */
@@ -0,0 +1,114 @@
+/*
+ * cBtGattCache.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtGattCache.h"
+#include "../m_flash/cFlash.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtGattCache";
+
+#define CACHE_INDEX_KEY		"index"
+#define CACHE_ADDR_LEN		6
+
+cBtGattCache::cBtGattCache(const std::string &storageName):m_bIndexLoaded(false) {
+	m_pFlash = new cFlash(storageName);
+}
+
+cBtGattCache::~cBtGattCache() {
+	delete m_pFlash;
+}
+
+// NVS keys are up to 15 characters: 'd' and 12 hex digits of the address
+std::string cBtGattCache::key(const esp_bd_addr_t bda){
+	char buf[16];
+	snprintf(buf, sizeof buf, "d%02x%02x%02x%02x%02x%02x", bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+	return buf;
+}
+
+void cBtGattCache::indexLoad(){
+	if(m_bIndexLoaded)
+		return;
+	if(!m_pFlash->GetVal(CACHE_INDEX_KEY, m_index) || m_index.size() % CACHE_ADDR_LEN)
+		m_index.clear();
+	m_bIndexLoaded = true;
+}
+
+int cBtGattCache::indexFind(const esp_bd_addr_t bda){
+	for(size_t i = 0; i < m_index.size(); i += CACHE_ADDR_LEN){
+		if(memcmp(&m_index[i], bda, CACHE_ADDR_LEN) == 0)
+			return i;
+	}
+	return -1;
+}
+
+bool cBtGattCache::indexTouch(const esp_bd_addr_t bda){
+	indexLoad();
+	int pos = indexFind(bda);
+	if(pos >= 0 && pos + CACHE_ADDR_LEN == (int)m_index.size())
+		return false;
+	if(pos >= 0)
+		m_index.erase(m_index.begin() + pos, m_index.begin() + pos + CACHE_ADDR_LEN);
+	m_index.insert(m_index.end(), bda, bda + CACHE_ADDR_LEN);
+	while(m_index.size() > BT_GATT_CACHE_MAX_PEERS * CACHE_ADDR_LEN){
+		m_pFlash->Erase(key(&m_index[0]));
+		m_index.erase(m_index.begin(), m_index.begin() + CACHE_ADDR_LEN);
+	}
+	return true;
+}
+
+bool cBtGattCache::Load(const esp_bd_addr_t bda, cBtGattDb &db){
+	std::vector<uint8_t> data;
+	if(!m_pFlash->GetVal(key(bda), data))
+		return false;
+	if(!cBtGattDb::Decode(data, db)){
+		ESP_LOGE(LOG_TAG, "Bad record %s", key(bda).c_str());
+		return false;
+	}
+	// a record of the former versions without the index is adopted by it
+	if(indexTouch(bda)){
+		if(!m_pFlash->SetVal(CACHE_INDEX_KEY, m_index) || !m_pFlash->Commit())
+			ESP_LOGE(LOG_TAG, "Index is not saved");
+	}
+	return true;
+}
+
+bool cBtGattCache::Save(const esp_bd_addr_t bda, const cBtGattDb &db){
+	std::vector<uint8_t> data;
+	cBtGattDb::Encode(db, data);
+	bool bOk = m_pFlash->SetVal(key(bda), data);
+	if(indexTouch(bda))
+		bOk = m_pFlash->SetVal(CACHE_INDEX_KEY, m_index) && bOk;
+	return m_pFlash->Commit() && bOk;
+}
+
+bool cBtGattCache::Erase(const esp_bd_addr_t bda){
+	indexLoad();
+	int pos = indexFind(bda);
+	if(pos >= 0){
+		m_index.erase(m_index.begin() + pos, m_index.begin() + pos + CACHE_ADDR_LEN);
+		if(m_index.empty())
+			m_pFlash->Erase(CACHE_INDEX_KEY);
+		else
+			m_pFlash->SetVal(CACHE_INDEX_KEY, m_index);
+	}
+	bool bOk = m_pFlash->Erase(key(bda));
+	return m_pFlash->Commit() && bOk;
+}
+
+void cBtGattCache::EraseAll(){
+	m_pFlash->EraseAll();
+	m_pFlash->Commit();
+	m_index.clear();
+	m_bIndexLoaded = true;
+}
+
+size_t cBtGattCache::Count(){
+	indexLoad();
+	return m_index.size() / CACHE_ADDR_LEN;
+}
@@ -0,0 +1,47 @@
+/*
+ * cBtGattCache.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Flash cache of the discovered databases of the peers for the GATT client
+ */
+
+#ifndef COMPONENTS_M_BT_CBTGATTCACHE_H_
+#define COMPONENTS_M_BT_CBTGATTCACHE_H_
+
+#include <stdint.h>
+#include <esp_bt_defs.h>
+#include <string>
+#include <vector>
+#include "cBtGattDb.h"
+
+class cFlash;
+
+#define BT_GATT_CACHE_MAX_PEERS		8 // the least recently used peer is dropped
+
+// NVS backed store of the databases by the peer address
+class cBtGattCache {
+public:
+	cBtGattCache(const std::string &storageName = "btgattc");
+	~cBtGattCache();
+
+	// the loaded peer becomes the most recently used, the index is written only if the order is changed
+	bool Load(const esp_bd_addr_t bda, cBtGattDb &db);
+	bool Save(const esp_bd_addr_t bda, const cBtGattDb &db);
+	bool Erase(const esp_bd_addr_t bda);
+	void EraseAll();
+	// number of the cached peers
+	size_t Count();
+
+private:
+	cFlash *m_pFlash;
+	std::vector<uint8_t> m_index; // addresses of the cached peers, 6 bytes each, the last used at the end
+	bool m_bIndexLoaded;
+
+	static std::string key(const esp_bd_addr_t bda);
+	void indexLoad();
+	int indexFind(const esp_bd_addr_t bda);
+	// move the peer to the end and drop the oldest ones over the limit, returns true if the index is changed
+	bool indexTouch(const esp_bd_addr_t bda);
+};
+
+#endif /* COMPONENTS_M_BT_CBTGATTCACHE_H_ */
@@ -0,0 +1,184 @@
+/*
+ * cBtGattDb.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtGattDb.h"
+
+#include <algorithm>
+#include <string.h>
+
+#define GATTDB_VERSION		2 // 2: Database Hash
+#define GATTDB_CHAR_LEN		(16 + 16 + 2 + 2 + 1 + 2) // svc, uuid, handle, cccd, props, len
+
+static const BLEUUID s_svcChangedUuid = "2a05"_uuid;
+static const BLEUUID s_dbHashUuid = "2b2a"_uuid;
+
+// serialization helpers
+static void put_u16(std::vector<uint8_t> &buf, uint16_t v){
+	buf.push_back(v & 0xff);
+	buf.push_back(v >> 8);
+}
+
+static uint16_t get_u16(const uint8_t *p){
+	return p[0] | (p[1] << 8);
+}
+
+void cBtGattDb::Clear(){
+	m_chars.clear();
+	m_hash.clear();
+}
+
+void cBtGattDb::Add(const sBtGattChar &chr){
+	auto it = std::lower_bound(m_chars.begin(), m_chars.end(), chr.handle,
+			[](const sBtGattChar &c, uint16_t handle){return c.handle < handle;});
+	if(it != m_chars.end() && it->handle == chr.handle)
+		*it = chr;
+	else
+		m_chars.insert(it, chr);
+}
+
+sBtGattChar* cBtGattDb::Find(const BLEUUID &svc, const BLEUUID &uuid){
+	for(auto &chr : m_chars){
+		if(chr.uuid == uuid && chr.svc == svc)
+			return &chr;
+	}
+	return nullptr;
+}
+
+sBtGattChar* cBtGattDb::FindByHandle(uint16_t handle){
+	auto it = std::lower_bound(m_chars.begin(), m_chars.end(), handle,
+			[](const sBtGattChar &c, uint16_t handle){return c.handle < handle;});
+	return it != m_chars.end() && it->handle == handle ? &*it : nullptr;
+}
+
+uint16_t cBtGattDb::ServiceChangedHandle(){
+	for(auto &chr : m_chars){
+		if(chr.uuid == s_svcChangedUuid)
+			return chr.handle;
+	}
+	return 0;
+}
+
+uint16_t cBtGattDb::HashHandle(){
+	for(auto &chr : m_chars){
+		if(chr.uuid == s_dbHashUuid)
+			return chr.handle;
+	}
+	return 0;
+}
+
+void cBtGattDb::SetHash(const uint8_t *hash, size_t len){
+	if(len == BT_GATT_HASH_LEN)
+		m_hash.assign(hash, hash + len);
+	else
+		m_hash.clear();
+}
+
+bool cBtGattDb::HashMatches(const uint8_t *hash, size_t len)const{
+	return len == BT_GATT_HASH_LEN && m_hash.size() == len && memcmp(m_hash.data(), hash, len) == 0;
+}
+
+bool cBtGattDb::SetLength(uint16_t handle, size_t len){
+	sBtGattChar *pChr = FindByHandle(handle);
+	if(!pChr || pChr->len == len || len > 0xffff)
+		return false;
+	pChr->len = len;
+	return true;
+}
+
+void cBtGattDb::PlanReads(const uint16_t *handles, size_t count, size_t payload, std::vector<std::vector<uint16_t> > &reads){
+	reads.clear();
+	std::vector<uint16_t> batch;
+	size_t batchLen = 0;
+	for(size_t i = 0; i < count; i++){
+		sBtGattChar *pChr = FindByHandle(handles[i]);
+		if(!pChr || !pChr->len || pChr->len > payload){
+			// the length is learned by the single read
+			reads.push_back(std::vector<uint16_t>(1, handles[i]));
+			continue;
+		}
+		if(batch.size() == BT_GATT_MULTI_MAX || batchLen + pChr->len > payload){
+			reads.push_back(batch);
+			batch.clear();
+			batchLen = 0;
+		}
+		batch.push_back(handles[i]);
+		batchLen += pChr->len;
+	}
+	if(!batch.empty())
+		reads.push_back(batch);
+}
+
+void cBtGattDb::SetHandler(uint16_t handle, cBtGattHandler *pHandler){
+	if(pHandler)
+		m_handlers[handle] = pHandler;
+	else
+		m_handlers.erase(handle);
+}
+
+cBtGattHandler* cBtGattDb::Handler(uint16_t handle, cBtGattHandler *pDefault){
+	auto it = m_handlers.find(handle);
+	return it != m_handlers.end() ? it->second : pDefault;
+}
+
+bool cBtGattDb::SplitMultiple(const uint16_t *handles, size_t count, size_t len, std::vector<uint16_t> &lens){
+	size_t total = 0;
+	lens.clear();
+	for(size_t i = 0; i < count; i++){
+		sBtGattChar *pChr = FindByHandle(handles[i]);
+		if(!pChr || !pChr->len)
+			return false;
+		lens.push_back(pChr->len);
+		total += pChr->len;
+	}
+	return total == len;
+}
+
+void cBtGattDb::Encode(const cBtGattDb &db, std::vector<uint8_t> &data){
+	data.clear();
+	data.reserve(3 + db.m_chars.size() * GATTDB_CHAR_LEN + 1 + db.m_hash.size());
+	data.push_back(GATTDB_VERSION);
+	put_u16(data, db.m_chars.size());
+	uint8_t uuid[16];
+	for(auto &chr : db.m_chars){
+		chr.svc.get128(uuid);
+		data.insert(data.end(), uuid, uuid + 16);
+		chr.uuid.get128(uuid);
+		data.insert(data.end(), uuid, uuid + 16);
+		put_u16(data, chr.handle);
+		put_u16(data, chr.cccd);
+		data.push_back(chr.props);
+		put_u16(data, chr.len);
+	}
+	data.push_back(db.m_hash.size());
+	data.insert(data.end(), db.m_hash.begin(), db.m_hash.end());
+}
+
+bool cBtGattDb::Decode(const std::vector<uint8_t> &data, cBtGattDb &db){
+	if(data.size() < 3 || data[0] != GATTDB_VERSION)
+		return false;
+	size_t count = get_u16(&data[1]);
+	size_t hashPos = 3 + count * GATTDB_CHAR_LEN;
+	if(data.size() <= hashPos || (data[hashPos] != 0 && data[hashPos] != BT_GATT_HASH_LEN) ||
+			data.size() != hashPos + 1 + data[hashPos])
+		return false;
+	db.Clear();
+	db.SetHash(data.data() + hashPos + 1, data[hashPos]);
+	const uint8_t *p = &data[3];
+	uint8_t uuid[16];
+	for(size_t i = 0; i < count; i++, p += GATTDB_CHAR_LEN){
+		sBtGattChar chr;
+		memcpy(uuid, p, 16);
+		chr.svc = BLEUUID(uuid, 16, false);
+		memcpy(uuid, p + 16, 16);
+		chr.uuid = BLEUUID(uuid, 16, false);
+		chr.handle = get_u16(p + 32);
+		chr.cccd = get_u16(p + 34);
+		chr.props = p[36];
+		chr.len = get_u16(p + 37);
+		db.Add(chr);
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * cBtGattDb.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Discovered attribute database of a peer for the GATT client, its flash cache record and the value dispatch
+ */
+
+#ifndef COMPONENTS_M_BT_CBTGATTDB_H_
+#define COMPONENTS_M_BT_CBTGATTDB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include "BLEUUID.h"
+
+#define BT_GATT_MULTI_MAX		10 // handles of one read multiple request, ESP_GATT_MAX_READ_MULTI_HANDLES
+#define BT_GATT_HASH_LEN		16 // Database Hash characteristic (0x2B2A) value
+
+// characteristic of the peer
+struct sBtGattChar{
+	BLEUUID svc; // service UUID
+	BLEUUID uuid;
+	uint16_t handle; // value handle
+	uint16_t cccd; // CCCD handle, 0 if there is none
+	uint8_t props; // ESP_GATT_CHAR_PROP_BIT_xxx
+	uint16_t len; // value length of the last single read, 0 if unknown; needed to split the read multiple response
+};
+
+// receiver of the read and notified values
+class cBtGattHandler{
+public:
+	virtual ~cBtGattHandler(){}
+	// bNotify - notification or indication, otherwise read response
+	virtual void OnValue(uint16_t handle, const uint8_t *data, size_t len, bool bNotify) = 0;
+};
+
+// No BT calls here, the client fills it by the discovery or from the cache.
+class cBtGattDb {
+public:
+	void Clear(); // the handlers are kept
+	bool Empty()const{return m_chars.empty();}
+	void Add(const sBtGattChar &chr);
+	sBtGattChar* Find(const BLEUUID &svc, const BLEUUID &uuid);
+	sBtGattChar* FindByHandle(uint16_t handle);
+	const std::vector<sBtGattChar>& Chars()const{return m_chars;}
+	// Service Changed characteristic, 0 if the peer has none
+	uint16_t ServiceChangedHandle();
+	// Database Hash characteristic (GATT 5.1), 0 if the peer has none
+	uint16_t HashHandle();
+	// the Database Hash of the peer when it was discovered, empty if unknown; a cached database is valid
+	// while the peer reports the same hash
+	const std::vector<uint8_t>& Hash()const{return m_hash;}
+	void SetHash(const uint8_t *hash, size_t len);
+	bool HashMatches(const uint8_t *hash, size_t len)const;
+
+	// the read response remembers the value length, returns true if it was changed (the cache is to be saved)
+	bool SetLength(uint16_t handle, size_t len);
+	// split the handles into the read requests: up to BT_GATT_MULTI_MAX handles of the known length
+	// together not longer than payload (ATT MTU - 1), a single handle otherwise
+	void PlanReads(const uint16_t *handles, size_t count, size_t payload, std::vector<std::vector<uint16_t> > &reads);
+
+	// handler of the handle, nullptr removes it
+	void SetHandler(uint16_t handle, cBtGattHandler *pHandler);
+	void ClearHandlers(){m_handlers.clear();}
+	// receiver of the values of the handle, pDefault if it has no handler
+	cBtGattHandler* Handler(uint16_t handle, cBtGattHandler *pDefault = nullptr);
+	// read multiple response has the values one after another, they are split by the known lengths;
+	// returns false if the lengths do not match the response
+	bool SplitMultiple(const uint16_t *handles, size_t count, size_t len, std::vector<uint16_t> &lens);
+
+	// cache record format
+	static void Encode(const cBtGattDb &db, std::vector<uint8_t> &data);
+	static bool Decode(const std::vector<uint8_t> &data, cBtGattDb &db);
+
+private:
+	std::vector<sBtGattChar> m_chars; // sorted by handle
+	std::vector<uint8_t> m_hash;
+	std::map<uint16_t, cBtGattHandler*> m_handlers; // by value handle
+};
+
+#endif /* COMPONENTS_M_BT_CBTGATTDB_H_ */
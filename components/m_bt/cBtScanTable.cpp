@@ -0,0 +1,162 @@
+/*
+ * cBtScanTable.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtScanTable.h"
+#include "../../main/common/fnv1a.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define SCAN_MASK			(BT_SCAN_TABLE_SIZE - 1)
+#define SCAN_MAX_COUNT		(BT_SCAN_TABLE_SIZE * 3 / 4) // the oldest device is dropped above, the probing stays short
+#define SCAN_RSSI_WEIGHT	4 // the new RSSI has the weight 1/4 in the average
+
+static_assert((BT_SCAN_TABLE_SIZE & SCAN_MASK) == 0, "BT_SCAN_TABLE_SIZE must be a power of 2");
+
+bool cBtAdvIter::Next(uint8_t &type, const uint8_t *&value, size_t &len){
+	if(m_p >= m_end)
+		return false;
+	size_t fieldLen = m_p[0]; // type and value
+	if(fieldLen == 0 || m_p + 1 + fieldLen > m_end){
+		m_p = m_end;
+		return false;
+	}
+	type = m_p[1];
+	value = m_p + 2;
+	len = fieldLen - 1;
+	m_p += 1 + fieldLen;
+	return true;
+}
+
+bool cBtAdvIter::Find(const uint8_t *data, size_t len, uint8_t type, const uint8_t *&value, size_t &valueLen){
+	cBtAdvIter it(data, len);
+	uint8_t t;
+	while(it.Next(t, value, valueLen)){
+		if(t == type)
+			return true;
+	}
+	return false;
+}
+
+//===================================== cBtScanTable =============================
+
+cBtScanTable::cBtScanTable():RssiDelta(6), MinRssi(-100), TimeoutMs(30000) {
+	Clear();
+}
+
+void cBtScanTable::Clear(){
+	memset(m_tab, 0, sizeof(m_tab));
+	m_count = 0;
+}
+
+uint32_t cBtScanTable::Hash(const uint8_t *data, size_t len){
+	uint32_t h = fnv1a(data, len);
+	return h ? h : 1; // 0 means no data
+}
+
+size_t cBtScanTable::home(const uint8_t *bda){
+	return Hash(bda, 6) & SCAN_MASK;
+}
+
+int cBtScanTable::lookup(const uint8_t *bda)const{
+	for(size_t i = home(bda); m_tab[i].used; i = (i + 1) & SCAN_MASK){
+		if(memcmp(m_tab[i].bda, bda, 6) == 0)
+			return i;
+	}
+	return -1;
+}
+
+const sBtScanDevice* cBtScanTable::Find(const uint8_t *bda)const{
+	int i = lookup(bda);
+	return i >= 0 ? &m_tab[i] : nullptr;
+}
+
+// backward shift deletion, the following entries of the probe sequence are moved to the gap
+void cBtScanTable::remove(size_t i){
+	for(size_t j = (i + 1) & SCAN_MASK; m_tab[j].used; j = (j + 1) & SCAN_MASK){
+		size_t k = home(m_tab[j].bda);
+		// the entry at j stays if its home is cyclically in (i, j]
+		bool bStays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+		if(!bStays){
+			m_tab[i] = m_tab[j];
+			i = j;
+		}
+	}
+	m_tab[i].used = false;
+	m_count--;
+}
+
+void cBtScanTable::evictOldest(){
+	size_t oldest = 0;
+	bool bFound = false;
+	for(size_t i = 0; i < BT_SCAN_TABLE_SIZE; i++){
+		if(m_tab[i].used && (!bFound || (int32_t)(m_tab[i].lastSeen - m_tab[oldest].lastSeen) < 0)){
+			oldest = i;
+			bFound = true;
+		}
+	}
+	if(bFound)
+		remove(oldest);
+}
+
+eBtScanReport cBtScanTable::Feed(const uint8_t *bda, uint8_t addrType, int rssi, const uint8_t *data, size_t len, bool bScanRsp,
+		uint32_t now, const sBtScanDevice **ppDev){
+	if(ppDev)
+		*ppDev = nullptr;
+	if(rssi < MinRssi)
+		return eBtScanReport::e_none;
+	uint32_t hash = Hash(data, len);
+	int i = lookup(bda);
+	eBtScanReport report = eBtScanReport::e_none;
+	if(i < 0){
+		if(m_count >= SCAN_MAX_COUNT)
+			evictOldest();
+		size_t pos = home(bda);
+		while(m_tab[pos].used)
+			pos = (pos + 1) & SCAN_MASK;
+		sBtScanDevice &dev = m_tab[pos];
+		memset(&dev, 0, sizeof(dev));
+		memcpy(dev.bda, bda, 6);
+		dev.used = true;
+		dev.rssiAvg = rssi * BT_SCAN_RSSI_SCALE;
+		dev.firstSeen = now;
+		m_count++;
+		i = pos;
+		report = eBtScanReport::e_new;
+	}else{
+		sBtScanDevice &dev = m_tab[i];
+		dev.rssiAvg += (rssi * BT_SCAN_RSSI_SCALE - dev.rssiAvg) / SCAN_RSSI_WEIGHT;
+		// the advertisement and the scan response are compared separately, they alternate with the active scan
+		if((bScanRsp ? dev.rspHash : dev.advHash) != hash)
+			report = eBtScanReport::e_changed;
+		else if(abs(dev.Rssi() - dev.rssiReported) >= RssiDelta)
+			report = eBtScanReport::e_rssi;
+	}
+	sBtScanDevice &dev = m_tab[i];
+	dev.addrType = addrType;
+	dev.lastSeen = now;
+	dev.count++;
+	if(bScanRsp)
+		dev.rspHash = hash;
+	else
+		dev.advHash = hash;
+	if(report != eBtScanReport::e_none)
+		dev.rssiReported = dev.Rssi();
+	if(ppDev)
+		*ppDev = &dev;
+	return report;
+}
+
+bool cBtScanTable::Expire(uint32_t now, sBtScanDevice &lost){
+	for(size_t i = 0; i < BT_SCAN_TABLE_SIZE; i++){
+		if(m_tab[i].used && now - m_tab[i].lastSeen > TimeoutMs){
+			lost = m_tab[i];
+			remove(i);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,84 @@
+/*
+ * cBtScanTable.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Parsing of the received advertisements and the table of the seen devices for the scanner
+ */
+
+#ifndef COMPONENTS_M_BT_CBTSCANTABLE_H_
+#define COMPONENTS_M_BT_CBTSCANTABLE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef BT_SCAN_TABLE_SIZE
+#define BT_SCAN_TABLE_SIZE		64 // devices, power of 2
+#endif
+#define BT_SCAN_RSSI_SCALE		16 // the RSSI average is kept in 1/16 dB
+
+// AD structures of the advertisement or scan response data, nothing is copied
+class cBtAdvIter {
+public:
+	cBtAdvIter(const uint8_t *data, size_t len):m_p(data), m_end(data + len){}
+	// the next AD structure, returns false at the end, on the padding or a bad length
+	bool Next(uint8_t &type, const uint8_t *&value, size_t &len);
+	// the first AD structure of the type
+	static bool Find(const uint8_t *data, size_t len, uint8_t type, const uint8_t *&value, size_t &valueLen);
+
+private:
+	const uint8_t *m_p;
+	const uint8_t *m_end;
+};
+
+// device in the table
+struct sBtScanDevice{
+	uint8_t bda[6];
+	uint8_t addrType; // esp_ble_addr_type_t
+	bool used;
+	int16_t rssiAvg; // moving average in 1/BT_SCAN_RSSI_SCALE dB
+	int8_t rssiReported; // average at the last report
+	uint32_t advHash; // of the advertisement data, 0 if not received yet
+	uint32_t rspHash; // of the scan response data
+	uint32_t firstSeen; // ms
+	uint32_t lastSeen;
+	uint32_t count; // received advertisements and scan responses
+
+	int Rssi()const{return (rssiAvg + (rssiAvg < 0 ? -BT_SCAN_RSSI_SCALE / 2 : BT_SCAN_RSSI_SCALE / 2)) / BT_SCAN_RSSI_SCALE;}
+};
+
+enum class eBtScanReport{e_none, e_new, e_changed, e_rssi};
+
+// Open addressing table of the seen devices by the address. Reports only the new devices, the changed data
+// and the big RSSI changes, so the application does not get every received advertisement. No BT calls here.
+class cBtScanTable {
+public:
+	int RssiDelta; // change of the average RSSI reported, dB, default 6
+	int MinRssi; // weaker devices are ignored, default -100
+	uint32_t TimeoutMs; // device is lost if not seen for this time, default 30000
+
+	cBtScanTable();
+	void Clear();
+	size_t Count()const{return m_count;}
+
+	// process the received advertisement (or scan response, bScanRsp), pDev is the table entry if it is not ignored
+	eBtScanReport Feed(const uint8_t *bda, uint8_t addrType, int rssi, const uint8_t *data, size_t len, bool bScanRsp,
+			uint32_t now, const sBtScanDevice **ppDev = nullptr);
+	// remove one device not seen for TimeoutMs, returns false if there is none
+	bool Expire(uint32_t now, sBtScanDevice &lost);
+	const sBtScanDevice* Find(const uint8_t *bda)const;
+	// entry by index 0..BT_SCAN_TABLE_SIZE-1 for the iteration, nullptr if not used
+	const sBtScanDevice* At(size_t i)const{return i < BT_SCAN_TABLE_SIZE && m_tab[i].used ? &m_tab[i] : nullptr;}
+
+	static uint32_t Hash(const uint8_t *data, size_t len);
+
+private:
+	sBtScanDevice m_tab[BT_SCAN_TABLE_SIZE];
+	size_t m_count;
+
+	static size_t home(const uint8_t *bda);
+	int lookup(const uint8_t *bda)const;
+	void remove(size_t i);
+	void evictOldest();
+};
+
+#endif /* COMPONENTS_M_BT_CBTSCANTABLE_H_ */
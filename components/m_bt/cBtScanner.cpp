@@ -0,0 +1,191 @@
+/*
+ * cBtScanner.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtScanner.h"
+
+#include <esp_log.h>
+
+static const char* LOG_TAG = "cBtScanner";
+
+#define SCAN_EXPIRE_PERIOD_MS	1000 // check of the lost devices
+
+// scan interval and window in 0.625 ms units, 2.5 ms .. 10.24 s
+static uint16_t scan_units(uint16_t ms){
+	uint32_t units = ms * 1000 / 625;
+	return units < 0x0004 ? 0x0004 : units > 0x4000 ? 0x4000 : units;
+}
+
+cBtScanner::cBtScanner():pDevice(nullptr), m_pCallbacks(nullptr), m_bStartPending(false), m_bScanning(false),
+		m_duration(0), m_expireTimer(nullptr) {
+	Active     = false;
+	IntervalMs = 100;
+	WindowMs   = 20;
+}
+
+cBtScanner::~cBtScanner() {
+	Deinit();
+}
+
+void cBtScanner::Init(cBtDevice *pDev){
+	pDevice = pDev;
+	pDev->pScanner = this;
+	if(!m_expireTimer)
+		m_expireTimer = xTimerCreate("BT scan", SCAN_EXPIRE_PERIOD_MS / portTICK_PERIOD_MS, pdTRUE, this, expireTimerHandler);
+}
+
+void cBtScanner::Deinit(){
+	Stop();
+	if(m_expireTimer){
+		xTimerStop(m_expireTimer, portMAX_DELAY);
+		xTimerDelete(m_expireTimer, portMAX_DELAY);
+		m_expireTimer = nullptr;
+	}
+	if(pDevice) pDevice->pScanner = nullptr;
+	pDevice = nullptr;
+}
+
+bool cBtScanner::Start(uint32_t durationSec){
+	uint16_t interval = scan_units(IntervalMs);
+	uint16_t window = scan_units(WindowMs);
+	esp_ble_scan_params_t params;
+	params.scan_type = Active ? BLE_SCAN_TYPE_ACTIVE : BLE_SCAN_TYPE_PASSIVE;
+	params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+	params.scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL;
+	params.scan_interval = interval;
+	params.scan_window = window < interval ? window : interval;
+	// every advertisement is needed for the RSSI average, the duplicates are filtered by the table
+	params.scan_duplicate = BLE_SCAN_DUPLICATE_DISABLE;
+
+	m_duration = durationSec;
+	m_bStartPending = true; // the scan is started by ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT
+	esp_err_t errRc = ::esp_ble_gap_set_scan_params(&params);
+	if(errRc != ESP_OK){
+		ESP_LOGE(LOG_TAG, "esp_ble_gap_set_scan_params: rc=%d", errRc);
+		m_bStartPending = false;
+		return false;
+	}
+	return true;
+}
+
+void cBtScanner::Stop(){
+	m_bStartPending = false;
+	if(!m_bScanning)
+		return;
+	esp_err_t errRc = ::esp_ble_gap_stop_scanning();
+	if(errRc != ESP_OK)
+		ESP_LOGE(LOG_TAG, "esp_ble_gap_stop_scanning: rc=%d", errRc);
+}
+
+void cBtScanner::Clear(){
+	cAutoLock lock(m_lock);
+	m_table.Clear();
+}
+
+void cBtScanner::getDevices(std::vector<sBtScanDevice> &devices){
+	cAutoLock lock(m_lock);
+	devices.clear();
+	devices.reserve(m_table.Count());
+	for(size_t i = 0; i < BT_SCAN_TABLE_SIZE; i++){
+		const sBtScanDevice *pDev = m_table.At(i);
+		if(pDev)
+			devices.push_back(*pDev);
+	}
+}
+
+void cBtScanner::feed(esp_ble_gap_cb_param_t *param, const uint8_t *data, size_t len, bool bScanRsp){
+	uint32_t now = cBaseTask::GetTickCount();
+	const sBtScanDevice *pDev;
+	m_lock.Lock();
+	eBtScanReport report = m_table.Feed(param->scan_rst.bda, param->scan_rst.ble_addr_type, param->scan_rst.rssi,
+			data, len, bScanRsp, now, &pDev);
+	sBtScanDevice dev;
+	if(pDev)
+		dev = *pDev;
+	m_lock.Unlock();
+	if(report != eBtScanReport::e_none && m_pCallbacks)
+		m_pCallbacks->OnDevice(dev, report, data, len, bScanRsp);
+}
+
+void cBtScanner::expire(uint32_t now){
+	sBtScanDevice lost;
+	while(true){
+		m_lock.Lock();
+		bool bLost = m_table.Expire(now, lost);
+		m_lock.Unlock();
+		if(!bLost)
+			break;
+		if(m_pCallbacks)
+			m_pCallbacks->OnLost(lost);
+	}
+}
+
+void cBtScanner::expireTimerHandler(TimerHandle_t timer) {
+	cBtScanner *pScanner = (cBtScanner*)pvTimerGetTimerID(timer);
+	pScanner->expire(cBaseTask::GetTickCount());
+}
+
+void cBtScanner::handleGAPEvent(
+		esp_gap_ble_cb_event_t  event,
+		esp_ble_gap_cb_param_t* param) {
+	switch(event) {
+	case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
+		if(!m_bStartPending)
+			break;
+		m_bStartPending = false;
+		if(param->scan_param_cmpl.status != ESP_BT_STATUS_SUCCESS){
+			ESP_LOGE(LOG_TAG, "Scan parameters are not set: %d", param->scan_param_cmpl.status);
+			break;
+		}
+		esp_err_t errRc = ::esp_ble_gap_start_scanning(m_duration);
+		if(errRc != ESP_OK)
+			ESP_LOGE(LOG_TAG, "esp_ble_gap_start_scanning: rc=%d", errRc);
+		break;
+	}
+	case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT: {
+		m_bScanning = param->scan_start_cmpl.status == ESP_BT_STATUS_SUCCESS;
+		if(!m_bScanning)
+			ESP_LOGE(LOG_TAG, "Scan is not started: %d", param->scan_start_cmpl.status);
+		else if(m_expireTimer)
+			xTimerStart(m_expireTimer, 0);
+		break;
+	}
+	// the devices are not heard, they are kept until the next scan
+	case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT: {
+		m_bScanning = false;
+		if(m_expireTimer)
+			xTimerStop(m_expireTimer, 0);
+		break;
+	}
+	// ESP_GAP_BLE_SCAN_RESULT_EVT
+	// scan_rst:
+	// - esp_gap_search_evt_t search_evt
+	// - esp_bd_addr_t bda
+	// - esp_ble_addr_type_t ble_addr_type
+	// - esp_ble_evt_type_t ble_evt_type
+	// - int rssi
+	// - uint8_t ble_adv[] - the advertisement data, then the scan response data
+	// - uint8_t adv_data_len
+	// - uint8_t scan_rsp_len
+	case ESP_GAP_BLE_SCAN_RESULT_EVT: {
+		if(param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT){
+			if(param->scan_rst.adv_data_len)
+				feed(param, param->scan_rst.ble_adv, param->scan_rst.adv_data_len, false);
+			if(param->scan_rst.scan_rsp_len)
+				feed(param, param->scan_rst.ble_adv + param->scan_rst.adv_data_len, param->scan_rst.scan_rsp_len, true);
+		}else if(param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_CMPL_EVT){
+			m_bScanning = false;
+			if(m_expireTimer)
+				xTimerStop(m_expireTimer, 0);
+			expire(cBaseTask::GetTickCount());
+			if(m_pCallbacks)
+				m_pCallbacks->OnScanEnd();
+		}
+		break;
+	}
+	default:
+		break;
+	}
+} // handleGAPEvent
@@ -0,0 +1,74 @@
+/*
+ * cBtScanner.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  BT scanner for the nearby tags and companion devices, reports only the new and changed devices
+ */
+
+#ifndef COMPONENTS_M_BT_CBTSCANNER_H_
+#define COMPONENTS_M_BT_CBTSCANNER_H_
+#include "sdkconfig.h"
+#include <esp_gap_ble_api.h>
+#include <freertos/timers.h>
+#include <vector>
+#include "../../main/common/cBaseTask.h"
+#include "cBtDevice.h"
+#include "cBtScanTable.h"
+
+// Called from the BT task, OnLost() from the timer task during the scan
+class cBtScanCallbacks{
+public:
+	virtual ~cBtScanCallbacks(){}
+	// new device, changed advertisement (or scan response) or RSSI; the data is valid during the call only,
+	// parse it by cBtAdvIter
+	virtual void OnDevice(const sBtScanDevice &dev, eBtScanReport reason, const uint8_t *data, size_t len, bool bScanRsp){}
+	// not seen for cBtScanTable::TimeoutMs, checked every second while scanning and at the scan end
+	virtual void OnLost(const sBtScanDevice &dev){}
+	// the scan duration is over
+	virtual void OnScanEnd(){}
+};
+
+class cBtScanner {
+	friend class cBtDevice;
+
+	cBtDevice *pDevice;
+	cBtScanCallbacks *m_pCallbacks;
+	cBtScanTable m_table;
+	cMutex m_lock; // m_table
+	bool m_bStartPending; // waits for the scan parameters
+	bool m_bScanning;
+	uint32_t m_duration;
+	TimerHandle_t m_expireTimer; // runs while scanning, the devices are lost without any scan result as well
+
+public:
+	bool Active; // request the scan responses, default false (passive scan, the devices do not see us)
+	// duty cycle: the radio listens WindowMs of every IntervalMs, default 20 of 100
+	uint16_t IntervalMs;
+	uint16_t WindowMs;
+
+	cBtScanner();
+	~cBtScanner();
+	void Init(cBtDevice *pDev);
+	void Deinit();
+	void setCallbacks(cBtScanCallbacks *pCallbacks){m_pCallbacks = pCallbacks;}
+	// reporting settings, change them before Start()
+	cBtScanTable& getTable(){return m_table;}
+
+	// scan for durationSec, 0 - until Stop(); the seen devices are kept
+	bool Start(uint32_t durationSec = 0);
+	void Stop();
+	bool IsScanning()const{return m_bScanning || m_bStartPending;}
+	// forget the seen devices, they are reported as new again
+	void Clear();
+	// copy of the seen devices
+	void getDevices(std::vector<sBtScanDevice> &devices);
+
+private:
+	void handleGAPEvent(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+	// process the data of the scan result, called without the lock
+	void feed(esp_ble_gap_cb_param_t *param, const uint8_t *data, size_t len, bool bScanRsp);
+	void expire(uint32_t now);
+	static void expireTimerHandler(TimerHandle_t timer);
+};
+
+#endif /* COMPONENTS_M_BT_CBTSCANNER_H_ */
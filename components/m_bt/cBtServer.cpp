@@ -7,28 +7,38 @@
 
 #include "cBtServer.h"
 #include "../../main/smart_alert_defs.h"
+#include "../../main/common/fnv1a.h"
 #include <esp_log.h>
+#include <string.h>
 #include <esp_bt.h>
 #include <esp_bt_main.h>
 #include <esp_gap_ble_api.h>
 #include <esp_gatts_api.h>
+#include <esp_system.h>
+#if defined(__has_include)
+#if __has_include(<esp_idf_version.h>)
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 1, 0)
+#define BT_SERVICE_CHANGE_API // esp_ble_gatts_send_service_change_indication() is not in the older IDF
+#endif
+#endif
+#endif
 //#include <gatt_api.h>
 
 static const char* LOG_TAG = "cBtServer";
+static const BLEUUID s_cccdUuid = "00002902-0000-1000-8000-00805f9b34fb"_uuid;
 
 
 cBtService* cBtServer::ServiceFind(const BLEUUID &uuid){
-	for(auto &svc : services){
-		if(svc->uuid == uuid)
-			return svc;
-	}
-	return nullptr;
+	auto it = m_svcIndex.find(uuid);
+	return it != m_svcIndex.end() ? it->second : nullptr;
 }
 
 void cBtServer::ServiceAddExisting(cBtService *pSvc){
 	if(ServiceFind(pSvc->uuid))
 		return;
 	services.push_back(pSvc);
+	m_svcIndex[pSvc->uuid] = pSvc;
 }
 
 cBtService* cBtServer::ServiceCreate(const BLEUUID &uuid){
@@ -41,20 +51,29 @@ cBtService* cBtServer::ServiceCreate(const BLEUUID &uuid){
 	psvc->uuid = uuid;
 	psvc->pServ = this;
 	services.push_back(psvc);
+	m_svcIndex[uuid] = psvc;
 
 	ESP_LOGD(LOG_TAG, "<< createService");
 	return psvc;
 }
 
-cBtServer::cBtServer():pDevice(nullptr),
+#define POLICY_PERIOD_MS		500 // period of the connection policy checks
+
+cBtServer::cBtServer():pDevice(nullptr), m_policyTimer(nullptr), m_beaconOffset(-1), m_bAdvSuspended(false), m_pBonds(nullptr), m_dbHash(0),
 		m_semaphoreRegisterAppEvt("cBtServer::RegisterAppEvt"),
 		m_semaphoreCreateEvt("cBtServer::CreateEvt"){
 	m_appId            = -1;
 	m_gatts_if         = -1;
-	m_connectedCount   = 0;
 	m_connId           = -1;
+	MaxConnections     = 1;
+	BatchCreate        = true;
+	TxQueueLen         = 8;
+	PersistBonds       = true;
+	BondSaveDelayMs    = 2000;
+	RequestSecurity    = false;
 	last_client_active_t = 0;
 	server_create_t = cBaseTask::GetTickCount();
+	resetStats();
 }
 
 cBtServer::~cBtServer() {
@@ -70,6 +89,16 @@ void cBtServer::createApp(uint16_t appId) {
 void cBtServer::Init(cBtDevice *pDev){
 	pDevice = pDev;
 	pDev->pServer = this;
+	resetStats();
+	if(PersistBonds && !m_pBonds)
+		m_pBonds = new cBtBondStore;
+	// the advertising starts fast, it is started by ESP_GATTS_REG_EVT
+	kickAdvertising();
+	if(!m_policyTimer){
+		m_policyTimer = xTimerCreate("BT policy", POLICY_PERIOD_MS / portTICK_PERIOD_MS, pdTRUE, this, policyTimerHandler);
+		if(m_policyTimer)
+			xTimerStart(m_policyTimer, 0);
+	}
 	createApp(0);
 }
 
@@ -81,11 +110,27 @@ void cBtServer::Start(){
 }
 
 void cBtServer::Deinit(){
+	bondFlush(true); // the handles are known while the services exist
 	// delete all services
 	for(auto &svc : services){
 		delete svc;
 	}
 	services.clear();
+	m_svcIndex.clear();
+	m_attrs.clear();
+	if(m_policyTimer){
+		xTimerStop(m_policyTimer, portMAX_DELAY);
+		xTimerDelete(m_policyTimer, portMAX_DELAY);
+		m_policyTimer = nullptr;
+	}
+	m_connLock.Lock();
+	m_conns.clear();
+	m_connLock.Unlock();
+	m_bondLock.Lock();
+	delete m_pBonds;
+	m_pBonds = nullptr;
+	m_bondLock.Unlock();
+	m_dbHash = 0;
 	// HW disable
 	if(pDevice) pDevice->pServer = nullptr;
 	if(m_gatts_if == (uint16_t)-1) return;
@@ -107,7 +152,8 @@ uint16_t cBtServer::getConnId() {
 
 // return The number of connected clients.
 uint32_t cBtServer::getConnectedCount() {
-	return m_connectedCount;
+	cAutoLock lock(m_connLock);
+	return m_conns.size();
 }
 
 
@@ -116,6 +162,454 @@ int cBtServer::getGattsIf() {
 }
 
 
+uint16_t cBtServer::getMtu(uint16_t connId) {
+	cAutoLock lock(m_connLock);
+	auto it = m_conns.find(connId);
+	return it != m_conns.end() ? it->second.mtu : ESP_GATT_DEF_BLE_MTU_SIZE;
+}
+
+
+sBtConnection* cBtServer::getConnection(uint16_t connId) {
+	auto it = m_conns.find(connId);
+	return it != m_conns.end() ? &it->second : nullptr;
+}
+
+
+void cBtServer::clearConnection(sBtConnection &conn) {
+	conn.congested = false;
+	conn.cccd.clear();
+	conn.readHandle = -1;
+	conn.readVersion = 0;
+	conn.prepHandle = -1;
+	conn.prepare.clear();
+	conn.tx.Clear();
+	conn.tx.MaxItems = TxQueueLen;
+}
+
+
+bool cBtServer::resetConnection(uint16_t connId) {
+	cAutoLock lock(m_connLock);
+	sBtConnection *pConn = getConnection(connId);
+	if(!pConn)
+		return false;
+	clearConnection(*pConn);
+	bondChanged(*pConn); // the client subscribes again
+	return true;
+}
+
+
+sBtConnection* cBtServer::findConnection(const esp_bd_addr_t bda) {
+	for(auto &it : m_conns){
+		if(memcmp(it.second.bda, bda, sizeof(esp_bd_addr_t)) == 0)
+			return &it.second;
+	}
+	return nullptr;
+}
+
+
+// The stored CCCD handles are valid while the attribute table is the same
+uint32_t cBtServer::attrTableHash() {
+	if(m_dbHash)
+		return m_dbHash;
+	uint32_t h = FNV1A_INIT;
+	for(size_t handle = 0; handle < m_attrs.size(); handle++){
+		sBtAttrEntry &attr = m_attrs[handle];
+		if(!attr.pChar)
+			continue;
+		uint32_t v[3] = {(uint32_t)handle, attr.pDesc ? attr.pDesc->uuid.hash() : attr.pChar->uuid.hash(), attr.pDesc ? 1u : 0u};
+		uint8_t bytes[sizeof v];
+		for(size_t i = 0; i < sizeof bytes; i++) // little endian, independent of the CPU
+			bytes[i] = v[i / 4] >> (8 * (i % 4));
+		h = fnv1a(bytes, sizeof bytes, h);
+	}
+	m_dbHash = h ? h : 1;
+	return m_dbHash;
+}
+
+
+void cBtServer::bondRestore(sBtConnection &conn) {
+	sBtBond bond;
+	m_bondLock.Lock();
+	bool bLoaded = m_pBonds && m_pBonds->Load(conn.bda, bond);
+	m_bondLock.Unlock();
+	if(!bLoaded)
+		return;
+	if(bond.dbHash == attrTableHash()){
+		// the values written after the connection are newer
+		for(auto &it : bond.cccd)
+			conn.cccd.insert(it);
+		ESP_LOGD(LOG_TAG, "Bond restored: %d CCCDs, last MTU %d", bond.cccd.size(), bond.mtu);
+		return;
+	}
+	// the client has to discover the attributes again
+	ESP_LOGD(LOG_TAG, "Attribute table is changed, service changed indication");
+#ifdef BT_SERVICE_CHANGE_API
+	esp_err_t errRc = ::esp_ble_gatts_send_service_change_indication(m_gatts_if, conn.bda);
+	if(errRc != ESP_OK)
+		ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_service_change_indication: rc=%d", errRc);
+#endif
+}
+
+
+void cBtServer::bondChanged(sBtConnection &conn) {
+	if(!m_pBonds || !conn.bonded)
+		return;
+	conn.bondDirty = true;
+	conn.bondChangeTime = cBaseTask::GetTickCount();
+}
+
+
+void cBtServer::bondRecord(const sBtConnection &conn, sBtBond &bond) {
+	memcpy(bond.bda, conn.bda, sizeof(esp_bd_addr_t));
+	bond.dbHash = attrTableHash();
+	bond.mtu = conn.mtu;
+	bond.params = conn.params;
+	bond.cccd = conn.cccd;
+}
+
+
+// a subscription to several characteristics is one write, the BT events do not wait for the flash
+void cBtServer::bondFlush(bool bAll) {
+	std::vector<sBtBond> bonds;
+	uint32_t now = cBaseTask::GetTickCount();
+	m_connLock.Lock();
+	for(auto &it : m_conns){
+		sBtConnection &conn = it.second;
+		if(conn.bondDirty && (bAll || now - conn.bondChangeTime >= BondSaveDelayMs)){
+			bonds.emplace_back();
+			bondRecord(conn, bonds.back());
+			conn.bondDirty = false;
+		}
+	}
+	m_connLock.Unlock();
+	for(auto &bond : bonds)
+		bondSave(bond);
+}
+
+
+void cBtServer::bondSave(const sBtBond &bond) {
+	cAutoLock lock(m_bondLock);
+	if(m_pBonds && !m_pBonds->Save(bond))
+		ESP_LOGE(LOG_TAG, "Bond is not saved");
+}
+
+
+void cBtServer::eraseBonds() {
+	cAutoLock lock(m_connLock);
+	m_bondLock.Lock();
+	if(m_pBonds)
+		m_pBonds->EraseAll();
+	m_bondLock.Unlock();
+	int count = ::esp_ble_get_bond_device_num();
+	if(count > 0){
+		std::vector<esp_ble_bond_dev_t> devs(count);
+		if(::esp_ble_get_bond_device_list(&count, devs.data()) == ESP_OK){
+			for(int i = 0; i < count; i++)
+				::esp_ble_remove_bond_device(devs[i].bd_addr);
+		}
+	}
+	for(auto &it : m_conns){
+		it.second.bonded = false;
+		it.second.bondDirty = false;
+	}
+}
+
+
+void cBtServer::getSubscribers(uint16_t cccdHandle, uint16_t mask, std::vector<sBtPeer> &peers) {
+	cAutoLock lock(m_connLock);
+	peers.clear();
+	for(auto &it : m_conns){
+		sBtConnection &conn = it.second;
+		if(cccdHandle != (uint16_t)-1){
+			auto cit = conn.cccd.find(cccdHandle);
+			if(cit == conn.cccd.end() || !(cit->second & mask))
+				continue;
+		}
+		peers.push_back(sBtPeer{conn.conn_id, conn.mtu, conn.congested});
+	}
+}
+
+
+bool cBtServer::queueValue(uint16_t connId, uint16_t handle, bool bIndicate, const uint8_t *data, size_t len) {
+	cAutoLock lock(m_connLock);
+	sBtConnection *pConn = getConnection(connId);
+	if(!pConn)
+		return false;
+	uint32_t dropped = pConn->tx.Dropped();
+	bool bQueued = pConn->tx.Push(handle, bIndicate, data, len);
+	m_stats.txDropped += pConn->tx.Dropped() - dropped;
+	if(!bQueued)
+		ESP_LOGE(LOG_TAG, "Queue of the connection %d is full, handle %d dropped", connId, handle);
+	txPump(*pConn);
+	return bQueued;
+}
+
+
+void cBtServer::txPump(sBtConnection &conn) {
+	const sBtTxItem *pItem;
+	while((pItem = conn.tx.Next(conn.congested)) != nullptr){
+		size_t length = pItem->data.size();
+		if(length > (size_t)(conn.mtu - 3)){
+			ESP_LOGD(LOG_TAG, "- Truncating to %d bytes", conn.mtu - 3);
+			length = conn.mtu - 3;
+		}
+		esp_err_t errRc = ::esp_ble_gatts_send_indicate(m_gatts_if, conn.conn_id, pItem->handle,
+				length, (uint8_t*)pItem->data.data(), pItem->bIndicate);
+		if(errRc != ESP_OK){
+			ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_indicate: rc=%d", errRc);
+			m_stats.txDropped++;
+		}else{
+			if(pItem->bIndicate)
+				m_stats.indications++;
+			else
+				m_stats.notifications++;
+			m_stats.txBytes += length;
+		}
+		conn.tx.Sent(errRc == ESP_OK, cBaseTask::GetTickCount());
+	}
+}
+
+
+void cBtServer::countEvent(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+	cAutoLock lock(m_connLock);
+	switch(event) {
+	case ESP_GATTS_READ_EVT:
+		m_stats.reads++;
+		break;
+	case ESP_GATTS_WRITE_EVT:
+		m_stats.writes++;
+		break;
+	case ESP_GATTS_EXEC_WRITE_EVT:
+		m_stats.execWrites++;
+		break;
+	case ESP_GATTS_CONGEST_EVT:
+		if(param->congest.congested)
+			m_stats.congestions++;
+		break;
+	case ESP_GATTS_CONNECT_EVT:
+		m_stats.connects++;
+		break;
+	case ESP_GATTS_DISCONNECT_EVT:
+		m_stats.disconnects++;
+		break;
+	default:
+		break;
+	}
+}
+
+
+void cBtServer::getStats(sBtStats &stats) {
+	m_connLock.Lock();
+	stats = m_stats;
+	m_connLock.Unlock();
+	stats.time = cBaseTask::GetTickCount() - m_statsStart;
+	stats.freeHeap = esp_get_free_heap_size();
+	stats.minFreeHeap = esp_get_minimum_free_heap_size();
+}
+
+
+void cBtServer::resetStats() {
+	cAutoLock lock(m_connLock);
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_statsStart = cBaseTask::GetTickCount();
+}
+
+
+void cBtServer::logStats() {
+	sBtStats s;
+	getStats(s);
+	ESP_LOGI(LOG_TAG, "BT stats for %d ms: reads %d, writes %d (%d exec), %d attr ops/s", s.time, s.reads, s.writes,
+			s.execWrites, s.perSec(s.reads + s.writes));
+	ESP_LOGI(LOG_TAG, "notifications %d, indications %d (%d confirmed), %d bytes/s, dropped %d, congested %d times",
+			s.notifications, s.indications, s.confirmations, s.perSec(s.txBytes), s.txDropped, s.congestions);
+	ESP_LOGI(LOG_TAG, "connects %d, disconnects %d, free heap %d, min free heap %d", s.connects, s.disconnects,
+			s.freeHeap, s.minFreeHeap);
+}
+
+
+// advertise while there is room for more clients, then only the beacon if enabled
+void cBtServer::updateAdvertising() {
+	cAutoLock lock(m_policyLock); // the policy timer restarts the advertising as well
+	if(m_bAdvSuspended){
+		m_bleAdvertising.stop();
+	}else if((int)getConnectedCount() < MaxConnections){ // m_connLock after m_policyLock
+		m_bleAdvertising.setConnectable(true);
+		startAdvertising();
+	}else if(m_beaconOffset >= 0 && m_beacon.HasKey()){
+		m_bleAdvertising.stop();
+		m_bleAdvertising.setConnectable(false);
+		m_bleAdvertising.start();
+	}else{
+		m_bleAdvertising.stop();
+	}
+}
+
+
+void cBtServer::suspendAdvertising() {
+	m_policyLock.Lock();
+	m_bAdvSuspended = true;
+	m_policyLock.Unlock();
+	updateAdvertising();
+}
+
+
+void cBtServer::resumeAdvertising() {
+	m_policyLock.Lock();
+	m_bAdvSuspended = false;
+	m_policy.KickAdvertising(cBaseTask::GetTickCount());
+	m_policyLock.Unlock();
+	applyPolicy(); // the fast interval is set before the start
+	updateAdvertising();
+}
+
+
+bool cBtServer::enableBeacon(const BLEAdvertisementData &advData, const uint8_t *key, size_t keyLen) {
+	cAutoLock lock(m_policyLock);
+	uint8_t payload[BT_BEACON_LEN] = {0};
+	if(!m_beacon.Open())
+		ESP_LOGE(LOG_TAG, "No NVS for the beacon, the sequence restarts at reboot");
+	if(key)
+		m_beacon.SetKey(key, keyLen);
+	m_beaconBase = advData;
+	m_beaconAdv = advData;
+	m_beaconOffset = m_beaconAdv.addField(ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, payload, BT_BEACON_LEN);
+	if(m_beaconOffset < 0){
+		ESP_LOGE(LOG_TAG, "No room for the beacon in the advertisement data");
+		return false;
+	}
+	setBeaconData();
+	return true;
+}
+
+
+void cBtServer::setBeaconKey(const uint8_t *key, size_t keyLen) {
+	{
+		cAutoLock lock(m_policyLock);
+		if(!m_beacon.Open())
+			ESP_LOGE(LOG_TAG, "No NVS for the beacon, the key is lost at reboot");
+		m_beacon.SetKey(key, keyLen);
+		if(m_beaconOffset < 0)
+			return;
+		setBeaconData();
+	}
+	// with all clients connected only the beacon is advertised
+	if((int)getConnectedCount() >= MaxConnections)
+		updateAdvertising();
+}
+
+
+// the advertisement data with a new payload, without the beacon if there is no key; m_policyLock is taken
+void cBtServer::setBeaconData() {
+	uint8_t payload[BT_BEACON_LEN];
+	if(!m_beacon.HasKey()){
+		m_bleAdvertising.setAdvertisementData(m_beaconBase);
+		return;
+	}
+	if(m_beacon.Poll(cBaseTask::GetTickCount(), payload))
+		m_beaconAdv.patch(m_beaconOffset, payload, BT_BEACON_LEN);
+	m_bleAdvertising.setAdvertisementData(m_beaconAdv);
+}
+
+
+void cBtServer::setBeaconState(uint8_t flags, uint8_t battery) {
+	cAutoLock lock(m_policyLock);
+	m_beacon.SetState(flags, battery);
+	updateBeacon(cBaseTask::GetTickCount());
+}
+
+
+// the new payload is patched in place, the advertising goes on with the new data, m_policyLock is taken
+void cBtServer::updateBeacon(uint32_t now) {
+	uint8_t payload[BT_BEACON_LEN];
+	if(m_beaconOffset < 0 || !m_beacon.Poll(now, payload))
+		return;
+	m_beaconAdv.patch(m_beaconOffset, payload, BT_BEACON_LEN);
+	m_bleAdvertising.setAdvertisementData(m_beaconAdv);
+}
+
+
+void cBtServer::setLinkActivity(uint32_t mask, bool bActive) {
+	m_policyLock.Lock();
+	m_policy.SetActive(mask, bActive, cBaseTask::GetTickCount());
+	m_policyLock.Unlock();
+	applyPolicy(); // the short interval is requested without the timer delay
+}
+
+
+void cBtServer::kickAdvertising() {
+	m_policyLock.Lock();
+	m_policy.KickAdvertising(cBaseTask::GetTickCount());
+	m_policyLock.Unlock();
+	applyPolicy();
+}
+
+
+void cBtServer::policyTimerHandler(TimerHandle_t timer) {
+	cBtServer *pServ = (cBtServer*)pvTimerGetTimerID(timer);
+	pServ->applyPolicy();
+	pServ->bondFlush(false);
+
+	// the lost confirmations must not stop the indications
+	uint32_t now = cBaseTask::GetTickCount();
+	cAutoLock lock(pServ->m_connLock);
+	for(auto &it : pServ->m_conns){
+		if(it.second.tx.Tick(now)){
+			pServ->m_stats.txDropped++;
+			ESP_LOGE(LOG_TAG, "No confirmation of the indication, connection %d", it.first);
+			pServ->txPump(it.second);
+		}
+	}
+}
+
+
+// request the connection parameters and change the advertising interval when the policy decides so
+void cBtServer::applyPolicy() {
+	cAutoLock lock(m_policyLock);
+	uint32_t now = cBaseTask::GetTickCount();
+
+	// the status changes collected during cBtBeacon::MinPeriodMs and the periodic refresh
+	updateBeacon(now);
+
+	uint16_t advMin, advMax;
+	if(m_policy.AdvInterval(now, advMin, advMax)){
+		ESP_LOGD(LOG_TAG, "Advertising interval: %d..%d", advMin, advMax);
+		m_bleAdvertising.setInterval(advMin, advMax);
+		if(m_bleAdvertising.isStarted()){
+			// restart with the new interval
+			m_bleAdvertising.stop();
+			m_bleAdvertising.start();
+		}
+	}
+
+	sBtConnParams params;
+	if(!m_policy.Poll(now, params))
+		return;
+	std::vector<esp_ble_conn_update_params_t> updates;
+	m_connLock.Lock();
+	for(auto &it : m_conns){
+		esp_ble_conn_update_params_t upd;
+		memcpy(upd.bda, it.second.bda, sizeof(esp_bd_addr_t));
+		upd.min_int = params.min_int;
+		upd.max_int = params.max_int;
+		upd.latency = params.latency;
+		upd.timeout = params.timeout;
+		updates.push_back(upd);
+	}
+	m_connLock.Unlock();
+	bool bOk = !updates.empty();
+	for(auto &upd : updates){
+		ESP_LOGD(LOG_TAG, "Connection parameters request: %d..%d, latency %d", upd.min_int, upd.max_int, upd.latency);
+		esp_err_t errRc = ::esp_ble_gap_update_conn_params(&upd);
+		if(errRc != ESP_OK){
+			ESP_LOGE(LOG_TAG, "esp_ble_gap_update_conn_params: rc=%d", errRc);
+			bOk = false;
+		}
+	}
+	if(!bOk)
+		m_policy.OnUpdate(false, now);
+}
+
+
 // Handle a receiver GAP event.
 void cBtServer::handleGAPEvent(
 		esp_gap_ble_cb_event_t  event,
@@ -125,6 +619,41 @@ void cBtServer::handleGAPEvent(
 	case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT: {
 		break;
 	}
+	// the pairing or the encryption with the bonded client is completed
+	case ESP_GAP_BLE_AUTH_CMPL_EVT: {
+		ESP_LOGD(LOG_TAG, "Authentication: success %d, reason %d", param->ble_security.auth_cmpl.success,
+				param->ble_security.auth_cmpl.fail_reason);
+		if(!param->ble_security.auth_cmpl.success)
+			break;
+		cAutoLock lock(m_connLock);
+		sBtConnection *pConn = findConnection(param->ble_security.auth_cmpl.bd_addr);
+		if(pConn && m_pBonds && !pConn->bonded){
+			pConn->bonded = true;
+			bondRestore(*pConn);
+			bondChanged(*pConn);
+		}
+		break;
+	}
+	// the answer to the connection parameters request (or the central has changed them)
+	case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT: {
+		ESP_LOGD(LOG_TAG, "Connection parameters: status %d, interval %d, latency %d, timeout %d",
+				param->update_conn_params.status, param->update_conn_params.conn_int,
+				param->update_conn_params.latency, param->update_conn_params.timeout);
+		if(param->update_conn_params.status == ESP_BT_STATUS_SUCCESS){
+			cAutoLock lock(m_connLock);
+			sBtConnection *pConn = findConnection(param->update_conn_params.bda);
+			if(pConn){
+				pConn->params.min_int = param->update_conn_params.conn_int;
+				pConn->params.max_int = param->update_conn_params.conn_int;
+				pConn->params.latency = param->update_conn_params.latency;
+				pConn->params.timeout = param->update_conn_params.timeout;
+				bondChanged(*pConn);
+			}
+		}
+		cAutoLock lock(m_policyLock);
+		m_policy.OnUpdate(param->update_conn_params.status == ESP_BT_STATUS_SUCCESS, cBaseTask::GetTickCount());
+		break;
+	}
 	default:
 		break;
 	}
@@ -138,11 +667,76 @@ void cBtServer::handleGATTServerEvent(
 		esp_ble_gatts_cb_param_t* param) {
 
 	ESP_LOGD(LOG_TAG, ">> handleGATTServerEvent: %d", event);
+	countEvent(event, param);
 
+	// connection state has to be known by the characteristics before they get the events
+	switch(event) {
+	// ESP_GATTS_MTU_EVT
+	// mtu:
+	// - uint16_t conn_id
+	// - uint16_t mtu
+	case ESP_GATTS_MTU_EVT: {
+		ESP_LOGD(LOG_TAG, "MTU of the connection %d: %d", param->mtu.conn_id, param->mtu.mtu);
+		cAutoLock lock(m_connLock);
+		sBtConnection *pConn = getConnection(param->mtu.conn_id);
+		if(pConn){
+			pConn->mtu = param->mtu.mtu;
+			bondChanged(*pConn);
+		}
+		break;
+	}
+	case ESP_GATTS_CONNECT_EVT: {
+		cAutoLock lock(m_connLock);
+		sBtConnection &conn = m_conns[param->connect.conn_id];
+		conn.conn_id = param->connect.conn_id;
+		memcpy(conn.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+		conn.mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+		clearConnection(conn);
+		conn.bonded = false;
+		conn.bondDirty = false;
+		memset(&conn.params, 0, sizeof(conn.params));
+		break;
+	}
+	// ESP_GATTS_CONF_EVT
+	// conf:
+	// - esp_gatt_status_t status
+	// - uint16_t conn_id
+	// - uint16_t handle
+	case ESP_GATTS_CONF_EVT: {
+		cAutoLock lock(m_connLock);
+		sBtConnection *pConn = getConnection(param->conf.conn_id);
+		if(param->conf.status != ESP_GATT_OK)
+			m_stats.txDropped++; // not sent by the stack, e.g. congested
+		if(pConn && pConn->tx.OnConfirm(param->conf.handle)){
+			if(param->conf.status == ESP_GATT_OK)
+				m_stats.confirmations++;
+			txPump(*pConn);
+		}
+		break;
+	}
+	// ESP_GATTS_CONGEST_EVT
+	// congest:
+	// - uint16_t conn_id
+	// - bool congested
+	case ESP_GATTS_CONGEST_EVT: {
+		cAutoLock lock(m_connLock);
+		sBtConnection *pConn = getConnection(param->congest.conn_id);
+		if(pConn){
+			pConn->congested = param->congest.congested;
+			if(!pConn->congested)
+				txPump(*pConn);
+		}
+		break;
+	}
+	default:
+		break;
+	}
 
-	// Invoke the handler for every Service we have.
-	for(auto &svc : services){
-		svc->handleGATTServerEvent(event, gatts_if, param);
+	// attribute access goes directly to the attribute, other events are passed to every Service we have
+	if(!dispatchAttrEvent(event, gatts_if, param)){
+		for(auto &svc : services){
+			svc->handleGATTServerEvent(event, gatts_if, param);
+		}
 	}
 
 	switch(event) {
@@ -156,10 +750,18 @@ void cBtServer::handleGATTServerEvent(
 	case ESP_GATTS_CONNECT_EVT: {
 		m_connId = param->connect.conn_id; // Save the connection id.
 
-		m_connectedCount++;
 		last_client_active_t = cBaseTask::GetTickCount();
-		// stop advertising after the first connected client
-		m_bleAdvertising.stop();
+		m_policyLock.Lock();
+		m_policy.OnConnect(last_client_active_t);
+		m_policyLock.Unlock();
+		if(RequestSecurity){
+			// a bonded client is encrypted by the stored keys, a new one is paired
+			esp_err_t errRc = ::esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM);
+			if(errRc != ESP_OK)
+				ESP_LOGE(LOG_TAG, "esp_ble_set_encryption: rc=%d", errRc);
+		}
+		// advertising is stopped by the connection, continue it if more clients are allowed
+		updateAdvertising();
 		TS_PRINT("BT client is connected");
 		break;
 	} // ESP_GATTS_CONNECT_EVT
@@ -172,7 +774,7 @@ void cBtServer::handleGATTServerEvent(
 	case ESP_GATTS_REG_EVT: {
 		m_gatts_if = gatts_if;
 		m_semaphoreRegisterAppEvt.Unlock();
-		startAdvertising();
+		updateAdvertising();
 		break;
 	} // ESP_GATTS_REG_EVT
 
@@ -235,8 +837,21 @@ void cBtServer::handleGATTServerEvent(
 	// If we receive a disconnect event then invoke the callback for disconnects (if one is present).
 	// we also want to start advertising again.
 	case ESP_GATTS_DISCONNECT_EVT: {
-		m_connectedCount--;
-		startAdvertising();
+		m_connLock.Lock();
+		sBtConnection *pConn = getConnection(param->disconnect.conn_id);
+		sBtBond bond;
+		bool bSave = pConn && pConn->bondDirty;
+		if(bSave)
+			bondRecord(*pConn, bond);
+		m_conns.erase(param->disconnect.conn_id);
+		bool bLast = m_conns.empty();
+		m_connLock.Unlock();
+		if(bSave)
+			bondSave(bond); // the changes of the last BondSaveDelayMs
+		m_policyLock.Lock();
+		m_policy.OnDisconnect(cBaseTask::GetTickCount(), bLast);
+		m_policyLock.Unlock();
+		updateAdvertising();
 		TS_PRINT("BT client is disconnected");
 		break;
 	} // ESP_GATTS_DISCONNECT_EVT
@@ -261,6 +876,142 @@ void cBtServer::handleGATTServerEvent(
 } // handleGATTServerEvent
 
 
+// remember the attribute handle, called when the attribute is created
+void cBtServer::registerAttr(uint16_t handle, cBtCharacteristic *pChar, cBtCharDescriptor *pDesc) {
+	if(handle == (uint16_t)-1)
+		return;
+	if(handle >= m_attrs.size()){
+		m_attrs.resize(handle + 1, sBtAttrEntry{nullptr, nullptr});
+	}
+	m_attrs[handle].pChar = pChar;
+	m_attrs[handle].pDesc = pDesc;
+	m_dbHash = 0;
+}
+
+
+sBtAttrEntry* cBtServer::findAttr(uint16_t handle) {
+	if(handle >= m_attrs.size() || !m_attrs[handle].pChar)
+		return nullptr;
+	return &m_attrs[handle];
+}
+
+
+// Pass the attribute access event to its attribute, returns false if the event is not an attribute access.
+bool cBtServer::dispatchAttrEvent(
+		esp_gatts_cb_event_t      event,
+		esp_gatt_if_t             gatts_if,
+		esp_ble_gatts_cb_param_t* param) {
+	switch(event) {
+	case ESP_GATTS_READ_EVT:
+	case ESP_GATTS_WRITE_EVT: {
+		bool bRead = event == ESP_GATTS_READ_EVT;
+		uint16_t handle = bRead ? param->read.handle : param->write.handle;
+		sBtAttrEntry *pAttr = findAttr(handle);
+		if(!pAttr){
+			ESP_LOGE(LOG_TAG, "Access to unknown attribute, handle: 0x%.2x", handle);
+			if(bRead ? param->read.need_rsp : param->write.need_rsp){
+				esp_err_t errRc = ::esp_ble_gatts_send_response(gatts_if,
+						bRead ? param->read.conn_id : param->write.conn_id,
+						bRead ? param->read.trans_id : param->write.trans_id, ESP_GATT_INVALID_HANDLE, nullptr);
+				if (errRc != ESP_OK) {
+					ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
+				}
+			}
+			return true;
+		}
+		if(pAttr->pDesc){
+			// CCCD values are kept for every client
+			if(pAttr->pDesc->uuid == s_cccdUuid && handleCccdEvent(event, gatts_if, param))
+				return true;
+			pAttr->pDesc->handleGATTServerEvent(event, gatts_if, param);
+			return true;
+		}
+		pAttr->pChar->handleAttrEvent(event, gatts_if, param);
+		return true;
+	}
+
+	// exec_write has no handle, the prepared writes of the client are executed, one response for all of them
+	case ESP_GATTS_EXEC_WRITE_EVT: {
+		// the value is taken under the lock, the callbacks of execWrite() may queue notifications
+		sBtAttrEntry *pAttr = nullptr;
+		std::vector<uint8_t> value;
+		m_connLock.Lock();
+		sBtConnection *pConn = getConnection(param->exec_write.conn_id);
+		if(pConn){
+			pAttr = findAttr(pConn->prepHandle);
+			if(pAttr && !pAttr->pDesc && param->exec_write.exec_write_flag == ESP_GATT_PREP_WRITE_EXEC)
+				value.assign(pConn->prepare.getData(), pConn->prepare.getData() + pConn->prepare.getLength());
+			else
+				pAttr = nullptr;
+			pConn->prepHandle = -1;
+			pConn->prepare.clear();
+		}
+		m_connLock.Unlock();
+		if(pAttr)
+			pAttr->pChar->execWrite(value.data(), value.size());
+		esp_err_t errRc = ::esp_ble_gatts_send_response(
+				gatts_if, param->exec_write.conn_id, param->exec_write.trans_id, ESP_GATT_OK, nullptr);
+		if (errRc != ESP_OK) {
+			ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
+		}
+		return true;
+	}
+
+	case ESP_GATTS_CONF_EVT: {
+		sBtAttrEntry *pAttr = findAttr(param->conf.handle);
+		if(pAttr && !pAttr->pDesc){
+			pAttr->pChar->handleAttrEvent(event, gatts_if, param);
+		}
+		return true;
+	}
+
+	default:
+		return false;
+	}
+} // dispatchAttrEvent
+
+
+// Keep the CCCD value of the client, returns true if the event is processed completely.
+bool cBtServer::handleCccdEvent(
+		esp_gatts_cb_event_t      event,
+		esp_gatt_if_t             gatts_if,
+		esp_ble_gatts_cb_param_t* param) {
+	if(event == ESP_GATTS_WRITE_EVT){
+		cAutoLock lock(m_connLock);
+		sBtConnection *pConn = getConnection(param->write.conn_id);
+		if(pConn && !param->write.is_prep && param->write.len == 2){
+			pConn->cccd[param->write.handle] = param->write.value[0] | (param->write.value[1] << 8);
+			bondChanged(*pConn);
+		}
+		return false; // the descriptor stores the last written value and responds
+	}
+	if(!param->read.need_rsp)
+		return true;
+	uint16_t val = 0;
+	m_connLock.Lock();
+	sBtConnection *pConn = getConnection(param->read.conn_id);
+	if(pConn){
+		auto it = pConn->cccd.find(param->read.handle);
+		if(it != pConn->cccd.end())
+			val = it->second;
+	}
+	m_connLock.Unlock();
+	esp_gatt_rsp_t rsp;
+	rsp.attr_value.len      = 2;
+	rsp.attr_value.handle   = param->read.handle;
+	rsp.attr_value.offset   = 0;
+	rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+	rsp.attr_value.value[0] = val & 0xff;
+	rsp.attr_value.value[1] = val >> 8;
+	esp_err_t errRc = ::esp_ble_gatts_send_response(
+			gatts_if, param->read.conn_id, param->read.trans_id, ESP_GATT_OK, &rsp);
+	if (errRc != ESP_OK) {
+		ESP_LOGE(LOG_TAG, "esp_ble_gatts_send_response: rc=%d", errRc);
+	}
+	return true;
+} // handleCccdEvent
+
+
 /**
  * @brief Register the app.
  *
@@ -301,15 +1052,13 @@ cBtService::~cBtService(){
 		delete c;
 	}
 	chars.clear();
+	m_charIndex.clear();
 }
 
 
 cBtCharacteristic* cBtService::CharFind(const BLEUUID &uuid){
-	for(auto &c : chars){
-		if(c->uuid  == uuid)
-			return c;
-	}
-	return nullptr;
+	auto it = m_charIndex.find(uuid);
+	return it != m_charIndex.end() ? it->second : nullptr;
 }
 
 cBtCharacteristic* cBtService::CharCreate(const BLEUUID &uuid){
@@ -318,30 +1067,34 @@ cBtCharacteristic* cBtService::CharCreate(const BLEUUID &uuid){
 	pc = new cBtCharacteristic;
 	pc->uuid = uuid;
 	chars.push_back(pc);
+	m_charIndex[uuid] = pc;
 	return pc;
 }
 
 void cBtService::Start(){
 
-	executeCreate();   // Perform the API calls to actually create the service.
-
-	// We ask the BLE runtime to start the service and then create each of the characteristics.
-	// We start the service through its local handle which was returned in the ESP_GATTS_CREATE_EVT event
-	// obtained as a result of calling esp_ble_gatts_create_service().
-	//
-	ESP_LOGD(LOG_TAG, ">> cBtService::start(): Starting service (esp_ble_gatts_start_service): %s", uuid.toString().c_str());
-	if (m_handle == (uint16_t)-1) {
-		ESP_LOGE(LOG_TAG, "<< !!! We attempted to start a service but don't know its handle!");
-		return;
-	}
+	// The attribute table creates everything with one round trip, the attribute per call way is the fallback.
+	if(!pServ->BatchCreate || !executeCreateTable()){
+		executeCreate();   // Perform the API calls to actually create the service.
+
+		// We ask the BLE runtime to start the service and then create each of the characteristics.
+		// We start the service through its local handle which was returned in the ESP_GATTS_CREATE_EVT event
+		// obtained as a result of calling esp_ble_gatts_create_service().
+		//
+		if (m_handle == (uint16_t)-1) {
+			ESP_LOGE(LOG_TAG, "<< !!! We attempted to start a service but don't know its handle!");
+			return;
+		}
 
-	// Start each of the characteristics ... these are found in the m_characteristicMap.
+		// Start each of the characteristics ... these are found in the m_characteristicMap.
 
-	for(auto &pc: chars){
-		m_semaphoreAddCharEvt.Lock();
-		m_lastCreatedCharacteristic = pc;
-		pc->executeCreate(this);
+		for(auto &pc: chars){
+			m_semaphoreAddCharEvt.Lock();
+			m_lastCreatedCharacteristic = pc;
+			pc->executeCreate(this);
+		}
 	}
+	ESP_LOGD(LOG_TAG, ">> cBtService::start(): Starting service (esp_ble_gatts_start_service): %s", uuid.toString().c_str());
 
 	m_semaphoreStartEvt.Lock();
 	esp_err_t errRc = ::esp_ble_gatts_start_service(m_handle);
@@ -365,8 +1118,10 @@ void cBtService::executeCreate(){
 	srvc_id.id.uuid    = *uuid.getNative();
 
 	m_semaphoreCreateEvt.Lock(); // Take the mutex and release at event ESP_GATTS_CREATE_EVT
-	// calculate handles count to allocate
-	int handle_count_required = 4 + chars.size() * 2;
+	// calculate handles count to allocate: the declaration, the characteristics with their descriptors
+	int handle_count_required = 1;
+	for(auto pChar : chars)
+		handle_count_required += 2 + pChar->descriptors.size();
 	// start service registration
 	esp_err_t errRc = esp_ble_gatts_create_service(pServ->getGattsIf(), &srvc_id, handle_count_required);
 
@@ -381,6 +1136,82 @@ void cBtService::executeCreate(){
 	ESP_LOGD(LOG_TAG, "<< executeCreate");
 }
 
+// static UUIDs of the declarations, the table keeps the pointers
+static uint16_t s_primaryServiceUuid = ESP_GATT_UUID_PRI_SERVICE;
+static uint16_t s_charDeclareUuid    = ESP_GATT_UUID_CHAR_DECLARE;
+
+void cBtService::addTableEntry(uint8_t *uuid, uint16_t uuidLen, uint16_t perm, uint16_t maxLen, uint16_t len, uint8_t *value,
+		cBtCharacteristic *pChar, cBtCharDescriptor *pDesc){
+	esp_gatts_attr_db_t attr;
+	attr.attr_control.auto_rsp = ESP_GATT_RSP_BY_APP;
+	attr.att_desc.uuid_length  = uuidLen;
+	attr.att_desc.uuid_p       = uuid;
+	attr.att_desc.perm         = perm;
+	attr.att_desc.max_length   = maxLen;
+	attr.att_desc.length       = len;
+	attr.att_desc.value        = value;
+	m_attrTab.push_back(attr);
+	m_tabAttrs.push_back(sBtAttrEntry{pChar, pDesc});
+}
+
+// The table order: service declaration, then for every characteristic its declaration, value and descriptors.
+// ESP_GATTS_CREAT_ATTR_TAB_EVT returns the handles in the same order.
+bool cBtService::executeCreateTable(){
+	ESP_LOGD(LOG_TAG, ">> executeCreateTable() - service uuid: %s", uuid.toString().c_str());
+
+	// the service declaration value is 16 or 128 bit UUID only
+	m_declUuid = uuid.bitSize() == 32 ? uuid.to128() : uuid;
+	esp_bt_uuid_t *pSvcUuid = m_declUuid.getNative();
+
+	m_attrTab.clear();
+	m_tabAttrs.clear();
+	addTableEntry((uint8_t*)&s_primaryServiceUuid, ESP_UUID_LEN_16, ESP_GATT_PERM_READ,
+			pSvcUuid->len, pSvcUuid->len, (uint8_t*)&pSvcUuid->uuid, nullptr, nullptr);
+	for(auto &pc : chars){
+		if(pc->m_handle != (uint16_t)-1){
+			ESP_LOGE(LOG_TAG, "Characteristic already has a handle.");
+			m_attrTab.clear();
+			m_tabAttrs.clear();
+			return false;
+		}
+		pc->m_pService = this;
+		esp_bt_uuid_t *pCharUuid = pc->uuid.getNative();
+		addTableEntry((uint8_t*)&s_charDeclareUuid, ESP_UUID_LEN_16, ESP_GATT_PERM_READ,
+				sizeof(pc->m_properties), sizeof(pc->m_properties), (uint8_t*)&pc->m_properties, nullptr, nullptr);
+		// the value is provided by the application on every read
+		addTableEntry((uint8_t*)&pCharUuid->uuid, pCharUuid->len, pc->getPermissions(),
+				0, 0, nullptr, pc, nullptr);
+		for(auto &d : pc->descriptors){
+			d->m_pCharacteristic = pc;
+			esp_bt_uuid_t *pDescUuid = d->uuid.getNative();
+			addTableEntry((uint8_t*)&pDescUuid->uuid, pDescUuid->len, d->getPermissions(),
+					d->m_value.attr_max_len, d->m_value.attr_len, d->m_value.attr_value, pc, d);
+		}
+	}
+	// the number of attributes is 8 bit in the API
+	if(m_attrTab.size() > 0xff){
+		ESP_LOGE(LOG_TAG, "Too many attributes for one table: %d", m_attrTab.size());
+		m_attrTab.clear();
+		m_tabAttrs.clear();
+		return false;
+	}
+
+	m_semaphoreCreateEvt.Lock(); // released at ESP_GATTS_CREAT_ATTR_TAB_EVT
+	esp_err_t errRc = ::esp_ble_gatts_create_attr_tab(m_attrTab.data(), pServ->getGattsIf(), m_attrTab.size(), 0);
+	if (errRc != ESP_OK) {
+		ESP_LOGE(LOG_TAG, "esp_ble_gatts_create_attr_tab: rc=%d", errRc);
+		m_semaphoreCreateEvt.Unlock();
+		m_attrTab.clear();
+		m_tabAttrs.clear();
+		return false;
+	}
+	m_semaphoreCreateEvt.Wait();
+	m_semaphoreCreateEvt.Unlock();
+
+	ESP_LOGD(LOG_TAG, "<< executeCreateTable");
+	return m_handle != (uint16_t)-1;
+}
+
 void cBtService::handleGATTServerEvent(
 		esp_gatts_cb_event_t      event,
 		esp_gatt_if_t             gatts_if,
@@ -448,6 +1279,39 @@ void cBtService::handleGATTServerEvent(
 		break;
 	} // ESP_GATTS_CREATE_EVT
 
+	// ESP_GATTS_CREAT_ATTR_TAB_EVT
+	// The attribute table is created, the handles are valid only in this event.
+	//
+	// add_attr_tab:
+	// * esp_gatt_status_t status
+	// * esp_bt_uuid_t svc_uuid
+	// * uint8_t svc_inst_id
+	// * uint16_t num_handle
+	// * uint16_t *handles
+	//
+	case ESP_GATTS_CREAT_ATTR_TAB_EVT: {
+		if (!m_attrTab.empty() && m_declUuid == param->add_attr_tab.svc_uuid) {
+			if (param->add_attr_tab.status == ESP_GATT_OK && param->add_attr_tab.num_handle == m_attrTab.size()) {
+				m_handle = param->add_attr_tab.handles[0];
+				for (size_t i = 1; i < m_tabAttrs.size(); i++) {
+					sBtAttrEntry &attr = m_tabAttrs[i];
+					if (attr.pDesc) {
+						attr.pDesc->setHandle(param->add_attr_tab.handles[i]);
+					} else if (attr.pChar) {
+						attr.pChar->setHandle(param->add_attr_tab.handles[i]);
+					}
+				}
+			} else {
+				ESP_LOGE(LOG_TAG, "Attribute table is not created, status: %d, handles: %d of %d",
+						param->add_attr_tab.status, param->add_attr_tab.num_handle, m_attrTab.size());
+			}
+			m_attrTab.clear();
+			m_tabAttrs.clear();
+			m_semaphoreCreateEvt.Unlock();
+		}
+		break;
+	} // ESP_GATTS_CREAT_ATTR_TAB_EVT
+
 	default: {
 		break;
 	} // Default
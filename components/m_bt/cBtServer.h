@@ -9,21 +9,88 @@
 #define COMPONENTS_M_BT_CBTSERVER_H_
 #include "sdkconfig.h"
 #include <esp_gatts_api.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
 #include "../../main/common/cBaseTask.h"
 #include "cBtDevice.h"
 #include "BLEUUID.h"
 #include "BLEAdvertising.h"
+#include "cBtCharValue.h"
+#include "cBtConnPolicy.h"
+#include "cBtTxQueue.h"
+#include "cBtBeacon.h"
+#include "cBtBondStore.h"
 #include "cBtCharacteristic.h"
 
 class cBtServer;
 class cBtService;
 class cBtAttribute;
 class cBtCharacteristic;
+class cBtCharDescriptor;
+
+// entry of the attribute handles table
+struct sBtAttrEntry{
+	cBtCharacteristic *pChar;
+	cBtCharDescriptor *pDesc; // nullptr for the characteristic value
+};
+
+// CCCD bits
+#define BT_CCCD_NOTIFY		(1 << 0)
+#define BT_CCCD_INDICATE	(1 << 1)
+
+// state of one client connection
+struct sBtConnection{
+	uint16_t conn_id;
+	esp_bd_addr_t bda;
+	uint16_t mtu; // negotiated ATT MTU
+	bool congested; // the stack does not accept more notifications
+	std::map<uint16_t, uint16_t> cccd; // CCCD values of this client by the descriptor handle
+	uint16_t readHandle; // characteristic being read in parts, -1 if none
+	uint32_t readVersion; // version of its value at the first part
+	uint16_t prepHandle; // characteristic of the prepared writes, -1 if none
+	cBtCharValue prepare; // prepared writes, the buffer is allocated by the first one
+	cBtTxQueue tx; // notifications and indications to send
+	bool bonded; // encrypted with the bonded client, its state is saved by cBtBondStore
+	bool bondDirty; // the bond state is changed, not saved yet
+	uint32_t bondChangeTime; // of the last change
+	sBtConnParams params; // the current ones, interval in min_int and max_int
+};
+
+// counters for the throughput measurements, see cBtServer::getStats()
+struct sBtStats{
+	uint32_t time; // ms since resetStats()
+	uint32_t reads; // attribute reads, every part of a long read
+	uint32_t writes; // attribute writes including the prepared ones
+	uint32_t execWrites;
+	uint32_t notifications;
+	uint32_t indications;
+	uint32_t confirmations;
+	uint32_t txBytes; // payload of the notifications and indications
+	uint32_t txDropped; // by the queue overflow, send errors and confirmation timeouts
+	uint32_t congestions;
+	uint32_t connects;
+	uint32_t disconnects;
+	uint32_t freeHeap; // at getStats()
+	uint32_t minFreeHeap; // since boot
+	// count per second of the measured time
+	uint32_t perSec(uint32_t count)const{return time < 1000 ? count : (uint32_t)((uint64_t)count * 1000 / time);}
+};
+
+// connection to send the notification to
+struct sBtPeer{
+	uint16_t conn_id;
+	uint16_t mtu;
+	bool congested;
+};
 
 // BT Application Server Service
 class cBtService{
 	friend class cBtServer;
+	friend class cBtBulkService;
 	friend class cBtAttribute;
 	friend class cBtCharacteristic;
 	friend class cBtCharDescriptor;
@@ -34,6 +101,7 @@ class cBtService{
 	cSemaphore m_semaphoreStartEvt;
 
 	std::list<cBtCharacteristic*> chars;
+	std::unordered_map<BLEUUID, cBtCharacteristic*, BLEUUIDHash> m_charIndex; // chars by UUID
 
 public:
 	BLEUUID uuid; // service unique ID
@@ -48,7 +116,15 @@ public:
 
 private:
 	cBtCharacteristic*   m_lastCreatedCharacteristic;
+	// attribute table of the batched creation, the stack reads the pointed data until ESP_GATTS_CREAT_ATTR_TAB_EVT
+	std::vector<esp_gatts_attr_db_t> m_attrTab;
+	std::vector<sBtAttrEntry> m_tabAttrs; // owner of every table entry, pChar is nullptr for the declarations
+	BLEUUID m_declUuid; // service UUID in the service declaration, 16 or 128 bit
 	void executeCreate();
+	// create the service, its characteristics and descriptors by one call, returns false if not created
+	bool executeCreateTable();
+	void addTableEntry(uint8_t *uuid, uint16_t uuidLen, uint16_t perm, uint16_t maxLen, uint16_t len, uint8_t *value,
+			cBtCharacteristic *pChar, cBtCharDescriptor *pDesc);
 	void handleGATTServerEvent(
 			esp_gatts_cb_event_t      event,
 			esp_gatt_if_t             gatts_if,
@@ -60,18 +136,47 @@ class cBtServer {
 	friend class cBtDevice;
 	friend class cBtService;
 	friend class cBtCharacteristic;
+	friend class cBtCharDescriptor;
 
 	esp_ble_adv_data_t  m_adv_data;
 	uint16_t            m_appId;
 
-	uint16_t			m_connId;
-	uint32_t            m_connectedCount;
+	uint16_t			m_connId; // the last connected client
+	std::map<uint16_t, sBtConnection> m_conns; // connected clients by conn_id
+	cMutex              m_connLock; // m_conns are changed by BT events and read by notify()
 	int          		m_gatts_if;
 	cBtDevice *pDevice;
 	std::list<cBtService*> services; // pointers to all our services
+	std::unordered_map<BLEUUID, cBtService*, BLEUUIDHash> m_svcIndex; // services by UUID
+	std::vector<sBtAttrEntry> m_attrs; // attributes by handle, filled when they are created
 	BLEAdvertising      m_bleAdvertising; // BT advertiser
+	cBtConnPolicy       m_policy; // connection and advertising intervals
+	cMutex              m_policyLock;
+	TimerHandle_t       m_policyTimer; // the policy decisions are applied from the timer
+	cBtBeacon           m_beacon; // protected by m_policyLock
+	BLEAdvertisementData m_beaconAdv;
+	BLEAdvertisementData m_beaconBase; // m_beaconAdv without the beacon, advertised while there is no key
+	int                 m_beaconOffset; // of the beacon payload in m_beaconAdv, -1 if the beacon is disabled
+	bool                m_bAdvSuspended; // by suspendAdvertising(), protected by m_policyLock
+	cBtBondStore        *m_pBonds; // created by Init(), NVS is not ready earlier
+	cMutex              m_bondLock; // m_pBonds, NVS is written without m_connLock
+	uint32_t            m_dbHash; // of the attribute table, 0 if not calculated yet
+	sBtStats            m_stats; // protected by m_connLock
+	uint32_t            m_statsStart;
 
 public:
+	int MaxConnections; // advertising goes on until this number of clients is connected, default 1
+	// create every service with one attribute table (esp_ble_gatts_create_attr_tab) instead of
+	// a call per attribute, default true
+	bool BatchCreate;
+	size_t TxQueueLen; // queued notifications and indications per client, default 8
+	// keep the CCCDs, MTU and connection parameters of the bonded clients in NVS, so the reconnecting clients
+	// get their notifications without the discovery and subscription, default true; set before Init()
+	bool PersistBonds;
+	// the bond changes (subscriptions, MTU) are collected for this time and saved by one NVS write from
+	// the policy timer, the pending ones at the disconnection; default 2000
+	uint32_t BondSaveDelayMs;
+	bool RequestSecurity; // request the encryption (bonding) when a client connects, default false
 	uint32_t last_client_active_t; // timestamp of the any client's activity
 	uint32_t server_create_t; // timestamp of the server instantiation
 
@@ -89,7 +194,44 @@ public:
 	uint32_t        getConnectedCount();
 	BLEAdvertising* getAdvertising();
 	void            startAdvertising();
+	// stop advertising, also the beacon, until resumeAdvertising(); the services stay registered
+	void            suspendAdvertising();
+	void            resumeAdvertising();
+	bool            isAdvertisingSuspended()const{return m_bAdvSuspended;}
+	// forget the read offsets, prepared writes, subscriptions and queued values of the connection,
+	// the client stays connected; returns false if there is no such connection
+	bool            resetConnection(uint16_t connId);
 	int        getGattsIf();
+	// ATT MTU of the connection, 23 until the client negotiates a bigger one
+	uint16_t        getMtu(uint16_t connId);
+	// connections which enabled the notifications (BT_CCCD_NOTIFY) or indications (BT_CCCD_INDICATE) by the CCCD,
+	// all connections if there is no CCCD (cccdHandle is -1)
+	void            getSubscribers(uint16_t cccdHandle, uint16_t mask, std::vector<sBtPeer> &peers);
+	// queue the notification or indication, it is sent when the client is ready (indications one by one
+	// after ESP_GATTS_CONF_EVT), does not block; returns false if the value is dropped
+	bool            queueValue(uint16_t connId, uint16_t handle, bool bIndicate, const uint8_t *data, size_t len);
+	// intervals of the policy may be changed before Init()
+	cBtConnPolicy&  getConnPolicy(){return m_policy;}
+	// activity (BT_LINK_xxx) which needs the short connection interval
+	void            setLinkActivity(uint32_t mask, bool bActive);
+	// fast advertising for a while, e.g. after a button press
+	void            kickAdvertising();
+	// broadcast the status in the manufacturer data added to advData, which becomes the advertisement data;
+	// with MaxConnections clients connected the advertising goes on as non-connectable. The key and the sequence
+	// are kept in NVS, a nullptr key keeps the saved one; without a key advData goes without the beacon.
+	bool            enableBeacon(const BLEAdvertisementData &advData, const uint8_t *key = nullptr, size_t keyLen = 0);
+	// dedicated secret shared with the phone, must not be readable by any characteristic; empty stops the beacon
+	void            setBeaconKey(const uint8_t *key, size_t keyLen);
+	// BT_BEACON_xxx flags and battery %, broadcast at the rate of getBeacon() settings
+	void            setBeaconState(uint8_t flags, uint8_t battery);
+	cBtBeacon&      getBeacon(){return m_beacon;}
+	// forget all bonded clients
+	void            eraseBonds();
+	// counters since resetStats() or Init()
+	void            getStats(sBtStats &stats);
+	void            resetStats();
+	// print the counters and the rates per second
+	void            logStats();
 private:
 
 	void            createApp(uint16_t appId);
@@ -97,6 +239,33 @@ private:
 	void            handleGAPEvent(esp_gap_ble_cb_event_t event,	esp_ble_gap_cb_param_t *param);
 	void            handleGATTServerEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
 	void            registerApp();
+	void            registerAttr(uint16_t handle, cBtCharacteristic *pChar, cBtCharDescriptor *pDesc);
+	sBtAttrEntry*   findAttr(uint16_t handle);
+	bool            dispatchAttrEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+	bool            handleCccdEvent(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+	// context of the connection, m_connLock is taken; the pointer is valid until it is released
+	sBtConnection*  getConnection(uint16_t connId);
+	sBtConnection*  findConnection(const esp_bd_addr_t bda);
+	// initial state of the connection context, m_connLock is taken
+	void            clearConnection(sBtConnection &conn);
+	uint32_t        attrTableHash();
+	// the bond state is restored after the encryption, m_connLock is taken
+	void            bondRestore(sBtConnection &conn);
+	// the bond state is changed, it is saved later by bondFlush() or at the disconnection; m_connLock is taken
+	void            bondChanged(sBtConnection &conn);
+	void            bondRecord(const sBtConnection &conn, sBtBond &bond);
+	// save the bonds changed BondSaveDelayMs ago, all changed ones if bAll; NVS is written without m_connLock
+	void            bondFlush(bool bAll);
+	void            bondSave(const sBtBond &bond);
+	// takes m_policyLock, then m_connLock for the number of clients; called without both
+	void            updateAdvertising();
+	// send what the queue of the connection allows, m_connLock is taken
+	void            txPump(sBtConnection &conn);
+	void            countEvent(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param);
+	void            applyPolicy();
+	void            updateBeacon(uint32_t now);
+	void            setBeaconData();
+	static void     policyTimerHandler(TimerHandle_t timer);
 
 	cSemaphore m_semaphoreRegisterAppEvt;
 	cSemaphore m_semaphoreCreateEvt;
@@ -0,0 +1,102 @@
+/*
+ * cBtTxQueue.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cBtTxQueue.h"
+
+cBtTxQueue::cBtTxQueue():MaxItems(8), Overflow(eBtTxOverflow::e_drop_oldest), ConfTimeoutMs(30000),
+		m_next(m_items.end()), m_bWaiting(false), m_waitHandle(0), m_sentTime(0), m_dropped(0), m_coalesced(0) {
+}
+
+bool cBtTxQueue::Push(uint16_t handle, bool bIndicate, const uint8_t *data, size_t len){
+	for(auto &item : m_items){
+		if(item.handle == handle && item.bIndicate == bIndicate){
+			// the queued value is stale
+			item.data.assign(data, data + len);
+			m_coalesced++;
+			return true;
+		}
+	}
+	if(MaxItems == 0 || m_items.size() >= MaxItems){
+		if(Overflow == eBtTxOverflow::e_drop_new || MaxItems == 0){
+			m_dropped++;
+			return false;
+		}
+		dropOne();
+	}
+	m_items.push_back(sBtTxItem{handle, bIndicate, std::vector<uint8_t>(data, data + len)});
+	return true;
+}
+
+void cBtTxQueue::dropOne(){
+	auto victim = m_items.begin();
+	for(auto it = m_items.begin(); it != m_items.end(); ++it){
+		if(!it->bIndicate){
+			victim = it;
+			break;
+		}
+	}
+	if(victim == m_next)
+		m_next = m_items.end();
+	m_items.erase(victim);
+	m_dropped++;
+}
+
+const sBtTxItem* cBtTxQueue::Next(bool bCongested){
+	m_next = m_items.end();
+	if(bCongested)
+		return nullptr;
+	for(auto it = m_items.begin(); it != m_items.end(); ++it){
+		// the notifications may pass the waiting indication
+		if(!it->bIndicate || !m_bWaiting){
+			m_next = it;
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+void cBtTxQueue::Sent(bool bOk, uint32_t now){
+	if(m_next == m_items.end())
+		return;
+	if(!bOk)
+		m_dropped++;
+	else if(m_next->bIndicate){
+		m_bWaiting = true;
+		m_waitHandle = m_next->handle;
+		m_sentTime = now;
+	}else
+		m_notifyConfs[m_next->handle]++;
+	m_items.erase(m_next);
+	m_next = m_items.end();
+}
+
+bool cBtTxQueue::OnConfirm(uint16_t handle){
+	auto it = m_notifyConfs.find(handle);
+	if(it != m_notifyConfs.end()){
+		if(--it->second == 0)
+			m_notifyConfs.erase(it);
+		return false;
+	}
+	if(!m_bWaiting || handle != m_waitHandle)
+		return false;
+	m_bWaiting = false;
+	return true;
+}
+
+bool cBtTxQueue::Tick(uint32_t now){
+	if(!m_bWaiting || now - m_sentTime < ConfTimeoutMs)
+		return false;
+	m_bWaiting = false;
+	m_dropped++;
+	return true;
+}
+
+void cBtTxQueue::Clear(){
+	m_items.clear();
+	m_next = m_items.end();
+	m_bWaiting = false;
+	m_notifyConfs.clear();
+}
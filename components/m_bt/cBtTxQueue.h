@@ -0,0 +1,73 @@
+/*
+ * cBtTxQueue.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Outbound queue of the notifications and indications of one connection
+ */
+
+#ifndef COMPONENTS_M_BT_CBTTXQUEUE_H_
+#define COMPONENTS_M_BT_CBTTXQUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <vector>
+
+// what to drop when the queue is full
+enum class eBtTxOverflow{
+	e_drop_oldest, // the oldest notification, the oldest indication if there are no notifications
+	e_drop_new // the value being queued
+};
+
+struct sBtTxItem{
+	uint16_t handle;
+	bool bIndicate;
+	std::vector<uint8_t> data;
+};
+
+// Keeps the values to send, no BT calls here.
+// A new value of the characteristic replaces its queued one which is not sent yet.
+// Only one indication waits for the confirmation, the notifications may go meanwhile.
+class cBtTxQueue {
+public:
+	size_t MaxItems; // default 8
+	eBtTxOverflow Overflow; // default e_drop_oldest
+	uint32_t ConfTimeoutMs; // the indication without the confirmation is dropped, default 30000 (ATT timeout)
+
+	cBtTxQueue();
+	cBtTxQueue(const cBtTxQueue&) = delete;
+	cBtTxQueue& operator=(const cBtTxQueue&) = delete;
+
+	// returns false if the value is dropped
+	bool Push(uint16_t handle, bool bIndicate, const uint8_t *data, size_t len);
+	// the item to send now, nullptr if nothing may be sent
+	const sBtTxItem* Next(bool bCongested);
+	// result of sending the item returned by Next(), the failed one is dropped
+	void Sent(bool bOk, uint32_t now);
+	// ESP_GATTS_CONF_EVT of the handle, returns true if it confirms the waiting indication.
+	// The stack reports the sent notifications by this event too, they are counted out first.
+	bool OnConfirm(uint16_t handle);
+	// returns true if the waiting indication has timed out
+	bool Tick(uint32_t now);
+	void Clear();
+
+	size_t Size()const{return m_items.size();}
+	bool Waiting()const{return m_bWaiting;}
+	uint32_t Dropped()const{return m_dropped;}
+	uint32_t Coalesced()const{return m_coalesced;}
+
+private:
+	std::list<sBtTxItem> m_items;
+	std::list<sBtTxItem>::iterator m_next; // returned by Next(), m_items.end() if none
+	bool m_bWaiting; // an indication is sent and not confirmed
+	uint16_t m_waitHandle; // handle of the waiting indication
+	std::map<uint16_t, uint16_t> m_notifyConfs; // CONF events of the sent notifications not received yet, by handle
+	uint32_t m_sentTime;
+	uint32_t m_dropped;
+	uint32_t m_coalesced;
+
+	void dropOne();
+};
+
+#endif /* COMPONENTS_M_BT_CBTTXQUEUE_H_ */
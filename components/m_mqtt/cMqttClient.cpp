@@ -9,6 +9,7 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include "../../main/common/cBaseTask.h"
+#include "../m_wifi/cWiFiDevice.h"
 
 static const char *TAG = "cMqttClient";
 cMqttClient *cMqttClient::pInst = nullptr;
@@ -93,6 +94,7 @@ bool cMqttClient::Publish(const std::string &topic, const std::string &data, uin
 	ESP_LOGD(TAG, "MQTT Publish to topic: %s\r\nmessage: %s", topic.c_str(), data.c_str());
 	mqtt_publish(m_client, topic.c_str(), data.c_str(), data.length() + 1, qos, retain);
 	lastDataT = cBaseTask::GetTickCount();
+	cWiFiDevice::NotifyTraffic();
 	return true;
 }
 
@@ -187,5 +189,6 @@ void cMqttClient::data_cb(mqtt_client *self, mqtt_event_data_t *params){
 		return;
 	pInst->lastDataT = cBaseTask::GetTickCount();
 	pInst->iDisconnectCnt = 0;
+	cWiFiDevice::NotifyTraffic();
 	pInst->m_callbacks->OnData(pInst, params);
 }
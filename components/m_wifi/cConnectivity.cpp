@@ -0,0 +1,120 @@
+/*
+ * cConnectivity.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cConnectivity.h"
+
+#include <algorithm>
+
+#include <esp_log.h>
+
+static const char* TAG = "cConnectivity";
+
+cConnectivity cConnectivity::inst;
+
+cConnectivity::cConnectivity():m_group(nullptr), m_mux(nullptr) {
+}
+
+cConnectivity::~cConnectivity() {
+	if(m_group)
+		vEventGroupDelete(m_group);
+	if(m_mux)
+		vSemaphoreDelete(m_mux);
+}
+
+// the first call is made by the cWiFiDevice constructor, before any consumer
+void cConnectivity::init(){
+	if(m_group)
+		return;
+	m_mux = xSemaphoreCreateMutex();
+	m_group = xEventGroupCreate();
+	xEventGroupSetBits(m_group, core.Bits());
+}
+
+void cConnectivity::Post(eConnEvent ev, int rssi){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	eLinkQuality quality = core.Quality();
+	eConnState state = core.State();
+	bool bChanged = core.Process(ev, rssi);
+	bool bStateChanged = bChanged && core.State() != state;
+	bool bQualityChanged = bChanged && core.Quality() != quality;
+	uint32_t bits = core.Bits();
+	if(bStateChanged){
+		xEventGroupClearBits(m_group, CONN_BITS_ALL & ~bits);
+		xEventGroupSetBits(m_group, bits);
+		ESP_LOGD(TAG, "State %d -> %d", (int)state, (int)core.State());
+	}
+	eConnState newState = core.State();
+	quality = core.Quality();
+	rssi = core.Rssi();
+	std::vector<cConnectivityCallbacks*> subs;
+	if(bChanged)
+		subs = subscribers;
+	xSemaphoreGive(m_mux);
+
+	// notify without the lock, a subscriber may unsubscribe itself
+	for(auto pSub : subs){
+		if(bStateChanged)
+			pSub->OnStateChanged(state, newState);
+		if(bQualityChanged)
+			pSub->OnLinkQuality(quality, rssi);
+	}
+}
+
+uint32_t cConnectivity::WaitBits(uint32_t bits, uint32_t timeoutMs){
+	init();
+	return xEventGroupWaitBits(m_group, bits, pdFALSE, pdFALSE, timeoutMs / portTICK_PERIOD_MS) & CONN_BITS_ALL;
+}
+
+bool cConnectivity::WaitOnline(uint32_t timeoutMs){
+	return WaitBits(CONN_BIT_ONLINE | CONN_BIT_DOWN, timeoutMs) & CONN_BIT_ONLINE;
+}
+
+eConnState cConnectivity::State(){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	eConnState res = core.State();
+	xSemaphoreGive(m_mux);
+	return res;
+}
+
+eLinkQuality cConnectivity::Quality(){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	eLinkQuality res = core.Quality();
+	xSemaphoreGive(m_mux);
+	return res;
+}
+
+int cConnectivity::Rssi(){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	int res = core.Rssi();
+	xSemaphoreGive(m_mux);
+	return res;
+}
+
+uint32_t cConnectivity::Bits(){
+	init();
+	return xEventGroupGetBits(m_group) & CONN_BITS_ALL;
+}
+
+void cConnectivity::Subscribe(cConnectivityCallbacks *pCallbacks){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	if(std::find(subscribers.begin(), subscribers.end(), pCallbacks) == subscribers.end())
+		subscribers.push_back(pCallbacks);
+	xSemaphoreGive(m_mux);
+}
+
+void cConnectivity::Unsubscribe(cConnectivityCallbacks *pCallbacks){
+	init();
+	xSemaphoreTake(m_mux, portMAX_DELAY);
+	auto it = std::find(subscribers.begin(), subscribers.end(), pCallbacks);
+	if(it != subscribers.end())
+		subscribers.erase(it);
+	xSemaphoreGive(m_mux);
+}
@@ -0,0 +1,63 @@
+/*
+ * cConnectivity.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Connectivity service: state bits in an event group and subscribers notification
+ */
+
+#ifndef COMPONENTS_M_WIFI_CCONNECTIVITY_H_
+#define COMPONENTS_M_WIFI_CCONNECTIVITY_H_
+
+#include "cConnectivityCore.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+
+#include <vector>
+
+// connectivity events callbacks shell, called from the WiFi event task - don't block there
+class cConnectivityCallbacks{
+public:
+	virtual void OnStateChanged(eConnState from, eConnState to){}
+	virtual void OnLinkQuality(eLinkQuality quality, int rssi){}
+	virtual ~cConnectivityCallbacks(){}
+};
+
+// The only connectivity service instance, fed by cWiFiDevice.
+// Wait for the CONN_BIT_xxx bits instead of polling cWiFiDevice::CurrentState.
+class cConnectivity {
+	static cConnectivity inst;
+	cConnectivityCore core;
+	EventGroupHandle_t m_group;
+	SemaphoreHandle_t m_mux; // protects the core and the subscribers
+	std::vector<cConnectivityCallbacks*> subscribers;
+	cConnectivity();
+public:
+	~cConnectivity();
+	static cConnectivity& Get(){return inst;}
+
+	// feed the state machine, subscribers are called from here
+	void Post(eConnEvent ev, int rssi = 0);
+
+	// wait for any of the bits, returns the current state bits (check them, the wait could time out)
+	uint32_t WaitBits(uint32_t bits, uint32_t timeoutMs);
+	// wait for IP or for the end of the connection attempts, returns true if online
+	bool WaitOnline(uint32_t timeoutMs);
+
+	eConnState State();
+	eLinkQuality Quality();
+	int Rssi();
+	uint32_t Bits();
+	bool IsOnline(){return Bits() & CONN_BIT_ONLINE;}
+
+	void Subscribe(cConnectivityCallbacks *pCallbacks);
+	void Unsubscribe(cConnectivityCallbacks *pCallbacks);
+
+	// the state bits in the event group, only CONN_BITS_ALL are used
+	EventGroupHandle_t EventGroup(){init(); return m_group;}
+
+private:
+	void init();
+};
+
+#endif /* COMPONENTS_M_WIFI_CCONNECTIVITY_H_ */
@@ -0,0 +1,101 @@
+/*
+ * cConnectivityCore.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cConnectivityCore.h"
+
+cConnectivityCore::cConnectivityCore():QualityHysteresisDb(3),
+		m_state(eConnState::e_down), m_prev(eConnState::e_down), m_quality(eLinkQuality::e_none), m_rssi(0) {
+}
+
+uint32_t cConnectivityCore::StateBits(eConnState state){
+	switch(state){
+	case eConnState::e_connecting:
+		return CONN_BIT_CONNECTING;
+	case eConnState::e_link_up:
+		return CONN_BIT_LINK;
+	case eConnState::e_online:
+		return CONN_BIT_LINK | CONN_BIT_ONLINE;
+	case eConnState::e_failed:
+		return CONN_BIT_DOWN | CONN_BIT_FAILED;
+	default:
+		return CONN_BIT_DOWN;
+	}
+}
+
+eLinkQuality cConnectivityCore::RssiLevel(int rssi){
+	if(rssi >= -60)
+		return eLinkQuality::e_good;
+	if(rssi >= -70)
+		return eLinkQuality::e_fair;
+	if(rssi >= -80)
+		return eLinkQuality::e_poor;
+	return eLinkQuality::e_bad;
+}
+
+bool cConnectivityCore::update_quality(int rssi){
+	m_rssi = rssi;
+	eLinkQuality q = RssiLevel(rssi);
+	if(m_quality != eLinkQuality::e_none){
+		// move to the next level only when the RSSI is clearly beyond the border
+		if(q > m_quality){
+			eLinkQuality qh = RssiLevel(rssi - QualityHysteresisDb);
+			q = qh > m_quality ? qh : m_quality;
+		}else if(q < m_quality){
+			eLinkQuality qh = RssiLevel(rssi + QualityHysteresisDb);
+			q = qh < m_quality ? qh : m_quality;
+		}
+	}
+	if(q == m_quality)
+		return false;
+	m_quality = q;
+	return true;
+}
+
+bool cConnectivityCore::Process(eConnEvent ev, int rssi){
+	eConnState next = m_state;
+	switch(ev){
+	case eConnEvent::e_start:
+		next = eConnState::e_connecting;
+		break;
+	case eConnEvent::e_link_up:
+		if(m_state != eConnState::e_online)
+			next = eConnState::e_link_up;
+		break;
+	case eConnEvent::e_got_ip:
+		if(m_state != eConnState::e_down && m_state != eConnState::e_failed)
+			next = eConnState::e_online;
+		break;
+	case eConnEvent::e_lost_ip:
+		if(m_state == eConnState::e_online)
+			next = eConnState::e_link_up;
+		break;
+	case eConnEvent::e_link_lost:
+		if(m_state != eConnState::e_down && m_state != eConnState::e_failed)
+			next = eConnState::e_connecting;
+		break;
+	case eConnEvent::e_down:
+		if(m_state != eConnState::e_failed)
+			next = eConnState::e_down;
+		break;
+	case eConnEvent::e_fail:
+		next = eConnState::e_failed;
+		break;
+	case eConnEvent::e_rssi:
+		// the quality is known only for the live link
+		if(m_state == eConnState::e_link_up || m_state == eConnState::e_online)
+			return update_quality(rssi);
+		return false;
+	}
+	if(next == m_state)
+		return false;
+	m_prev = m_state;
+	m_state = next;
+	if(next != eConnState::e_link_up && next != eConnState::e_online){
+		m_quality = eLinkQuality::e_none;
+		m_rssi = 0;
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+/*
+ * cConnectivityCore.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Connectivity state machine: link, IP and link quality states
+ */
+
+#ifndef COMPONENTS_M_WIFI_CCONNECTIVITYCORE_H_
+#define COMPONENTS_M_WIFI_CCONNECTIVITYCORE_H_
+
+#include <stdint.h>
+
+// connectivity states
+enum class eConnState{
+	e_down, // not started, stopped or all reconnection attempts are over
+	e_connecting, // looking for the AP, includes reconnection after a link loss
+	e_link_up, // associated with the AP, no IP address
+	e_online, // IP address is assigned
+	e_failed // wrong configuration, no attempts will be made
+};
+
+// input events
+enum class eConnEvent{
+	e_start, // connection started
+	e_link_up, // associated
+	e_got_ip, // IP address is (re)acquired
+	e_lost_ip, // IP address is lost, the link is alive
+	e_link_lost, // link is lost, reconnecting
+	e_down, // link is lost, no more attempts or stopped
+	e_fail, // configuration error
+	e_rssi // new RSSI value of the link
+};
+
+enum class eLinkQuality{e_none, e_bad, e_poor, e_fair, e_good};
+
+// state bits, one or more bits are set for every state (see cConnectivityCore::Bits())
+#define CONN_BIT_CONNECTING		(1 << 0)
+#define CONN_BIT_LINK			(1 << 1) // e_link_up or e_online
+#define CONN_BIT_ONLINE			(1 << 2)
+#define CONN_BIT_DOWN			(1 << 3) // e_down or e_failed, nothing to wait for
+#define CONN_BIT_FAILED			(1 << 4)
+#define CONN_BITS_ALL			(CONN_BIT_CONNECTING | CONN_BIT_LINK | CONN_BIT_ONLINE | CONN_BIT_DOWN | CONN_BIT_FAILED)
+
+// The pure state machine without RTOS calls, it can be fed by a fake event source on host
+class cConnectivityCore {
+public:
+	int QualityHysteresisDb; // RSSI hysteresis of the quality levels, default 3
+
+	cConnectivityCore();
+
+	// process the event, returns true if the state or the link quality has changed
+	bool Process(eConnEvent ev, int rssi = 0);
+
+	eConnState State()const{return m_state;}
+	eConnState PrevState()const{return m_prev;}
+	eLinkQuality Quality()const{return m_quality;}
+	int Rssi()const{return m_rssi;}
+	uint32_t Bits()const{return StateBits(m_state);}
+
+	static uint32_t StateBits(eConnState state);
+	static eLinkQuality RssiLevel(int rssi);
+
+private:
+	eConnState m_state;
+	eConnState m_prev; // state before the last change
+	eLinkQuality m_quality;
+	int m_rssi;
+	bool update_quality(int rssi);
+};
+
+#endif /* COMPONENTS_M_WIFI_CCONNECTIVITYCORE_H_ */
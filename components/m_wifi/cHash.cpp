@@ -0,0 +1,147 @@
+/*
+ * cHash.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cHash.h"
+
+#include <string.h>
+#include <mbedtls/base64.h>
+
+cHash::cHash(eHashAlgo algo):m_algo(algo), m_started(false), m_finished(false), m_fill(0) {
+	memset(m_digest, 0, sizeof m_digest);
+}
+
+cHash::~cHash() {
+	Cancel();
+}
+
+size_t cHash::DigestLen()const{
+	return m_algo == eHashAlgo::e_sha256 ? 32 : 20;
+}
+
+void cHash::Start(eHashAlgo algo){
+	Cancel();
+	m_algo = algo;
+	if(m_algo == eHashAlgo::e_sha256){
+		mbedtls_sha256_init(&m_ctx.sha256);
+		mbedtls_sha256_starts(&m_ctx.sha256, 0);
+	}else{
+		mbedtls_sha1_init(&m_ctx.sha1);
+		mbedtls_sha1_starts(&m_ctx.sha1);
+	}
+	m_fill = 0;
+	m_started = true;
+	m_finished = false;
+}
+
+void cHash::engine_update(const uint8_t *data, size_t len){
+	if(m_algo == eHashAlgo::e_sha256)
+		mbedtls_sha256_update(&m_ctx.sha256, data, len);
+	else
+		mbedtls_sha1_update(&m_ctx.sha1, data, len);
+}
+
+void cHash::engine_free(){
+	if(m_algo == eHashAlgo::e_sha256)
+		mbedtls_sha256_free(&m_ctx.sha256);
+	else
+		mbedtls_sha1_free(&m_ctx.sha1);
+}
+
+void cHash::Update(const uint8_t *data, size_t len){
+	if(!m_started || !len)
+		return;
+	// top up the partially filled buffer first
+	if(m_fill){
+		size_t n = BLOCK_BUF_LEN - m_fill;
+		if(n > len)
+			n = len;
+		memcpy(m_block + m_fill, data, n);
+		m_fill += n;
+		data += n;
+		len -= n;
+		if(m_fill < BLOCK_BUF_LEN)
+			return;
+		engine_update(m_block, BLOCK_BUF_LEN);
+		m_fill = 0;
+	}
+	// large aligned input goes to the engine directly, without copying
+	if(len >= BLOCK_BUF_LEN && ((uintptr_t)data & 3) == 0){
+		size_t n = len - len % BLOCK_BUF_LEN;
+		engine_update(data, n);
+		data += n;
+		len -= n;
+	}
+	while(len >= BLOCK_BUF_LEN){
+		memcpy(m_block, data, BLOCK_BUF_LEN);
+		engine_update(m_block, BLOCK_BUF_LEN);
+		data += BLOCK_BUF_LEN;
+		len -= BLOCK_BUF_LEN;
+	}
+	if(len){
+		memcpy(m_block, data, len);
+		m_fill = len;
+	}
+}
+
+bool cHash::Finish(){
+	if(!m_started)
+		return false;
+	if(m_fill)
+		engine_update(m_block, m_fill);
+	m_fill = 0;
+	if(m_algo == eHashAlgo::e_sha256)
+		mbedtls_sha256_finish(&m_ctx.sha256, m_digest);
+	else
+		mbedtls_sha1_finish(&m_ctx.sha1, m_digest);
+	engine_free();
+	m_started = false;
+	m_finished = true;
+	return true;
+}
+
+void cHash::Cancel(){
+	if(m_started)
+		engine_free();
+	m_started = false;
+	m_fill = 0;
+}
+
+std::string cHash::Format(eHashFormat fmt)const{
+	if(!m_finished)
+		return "";
+	switch(fmt){
+	case eHashFormat::e_raw:
+		return std::string((const char*)m_digest, DigestLen());
+	case eHashFormat::e_hex:
+		return ToHex(m_digest, DigestLen());
+	case eHashFormat::e_base64:
+		return ToBase64(m_digest, DigestLen());
+	default:{ // e_base64_hex
+		std::string hex = ToHex(m_digest, DigestLen());
+		return ToBase64((const uint8_t*)hex.data(), hex.size());
+	}
+	}
+}
+
+std::string cHash::ToHex(const uint8_t *data, size_t len){
+	static const char digits[] = "0123456789abcdef";
+	std::string res(len * 2, '0');
+	for(size_t i = 0; i < len; i++){
+		res[i * 2] = digits[data[i] >> 4];
+		res[i * 2 + 1] = digits[data[i] & 0x0f];
+	}
+	return res;
+}
+
+std::string cHash::ToBase64(const uint8_t *data, size_t len){
+	// 4 characters of every started 3 bytes and the terminating zero written by mbedtls
+	std::string res(4 * ((len + 2) / 3) + 1, '\0');
+	size_t out_len(0);
+	if(mbedtls_base64_encode((unsigned char*)&res[0], res.size(), &out_len, data, len) != 0)
+		return "";
+	res.resize(out_len);
+	return res;
+}
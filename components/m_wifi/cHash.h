@@ -0,0 +1,76 @@
+/*
+ * cHash.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Streaming content hash (SHA-1 / SHA-256) helper for the HTTP(S) client
+ */
+
+#ifndef COMPONENTS_M_WIFI_CHASH_H_
+#define COMPONENTS_M_WIFI_CHASH_H_
+
+#define MBEDTLS_SHA1_ALT // only this configuration is working
+#include <mbedtls/sha1.h>
+#include <mbedtls/sha256.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// supported algorithms
+enum class eHashAlgo{e_sha1, e_sha256};
+
+// digest output formats, e_base64_hex is base64(hex(digest)) - the format used by our servers
+enum class eHashFormat{e_raw, e_hex, e_base64, e_base64_hex};
+
+// Incremental hash calculator.
+// Incoming data is collected into an aligned buffer and passed to mbedtls in whole blocks,
+// so the SHA engine is fed with large pieces instead of every small network read.
+// On the ESP32 mbedtls is built with CONFIG_MBEDTLS_HARDWARE_SHA and runs on the SHA accelerator,
+// any other mbedtls build (host) uses the portable software implementation.
+class cHash {
+public:
+	static const size_t MAX_DIGEST_LEN = 32;
+
+	cHash(eHashAlgo algo = eHashAlgo::e_sha1);
+	~cHash();
+
+	// (re)start calculation, the algorithm may be changed here
+	void Start(eHashAlgo algo);
+	void Start(){Start(m_algo);}
+	// add data to the hash
+	void Update(const uint8_t *data, size_t len);
+	// finalize the calculation, the digest is available after this call
+	bool Finish();
+	// drop the ongoing calculation
+	void Cancel();
+
+	bool IsStarted()const{return m_started;}
+	eHashAlgo Algo()const{return m_algo;}
+	size_t DigestLen()const;
+	const uint8_t* Digest()const{return m_digest;}
+	// get the last digest in the requested format
+	std::string Format(eHashFormat fmt)const;
+
+	// formatting helpers without iostreams
+	static std::string ToHex(const uint8_t *data, size_t len);
+	static std::string ToBase64(const uint8_t *data, size_t len);
+
+private:
+	static const size_t BLOCK_BUF_LEN = 1024; // must be multiple of the SHA block size (64 bytes)
+
+	eHashAlgo m_algo;
+	bool m_started;
+	bool m_finished;
+	union{
+		mbedtls_sha1_context sha1;
+		mbedtls_sha256_context sha256;
+	} m_ctx;
+	size_t m_fill; // bytes collected in the block buffer
+	uint8_t m_block[BLOCK_BUF_LEN] __attribute__((aligned(4)));
+	uint8_t m_digest[MAX_DIGEST_LEN];
+
+	void engine_update(const uint8_t *data, size_t len);
+	void engine_free();
+};
+
+#endif /* COMPONENTS_M_WIFI_CHASH_H_ */
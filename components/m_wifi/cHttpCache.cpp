@@ -0,0 +1,395 @@
+/*
+ * cHttpCache.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cHttpCache.h"
+#include "../m_flash/cFlash.h"
+#include "../../main/common/fnv1a.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <esp_log.h>
+
+static const char* TAG = "cHttpCache";
+
+#define CACHE_INDEX_KEY		"index"
+#define CACHE_INDEX_VER		1
+#define CACHE_MAX_TAG_LEN	200 // longer validators are not cached
+#define CACHE_CHUNKED_END	"0\r\n\r\n" // the last chunk without trailers
+
+// ============================== cHttpCacheFlashStore ==============================
+
+cHttpCacheFlashStore::cHttpCacheFlashStore(const std::string &storageName){
+	m_pFlash = new cFlash(storageName);
+}
+
+cHttpCacheFlashStore::~cHttpCacheFlashStore(){
+	delete m_pFlash;
+}
+
+std::string cHttpCacheFlashStore::chunk_key(const std::string &key, int n){
+	char buf[8];
+	snprintf(buf, sizeof buf, "_%d", n);
+	return key + buf;
+}
+
+// -1 if the value does not exist
+int cHttpCacheFlashStore::chunk_count(const std::string &key){
+	std::vector<uint8_t> hdr;
+	if(!m_pFlash->GetVal(key, hdr) || hdr.size() != 2)
+		return -1;
+	return hdr[0] | (hdr[1] << 8);
+}
+
+void cHttpCacheFlashStore::erase_chunks(const std::string &key, int from, int to){
+	for(int i = from; i < to; i++)
+		m_pFlash->Erase(chunk_key(key, i));
+}
+
+bool cHttpCacheFlashStore::Load(const std::string &key, std::vector<uint8_t> &data){
+	int chunks = chunk_count(key);
+	if(chunks < 0)
+		return false;
+	data.clear();
+	std::vector<uint8_t> chunk;
+	for(int i = 0; i < chunks; i++){
+		if(!m_pFlash->GetVal(chunk_key(key, i), chunk))
+			return false;
+		data.insert(data.end(), chunk.begin(), chunk.end());
+	}
+	return true;
+}
+
+bool cHttpCacheFlashStore::Save(const std::string &key, const std::vector<uint8_t> &data){
+	int chunks = (data.size() + CHUNK_LEN - 1) / CHUNK_LEN;
+	int old_chunks = chunk_count(key);
+	std::vector<uint8_t> chunk;
+	for(int i = 0; i < chunks; i++){
+		size_t start = i * CHUNK_LEN;
+		size_t len = data.size() - start < CHUNK_LEN ? data.size() - start : CHUNK_LEN;
+		chunk.assign(data.begin() + start, data.begin() + start + len);
+		if(!m_pFlash->SetVal(chunk_key(key, i), chunk)){
+			// the old value is partly overwritten, drop it with the chunks written so far
+			m_pFlash->Erase(key);
+			erase_chunks(key, 0, i > old_chunks ? i : old_chunks);
+			return false;
+		}
+	}
+	std::vector<uint8_t> hdr(2);
+	hdr[0] = chunks & 0xff;
+	hdr[1] = (chunks >> 8) & 0xff;
+	if(!m_pFlash->SetVal(key, hdr)){
+		m_pFlash->Erase(key);
+		erase_chunks(key, 0, chunks > old_chunks ? chunks : old_chunks);
+		return false;
+	}
+	// the rest of a longer old value
+	erase_chunks(key, chunks, old_chunks);
+	return true;
+}
+
+bool cHttpCacheFlashStore::Erase(const std::string &key){
+	int chunks = chunk_count(key);
+	if(chunks < 0)
+		return false;
+	erase_chunks(key, 0, chunks);
+	return m_pFlash->Erase(key);
+}
+
+bool cHttpCacheFlashStore::EraseAll(){
+	return m_pFlash->EraseAll();
+}
+
+bool cHttpCacheFlashStore::Commit(){
+	return m_pFlash->Commit();
+}
+
+// ============================== cHttpCache ==============================
+
+// serialization helpers
+static void put_u32(std::vector<uint8_t> &buf, uint32_t v){
+	for(int i = 0; i < 4; i++)
+		buf.push_back((v >> (8 * i)) & 0xff);
+}
+
+static bool get_u32(const std::vector<uint8_t> &buf, size_t &pos, uint32_t &v){
+	if(pos + 4 > buf.size())
+		return false;
+	v = buf[pos] | (buf[pos + 1] << 8) | (buf[pos + 2] << 16) | ((uint32_t)buf[pos + 3] << 24);
+	pos += 4;
+	return true;
+}
+
+static void put_str(std::vector<uint8_t> &buf, const std::string &s){
+	buf.push_back(s.size());
+	buf.insert(buf.end(), s.begin(), s.end());
+}
+
+static bool get_str(const std::vector<uint8_t> &buf, size_t &pos, std::string &s){
+	if(pos >= buf.size())
+		return false;
+	size_t len = buf[pos++];
+	if(pos + len > buf.size())
+		return false;
+	s.assign((const char*)&buf[pos], len);
+	pos += len;
+	return true;
+}
+
+cHttpCache::cHttpCache(cHttpCacheStore &store, uint32_t budgetBytes, int maxEntries):
+		m_store(store), m_budget(budgetBytes), m_maxEntries(maxEntries), m_useCounter(0), m_indexLoaded(false) {
+	// the index keeps the count in one byte
+	if(m_maxEntries > MAX_ENTRIES)
+		m_maxEntries = MAX_ENTRIES;
+	if(m_maxEntries < 1)
+		m_maxEntries = 1;
+}
+
+cHttpCache::~cHttpCache() {
+}
+
+uint32_t cHttpCache::url_hash(const std::string &url){
+	return fnv1a(url.data(), url.size());
+}
+
+std::string cHttpCache::entry_key(uint32_t key){
+	char buf[12];
+	snprintf(buf, sizeof buf, "c%08x", key);
+	return buf;
+}
+
+cHttpCache::sEntry* cHttpCache::find(uint32_t key){
+	for(auto &e : m_entries){
+		if(e.key == key)
+			return &e;
+	}
+	return nullptr;
+}
+
+void cHttpCache::remove(uint32_t key){
+	for(auto it = m_entries.begin(); it != m_entries.end(); ++it){
+		if(it->key == key){
+			m_store.Erase(entry_key(key));
+			m_entries.erase(it);
+			return;
+		}
+	}
+}
+
+uint32_t cHttpCache::UsedBytes()const{
+	uint32_t res(0);
+	for(auto &e : m_entries)
+		res += e.size;
+	return res;
+}
+
+void cHttpCache::evict_for(uint32_t size){
+	while(m_entries.size() && (UsedBytes() + size > m_budget || (int)m_entries.size() >= m_maxEntries)){
+		// remove the least recently used entry
+		auto lru = m_entries.begin();
+		for(auto it = m_entries.begin(); it != m_entries.end(); ++it){
+			if(it->last_use < lru->last_use)
+				lru = it;
+		}
+		ESP_LOGD(TAG, "Evict %s (%u bytes)", entry_key(lru->key).c_str(), lru->size);
+		remove(lru->key);
+	}
+}
+
+void cHttpCache::index_load(){
+	if(m_indexLoaded)
+		return;
+	m_indexLoaded = true;
+	m_entries.clear();
+	std::vector<uint8_t> buf;
+	if(!m_store.Load(CACHE_INDEX_KEY, buf) || buf.size() < 6 || buf[0] != CACHE_INDEX_VER){
+		// the entries can't be found without the index (lost by a failed write), drop them
+		m_store.EraseAll();
+		m_store.Commit();
+		return;
+	}
+	size_t pos = 1;
+	get_u32(buf, pos, m_useCounter);
+	int count = buf[pos++];
+	for(int i = 0; i < count; i++){
+		sEntry e;
+		if(!get_u32(buf, pos, e.key) || !get_u32(buf, pos, e.size) || !get_u32(buf, pos, e.last_use) ||
+				!get_str(buf, pos, e.etag) || !get_str(buf, pos, e.last_modified)){
+			ESP_LOGE(TAG, "Index is corrupted, dropping the cache");
+			m_entries.clear();
+			m_store.EraseAll();
+			m_store.Commit();
+			return;
+		}
+		m_entries.push_back(e);
+	}
+}
+
+void cHttpCache::index_save(){
+	std::vector<uint8_t> buf;
+	buf.push_back(CACHE_INDEX_VER);
+	put_u32(buf, m_useCounter);
+	buf.push_back(m_entries.size());
+	for(auto &e : m_entries){
+		put_u32(buf, e.key);
+		put_u32(buf, e.size);
+		put_u32(buf, e.last_use);
+		put_str(buf, e.etag);
+		put_str(buf, e.last_modified);
+	}
+	m_store.Save(CACHE_INDEX_KEY, buf);
+	m_store.Commit();
+}
+
+std::string cHttpCache::ConditionalHeaders(const std::string &url){
+	index_load();
+	sEntry *pe = find(url_hash(url));
+	if(!pe)
+		return "";
+	std::string res;
+	if(pe->etag.length())
+		res += "If-None-Match: " + pe->etag;
+	if(pe->last_modified.length())
+		res += (res.length() ? "\r\n" : "") + std::string("If-Modified-Since: ") + pe->last_modified;
+	return res;
+}
+
+bool cHttpCache::Load(const std::string &url, std::vector<uint8_t> &body){
+	index_load();
+	uint32_t key = url_hash(url);
+	sEntry *pe = find(key);
+	if(!pe)
+		return false;
+	std::vector<uint8_t> buf;
+	size_t url_len(0);
+	if(m_store.Load(entry_key(key), buf) && buf.size() >= 2){
+		url_len = buf[0] | (buf[1] << 8);
+	}
+	// the blob starts with the url to protect against hash collisions
+	if(buf.size() < 2 + url_len || url.compare(0, std::string::npos, (const char*)&buf[2], url_len) != 0){
+		ESP_LOGE(TAG, "Entry for %s is missing or does not match", url.c_str());
+		remove(key);
+		index_save();
+		return false;
+	}
+	body.assign(buf.begin() + 2 + url_len, buf.end());
+	// LRU order is persisted with the next Store(), no need to write the flash on every hit
+	pe->last_use = ++m_useCounter;
+	return true;
+}
+
+bool cHttpCache::Store(const std::string &url, const std::string &headers, const std::vector<uint8_t> &body){
+	index_load();
+	uint32_t key = url_hash(url);
+	std::string etag = GetHeader(headers, "ETag");
+	std::string last_modified = GetHeader(headers, "Last-Modified");
+	uint32_t size = 2 + url.size() + body.size();
+
+	if(GetStatusCode(headers) != 200 || !IsComplete(headers, body) || (!etag.length() && !last_modified.length()) ||
+			etag.length() > CACHE_MAX_TAG_LEN || last_modified.length() > CACHE_MAX_TAG_LEN ||
+			url.size() > 0xffff || size > m_budget){
+		// not cacheable, the old entry is outdated anyway
+		if(find(key)){
+			remove(key);
+			index_save();
+		}
+		return false;
+	}
+
+	remove(key);
+	evict_for(size);
+
+	std::vector<uint8_t> buf;
+	buf.reserve(size);
+	buf.push_back(url.size() & 0xff);
+	buf.push_back((url.size() >> 8) & 0xff);
+	buf.insert(buf.end(), url.begin(), url.end());
+	buf.insert(buf.end(), body.begin(), body.end());
+	if(!m_store.Save(entry_key(key), buf)){
+		// the store drops the incomplete value itself
+		ESP_LOGE(TAG, "Can't store %s", url.c_str());
+		index_save();
+		return false;
+	}
+
+	sEntry e;
+	e.key = key;
+	e.size = size;
+	e.last_use = ++m_useCounter;
+	e.etag = etag;
+	e.last_modified = last_modified;
+	m_entries.push_back(e);
+	index_save();
+	ESP_LOGD(TAG, "Stored %s, %u bytes", url.c_str(), size);
+	return true;
+}
+
+void cHttpCache::Invalidate(const std::string &url){
+	index_load();
+	uint32_t key = url_hash(url);
+	if(find(key)){
+		remove(key);
+		index_save();
+	}
+}
+
+void cHttpCache::Clear(){
+	index_load();
+	while(m_entries.size())
+		remove(m_entries.front().key);
+	index_save();
+}
+
+int cHttpCache::GetStatusCode(const std::string &headers){
+	// HTTP/1.1 200 OK
+	size_t sp = headers.find(' ');
+	if(headers.compare(0, 5, "HTTP/") != 0 || sp == std::string::npos)
+		return 0;
+	return atoi(headers.c_str() + sp + 1);
+}
+
+std::string cHttpCache::GetHeader(const std::string &headers, const char *name){
+	size_t name_len = strlen(name);
+	size_t pos = headers.find('\n');
+	while(pos != std::string::npos){
+		pos++;
+		size_t eol = headers.find('\n', pos);
+		size_t line_end = eol == std::string::npos ? headers.size() : eol;
+		if(line_end - pos > name_len && headers[pos + name_len] == ':' &&
+				strncasecmp(headers.c_str() + pos, name, name_len) == 0){
+			size_t vs = pos + name_len + 1;
+			while(vs < line_end && (headers[vs] == ' ' || headers[vs] == '\t'))
+				vs++;
+			size_t ve = line_end;
+			while(ve > vs && isspace((uint8_t)headers[ve - 1]))
+				ve--;
+			return headers.substr(vs, ve - vs);
+		}
+		pos = eol;
+	}
+	return "";
+}
+
+bool cHttpCache::IsComplete(const std::string &headers, const std::vector<uint8_t> &body){
+	// the transfer coding overrides Content-Length
+	std::string coding = GetHeader(headers, "Transfer-Encoding");
+	for(auto &c : coding)
+		c = tolower((uint8_t)c);
+	if(coding.find("chunked") != std::string::npos){
+		static const size_t end_len = sizeof(CACHE_CHUNKED_END) - 1;
+		return body.size() >= end_len && memcmp(&body[body.size() - end_len], CACHE_CHUNKED_END, end_len) == 0;
+	}
+	std::string len = GetHeader(headers, "Content-Length");
+	if(len.length()){
+		char *end;
+		unsigned long n = strtoul(len.c_str(), &end, 10);
+		return !*end && n == body.size();
+	}
+	return false;
+}
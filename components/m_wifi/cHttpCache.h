@@ -0,0 +1,104 @@
+/*
+ * cHttpCache.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  HTTP response cache with ETag / Last-Modified revalidation
+ */
+
+#ifndef COMPONENTS_M_WIFI_CHTTPCACHE_H_
+#define COMPONENTS_M_WIFI_CHTTPCACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class cFlash;
+
+// Persistent key-value storage used by the cache, keys are up to 9 characters
+class cHttpCacheStore{
+public:
+	virtual ~cHttpCacheStore(){}
+	virtual bool Load(const std::string &key, std::vector<uint8_t> &data) = 0;
+	virtual bool Save(const std::string &key, const std::vector<uint8_t> &data) = 0;
+	virtual bool Erase(const std::string &key) = 0;
+	// drop every value of the cache
+	virtual bool EraseAll() = 0;
+	virtual bool Commit(){return true;}
+};
+
+// NVS backed store, values larger than one NVS blob are split into chunks.
+// The NVS partition (24 KB) is shared with the WiFi driver, the credentials and the BT bonds,
+// so the budget of the cache on it should stay within a few KB. The namespace belongs to the cache alone.
+class cHttpCacheFlashStore: public cHttpCacheStore{
+	cFlash *m_pFlash;
+public:
+	cHttpCacheFlashStore(const std::string &storageName = "httpcache");
+	~cHttpCacheFlashStore();
+	bool Load(const std::string &key, std::vector<uint8_t> &data);
+	bool Save(const std::string &key, const std::vector<uint8_t> &data);
+	bool Erase(const std::string &key);
+	bool EraseAll();
+	bool Commit();
+private:
+	static const size_t CHUNK_LEN = 1980; // max NVS blob length
+	static std::string chunk_key(const std::string &key, int n);
+	int chunk_count(const std::string &key);
+	void erase_chunks(const std::string &key, int from, int to);
+};
+
+// Response cache keyed by URL, with LRU eviction within a size budget.
+// Only complete responses carrying ETag or Last-Modified are stored, because only they can be revalidated.
+class cHttpCache {
+public:
+	static const int MAX_ENTRIES = 255;
+
+	// maxEntries is limited by MAX_ENTRIES
+	cHttpCache(cHttpCacheStore &store, uint32_t budgetBytes = 4096, int maxEntries = 8);
+	~cHttpCache();
+
+	// conditional request headers for the url ("If-None-Match: ...\r\nIf-Modified-Since: ..."), empty if not cached
+	std::string ConditionalHeaders(const std::string &url);
+	// get the cached body for the url (call it on 304 Not Modified)
+	bool Load(const std::string &url, std::vector<uint8_t> &body);
+	// store the response, returns false if it is not cacheable or incomplete
+	bool Store(const std::string &url, const std::string &headers, const std::vector<uint8_t> &body);
+	// drop the entry for the url
+	void Invalidate(const std::string &url);
+	// drop everything
+	void Clear();
+
+	uint32_t UsedBytes()const;
+
+	// response headers helpers
+	static int GetStatusCode(const std::string &headers);
+	static std::string GetHeader(const std::string &headers, const char *name);
+	// the body has the length of Content-Length or ends with the terminating chunk of the chunked encoding;
+	// a body ended by the connection close only can't be verified
+	static bool IsComplete(const std::string &headers, const std::vector<uint8_t> &body);
+
+private:
+	struct sEntry{
+		uint32_t key; // url hash
+		uint32_t size; // stored bytes
+		uint32_t last_use; // LRU counter value
+		std::string etag;
+		std::string last_modified;
+	};
+
+	cHttpCacheStore &m_store;
+	uint32_t m_budget;
+	int m_maxEntries;
+	uint32_t m_useCounter;
+	bool m_indexLoaded;
+	std::vector<sEntry> m_entries;
+
+	static uint32_t url_hash(const std::string &url);
+	static std::string entry_key(uint32_t key);
+	sEntry* find(uint32_t key);
+	void remove(uint32_t key);
+	void evict_for(uint32_t size);
+	void index_load();
+	void index_save();
+};
+
+#endif /* COMPONENTS_M_WIFI_CHTTPCACHE_H_ */
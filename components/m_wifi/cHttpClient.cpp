@@ -13,9 +13,7 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <iomanip>
 #include <algorithm>    // find
-#include <sstream>
 
 #include <posix/sys/socket.h>
 
@@ -25,7 +23,6 @@
 #include <lwip/netdb.h>
 
 #include <errno.h>
-#include <mbedtls/base64.h>
 
 #include "../../main/common/Utils.h"
 
@@ -130,17 +127,25 @@ cHttpClient::cHttpClient(cWiFiDevice &dev):CurrentStatus(eHttpClientStatus::e_sh
 	pCallbacks = nullptr;
 	m_pwifi = &dev;
 	bAutoCalcSha1 = false;
-	bShaWasInit = false;
+	HashAlgo = eHashAlgo::e_sha1;
+	HashFormat = eHashFormat::e_base64_hex;
 	b_allow_data_processing = false;
 	_CA_cert = NULL;
 	cli_cert = NULL;
 	cli_private_key = NULL;
 	bModeHttps = false;
+	b_body_dropped = false;
+	m_bodyLen = 0;
+	m_pCache = nullptr;
+	ResponseCode = 0;
+	bFromCache = false;
+	wake = xSemaphoreCreateBinary();
 	ssl_init();
 }
 
 cHttpClient::~cHttpClient() {
 	Shutdown();
+	vSemaphoreDelete(wake);
 }
 
 
@@ -167,31 +172,18 @@ void cHttpClient::TaskHandler(){
 	while(true){
 		bSleep = true;
 
-		// WiFi state checkers
+		// WiFi state checkers, the requests wait for WiFi by themselves (see wait_wifi())
 		if(CurrentStatus == eHttpClientStatus::e_shutdown){
-			if(m_pwifi->CurrentState == eWiFiState::e_connected){
-				CurrentStatus = eHttpClientStatus::e_busy_wifi; // allow to process this state and advance
+			// a request may be started meanwhile, it changes the status by itself
+			if((cConnectivity::Get().WaitBits(CONN_BIT_ONLINE, portMAX_DELAY) & CONN_BIT_ONLINE) && CurrentStatus == eHttpClientStatus::e_shutdown){
+				CurrentStatus = eHttpClientStatus::e_ok;
 			}
+			continue;
 		}
 
-		if(CurrentStatus == eHttpClientStatus::e_busy_wifi){
-			// check WiFi
-			switch(m_pwifi->CurrentState){
-			case eWiFiState::e_connected:
-				CurrentStatus = eHttpClientStatus::e_ok;
-				break;
-			case eWiFiState::e_disconnected:
-			case eWiFiState::e_failed:
-				CurrentStatus = eHttpClientStatus::e_wifi_failed;
-				if(pCallbacks)
-					pCallbacks->OnError(this);
-				break;
-			default:
-				break;
-			}
-		}else if(CurrentStatus == eHttpClientStatus::e_busy_http){
+		if(CurrentStatus == eHttpClientStatus::e_busy_http){
 			// check wifi state
-			if(m_pwifi->CurrentState == eWiFiState::e_disconnected || m_pwifi->CurrentState == eWiFiState::e_failed){
+			if(cConnectivity::Get().Bits() & CONN_BIT_DOWN){
 				CurrentStatus = eHttpClientStatus::e_wifi_failed;
 				ESP_LOGE(TAG, "WiFi unexpectedly fails!");
 				if(pCallbacks)
@@ -204,11 +196,9 @@ void cHttpClient::TaskHandler(){
 				continue;
 			}
 
-			// initialize sha if required
-			if(bAutoCalcSha1 && !bShaWasInit){
-				mbedtls_sha1_init(&sha);
-				mbedtls_sha1_starts(&sha);
-				bShaWasInit = true;
+			// initialize hash if required
+			if(bAutoCalcSha1 && !hash.IsStarted()){
+				hash.Start(HashAlgo);
 			}
 			// process HTTP response
 			uint8_t buf[256];
@@ -244,18 +234,19 @@ void cHttpClient::TaskHandler(){
 
 			} else if (buff_len > 0) {
 				bSleep = false;
+				cWiFiDevice::NotifyTraffic();
 				if(b_resp_body_start){ // headers are already received
 					int cursz = body_data.size();
 					if(cursz > 10000){
 						ESP_LOGE(TAG, "Body data overflow - dropping! Use callbacks, please!");
 						cursz = 0;
+						b_body_dropped = true;
 					}
 					body_data.resize(cursz + buff_len);
 					memcpy(&body_data[cursz], buf, buff_len);
-					// add this data to sha
-					if(bShaWasInit){
-						mbedtls_sha1_update(&sha, buf, buff_len);
-					}
+					m_bodyLen += buff_len;
+					// add this data to hash
+					hash.Update(buf, buff_len);
 					if(pCallbacks){// process user callback
 						pCallbacks->OnNewData(this);
 					}
@@ -267,10 +258,9 @@ void cHttpClient::TaskHandler(){
 							int cursz = body_data.size();
 							body_data.resize(cursz + buff_len - ic);
 							memcpy(&body_data[cursz], buf + ic, buff_len - ic);
-							// add this data to sha
-							if(bShaWasInit){
-								mbedtls_sha1_update(&sha, buf + ic, buff_len - ic);
-							}
+							m_bodyLen += buff_len - ic;
+							// add this data to hash
+							hash.Update(buf + ic, buff_len - ic);
 							if(pCallbacks){	// process callback
 								pCallbacks->OnNewData(this);
 							}
@@ -304,6 +294,8 @@ void cHttpClient::TaskHandler(){
 					close(socket_id);
 					socket_id = -1;
 				}
+				// serve or update the response cache
+				cache_finish();
 				// finish sha processing
 				sha_finish();
 				if(pCallbacks)
@@ -312,10 +304,31 @@ void cHttpClient::TaskHandler(){
 				ESP_LOGD(TAG, "Connection closed, all packets was received");
 			}
 		}
-		if(bSleep) vTaskDelay(10);
+		if(CurrentStatus != eHttpClientStatus::e_busy_http){
+			// nothing to receive, sleep until the next request
+			xSemaphoreTake(wake, portMAX_DELAY);
+		}else if(bSleep){
+			vTaskDelay(10);
+		}
 	}
 }
 
+// wait for the network without polling, returns false if it is not available
+bool cHttpClient::wait_wifi(){
+	// maybe we already have wifi connection?
+	CurrentStatus = eHttpClientStatus::e_busy_wifi;
+	StartTask();
+	if(cConnectivity::Get().WaitOnline(10000)){
+		CurrentStatus = eHttpClientStatus::e_ok;
+		return true;
+	}
+	CurrentStatus = eHttpClientStatus::e_wifi_failed;
+	ESP_LOGE(TAG, "My Status is not good enough to execute HTTP request");
+	if(pCallbacks)
+		pCallbacks->OnError(this);
+	return false;
+}
+
 bool cHttpClient::HttpsRequest(const std::string &req_body, const std::string &server_host, const std::string &server_port, bool bCheckOnly){
 	ESP_LOGD(TAG, ">> HttpsRequest");
 	if(!server_host.length() || !server_port.length()){
@@ -334,27 +347,15 @@ bool cHttpClient::HttpsRequest(const std::string &req_body, const std::string &s
 	// cleanup
 	headers_data.clear();
 	body_data.clear();
-	// maybe we already have wifi connection?
-	CurrentStatus = eHttpClientStatus::e_busy_wifi;
+	b_body_dropped = false;
+	m_bodyLen = 0;
+	ResponseCode = 0;
+	bFromCache = false;
 	b_allow_data_processing = !pCallbacks; // deny implicit data processing when callbacks are in use
 
-	StartTask();
-
-	cTimeout to(10000);
-	while(CurrentStatus == eHttpClientStatus::e_busy_wifi && !to()){ // wait for WiFi status
-		vTaskDelay(10);
-	}
-
-	// check our state
-	bool bCanTry = CurrentStatus == eHttpClientStatus::e_ok || CurrentStatus == eHttpClientStatus::e_http_failed;
-	if(!bCanTry){
-		ESP_LOGE(TAG, "My Status is not good enough to execute HTTP request");
-		if(pCallbacks)
-			pCallbacks->OnError(this);
+	if(!wait_wifi())
 		return false;
-	}
-
-	CurrentStatus = eHttpClientStatus::e_ok;
+	cWiFiDevice::NotifyTraffic();
 
 	ESP_LOGD(TAG, "HTTPS Request: %s", req_body.c_str());
 
@@ -395,6 +396,7 @@ bool cHttpClient::HttpsRequest(const std::string &req_body, const std::string &s
 	recv_start_t = GetTickCount();
 	b_resp_body_start = false;
 	CurrentStatus = eHttpClientStatus::e_busy_http;
+	xSemaphoreGive(wake); // start receiving
 	ESP_LOGD(TAG, "<< HttpSRequest OK");
 	return true;
 }
@@ -417,27 +419,15 @@ bool cHttpClient::HttpRequest(const std::string &req_body, const std::string &se
 	// cleanup
 	headers_data.clear();
 	body_data.clear();
-	// maybe we already have wifi connection?
-	CurrentStatus = eHttpClientStatus::e_busy_wifi;
+	b_body_dropped = false;
+	m_bodyLen = 0;
+	ResponseCode = 0;
+	bFromCache = false;
 	b_allow_data_processing = !pCallbacks; // deny implicit data processing when callbacks are in use
 
-	StartTask();
-
-	cTimeout to(10000);
-	while(CurrentStatus == eHttpClientStatus::e_busy_wifi && !to()){ // wait for WiFi status
-		vTaskDelay(10);
-	}
-
-	// check our state
-	bool bCanTry = CurrentStatus == eHttpClientStatus::e_ok || CurrentStatus == eHttpClientStatus::e_http_failed;
-	if(!bCanTry){
-		ESP_LOGE(TAG, "My Status is not good enough to execute HTTP request");
-		if(pCallbacks)
-			pCallbacks->OnError(this);
+	if(!wait_wifi())
 		return false;
-	}
-
-	CurrentStatus = eHttpClientStatus::e_ok;
+	cWiFiDevice::NotifyTraffic();
 
 	ESP_LOGD(TAG, "HTTP Request: %s", req_body.c_str());
 
@@ -495,6 +485,7 @@ bool cHttpClient::HttpRequest(const std::string &req_body, const std::string &se
 	recv_start_t = GetTickCount();
 	b_resp_body_start = false;
 	CurrentStatus = eHttpClientStatus::e_busy_http;
+	xSemaphoreGive(wake); // start receiving
 	ESP_LOGD(TAG, "<< HttpRequest OK");
 	return true;
 }
@@ -507,10 +498,19 @@ bool cHttpClient::HttpGet(const std::string& uri, const std::string &more_header
 	if(!ParseUrlToParts(uri, Host, Port, Path, QueryString, Protocol))
 		return false;
 
+	// revalidate the cached copy instead of downloading it again
+	std::string cond_headers;
+	m_cacheUrl.clear();
+	if(m_pCache && !bCheckOnly){
+		m_cacheUrl = uri;
+		cond_headers = m_pCache->ConditionalHeaders(uri);
+	}
+
 	std::string req_body =
 			"GET " + Path + (QueryString.length() ? "?" + QueryString : "") + " HTTP/1.1\r\n"
 			"Host: " + Host + "\r\n" +
 			more_headers + (more_headers.length() ? "\r\n" : "") +
+			cond_headers + (cond_headers.length() ? "\r\n" : "") +
 			"Connection: close\r\n\r\n";
 	return Protocol == "https" || Port == "443" ?  HttpsRequest(req_body, Host, Port, bCheckOnly) : HttpRequest(req_body, Host, Port, bCheckOnly);
 }
@@ -530,6 +530,7 @@ bool cHttpClient::HttpPost(const std::string& uri, const std::string &data, cons
 	std::string QueryString, Path, Protocol, Host, Port;
 	if(!ParseUrlToParts(uri, Host, Port, Path, QueryString, Protocol))
 		return false;
+	m_cacheUrl.clear();
 
 	std::string req_body =
 			"POST " + Path + (QueryString.length() ? "?" + QueryString : "") + " HTTP/1.1\r\n"
@@ -545,11 +546,8 @@ bool cHttpClient::HttpPost(const std::string& uri, const std::string &data, cons
 void cHttpClient::Shutdown(){
 	ESP_LOGD(TAG, ">> Shutdown");
 
-	if(bShaWasInit){
-		// deinitialize sha internals
-		mbedtls_sha1_free(&sha);
-		bShaWasInit = false;
-	}
+	// deinitialize hash internals
+	hash.Cancel();
 
 	if(CurrentStatus == eHttpClientStatus::e_shutdown){
 		ESP_LOGD(TAG, "<< Shutdown - already down!");
@@ -572,25 +570,31 @@ void cHttpClient::Shutdown(){
 }
 
 
+void cHttpClient::cache_finish(){
+	ResponseCode = cHttpCache::GetStatusCode(headers_data);
+	if(!m_pCache || !m_cacheUrl.length())
+		return;
+	if(ResponseCode == 304){
+		// not modified, take the body from the cache
+		if(m_pCache->Load(m_cacheUrl, body_data)){
+			bFromCache = true;
+			ESP_LOGD(TAG, "Response for %s is served from the cache", m_cacheUrl.c_str());
+			hash.Update(body_data.data(), body_data.size());
+			if(pCallbacks)
+				pCallbacks->OnNewData(this);
+		}
+	}else if(!b_body_dropped && body_data.size() == m_bodyLen){
+		// the cache checks the length against the headers
+		m_pCache->Store(m_cacheUrl, headers_data, body_data);
+	}
+	m_cacheUrl.clear();
+}
+
+
 void cHttpClient::sha_finish(){
-	if(bShaWasInit){
-		unsigned char output[20], base64_out[64];
-		mbedtls_sha1_finish(&sha, output);
-		// deinitialize sha internals
-		mbedtls_sha1_free(&sha);
-		bShaWasInit = false;
-		// convert sha1 to the hex string
-		std::stringstream ss;
-		ss << std::hex;
-		for(int i = 0; i < sizeof output; i++)
-			ss << std::setw(2) << std::setfill('0') << (int)output[i];
-		// now get the base64-encoded string
-		size_t out_len(0);
-		mbedtls_base64_encode(base64_out, sizeof base64_out,  &out_len,
-				(uint8_t*)ss.str().c_str(), ss.str().size());
-
-		base64_out[out_len] = 0; // null-terminate
-		DataSha1Hash = (char*) base64_out;
+	if(hash.IsStarted()){
+		hash.Finish();
+		DataSha1Hash = hash.Format(HashFormat);
 	}
 }
 
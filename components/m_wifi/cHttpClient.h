@@ -12,11 +12,11 @@
 #define COMPONENTS_M_WIFI_CHTTPSCLIENT_H_
 
 #include "cWiFiDevice.h"
+#include "cHash.h"
+#include "cHttpCache.h"
+#include "cConnectivity.h"
 #include "../../main/common/cBaseTask.h"
 
-#define MBEDTLS_SHA1_ALT // only this configuration is working
-#include <mbedtls/sha1.h>
-
 #include <vector>
 #include <string>
 
@@ -30,6 +30,10 @@
 
 class cHttpClient;
 
+// URL and DNS helpers
+bool ParseUrlToParts(const std::string& uri, std::string &retHost, std::string &retPort, std::string &retPath, std::string &retQueryString, std::string &retProtocol);
+std::string HostNameToIP(const std::string &hname);
+
 // Http client events callbacks shell
 class cHttpCallbacks{
 public:
@@ -47,8 +51,8 @@ enum class eHttpClientStatus{e_shutdown, e_busy_wifi, e_wifi_failed, e_busy_http
 // also use calling task's stack size at least 8 kB when executing HTTPS requests
 class cHttpClient : private cBaseTask {
 	cWiFiDevice *m_pwifi; // pointer to the device instance
-	mbedtls_sha1_context sha; // context for data hash calculation
-	bool bShaWasInit; // internal sha state flag
+	cHash hash; // body data hash calculator
+	SemaphoreHandle_t wake; // wakes the idle task up for a new request
 
 	// SSL context
     mbedtls_ssl_context ssl_ctx;
@@ -65,15 +69,23 @@ class cHttpClient : private cBaseTask {
     const char *cli_cert;
     const char *cli_private_key;
 public:
-	bool bAutoCalcSha1; // set to true to automatically calculate sha1 hash, default is false
-	std::string DataSha1Hash; // contains last base64(sha1(body_data)) if bAutoCalcSha1 is true
+	bool bAutoCalcSha1; // set to true to automatically calculate body hash, default is false
+	eHashAlgo HashAlgo; // hash algorithm used when bAutoCalcSha1 is true, default is SHA-1
+	eHashFormat HashFormat; // DataSha1Hash format, default is base64(hex(hash))
+	std::string DataSha1Hash; // contains last formatted hash(body_data) if bAutoCalcSha1 is true
 	cHttpCallbacks *pCallbacks; // if you want to use callbacks
 	eHttpClientStatus CurrentStatus; // track this status to discover what happens
 	std::string headers_data; // headers from a response
 	std::vector <uint8_t> body_data; // response body data
+	int ResponseCode; // HTTP status code of the last response, 0 if unknown
+	bool bFromCache; // true if body_data of the last GET was served from the response cache (304 Not Modified)
 	cHttpClient(cWiFiDevice &dev);
 	~cHttpClient();
 
+	// opt-in response cache for HttpGet(), pass nullptr to disable
+	// only a complete body_data is stored, so nothing is cached if the callbacks consume it
+	void SetCache(cHttpCache *pCache){m_pCache = pCache;}
+
 	// Attention!!! this methods is for making request, you have to wait for body polling  IsFailed() and IsReadyToGet()
 	bool HttpGet(const std::string& uri, const std::string &more_headers, bool bCheckOnly = false);
 	bool HttpPost(const std::string& uri, const std::string &data, const std::string &more_headers);
@@ -93,13 +105,19 @@ private:
 	unsigned int recv_start_t;
 	bool b_allow_data_processing;
 	bool bModeHttps;
+	bool b_body_dropped; // body data overflow happened, the body is incomplete
+	size_t m_bodyLen; // bytes of the body received, body_data is complete if it has all of them
+	cHttpCache *m_pCache; // response cache, nullptr if not used
+	std::string m_cacheUrl; // url of the current cacheable request
 	void TaskHandler();
 	void StartTask();
+	bool wait_wifi();
 
 	// make a request
 	bool HttpsRequest(const std::string &req_body, const std::string &server_host, const std::string &server_port, bool bCheckOnly = false);
 	bool HttpRequest(const std::string &req_body, const std::string &server_host, const std::string &server_port, bool bCheckOnly = false);
 	void sha_finish();
+	void cache_finish();
 	// SSL methods
 	void ssl_init();
 	int start_ssl_client(const std::string& host, const std::string& port);
@@ -0,0 +1,489 @@
+/*
+ * cHttpScheduler.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cHttpScheduler.h"
+#include "cHttpClient.h" // URL and DNS helpers
+#include "cHttpCache.h" // status code parser
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include <posix/sys/socket.h>
+#include <lwip/inet.h>
+#include <lwip/sockets.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "../../main/common/Utils.h"
+
+#include <esp_log.h>
+
+static const char* TAG = "cHttpScheduler";
+
+#define SCHEDULER_SELECT_MS		100 // max time of one select() call
+#define SCHEDULER_RECV_BUF_LEN	512
+
+//===========================================================================================================
+
+cHttpRequest::cHttpRequest():Priority(0), TimeoutMs(25000), MaxBodyLen(10000), pCallbacks(nullptr), pOwner(nullptr),
+		State(eHttpRequestState::e_idle), ResponseCode(0), sock(-1), sent(0), b_body_start(false), seq(0), last_activity_t(0) {
+}
+
+cHttpRequest::~cHttpRequest() {
+	if(sock != -1)
+		close(sock);
+}
+
+void cHttpRequest::reset(){
+	if(sock != -1)
+		close(sock);
+	sock = -1;
+	sent = 0;
+	b_body_start = false;
+	ResponseCode = 0;
+	headers_data.clear();
+	body_data.clear();
+}
+
+bool cHttpRequest::set_uri(const std::string &uri, std::string &path){
+	std::string QueryString, Path, Protocol;
+	if(!ParseUrlToParts(uri, host, port, Path, QueryString, Protocol))
+		return false;
+	if(Protocol == "https" || port == "443"){
+		ESP_LOGE(TAG, "HTTPS is not supported by the scheduler, use cHttpClient: %s", uri.c_str());
+		return false;
+	}
+	path = Path + (QueryString.length() ? "?" + QueryString : "");
+	return true;
+}
+
+bool cHttpRequest::SetGet(const std::string &uri, const std::string &more_headers){
+	if(State != eHttpRequestState::e_idle && !IsFinished())
+		return false;
+	std::string path;
+	if(!set_uri(uri, path))
+		return false;
+	req_body =
+			"GET " + path + " HTTP/1.1\r\n"
+			"Host: " + host + "\r\n" +
+			more_headers + (more_headers.length() ? "\r\n" : "") +
+			"Connection: close\r\n\r\n";
+	reset();
+	State = eHttpRequestState::e_idle;
+	return true;
+}
+
+bool cHttpRequest::SetPost(const std::string &uri, const std::string &data, const std::string &more_headers){
+	if(State != eHttpRequestState::e_idle && !IsFinished())
+		return false;
+	std::string path;
+	if(!set_uri(uri, path))
+		return false;
+	req_body =
+			"POST " + path + " HTTP/1.1\r\n"
+			"Host: " + host + "\r\n"+
+			more_headers + (more_headers.length() ? "\r\n" : "") +
+			"Content-Length: " + IntToStr(data.length()) + "\r\n"
+			"Connection: close\r\n\r\n" + data;
+	reset();
+	State = eHttpRequestState::e_idle;
+	return true;
+}
+
+//===========================================================================================================
+
+cHttpScheduler::cHttpScheduler(int maxConnections, int maxConnectionsPerHost):
+		m_task(nullptr), m_bStop(false), seq_counter(0), MaxConnections(maxConnections), MaxConnectionsPerHost(maxConnectionsPerHost) {
+	wake = xSemaphoreCreateBinary();
+	stopped = xSemaphoreCreateBinary();
+	cConnectivity::Get().Subscribe(this);
+}
+
+cHttpScheduler::~cHttpScheduler() {
+	cConnectivity::Get().Unsubscribe(this);
+	Shutdown();
+	vSemaphoreDelete(wake);
+	vSemaphoreDelete(stopped);
+}
+
+bool cHttpScheduler::Enqueue(cHttpRequest *pReq){
+	if(!pReq || !pReq->req_body.length() || (pReq->State != eHttpRequestState::e_idle && !pReq->IsFinished())){
+		ESP_LOGE(TAG, "Enqueue: the request is not prepared or already in work");
+		return false;
+	}
+	{
+		cAutoLock lk(mux);
+		pReq->reset();
+		pReq->seq = seq_counter++;
+		pReq->last_activity_t = GetTickCount();
+		pReq->State = eHttpRequestState::e_queued;
+		queued.push_back(pReq);
+	}
+	if(!IsTaskExists()){
+		m_bStop = false;
+		TaskCreate("HTTP Scheduler", 5, 4096);
+	}
+	xSemaphoreGive(wake);
+	return true;
+}
+
+bool cHttpScheduler::Cancel(cHttpRequest *pReq){
+	bool bWake(false);
+	{
+		cAutoLock lk(mux);
+		auto it = std::find(completed.begin(), completed.end(), pReq);
+		if(it != completed.end()){
+			completed.erase(it); // finished, but not notified yet
+			return true;
+		}
+		it = std::find(queued.begin(), queued.end(), pReq);
+		if(it != queued.end()){
+			queued.erase(it);
+		}else{
+			it = std::find(active.begin(), active.end(), pReq);
+			if(it == active.end())
+				return false;
+			active.erase(it);
+			if(pReq->sock != -1){
+				// the task may be in select() on it, the socket is closed there and the request is free now
+				closing.push_back(pReq->sock);
+				pReq->sock = -1;
+				bWake = true;
+			}
+		}
+		pReq->reset();
+		pReq->State = eHttpRequestState::e_idle;
+	}
+	if(bWake)
+		xSemaphoreGive(wake);
+	return true;
+}
+
+void cHttpScheduler::Shutdown(){
+	ESP_LOGD(TAG, ">> Shutdown");
+	if(IsTaskExists()){
+		// the task deletes itself between the cycles, so it is never killed holding the lock or inside a callback
+		if(xTaskGetCurrentTaskHandle() == m_task){
+			m_bStop = true; // from a callback, the task stops when it returns
+		}else{
+			xSemaphoreTake(stopped, 0);
+			m_bStop = true;
+			xSemaphoreGive(wake);
+			xSemaphoreTake(stopped, portMAX_DELAY);
+		}
+	}
+	cAutoLock lk(mux);
+	for(auto pReq : queued){
+		pReq->State = eHttpRequestState::e_idle;
+	}
+	for(auto pReq : active){
+		pReq->reset();
+		pReq->State = eHttpRequestState::e_idle;
+	}
+	queued.clear();
+	active.clear();
+	completed.clear();
+	close_cancelled(); // the task is stopped
+	ESP_LOGD(TAG, "<< Shutdown");
+}
+
+int cHttpScheduler::QueuedCount(){
+	cAutoLock lk(mux);
+	return queued.size();
+}
+
+int cHttpScheduler::ActiveCount(){
+	cAutoLock lk(mux);
+	return active.size();
+}
+
+int cHttpScheduler::host_connections(const std::string &host){
+	int res(0);
+	for(auto pReq : active){
+		if(pReq->host == host)
+			res++;
+	}
+	return res;
+}
+
+void cHttpScheduler::finish(cHttpRequest *pReq, eHttpRequestState state){
+	if(pReq->sock != -1){
+		close(pReq->sock);
+		pReq->sock = -1;
+	}
+	pReq->ResponseCode = cHttpCache::GetStatusCode(pReq->headers_data);
+	pReq->State = state;
+	auto it = std::find(active.begin(), active.end(), pReq);
+	if(it != active.end())
+		active.erase(it);
+	it = std::find(queued.begin(), queued.end(), pReq);
+	if(it != queued.end())
+		queued.erase(it);
+	ESP_LOGD(TAG, "Request to %s finished, state %d, code %d", pReq->host.c_str(), (int)state, pReq->ResponseCode);
+	completed.push_back(pReq); // OnRequestComplete is called without the lock
+}
+
+void cHttpScheduler::notify_completed(){
+	// one by one, so Cancel() of a request not notified yet removes it from the list and it is skipped here;
+	// the callback may enqueue the same request again
+	while(true){
+		cHttpRequest *pReq;
+		{
+			cAutoLock lk(mux);
+			if(completed.empty())
+				return;
+			pReq = completed.front();
+			completed.erase(completed.begin());
+		}
+		if(pReq->pCallbacks)
+			pReq->pCallbacks->OnRequestComplete(pReq);
+	}
+}
+
+// the mux is taken
+void cHttpScheduler::close_cancelled(){
+	for(auto sock : closing)
+		close(sock);
+	closing.clear();
+}
+
+// move the next requests to the active list, they are connected by connect_started() after resolve()
+void cHttpScheduler::start_queued(std::vector<cHttpRequest*> &starting, std::vector<std::string> &hosts){
+	if(!cConnectivity::Get().IsOnline()){
+		// fail the requests waiting for WiFi too long
+		uint32_t now = GetTickCount();
+		for(size_t i = 0; i < queued.size();){
+			cHttpRequest *pReq = queued[i];
+			if(now - pReq->last_activity_t > pReq->TimeoutMs){
+				ESP_LOGE(TAG, "No WiFi connection for the request to %s", pReq->host.c_str());
+				finish(pReq, eHttpRequestState::e_failed);
+				continue;
+			}
+			i++;
+		}
+		return;
+	}
+	while((int)active.size() < MaxConnections){
+		// the highest priority first, FIFO order within the same priority
+		cHttpRequest *pBest = nullptr;
+		for(auto pReq : queued){
+			if(host_connections(pReq->host) >= MaxConnectionsPerHost)
+				continue;
+			if(!pBest || pReq->Priority > pBest->Priority || (pReq->Priority == pBest->Priority && (int32_t)(pReq->seq - pBest->seq) < 0))
+				pBest = pReq;
+		}
+		if(!pBest)
+			return;
+		queued.erase(std::find(queued.begin(), queued.end(), pBest));
+		active.push_back(pBest);
+		pBest->State = eHttpRequestState::e_connecting; // no socket yet
+		pBest->last_activity_t = GetTickCount();
+		starting.push_back(pBest);
+		hosts.push_back(pBest->host);
+	}
+}
+
+// DNS query blocks for seconds, it is called without the lock; returns INADDR_NONE if the name is not resolved
+uint32_t cHttpScheduler::resolve(const std::string &host){
+	return inet_addr(HostNameToIP(host).c_str());
+}
+
+void cHttpScheduler::connect_started(const std::vector<cHttpRequest*> &starting, const std::vector<uint32_t> &addrs){
+	for(size_t i = 0; i < starting.size(); i++){
+		cHttpRequest *pReq = starting[i];
+		// it may be cancelled while resolving
+		if(std::find(active.begin(), active.end(), pReq) == active.end() || pReq->sock != -1)
+			continue;
+		if(addrs[i] == INADDR_NONE){
+			ESP_LOGE(TAG, "Can't resolve %s", pReq->host.c_str());
+			finish(pReq, eHttpRequestState::e_failed);
+		}else if(!start_connect(pReq, addrs[i])){
+			finish(pReq, eHttpRequestState::e_failed);
+		}
+	}
+}
+
+bool cHttpScheduler::start_connect(cHttpRequest *pReq, uint32_t addr){
+	pReq->sock = socket(AF_INET, SOCK_STREAM, 0);
+	if(pReq->sock == -1){
+		ESP_LOGE(TAG, "Create socket failed!");
+		return false;
+	}
+	fcntl(pReq->sock, F_SETFL, fcntl(pReq->sock, F_GETFL, 0) | O_NONBLOCK);
+
+	struct sockaddr_in sock_info;
+	memset(&sock_info, 0, sizeof(struct sockaddr_in));
+	sock_info.sin_family = AF_INET;
+	sock_info.sin_addr.s_addr = addr;
+	sock_info.sin_port = htons((uint16_t)atoi(pReq->port.c_str()));
+
+	pReq->last_activity_t = GetTickCount();
+	cWiFiDevice::NotifyTraffic();
+	if(connect(pReq->sock, (sockaddr *)&sock_info, sizeof(sock_info)) == -1 && errno != EINPROGRESS){
+		ESP_LOGE(TAG, "Connect to %s failed! errno=%d", pReq->host.c_str(), errno);
+		return false;
+	}
+	return true;
+}
+
+void cHttpScheduler::on_writable(cHttpRequest *pReq){
+	if(pReq->State == eHttpRequestState::e_connecting){
+		int err(0);
+		socklen_t len = sizeof err;
+		if(getsockopt(pReq->sock, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0){
+			ESP_LOGE(TAG, "Connect to %s failed! error=%d", pReq->host.c_str(), err);
+			finish(pReq, eHttpRequestState::e_failed);
+			return;
+		}
+		ESP_LOGD(TAG, "Connected to %s", pReq->host.c_str());
+		pReq->State = eHttpRequestState::e_sending;
+	}
+	int res = send(pReq->sock, pReq->req_body.c_str() + pReq->sent, pReq->req_body.size() - pReq->sent, MSG_DONTWAIT);
+	if(res < 0){
+		if(errno == EAGAIN)
+			return;
+		ESP_LOGE(TAG, "Send request to %s failed! errno=%d", pReq->host.c_str(), errno);
+		finish(pReq, eHttpRequestState::e_failed);
+		return;
+	}
+	pReq->sent += res;
+	pReq->last_activity_t = GetTickCount();
+	if(pReq->sent == pReq->req_body.size())
+		pReq->State = eHttpRequestState::e_receiving;
+}
+
+void cHttpScheduler::on_readable(cHttpRequest *pReq){
+	uint8_t buf[SCHEDULER_RECV_BUF_LEN];
+	int buff_len = recv(pReq->sock, buf, sizeof buf, MSG_DONTWAIT);
+	if(buff_len < 0){
+		if(errno == EAGAIN)
+			return;
+		ESP_LOGE(TAG, "Receive from %s failed! errno=%d", pReq->host.c_str(), errno);
+		finish(pReq, eHttpRequestState::e_failed);
+		return;
+	}
+	if(buff_len == 0){
+		ESP_LOGD(TAG, "Connection to %s closed, all packets was received", pReq->host.c_str());
+		finish(pReq, pReq->b_body_start ? eHttpRequestState::e_done : eHttpRequestState::e_failed);
+		return;
+	}
+	pReq->last_activity_t = GetTickCount();
+	cWiFiDevice::NotifyTraffic();
+	int ic(0);
+	if(!pReq->b_body_start){
+		// headers are finished with \r\n\r\n
+		for(; ic < buff_len && !pReq->b_body_start; ic++){
+			pReq->headers_data += (char)buf[ic];
+			size_t hl = pReq->headers_data.length();
+			if(hl >= 4 && pReq->headers_data.compare(hl - 4, 4, "\r\n\r\n") == 0){
+				pReq->b_body_start = true;
+				pReq->ResponseCode = cHttpCache::GetStatusCode(pReq->headers_data);
+				if(pReq->pCallbacks)
+					pReq->pCallbacks->OnRequestHeaders(pReq);
+			}
+		}
+	}
+	if(ic < buff_len){
+		if(pReq->body_data.size() + buff_len - ic > pReq->MaxBodyLen){
+			ESP_LOGE(TAG, "Body data overflow for %s! Consume body_data in OnRequestData, please!", pReq->host.c_str());
+			finish(pReq, eHttpRequestState::e_failed);
+			return;
+		}
+		pReq->body_data.insert(pReq->body_data.end(), buf + ic, buf + buff_len);
+		if(pReq->pCallbacks)
+			pReq->pCallbacks->OnRequestData(pReq);
+	}
+}
+
+void cHttpScheduler::OnStateChanged(eConnState from, eConnState to){
+	xSemaphoreGive(wake); // start the queued requests when online
+}
+
+void cHttpScheduler::TaskHandler(){
+	m_task = xTaskGetCurrentTaskHandle();
+	std::vector<cHttpRequest*> work, starting;
+	std::vector<std::string> hosts;
+	std::vector<uint32_t> addrs;
+	while(!m_bStop){
+		bool bIdle;
+		starting.clear();
+		hosts.clear();
+		{
+			cAutoLock lk(mux);
+			start_queued(starting, hosts);
+		}
+		addrs.clear();
+		for(auto &host : hosts)
+			addrs.push_back(resolve(host));
+		{
+			cAutoLock lk(mux);
+			close_cancelled();
+			connect_started(starting, addrs);
+			bIdle = active.empty();
+		}
+		notify_completed();
+		if(m_bStop)
+			break;
+		if(bIdle){
+			// sleep until a new request or a connectivity change, check the timeouts if something is queued
+			xSemaphoreTake(wake, QueuedCount() ? 1000 / portTICK_PERIOD_MS : portMAX_DELAY);
+			continue;
+		}
+
+		// wait for any socket activity
+		fd_set rfds, wfds;
+		FD_ZERO(&rfds);
+		FD_ZERO(&wfds);
+		int maxfd(-1);
+		{
+			cAutoLock lk(mux);
+			for(auto pReq : active){
+				if(pReq->sock == -1)
+					continue;
+				if(pReq->State == eHttpRequestState::e_receiving)
+					FD_SET(pReq->sock, &rfds);
+				else
+					FD_SET(pReq->sock, &wfds);
+				if(pReq->sock > maxfd)
+					maxfd = pReq->sock;
+			}
+		}
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = SCHEDULER_SELECT_MS * 1000;
+		int nsel = select(maxfd + 1, &rfds, &wfds, NULL, &tv);
+		if(nsel < 0){
+			ESP_LOGE(TAG, "select() failed! errno=%d", errno);
+			vTaskDelay(10);
+		}
+
+		{
+			cAutoLock lk(mux);
+			close_cancelled(); // not in select() any more
+			uint32_t now = GetTickCount();
+			bool bWiFiLost = cConnectivity::Get().Bits() & CONN_BIT_DOWN;
+			work = active; // finish() changes the active list
+			for(auto pReq : work){
+				if(bWiFiLost){
+					ESP_LOGE(TAG, "WiFi unexpectedly fails!");
+					finish(pReq, eHttpRequestState::e_failed);
+				}else if(nsel > 0 && pReq->sock != -1 && FD_ISSET(pReq->sock, &rfds)){
+					on_readable(pReq);
+				}else if(nsel > 0 && pReq->sock != -1 && FD_ISSET(pReq->sock, &wfds)){
+					on_writable(pReq);
+				}else if(now - pReq->last_activity_t > pReq->TimeoutMs){
+					ESP_LOGE(TAG, "Error: Timeout happens for the request to %s!", pReq->host.c_str());
+					finish(pReq, eHttpRequestState::e_failed);
+				}
+			}
+		}
+		notify_completed();
+	}
+	// Shutdown() waits for this
+	xSemaphoreGive(stopped);
+	TaskDelete();
+}
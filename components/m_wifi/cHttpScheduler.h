@@ -0,0 +1,117 @@
+/*
+ * cHttpScheduler.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Several concurrent HTTP requests driven by one task
+ */
+
+#ifndef COMPONENTS_M_WIFI_CHTTPSCHEDULER_H_
+#define COMPONENTS_M_WIFI_CHTTPSCHEDULER_H_
+
+#include "cWiFiDevice.h"
+#include "cConnectivity.h"
+#include "../../main/common/cBaseTask.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <vector>
+#include <string>
+
+class cHttpRequest;
+
+// request events callbacks shell
+class cHttpRequestCallbacks{
+public:
+	// called from the scheduler task with the queue locked, don't call the scheduler methods from here
+	virtual void OnRequestHeaders(cHttpRequest *pReq){}
+	virtual void OnRequestData(cHttpRequest *pReq){} // body_data has grown, it may be consumed (cleared) here
+	// called once for every finished request, check State; the request may be enqueued again from here
+	virtual void OnRequestComplete(cHttpRequest *pReq){}
+	virtual ~cHttpRequestCallbacks(){}
+};
+
+enum class eHttpRequestState{e_idle, e_queued, e_connecting, e_sending, e_receiving, e_done, e_failed};
+
+// One HTTP request with its own state and response buffers.
+// The object is owned by the caller and must stay alive until OnRequestComplete() or cHttpScheduler::Cancel().
+class cHttpRequest{
+	friend class cHttpScheduler;
+public:
+	int Priority; // requests with higher priority are started first
+	uint32_t TimeoutMs; // total time allowed for waiting WiFi/connection and for data inactivity, default 25000
+	size_t MaxBodyLen; // the request fails if body_data grows above this, default 10000
+	cHttpRequestCallbacks *pCallbacks;
+	void *pOwner; // used by the owner object
+
+	eHttpRequestState State; // use it as read-only
+	int ResponseCode; // HTTP status code, 0 if unknown
+	std::string headers_data; // headers from the response
+	std::vector<uint8_t> body_data; // response body data
+
+	cHttpRequest();
+	~cHttpRequest();
+	// prepare the request, only plain http:// is supported
+	bool SetGet(const std::string &uri, const std::string &more_headers);
+	bool SetPost(const std::string &uri, const std::string &data, const std::string &more_headers);
+
+	bool IsFinished()const{return State == eHttpRequestState::e_done || State == eHttpRequestState::e_failed;}
+
+private:
+	std::string host, port, req_body;
+	int sock;
+	size_t sent; // bytes of req_body already sent
+	bool b_body_start;
+	uint32_t seq; // queue order for the requests with equal priority
+	uint32_t last_activity_t;
+
+	bool set_uri(const std::string &uri, std::string &path);
+	void reset();
+};
+
+// Request scheduler: a queue of prioritized requests, several connections are served
+// from one task with select(), the number of connections is limited in total and per host.
+// Use it instead of several cHttpClient instances to overlap requests.
+class cHttpScheduler: private cBaseTask, private cConnectivityCallbacks {
+	cMutex mux; // protects the queue
+	SemaphoreHandle_t wake; // wakes the idle task up
+	SemaphoreHandle_t stopped; // given by the task when it leaves the cycle
+	TaskHandle_t m_task;
+	volatile bool m_bStop;
+	std::vector<cHttpRequest*> queued;
+	std::vector<cHttpRequest*> active;
+	std::vector<cHttpRequest*> completed; // finished, waiting for OnRequestComplete
+	std::vector<int> closing; // sockets of the cancelled requests, closed by the task after select()
+	uint32_t seq_counter;
+public:
+	int MaxConnections; // connections in total
+	int MaxConnectionsPerHost; // connections to the same host
+
+	cHttpScheduler(int maxConnections = 4, int maxConnectionsPerHost = 2);
+	~cHttpScheduler();
+
+	// put the prepared request to the queue
+	bool Enqueue(cHttpRequest *pReq);
+	// remove the request from the queue or abort it, no callbacks are called after it returns true;
+	// false if the request is not in work or OnRequestComplete is already called for it
+	bool Cancel(cHttpRequest *pReq);
+	// abort everything and stop the task, may be called from the callbacks as well
+	void Shutdown();
+	int QueuedCount();
+	int ActiveCount();
+
+private:
+	void TaskHandler();
+	void OnStateChanged(eConnState from, eConnState to);
+	void start_queued(std::vector<cHttpRequest*> &starting, std::vector<std::string> &hosts);
+	void connect_started(const std::vector<cHttpRequest*> &starting, const std::vector<uint32_t> &addrs);
+	static uint32_t resolve(const std::string &host);
+	bool start_connect(cHttpRequest *pReq, uint32_t addr);
+	void on_writable(cHttpRequest *pReq);
+	void on_readable(cHttpRequest *pReq);
+	void finish(cHttpRequest *pReq, eHttpRequestState state);
+	void notify_completed();
+	void close_cancelled();
+	int host_connections(const std::string &host);
+};
+
+#endif /* COMPONENTS_M_WIFI_CHTTPSCHEDULER_H_ */
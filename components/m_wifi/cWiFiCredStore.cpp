@@ -0,0 +1,204 @@
+/*
+ * cWiFiCredStore.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cWiFiCredStore.h"
+
+#include <string.h>
+
+#include <esp_log.h>
+
+static const char* TAG = "cWiFiCredStore";
+
+#define CRED_LIST_VER		1
+#define CRED_MAX_STREAK		4 // penalty is not growing after this
+
+// serialization helpers
+static void put_str(std::vector<uint8_t> &buf, const std::string &s){
+	buf.push_back(s.size());
+	buf.insert(buf.end(), s.begin(), s.end());
+}
+
+static bool get_str(const std::vector<uint8_t> &buf, size_t &pos, std::string &s){
+	if(pos >= buf.size())
+		return false;
+	size_t len = buf[pos++];
+	if(pos + len > buf.size())
+		return false;
+	s.assign((const char*)&buf[pos], len);
+	pos += len;
+	return true;
+}
+
+cWiFiCredStore::cWiFiCredStore():MaxCount(8), MinRssi(-90), HistoryWeightDb(10), FailPenaltyDb(6),
+		RoamRssi(-75), RoamMarginDb(8), RoamScanIntervalMs(60000), m_lastRoamScan(0), m_bRoamScanned(false) {
+}
+
+int cWiFiCredStore::Find(const std::string &ssid)const{
+	for(size_t i = 0; i < m_creds.size(); i++){
+		if(m_creds[i].ssid == ssid)
+			return i;
+	}
+	return -1;
+}
+
+bool cWiFiCredStore::Add(const std::string &ssid, const std::string &pass){
+	if(ssid.length() < 2 || ssid.length() > 32 || pass.length() > 64){
+		ESP_LOGE(TAG, "Wrong SSID or password length");
+		return false;
+	}
+	int idx = Find(ssid);
+	if(idx >= 0){
+		if(m_creds[idx].pass != pass){
+			// new password, the old statistics is not relevant
+			m_creds[idx].pass = pass;
+			m_creds[idx].fail_count = 0;
+			m_creds[idx].fail_streak = 0;
+		}
+		return true;
+	}
+	if((int)m_creds.size() >= MaxCount){
+		ESP_LOGE(TAG, "Networks list is full");
+		return false;
+	}
+	sWiFiCred cred;
+	cred.ssid = ssid;
+	cred.pass = pass;
+	cred.ok_count = 0;
+	cred.fail_count = 0;
+	cred.fail_streak = 0;
+	m_creds.push_back(cred);
+	return true;
+}
+
+bool cWiFiCredStore::Remove(const std::string &ssid){
+	int idx = Find(ssid);
+	if(idx < 0)
+		return false;
+	m_creds.erase(m_creds.begin() + idx);
+	return true;
+}
+
+bool cWiFiCredStore::Deserialize(const std::vector<uint8_t> &data){
+	m_creds.clear();
+	if(data.size() < 2 || data[0] != CRED_LIST_VER)
+		return false;
+	size_t pos = 1;
+	int count = data[pos++];
+	for(int i = 0; i < count; i++){
+		sWiFiCred cred;
+		if(!get_str(data, pos, cred.ssid) || !get_str(data, pos, cred.pass) || pos + 5 > data.size()){
+			ESP_LOGE(TAG, "Networks list is corrupted");
+			m_creds.clear();
+			return false;
+		}
+		cred.ok_count = data[pos] | (data[pos + 1] << 8);
+		cred.fail_count = data[pos + 2] | (data[pos + 3] << 8);
+		cred.fail_streak = data[pos + 4];
+		pos += 5;
+		m_creds.push_back(cred);
+	}
+	return true;
+}
+
+void cWiFiCredStore::Serialize(std::vector<uint8_t> &data)const{
+	data.clear();
+	data.push_back(CRED_LIST_VER);
+	data.push_back(m_creds.size());
+	for(auto &cred : m_creds){
+		put_str(data, cred.ssid);
+		put_str(data, cred.pass);
+		data.push_back(cred.ok_count & 0xff);
+		data.push_back(cred.ok_count >> 8);
+		data.push_back(cred.fail_count & 0xff);
+		data.push_back(cred.fail_count >> 8);
+		data.push_back(cred.fail_streak);
+	}
+}
+
+int cWiFiCredStore::Score(int idx, int rssi)const{
+	const sWiFiCred &cred = m_creds[idx];
+	// success ratio in -1..1, unknown networks are neutral
+	int total = cred.ok_count + cred.fail_count;
+	int history = HistoryWeightDb * (cred.ok_count - cred.fail_count) / (total + 2);
+	int streak = cred.fail_streak < CRED_MAX_STREAK ? cred.fail_streak : CRED_MAX_STREAK;
+	return rssi + history - FailPenaltyDb * streak;
+}
+
+bool cWiFiCredStore::SelectBest(const std::vector<sWiFiScanItem> &scan, sWiFiSelection &res)const{
+	bool bFound = false;
+	for(auto &item : scan){
+		if(item.rssi < MinRssi)
+			continue;
+		int idx = Find(item.ssid);
+		if(idx < 0)
+			continue;
+		int score = Score(idx, item.rssi);
+		if(!bFound || score > res.score){
+			bFound = true;
+			res.ssid = item.ssid;
+			memcpy(res.bssid, item.bssid, sizeof res.bssid);
+			res.channel = item.channel;
+			res.rssi = item.rssi;
+			res.score = score;
+		}
+	}
+	return bFound;
+}
+
+bool cWiFiCredStore::NeedRoamScan(int rssi, uint32_t now){
+	if(rssi >= RoamRssi)
+		return false;
+	if(m_bRoamScanned && now - m_lastRoamScan < RoamScanIntervalMs)
+		return false;
+	m_bRoamScanned = true;
+	m_lastRoamScan = now;
+	return true;
+}
+
+bool cWiFiCredStore::ShouldRoam(int rssi, const uint8_t curBssid[6], const std::vector<sWiFiScanItem> &scan, sWiFiSelection &res)const{
+	if(rssi >= RoamRssi)
+		return false;
+	// the history is not taken into account here: the current network has just been connected successfully
+	bool bFound = false;
+	for(auto &item : scan){
+		if(memcmp(item.bssid, curBssid, 6) == 0 || item.rssi < rssi + RoamMarginDb)
+			continue;
+		int idx = Find(item.ssid);
+		if(idx < 0 || m_creds[idx].fail_streak)
+			continue;
+		if(!bFound || item.rssi > res.rssi){
+			bFound = true;
+			res.ssid = item.ssid;
+			memcpy(res.bssid, item.bssid, sizeof res.bssid);
+			res.channel = item.channel;
+			res.rssi = item.rssi;
+			res.score = Score(idx, item.rssi);
+		}
+	}
+	return bFound;
+}
+
+bool cWiFiCredStore::OnResult(int idx, bool bOk){
+	if(idx < 0 || idx >= (int)m_creds.size())
+		return false;
+	sWiFiCred &cred = m_creds[idx];
+	if(cred.ok_count == 0xffff || cred.fail_count == 0xffff){
+		// keep the ratio, forget the old history
+		cred.ok_count /= 2;
+		cred.fail_count /= 2;
+	}
+	if(bOk){
+		bool bWasFailing = cred.fail_streak != 0;
+		cred.ok_count++;
+		cred.fail_streak = 0;
+		// successes are saved from time to time only, to save the flash
+		return bWasFailing || cred.ok_count <= 8 || (cred.ok_count & 7) == 0;
+	}
+	cred.fail_count++;
+	if(cred.fail_streak < 0xff)
+		cred.fail_streak++;
+	return true;
+}
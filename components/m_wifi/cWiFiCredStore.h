@@ -0,0 +1,84 @@
+/*
+ * cWiFiCredStore.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Known networks list with connection statistics, AP ranking and roaming decisions
+ */
+
+#ifndef COMPONENTS_M_WIFI_CWIFICREDSTORE_H_
+#define COMPONENTS_M_WIFI_CWIFICREDSTORE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// known network
+struct sWiFiCred{
+	std::string ssid;
+	std::string pass;
+	uint16_t ok_count; // successful connections
+	uint16_t fail_count; // failed connections
+	uint8_t fail_streak; // failures since the last success
+};
+
+// one AP from the scan results
+struct sWiFiScanItem{
+	std::string ssid;
+	uint8_t bssid[6];
+	uint8_t channel;
+	int8_t rssi;
+};
+
+// chosen AP
+struct sWiFiSelection{
+	std::string ssid; // network of the AP, the indexes in the store change when a network is removed
+	uint8_t bssid[6];
+	uint8_t channel;
+	int rssi;
+	int score;
+};
+
+// Credentials list and AP ranking, no ESP-IDF calls here.
+// APs are ranked by RSSI corrected by the connection history of their network,
+// so the ranking can be checked with recorded scan results.
+class cWiFiCredStore {
+public:
+	int MaxCount; // max networks, default 8
+	int MinRssi; // weaker APs are ignored, default -90 dBm
+	int HistoryWeightDb; // score bonus of the network with only successful connections, default 10 dB
+	int FailPenaltyDb; // score penalty per consecutive failure (up to 4), default 6 dB
+	int RoamRssi; // look for a better AP when the RSSI is below this, default -75 dBm
+	int RoamMarginDb; // a new AP must be better by this, default 8 dB
+	uint32_t RoamScanIntervalMs; // min time between the roaming scans, default 60000
+
+	cWiFiCredStore();
+
+	// add the network or update its password, returns false if the list is full or parameters are wrong
+	bool Add(const std::string &ssid, const std::string &pass);
+	bool Remove(const std::string &ssid);
+	int Find(const std::string &ssid)const;
+	int Count()const{return m_creds.size();}
+	const sWiFiCred& Get(int i)const{return m_creds[i];}
+
+	bool Deserialize(const std::vector<uint8_t> &data);
+	void Serialize(std::vector<uint8_t> &data)const;
+
+	// ranking of the AP of the network idx
+	int Score(int idx, int rssi)const;
+	// the best known AP from the scan results
+	bool SelectBest(const std::vector<sWiFiScanItem> &scan, sWiFiSelection &res)const;
+	// whether to scan for roaming candidates now, time in ms
+	bool NeedRoamScan(int rssi, uint32_t now);
+	// whether to leave the current AP for a better one from the scan results
+	bool ShouldRoam(int rssi, const uint8_t curBssid[6], const std::vector<sWiFiScanItem> &scan, sWiFiSelection &res)const;
+	// connection result of the network idx, returns true if the list should be saved
+	bool OnResult(int idx, bool bOk);
+	bool OnResult(const std::string &ssid, bool bOk){return OnResult(Find(ssid), bOk);}
+
+private:
+	std::vector<sWiFiCred> m_creds;
+	uint32_t m_lastRoamScan;
+	bool m_bRoamScanned; // m_lastRoamScan is valid
+};
+
+#endif /* COMPONENTS_M_WIFI_CWIFICREDSTORE_H_ */
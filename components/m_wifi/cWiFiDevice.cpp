@@ -6,8 +6,11 @@
  */
 
 #include "cWiFiDevice.h"
+#include "../m_flash/cFlash.h"
+#include "../../main/common/cBaseTask.h"
 
 #include <string.h>
+#include <time.h>
 
 #include "freertos/task.h"
 #include "esp_system.h"
@@ -21,9 +24,17 @@
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
 #include "lwip/dns.h"
+#include "lwip/dhcp.h"
 
 static const char* TAG = "cWiFiDevice";
 
+#define FAST_STORAGE_NAME	"wififast"
+#define FAST_RECORD_KEY		"last"
+#define CRED_STORAGE_NAME	"wificred"
+#define CRED_LIST_KEY		"list"
+#define SCAN_MAX_AP			20
+#define POLICY_PERIOD_MS	1000 // handler() period
+
 cWiFiDevice* cWiFiDevice::pActiveInst = nullptr;
 bool cWiFiDevice::b_tcp_adapter_was_init = false;
 eWiFiState cWiFiDevice::CurrentState = eWiFiState::e_disconnected;
@@ -42,6 +53,21 @@ cWiFiDevice::cWiFiDevice():start_counter(0) {
 	ref_cnt++;
 	ConnectTryCount = 5;
 	cur_connect_try = 0;
+	bFastConnect = false;
+	m_pFastFlash = nullptr;
+	RssiPollMs = 5000;
+	last_rssi_t = 0;
+	m_lastRssi = 0;
+	m_pCredFlash = nullptr;
+	m_bCredsLoaded = false;
+	m_bMulti = false;
+	m_bGotIp = false;
+	m_bRoamScan = false;
+	m_bRoaming = false;
+	cConnectivity::Get().EventGroup(); // create the event group before any consumer can wait for it
+	m_ps = eWiFiPowerSave::e_none;
+	m_listenInterval = 3;
+	m_timer = nullptr;
 }
 
 cWiFiDevice::~cWiFiDevice() {
@@ -50,6 +76,158 @@ cWiFiDevice::~cWiFiDevice() {
 		Stop();
 		pActiveInst = nullptr;
 	}
+	if(m_timer){
+		xTimerStop(m_timer, portMAX_DELAY);
+		xTimerDelete(m_timer, portMAX_DELAY);
+	}
+	delete m_pFastFlash;
+	delete m_pCredFlash;
+}
+
+void cWiFiDevice::fast_load(){
+	if(!m_pFastFlash)
+		m_pFastFlash = new cFlash(FAST_STORAGE_NAME);
+	std::vector<uint8_t> data;
+	if(!m_pFastFlash->GetVal(FAST_RECORD_KEY, data) || !FastConnect.Deserialize(data))
+		ESP_LOGD(TAG, "No fast connect record");
+}
+
+void cWiFiDevice::fast_save(bool bErase){
+	if(!m_pFastFlash)
+		return;
+	if(bErase){
+		m_pFastFlash->Erase(FAST_RECORD_KEY);
+	}else{
+		std::vector<uint8_t> data;
+		FastConnect.Serialize(data);
+		m_pFastFlash->SetVal(FAST_RECORD_KEY, data);
+	}
+	m_pFastFlash->Commit();
+}
+
+// use the cached or static address instead of DHCP, call it after the STA interface is started
+void cWiFiDevice::fast_set_ip(){
+	if(FastConnect.NeedDhcp())
+		return;
+	const sWiFiFastRecord &rec = FastConnect.IpInfo();
+	tcpip_adapter_ip_info_t ip_info;
+	ip_info.ip.addr = rec.ip;
+	ip_info.gw.addr = rec.gw;
+	ip_info.netmask.addr = rec.mask;
+	tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+	if(tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info) != ESP_OK){
+		ESP_LOGE(TAG, "Can't set the cached IP, use DHCP");
+		tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+		return;
+	}
+	if(rec.dns){
+		ip_addr_t dns;
+		memset(&dns, 0, sizeof dns);
+		IP_SET_TYPE(&dns, IPADDR_TYPE_V4);
+		ip_2_ip4(&dns)->addr = rec.dns;
+		dns_setserver(0, &dns);
+	}
+}
+
+// the cached address has reached T1, get it renewed by DHCP (the client asks the server for the same address)
+void cWiFiDevice::fast_renew(){
+	if(!FastConnect.NeedRenew(time(nullptr)))
+		return;
+	FastConnect.OnRenew();
+	tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+}
+
+// lease time offered by the DHCP server (option 51), 0 if the address is not from DHCP
+static uint32_t dhcp_lease_sec(){
+	struct netif *netif = nullptr;
+	if(tcpip_adapter_get_netif(TCPIP_ADAPTER_IF_STA, (void**)&netif) != ESP_OK || !netif)
+		return 0;
+	struct dhcp *dhcp = netif_dhcp_data(netif);
+	return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+void cWiFiDevice::apply_ps(eWiFiPowerSave ps){
+	static const wifi_ps_type_t ps_types[] = {WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM};
+	m_ps = ps;
+	if(CurrentState == eWiFiState::e_disconnected || CurrentState == eWiFiState::e_failed)
+		return; // applied on Start()
+	ESP_LOGD(TAG, "Power save %d", (int)ps);
+	esp_wifi_set_ps(ps_types[(int)ps]);
+}
+
+void cWiFiDevice::SetPowerSave(eWiFiPowerSave ps, uint8_t listenInterval){
+	if(listenInterval != m_listenInterval && CurrentState != eWiFiState::e_disconnected && CurrentState != eWiFiState::e_failed){
+		wifi_config_t wifi_config;
+		esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config);
+		wifi_config.sta.listen_interval = listenInterval;
+		esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+	}
+	m_listenInterval = listenInterval;
+	cAutoLock lock(m_psLock);
+	PowerPolicy.ActiveProfile = ps;
+	PowerPolicy.Reset(cBaseTask::GetTickCount());
+	apply_ps(ps);
+}
+
+void cWiFiDevice::timer_handler(TimerHandle_t timer){
+	((cWiFiDevice*)pvTimerGetTimerID(timer))->handler();
+}
+
+void cWiFiDevice::handler(){
+	if(CurrentState != eWiFiState::e_connected)
+		return;
+	uint32_t now = cBaseTask::GetTickCount();
+	m_psLock.Lock();
+	if(PowerPolicy.Update(now))
+		apply_ps(PowerPolicy.Profile());
+	m_psLock.Unlock();
+	if(fast_on()){
+		cAutoLock lock(m_fastLock);
+		fast_renew();
+	}
+	if(RssiPollMs && now - last_rssi_t >= RssiPollMs){
+		last_rssi_t = now;
+		wifi_ap_record_t ap_info;
+		if(esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK){
+			cConnectivity::Get().Post(eConnEvent::e_rssi, ap_info.rssi);
+			// look for a better AP in background
+			cAutoLock lock(m_credLock);
+			m_lastRssi = ap_info.rssi;
+			if(m_bMulti && !m_bRoaming && Creds.NeedRoamScan(ap_info.rssi, now))
+				scan(true);
+		}
+	}
+}
+
+void cWiFiDevice::NotifyTraffic(){
+	cWiFiDevice *pInst = pActiveInst;
+	if(!pInst)
+		return;
+	cAutoLock lock(pInst->m_psLock);
+	if(pInst->PowerPolicy.OnTraffic(cBaseTask::GetTickCount()))
+		pInst->apply_ps(pInst->PowerPolicy.Profile());
+}
+
+void cWiFiDevice::NotifyAlarm(){
+	cWiFiDevice *pInst = pActiveInst;
+	if(!pInst)
+		return;
+	cAutoLock lock(pInst->m_psLock);
+	if(pInst->PowerPolicy.OnAlarm(cBaseTask::GetTickCount()))
+		pInst->apply_ps(pInst->PowerPolicy.Profile());
+}
+
+// the cached AP is not reachable, forget it and connect as usual
+void cWiFiDevice::fast_fallback(){
+	fast_save(true);
+	wifi_config_t wifi_config;
+	esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config);
+	wifi_config.sta.channel = 0;
+	wifi_config.sta.bssid_set = false;
+	esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+	if(FastConnect.NeedDhcp())
+		tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+	cur_connect_try = 1;
 }
 
 
@@ -58,6 +236,165 @@ bool cWiFiDevice::IsConnectionFinished(){
 }
 
 
+void cWiFiDevice::creds_load(){
+	if(m_bCredsLoaded)
+		return;
+	m_bCredsLoaded = true;
+	if(!m_pCredFlash)
+		m_pCredFlash = new cFlash(CRED_STORAGE_NAME);
+	std::vector<uint8_t> data;
+	if(!m_pCredFlash->GetVal(CRED_LIST_KEY, data) || !Creds.Deserialize(data))
+		ESP_LOGD(TAG, "No known networks stored");
+}
+
+void cWiFiDevice::creds_save(){
+	if(!m_pCredFlash)
+		return;
+	std::vector<uint8_t> data;
+	Creds.Serialize(data);
+	m_pCredFlash->SetVal(CRED_LIST_KEY, data);
+	m_pCredFlash->Commit();
+}
+
+bool cWiFiDevice::AddNetwork(const std::string &ssid, const std::string &pass){
+	cAutoLock lock(m_credLock);
+	creds_load();
+	if(!Creds.Add(ssid, pass))
+		return false;
+	creds_save();
+	return true;
+}
+
+bool cWiFiDevice::RemoveNetwork(const std::string &ssid){
+	cAutoLock lock(m_credLock);
+	creds_load();
+	if(!Creds.Remove(ssid))
+		return false;
+	creds_save();
+	return true;
+}
+
+void cWiFiDevice::scan(bool bRoam){
+	m_bRoamScan = bRoam;
+	if(esp_wifi_scan_start(nullptr, false) != ESP_OK){
+		ESP_LOGE(TAG, "Can't start the scan");
+		m_bRoamScan = false;
+	}
+}
+
+// returns false if the network has been removed since the selection
+bool cWiFiDevice::apply_selection(const sWiFiSelection &sel){
+	int idx = Creds.Find(sel.ssid);
+	if(idx < 0)
+		return false;
+	const sWiFiCred &cred = Creds.Get(idx);
+	wifi_config_t wifi_config;
+	memset(&wifi_config, 0, sizeof(wifi_config));
+	strncpy((char*)wifi_config.sta.ssid, cred.ssid.c_str(), sizeof(wifi_config.sta.ssid));
+	strncpy((char*)wifi_config.sta.password, cred.pass.c_str(), sizeof(wifi_config.sta.password));
+	wifi_config.sta.listen_interval = m_listenInterval;
+	wifi_config.sta.channel = sel.channel;
+	wifi_config.sta.bssid_set = true;
+	memcpy(wifi_config.sta.bssid, sel.bssid, sizeof sel.bssid);
+	esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+	m_curSsid = cred.ssid;
+	memcpy(m_curBssid, sel.bssid, sizeof m_curBssid);
+	m_bGotIp = false;
+	ESP_LOGD(TAG, "Connecting to %s channel %d, RSSI %d", cred.ssid.c_str(), sel.channel, sel.rssi);
+	return true;
+}
+
+// connect to the best AP from the last scan
+bool cWiFiDevice::connect_best(){
+	sWiFiSelection sel;
+	if(!Creds.SelectBest(m_scan, sel) || !apply_selection(sel)){
+		ESP_LOGD(TAG, "No known AP found");
+		return false;
+	}
+	esp_wifi_connect();
+	return true;
+}
+
+void cWiFiDevice::on_scan_done(){
+	uint16_t n(0);
+	esp_wifi_scan_get_ap_num(&n);
+	if(n > SCAN_MAX_AP)
+		n = SCAN_MAX_AP;
+	std::vector<wifi_ap_record_t> recs(n);
+	if(n && esp_wifi_scan_get_ap_records(&n, &recs[0]) != ESP_OK)
+		n = 0;
+	// the subscribers may call AddNetwork(), the state is posted without the lock
+	bool bDown(false);
+	{
+		cAutoLock lock(m_credLock);
+		m_scan.clear();
+		for(int i = 0; i < n; i++){
+			sWiFiScanItem item;
+			item.ssid = (const char*)recs[i].ssid;
+			memcpy(item.bssid, recs[i].bssid, sizeof item.bssid);
+			item.channel = recs[i].primary;
+			item.rssi = recs[i].rssi;
+			m_scan.push_back(item);
+		}
+
+		if(m_bRoamScan){
+			m_bRoamScan = false;
+			if(CurrentState == eWiFiState::e_connected && Creds.ShouldRoam(m_lastRssi, m_curBssid, m_scan, m_roamSel)){
+				ESP_LOGI(TAG, "Roaming to %s, RSSI %d -> %d", m_roamSel.ssid.c_str(), m_lastRssi, m_roamSel.rssi);
+				m_bRoaming = true;
+				esp_wifi_disconnect(); // see multi_disconnected()
+			}
+			return;
+		}
+		if(CurrentState != eWiFiState::e_busy)
+			return; // stopped meanwhile
+		if(connect_best())
+			return;
+		if(cur_connect_try > ConnectTryCount){
+			CurrentState = eWiFiState::e_disconnected;
+			bDown = true;
+		}else{
+			cur_connect_try ++;
+			scan(false);
+		}
+	}
+	if(bDown)
+		cConnectivity::Get().Post(eConnEvent::e_down);
+}
+
+void cWiFiDevice::multi_disconnected(){
+	eConnEvent ev = eConnEvent::e_link_lost;
+	{
+		cAutoLock lock(m_credLock);
+		bool bRoam = m_bRoaming;
+		m_bRoaming = false;
+		if(CurrentState == eWiFiState::e_disconnected){
+			ev = eConnEvent::e_down;
+		}else if(bRoam && apply_selection(m_roamSel)){
+			// planned disconnection, go to the chosen AP
+			esp_wifi_connect();
+			CurrentState = eWiFiState::e_busy;
+		}else{
+			// also when the roaming target has been removed meanwhile
+			bool bWasOnline = m_bGotIp;
+			if(!bWasOnline && Creds.OnResult(m_curSsid, false))
+				creds_save();
+			if(cur_connect_try > ConnectTryCount){
+				CurrentState = eWiFiState::e_disconnected;
+				ev = eConnEvent::e_down;
+			}else{
+				cur_connect_try ++;
+				// the failed network has got a penalty, so the next best AP may be chosen from the same scan;
+				// the lost link is looked for again
+				if(bWasOnline || !connect_best())
+					scan(false);
+				CurrentState = eWiFiState::e_busy;
+			}
+		}
+	}
+	cConnectivity::Get().Post(ev);
+}
+
 // Initialize and start STA (client)
 void cWiFiDevice::Start(const char* ssid, const char* pass){
 	if(CurrentState == eWiFiState::e_connected || CurrentState == eWiFiState::e_busy){
@@ -65,6 +402,36 @@ void cWiFiDevice::Start(const char* ssid, const char* pass){
 		ESP_LOGD(TAG, "WiFi is busy or already connected");
 		return;
 	}
+	m_bMulti = false;
+	start_sta(ssid, pass);
+}
+
+bool cWiFiDevice::StartBest(){
+	if(CurrentState == eWiFiState::e_connected || CurrentState == eWiFiState::e_busy){
+		ESP_LOGD(TAG, "WiFi is busy or already connected");
+		return true;
+	}
+	std::string ssid, pass;
+	{
+		cAutoLock lock(m_credLock);
+		creds_load();
+		if(!Creds.Count()){
+			ESP_LOGE(TAG, "No known networks");
+			return false;
+		}
+		m_bMulti = true;
+		m_curSsid.clear();
+		m_bRoamScan = false;
+		m_bRoaming = false;
+		ssid = Creds.Get(0).ssid;
+		pass = Creds.Get(0).pass;
+	}
+	// the configuration is replaced after the scan
+	start_sta(ssid.c_str(), pass.c_str());
+	return true;
+}
+
+void cWiFiDevice::start_sta(const char* ssid, const char* pass){
 	if(CurrentState != eWiFiState::e_disconnected)
 		Stop(); // restart
 
@@ -73,10 +440,12 @@ void cWiFiDevice::Start(const char* ssid, const char* pass){
 		ESP_LOGE(TAG, "WiFi SSID %s is too short", ssid);
 		CurrentState = eWiFiState::e_failed;
 		cur_connect_try = 100;
+		cConnectivity::Get().Post(eConnEvent::e_fail);
 		return;
 	}
 
 	CurrentState = eWiFiState::e_busy;
+	cConnectivity::Get().Post(eConnEvent::e_start);
 	ESP_LOGD(TAG, ">> Start");
 
 	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
@@ -87,13 +456,34 @@ void cWiFiDevice::Start(const char* ssid, const char* pass){
 	memset(&wifi_config, 0, sizeof(wifi_config));
 	strcpy((char*)wifi_config.sta.ssid, ssid);
 	strcpy((char*)wifi_config.sta.password, pass);
+	wifi_config.sta.listen_interval = m_listenInterval;
+	if(fast_on()){
+		cAutoLock lock(m_fastLock);
+		fast_load();
+		if(FastConnect.Plan(ssid, time(nullptr)) != eWiFiConnectMode::e_full){
+			// connect to the known AP directly, without scanning all channels
+			const sWiFiFastRecord &rec = FastConnect.Radio();
+			wifi_config.sta.channel = rec.channel;
+			wifi_config.sta.bssid_set = true;
+			memcpy(wifi_config.sta.bssid, rec.bssid, sizeof rec.bssid);
+		}
+	}
 
 	ESP_LOGI(TAG, "Setting WiFi configuration SSID %s PASS %s", wifi_config.sta.ssid, wifi_config.sta.password);
 	ESP_ERROR_CHECK( esp_wifi_set_mode(WIFI_MODE_STA) );
 	ESP_ERROR_CHECK( esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config) );
 	ESP_ERROR_CHECK(tcpip_adapter_set_hostname(TCPIP_ADAPTER_IF_STA, "SmartRing")); // Reza: Change IPv4/IPv6 hostname to LivySmartRing
 	ESP_ERROR_CHECK( esp_wifi_start() );
-	esp_wifi_set_ps(WIFI_PS_NONE); // set power saving mode
+	// set power saving mode, the policy starts from the active profile
+	m_psLock.Lock();
+	PowerPolicy.Reset(cBaseTask::GetTickCount());
+	apply_ps(PowerPolicy.ActiveProfile);
+	m_psLock.Unlock();
+	if(!m_timer){
+		m_timer = xTimerCreate("WiFi policy", POLICY_PERIOD_MS / portTICK_PERIOD_MS, pdTRUE, this, timer_handler);
+		if(m_timer)
+			xTimerStart(m_timer, 0);
+	}
 	ESP_LOGD(TAG, "<< Start");
 	cur_connect_try = 1;
 }
@@ -102,6 +492,7 @@ void cWiFiDevice::Start(const char* ssid, const char* pass){
 void cWiFiDevice::Stop(){
 	// cleanup
 	CurrentState = eWiFiState::e_disconnected;
+	cConnectivity::Get().Post(eConnEvent::e_down);
 	//ESP_ERROR_CHECK( esp_wifi_set_mode(WIFI_MODE_NULL) );
 	ESP_ERROR_CHECK(esp_wifi_stop());
 	//ESP_ERROR_CHECK(esp_wifi_deinit());
@@ -112,22 +503,80 @@ esp_err_t cWiFiDevice::event_handler(void *ctx, system_event_t *event)
 	switch(event->event_id) {
 	case SYSTEM_EVENT_STA_START:
 		ESP_ERROR_CHECK(tcpip_adapter_set_hostname(TCPIP_ADAPTER_IF_STA, "SmartRing")); // Reza: Change DNS name to SmartRing. Currently the DNS name is espressif
-		esp_wifi_connect();
+		if(fast_on()){
+			cAutoLock lock(m_fastLock);
+			fast_set_ip();
+		}
+		if(m_bMulti){
+			cAutoLock lock(m_credLock);
+			scan(false); // choose the AP
+		}else{
+			esp_wifi_connect();
+		}
+		break;
+	case SYSTEM_EVENT_SCAN_DONE:
+		if(m_bMulti)
+			on_scan_done();
+		break;
+	case SYSTEM_EVENT_STA_CONNECTED:
+		if(fast_on()){
+			cAutoLock lock(m_fastLock);
+			FastConnect.OnConnected(event->event_info.connected.channel, event->event_info.connected.bssid);
+		}
+		cConnectivity::Get().Post(eConnEvent::e_link_up);
 		break;
 	case SYSTEM_EVENT_STA_GOT_IP:
 		CurrentState = eWiFiState::e_connected;
+		last_rssi_t = 0;
+		cConnectivity::Get().Post(eConnEvent::e_got_ip);
+		if(m_bMulti){
+			cAutoLock lock(m_credLock);
+			m_bGotIp = true;
+			cur_connect_try = 1;
+			if(Creds.OnResult(m_curSsid, true))
+				creds_save();
+		}
+		if(fast_on()){
+			cAutoLock lock(m_fastLock);
+			const tcpip_adapter_ip_info_t &ip_info = event->event_info.got_ip.ip_info;
+			const ip_addr_t *dns = dns_getserver(0);
+			uint32_t lease = FastConnect.NeedDhcp() ? dhcp_lease_sec() : 0;
+			if(FastConnect.OnGotIp(ip_info.ip.addr, ip_info.gw.addr, ip_info.netmask.addr, dns ? ip_2_ip4(dns)->addr : 0, lease, time(nullptr)))
+				fast_save();
+			fast_renew();
+		}
+		break;
+	case SYSTEM_EVENT_STA_LOST_IP:
+		// the link is alive, DHCP will acquire the address again
+		if(CurrentState == eWiFiState::e_connected)
+			CurrentState = eWiFiState::e_busy;
+		cConnectivity::Get().Post(eConnEvent::e_lost_ip);
 		break;
-	case SYSTEM_EVENT_STA_DISCONNECTED:
+	case SYSTEM_EVENT_STA_DISCONNECTED:{
+		if(m_bMulti){
+			multi_disconnected();
+			break;
+		}
 		// try to reconnect automatically
-		if(cur_connect_try <= ConnectTryCount && CurrentState != eWiFiState::e_disconnected){
+		eWiFiFastAction action = cur_connect_try <= ConnectTryCount ? eWiFiFastAction::e_retry : eWiFiFastAction::e_give_up;
+		if(fast_on() && CurrentState != eWiFiState::e_disconnected){
+			cAutoLock lock(m_fastLock);
+			action = FastConnect.OnDisconnected(cur_connect_try, ConnectTryCount);
+			if(action == eWiFiFastAction::e_fallback_full)
+				fast_fallback();
+		}
+		if(action != eWiFiFastAction::e_give_up && CurrentState != eWiFiState::e_disconnected){
 			cur_connect_try ++;
 			esp_wifi_connect();
 			CurrentState = eWiFiState::e_busy;
+			cConnectivity::Get().Post(eConnEvent::e_link_lost);
 		}
 		else{
 			CurrentState = eWiFiState::e_disconnected;
+			cConnectivity::Get().Post(eConnEvent::e_down);
 		}
 		break;
+	}
 	default:
 		break;
 	}
@@ -10,8 +10,16 @@
 #define COMPONENTS_M_WIFI_CWIFIDEVICE_H_
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/timers.h"
 #include "esp_event_loop.h"
 #include "esp_err.h"
+#include "cWiFiFastConnect.h"
+#include "cWiFiPowerPolicy.h"
+#include "cConnectivity.h"
+#include "cWiFiCredStore.h"
+#include "../../main/common/cBaseTask.h"
+
+class cFlash;
 
 enum class eWiFiState{e_disconnected, e_busy, e_connected, e_failed};
 
@@ -23,17 +31,77 @@ class cWiFiDevice {
 	int cur_connect_try;
 public:
 	int ConnectTryCount; // how many attempts to connect is allowed, default is 3
-	static eWiFiState CurrentState; // check this to discover how our device is feeling itself
+	static eWiFiState CurrentState; // kept for compatibility, wait for cConnectivity bits instead of polling it
+	bool bFastConnect; // reconnect with the saved channel, BSSID and IP lease (no scan, DHCP only to renew the lease), default is false
+	cWiFiFastConnect FastConnect; // fast connect settings (static IP, lease time)
+	cWiFiPowerPolicy PowerPolicy; // automatic power save switching, set PowerPolicy.bEnabled before Start() to use it
+	uint32_t RssiPollMs; // link quality check period for cConnectivity and roaming, 0 to disable, default 5000
+	cWiFiCredStore Creds; // known networks for StartBest(), use AddNetwork() / RemoveNetwork() to change the stored list
 	cWiFiDevice();
 	~cWiFiDevice();
 	// Initialize and start STA (client)
 	void Start(const char* ssid, const char * pass);
+	// Initialize and start STA with the best known network from a scan, roam to a better AP when the signal is weak
+	bool StartBest();
+	// stored known networks list
+	bool AddNetwork(const std::string &ssid, const std::string &pass);
+	bool RemoveNetwork(const std::string &ssid);
 	// stop WiFi processing and the device
 	void Stop();
 
 	bool IsConnectionFinished();
 
+	// select the power save profile, listenInterval (in AP beacon intervals) is used by e_max_modem
+	// and takes effect on the next association; with PowerPolicy enabled this is the active profile
+	void SetPowerSave(eWiFiPowerSave ps, uint8_t listenInterval = 3);
+	eWiFiPowerSave GetPowerSave()const{return m_ps;}
+	// Report network activity / an alarm to return to the full power at once, can be called from any task.
+	// Call NotifyTraffic() before every transfer (request, publish, connect): with the idle profile
+	// the radio sleeps between the beacons and the first packets would wait for the wakeup.
+	static void NotifyTraffic();
+	static void NotifyAlarm();
+
 private:
+	cFlash *m_pFastFlash; // fast connect record storage
+	cMutex m_fastLock; // FastConnect and its record, the timer renews the lease while the events change them
+	eWiFiPowerSave m_ps; // applied power save profile
+	uint8_t m_listenInterval;
+	cMutex m_psLock; // PowerPolicy and m_ps, they are changed from the timer and the Notify*() callers
+	TimerHandle_t m_timer; // runs handler()
+	uint32_t last_rssi_t; // last link quality check
+	int m_lastRssi;
+	// multi network mode
+	cMutex m_credLock; // Creds and the state below, used by the timer, the events and the AddNetwork() callers
+	cFlash *m_pCredFlash; // known networks storage
+	bool m_bCredsLoaded;
+	bool m_bMulti; // started by StartBest()
+	std::string m_curSsid; // current network, an index in Creds is not stable
+	uint8_t m_curBssid[6];
+	bool m_bGotIp; // the current connection has got IP
+	bool m_bRoamScan; // the running scan looks for roaming candidates
+	bool m_bRoaming; // disconnected to roam to m_roamSel
+	sWiFiSelection m_roamSel;
+	std::vector<sWiFiScanItem> m_scan; // last scan results
+	void apply_ps(eWiFiPowerSave ps); // under m_psLock
+	// applies the automatic power policy and tracks the link quality
+	void handler();
+	static void timer_handler(TimerHandle_t timer);
+	// fast_*() are called under m_fastLock
+	void fast_load();
+	void fast_save(bool bErase = false);
+	void fast_set_ip();
+	void fast_renew();
+	void fast_fallback();
+	bool fast_on()const{return bFastConnect && !m_bMulti;}
+	void start_sta(const char* ssid, const char * pass);
+	// creds_*(), scan(), connect_best() and apply_selection() are called under m_credLock
+	void creds_load();
+	void creds_save();
+	void scan(bool bRoam);
+	void on_scan_done();
+	bool connect_best();
+	bool apply_selection(const sWiFiSelection &sel);
+	void multi_disconnected();
 	esp_err_t event_handler(void *ctx, system_event_t *event);
 	static esp_err_t event_handler_stub(void *ctx, system_event_t *event){
 		if(pActiveInst)
@@ -0,0 +1,177 @@
+/*
+ * cWiFiFastConnect.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cWiFiFastConnect.h"
+#include "../../main/common/fnv1a.h"
+
+#include <string.h>
+
+#include <esp_log.h>
+
+static const char* TAG = "cWiFiFastConnect";
+
+#define FAST_RECORD_VER		2
+#define FAST_RECORD_LEN		36
+
+// serialization helpers
+static void put_u32(std::vector<uint8_t> &buf, uint32_t v){
+	for(int i = 0; i < 4; i++)
+		buf.push_back((v >> (8 * i)) & 0xff);
+}
+
+static uint32_t get_u32(const uint8_t *p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+cWiFiFastConnect::cWiFiFastConnect():LeaseValidSec(12 * 3600), FastTryCount(1),
+		m_mode(eWiFiConnectMode::e_full), m_ssidHash(0), m_fastTries(0), m_connected(false), m_radioChanged(false) {
+	memset(&m_rec, 0, sizeof m_rec);
+	memset(&m_staticIp, 0, sizeof m_staticIp);
+}
+
+uint32_t cWiFiFastConnect::SsidHash(const std::string &ssid){
+	return fnv1a(ssid.data(), ssid.size());
+}
+
+void cWiFiFastConnect::SetStaticIp(uint32_t ip, uint32_t gw, uint32_t mask, uint32_t dns){
+	m_staticIp.ip = ip;
+	m_staticIp.gw = gw;
+	m_staticIp.mask = mask;
+	m_staticIp.dns = dns;
+}
+
+void cWiFiFastConnect::Invalidate(){
+	memset(&m_rec, 0, sizeof m_rec);
+}
+
+bool cWiFiFastConnect::Deserialize(const std::vector<uint8_t> &data){
+	Invalidate();
+	if(data.size() != FAST_RECORD_LEN || data[0] != FAST_RECORD_VER)
+		return false;
+	const uint8_t *p = &data[1];
+	m_rec.ssid_hash = get_u32(p); p += 4;
+	m_rec.channel = *p++;
+	memcpy(m_rec.bssid, p, 6); p += 6;
+	m_rec.ip = get_u32(p); p += 4;
+	m_rec.gw = get_u32(p); p += 4;
+	m_rec.mask = get_u32(p); p += 4;
+	m_rec.dns = get_u32(p); p += 4;
+	m_rec.saved_t = get_u32(p); p += 4;
+	m_rec.lease_sec = get_u32(p);
+	if(m_rec.channel < 1 || m_rec.channel > 14){
+		Invalidate();
+		return false;
+	}
+	return true;
+}
+
+void cWiFiFastConnect::Serialize(std::vector<uint8_t> &data)const{
+	data.clear();
+	data.push_back(FAST_RECORD_VER);
+	put_u32(data, m_rec.ssid_hash);
+	data.push_back(m_rec.channel);
+	data.insert(data.end(), m_rec.bssid, m_rec.bssid + 6);
+	put_u32(data, m_rec.ip);
+	put_u32(data, m_rec.gw);
+	put_u32(data, m_rec.mask);
+	put_u32(data, m_rec.dns);
+	put_u32(data, m_rec.saved_t);
+	put_u32(data, m_rec.lease_sec);
+}
+
+// the client renews the lease at T1, so the server keeps the address for us at least till then
+uint32_t cWiFiFastConnect::reuse_sec()const{
+	if(m_rec.lease_sec && m_rec.lease_sec / 2 < LeaseValidSec)
+		return m_rec.lease_sec / 2;
+	return LeaseValidSec;
+}
+
+// the clock may be not set after a power loss, so a lease from the "future" is not valid too
+bool cWiFiFastConnect::lease_valid(uint32_t now)const{
+	return m_rec.ip && m_rec.saved_t && now >= m_rec.saved_t && now - m_rec.saved_t < reuse_sec();
+}
+
+eWiFiConnectMode cWiFiFastConnect::Plan(const std::string &ssid, uint32_t now){
+	m_ssidHash = SsidHash(ssid);
+	m_fastTries = 0;
+	m_connected = false;
+	bool bRadio = m_rec.channel && m_rec.ssid_hash == m_ssidHash;
+	bool bLease = bRadio && lease_valid(now);
+	if(!bRadio)
+		m_mode = eWiFiConnectMode::e_full;
+	else if(bLease || IsStaticIp())
+		m_mode = eWiFiConnectMode::e_fast;
+	else
+		m_mode = eWiFiConnectMode::e_fast_dhcp;
+	ESP_LOGD(TAG, "Plan: mode %d, channel %d", (int)m_mode, m_rec.channel);
+	return m_mode;
+}
+
+void cWiFiFastConnect::OnConnected(uint8_t channel, const uint8_t bssid[6]){
+	m_connected = true;
+	if(m_rec.ssid_hash != m_ssidHash || m_rec.channel != channel || memcmp(m_rec.bssid, bssid, 6) != 0)
+		m_radioChanged = true;
+	if(m_rec.ssid_hash != m_ssidHash || memcmp(m_rec.bssid, bssid, 6) != 0){
+		// another network or AP, the old lease is not applicable
+		m_rec.ip = 0;
+		m_rec.saved_t = 0;
+		m_rec.lease_sec = 0;
+	}
+	m_rec.ssid_hash = m_ssidHash;
+	m_rec.channel = channel;
+	memcpy(m_rec.bssid, bssid, 6);
+}
+
+bool cWiFiFastConnect::NeedRenew(uint32_t now)const{
+	return m_mode == eWiFiConnectMode::e_fast && !IsStaticIp() && !lease_valid(now);
+}
+
+void cWiFiFastConnect::OnRenew(){
+	ESP_LOGD(TAG, "Cached lease at T1, renew it by DHCP");
+	m_mode = eWiFiConnectMode::e_fast_dhcp;
+}
+
+bool cWiFiFastConnect::OnGotIp(uint32_t ip, uint32_t gw, uint32_t mask, uint32_t dns, uint32_t leaseSec, uint32_t now){
+	std::vector<uint8_t> before;
+	Serialize(before);
+	if(IsStaticIp()){
+		// nothing to cache except the radio parameters
+		m_rec.ip = 0;
+		m_rec.saved_t = 0;
+		m_rec.lease_sec = 0;
+	}else if(NeedDhcp()){
+		// a fresh lease; don't rewrite the flash on every wakeup while the old lease is young,
+		// an older saved_t only makes the reuse shorter
+		bool bSame = m_rec.ip == ip && m_rec.gw == gw && m_rec.mask == mask && m_rec.dns == dns && m_rec.lease_sec == leaseSec;
+		m_rec.lease_sec = leaseSec;
+		if(!bSame || !m_rec.saved_t || now < m_rec.saved_t || now - m_rec.saved_t > reuse_sec() / 2)
+			m_rec.saved_t = now;
+		m_rec.ip = ip;
+		m_rec.gw = gw;
+		m_rec.mask = mask;
+		m_rec.dns = dns;
+	}
+	// the cached lease is reused as is, its time is renewed by DHCP at T1 (see NeedRenew())
+	std::vector<uint8_t> after;
+	Serialize(after);
+	bool bChanged = m_radioChanged || before != after;
+	m_radioChanged = false;
+	return bChanged;
+}
+
+eWiFiFastAction cWiFiFastConnect::OnDisconnected(int tryNum, int maxTries){
+	if(m_mode != eWiFiConnectMode::e_full && !m_connected){
+		// the AP is not reachable with the cached parameters
+		if(++m_fastTries >= FastTryCount){
+			ESP_LOGD(TAG, "Fast connect failed, fallback to the full scan");
+			Invalidate();
+			m_mode = eWiFiConnectMode::e_full;
+			return eWiFiFastAction::e_fallback_full;
+		}
+		return eWiFiFastAction::e_retry;
+	}
+	return tryNum <= maxTries ? eWiFiFastAction::e_retry : eWiFiFastAction::e_give_up;
+}
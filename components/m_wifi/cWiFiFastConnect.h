@@ -0,0 +1,89 @@
+/*
+ * cWiFiFastConnect.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  Fast reconnect decisions: cached channel, BSSID and IP lease of the last AP
+ */
+
+#ifndef COMPONENTS_M_WIFI_CWIFIFASTCONNECT_H_
+#define COMPONENTS_M_WIFI_CWIFIFASTCONNECT_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// how to connect
+enum class eWiFiConnectMode{
+	e_full, // scan all channels, DHCP
+	e_fast_dhcp, // known channel and BSSID, DHCP
+	e_fast // known channel and BSSID, cached (or static) IP without DHCP until the cached lease reaches T1
+};
+
+// what to do after a disconnection
+enum class eWiFiFastAction{e_retry, e_fallback_full, e_give_up};
+
+// last successful connection parameters, IP addresses are in network byte order (as in tcpip_adapter)
+struct sWiFiFastRecord{
+	uint32_t ssid_hash; // record belongs to this SSID
+	uint8_t channel;
+	uint8_t bssid[6];
+	uint32_t ip, gw, mask, dns;
+	uint32_t saved_t; // time() of the lease, 0 if no lease is stored
+	uint32_t lease_sec; // lease time offered by the DHCP server (option 51), 0 if unknown
+};
+
+// Decision logic of the fast connect mode, no ESP-IDF calls here.
+// The owner feeds the WiFi events in and executes the returned decisions,
+// so the logic can be driven by a simulated event source as well.
+class cWiFiFastConnect {
+public:
+	// cached IP is reused until T1 (a half of the offered lease) and never longer than this, default 12 h
+	uint32_t LeaseValidSec;
+	int FastTryCount; // attempts with the cached parameters before the full scan, default 1
+
+	cWiFiFastConnect();
+
+	// use this address instead of DHCP, pass ip = 0 to return to DHCP
+	void SetStaticIp(uint32_t ip, uint32_t gw, uint32_t mask, uint32_t dns);
+	bool IsStaticIp()const{return m_staticIp.ip != 0;}
+
+	// restore the saved record, returns false if it is malformed
+	bool Deserialize(const std::vector<uint8_t> &data);
+	void Serialize(std::vector<uint8_t> &data)const;
+	void Invalidate();
+
+	// choose the connect mode for the SSID at the time now (seconds)
+	eWiFiConnectMode Plan(const std::string &ssid, uint32_t now);
+	eWiFiConnectMode Mode()const{return m_mode;}
+	// channel and BSSID for the planned connection
+	const sWiFiFastRecord& Radio()const{return m_rec;}
+	// address to set when DHCP is not needed
+	const sWiFiFastRecord& IpInfo()const{return IsStaticIp() ? m_staticIp : m_rec;}
+	bool NeedDhcp()const{return !IsStaticIp() && m_mode != eWiFiConnectMode::e_fast;}
+	// the cached lease has reached T1 and should be renewed by DHCP, the owner starts it and calls OnRenew()
+	bool NeedRenew(uint32_t now)const;
+	void OnRenew();
+
+	// events
+	void OnConnected(uint8_t channel, const uint8_t bssid[6]);
+	// leaseSec is the offered lease time, 0 if unknown; returns true if the record has changed and should be saved
+	bool OnGotIp(uint32_t ip, uint32_t gw, uint32_t mask, uint32_t dns, uint32_t leaseSec, uint32_t now);
+	// tryNum is the number of attempts made so far, the owner should forget the saved record on e_fallback_full
+	eWiFiFastAction OnDisconnected(int tryNum, int maxTries);
+
+	static uint32_t SsidHash(const std::string &ssid);
+
+private:
+	sWiFiFastRecord m_rec; // cached record
+	sWiFiFastRecord m_staticIp; // static IP configuration
+	eWiFiConnectMode m_mode;
+	uint32_t m_ssidHash;
+	int m_fastTries;
+	bool m_connected; // the current attempt has reached the AP at least once
+	bool m_radioChanged; // by OnConnected(), not saved yet
+
+	uint32_t reuse_sec()const;
+	bool lease_valid(uint32_t now)const;
+};
+
+#endif /* COMPONENTS_M_WIFI_CWIFIFASTCONNECT_H_ */
@@ -0,0 +1,50 @@
+/*
+ * cWiFiPowerPolicy.cpp
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ */
+
+#include "cWiFiPowerPolicy.h"
+
+cWiFiPowerPolicy::cWiFiPowerPolicy():bEnabled(false), ActiveProfile(eWiFiPowerSave::e_none), IdleProfile(eWiFiPowerSave::e_max_modem),
+		IdleTimeoutMs(5000), AlarmHoldMs(60000),
+		m_current(eWiFiPowerSave::e_none), m_trafficT(0), m_alarmT(0), m_bAlarm(false), m_switches(0) {
+}
+
+void cWiFiPowerPolicy::Reset(uint32_t now){
+	m_current = ActiveProfile;
+	m_trafficT = now;
+	m_bAlarm = false;
+}
+
+bool cWiFiPowerPolicy::Update(uint32_t now){
+	eWiFiPowerSave want = ActiveProfile;
+	if(bEnabled){
+		// unsigned differences are safe for the tick counter overflow
+		bool bAlarm = m_bAlarm && now - m_alarmT < AlarmHoldMs;
+		if(m_bAlarm && !bAlarm)
+			m_bAlarm = false;
+		if(!bAlarm && now - m_trafficT >= IdleTimeoutMs)
+			want = IdleProfile;
+	}
+	if(want == m_current)
+		return false;
+	m_current = want;
+	m_switches++;
+	return true;
+}
+
+bool cWiFiPowerPolicy::OnTraffic(uint32_t now){
+	m_trafficT = now;
+	// don't spend time for Update() on every data chunk when the profile is already active
+	if(m_current == ActiveProfile)
+		return false;
+	return Update(now);
+}
+
+bool cWiFiPowerPolicy::OnAlarm(uint32_t now){
+	m_alarmT = now;
+	m_bAlarm = true;
+	m_trafficT = now;
+	return Update(now);
+}
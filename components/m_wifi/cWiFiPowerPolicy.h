@@ -0,0 +1,48 @@
+/*
+ * cWiFiPowerPolicy.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  WiFi power save profiles and the idle/traffic switching policy
+ */
+
+#ifndef COMPONENTS_M_WIFI_CWIFIPOWERPOLICY_H_
+#define COMPONENTS_M_WIFI_CWIFIPOWERPOLICY_H_
+
+#include <stdint.h>
+
+// radio power save profiles, see esp_wifi_set_ps()
+enum class eWiFiPowerSave{e_none, e_min_modem, e_max_modem};
+
+// Automatic profile switching: the idle profile is used when there was no traffic for IdleTimeoutMs,
+// the active profile is restored at once when a transfer starts or an alarm is raised.
+// No ESP-IDF calls here, time is passed by the caller, so the policy can be replayed on recorded traces.
+class cWiFiPowerPolicy {
+public:
+	bool bEnabled; // automatic switching, default is false (the active profile is used always)
+	eWiFiPowerSave ActiveProfile; // profile while transferring, default is e_none
+	eWiFiPowerSave IdleProfile; // profile while idle, default is e_max_modem
+	uint32_t IdleTimeoutMs; // no traffic time to switch to the idle profile, default 5000
+	uint32_t AlarmHoldMs; // full power time after an alarm, default 60000
+
+	cWiFiPowerPolicy();
+
+	// events, return true if the profile should be changed to Profile() right now
+	bool OnTraffic(uint32_t now);
+	bool OnAlarm(uint32_t now);
+	// periodic check
+	bool Update(uint32_t now);
+	// restart the policy with the active profile
+	void Reset(uint32_t now);
+
+	eWiFiPowerSave Profile()const{return m_current;}
+	uint32_t SwitchCount()const{return m_switches;} // statistics
+
+private:
+	eWiFiPowerSave m_current;
+	uint32_t m_trafficT; // last traffic time
+	uint32_t m_alarmT; // last alarm time
+	bool m_bAlarm; // m_alarmT is valid
+	uint32_t m_switches;
+};
+
+#endif /* COMPONENTS_M_WIFI_CWIFIPOWERPOLICY_H_ */
@@ -0,0 +1,23 @@
+/*
+ * fnv1a.h
+ *
+ *  Created on: 19.10.2026 (c) EmSo
+ *  FNV-1a, the short non-cryptographic hash of the flash keys and the lookup tables
+ */
+
+#ifndef MAIN_COMMON_FNV1A_H_
+#define MAIN_COMMON_FNV1A_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FNV1A_INIT		2166136261u
+
+// pass the previous result as h to continue over several pieces
+static inline uint32_t fnv1a(const void *data, size_t len, uint32_t h = FNV1A_INIT){
+	for(size_t i = 0; i < len; i++)
+		h = (h ^ ((const uint8_t*)data)[i]) * 16777619u;
+	return h;
+}
+
+#endif /* MAIN_COMMON_FNV1A_H_ */
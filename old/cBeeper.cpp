@@ -6,6 +6,7 @@
  */
 #include "cBeeper.h"
 #include "cApplication.h"
+#include "../components/m_wifi/cWiFiDevice.h"
 #include <esp_log.h>
 
 #define LEDC_BEEPER_TIMER		LEDC_TIMER_1
@@ -167,6 +168,8 @@ void cBeeper::Play(beeperTune_t* tune) {
 		}
 
 		if (nullptr != tune) {
+			if (tune == &alarmTune || tune == &alarmTuneShort)
+				cWiFiDevice::NotifyAlarm(); // the alarm report follows, no power save delays for it
 			beeperIndex = 0x00;
 			beeperTune = tune;
 			if (0x00 != tune->notesAmount)  {
@@ -195,6 +195,8 @@ public:
 	void AftereWrite(cBtCharacteristic *pCaller){
 		if(!App.pPirCalibrator)
 			App.pPirCalibrator = new cPirCalibrator;
+		// the interactive calibration needs the short connection interval
+		pCaller->getServer()->setLinkActivity(BT_LINK_CALIBRATION, true);
 	}
 }btcb_11;
 
@@ -209,6 +211,7 @@ public:
 		if(App.pPirCalibrator){
 			delete App.pPirCalibrator;
 			App.pPirCalibrator = nullptr;
+			pCaller->getServer()->setLinkActivity(BT_LINK_CALIBRATION, false);
 			// also we have to destroy BT, Reza: Turn off BT and go to main after CALIBRATOR_DESTROY
 			App.btTargetState = eAppBtState::e_disabled;
 		}
@@ -372,10 +375,18 @@ public:
 	}
 }btcb_1c;
 
+// BEACON_KEY the secret of the status beacon, write only, kept by the server
+class cBtCallbacks1d: public cBtCharCallbacks{
+public:
+	void AftereWrite(cBtCharacteristic *pCaller){
+		pCaller->getServer()->setBeaconKey(pCaller->getData(), pCaller->getLength());
+		pCaller->setValue(""); // not kept in the characteristic
+	}
+}btcb_1d;
+
 //===================================
 
 cBluetooth::cBluetooth() {
-	bWasDisconnect = false;
 }
 
 cBluetooth::~cBluetooth() {
@@ -385,7 +396,52 @@ cBluetooth::~cBluetooth() {
 	}
 }
 
+// status for the beacon, the same as ALARM_STATE and BATTERY_STATUS characteristics
+void cBluetooth::UpdateBeacon(){
+	uint8_t flags = 0;
+	if(App.gsCurrentState == e_alarm){
+		flags |= BT_BEACON_ALARM;
+		if(SensorDataGlobal.bPIR)
+			flags |= BT_BEACON_MOTION;
+		if(SensorDataGlobal.bSmoke)
+			flags |= BT_BEACON_SMOKE;
+	}
+	if(App.gsCurrentState == e_guard)
+		flags |= BT_BEACON_GUARD;
+	if(App.errors.ErrCount())
+		flags |= BT_BEACON_ERROR;
+
+	uint8_t battery = BT_BEACON_BATTERY_UNKNOWN;
+	switch(SensorDataGlobal.BatteryState){
+	case e_bat_charging_full:
+		flags |= BT_BEACON_CHARGING;
+		// no break
+	case e_bat_full:
+		battery = 100;
+		break;
+	case e_bat_charging_med:
+		flags |= BT_BEACON_CHARGING;
+		// no break
+	case e_bat_med:
+		battery = 50;
+		break;
+	case e_bat_charging_low:
+		flags |= BT_BEACON_CHARGING;
+		// no break
+	case e_bat_low:
+		battery = 10;
+		break;
+	case e_bat_error:
+		flags |= BT_BEACON_ERROR;
+		break;
+	default:
+		break;
+	}
+	btSrv.setBeaconState(flags, battery);
+}
+
 bool cBluetooth::IsTimeToDestroy(){
+	UpdateBeacon(); // polled by the application
 	if(client_was_connected()){
 
 		bool cal_active = calibration_ongoing();
@@ -400,7 +456,9 @@ bool cBluetooth::IsTimeToDestroy(){
 		}
 		
 		if(!IsClientConnected()){
-			bWasDisconnect = true;
+			// the same server waits for the next client, the existence timeout starts again
+			btSrv.last_client_active_t = 0;
+			btSrv.server_create_t = cBaseTask::GetTickCount();
 		}
 	}else{
 		// no client connection happened
@@ -416,6 +474,7 @@ inline void cBluetooth::cancel_calibration(void)
 {
 	delete App.pPirCalibrator;
 	App.pPirCalibrator = nullptr;
+	btSrv.setLinkActivity(BT_LINK_CALIBRATION, false);
 }
 
 inline bool cBluetooth::calibration_ongoing(void){
@@ -440,14 +499,18 @@ void cBluetooth::Init(){
 	auto padv = btSrv.getAdvertising();
 	padv->addServiceUUID(svcuuid);
 
+	// the status beacon is added to the advertisement data, the name and the UID go to the scan response
 	BLEAdvertisementData advData;
-	advData.setManufacturerData(GetDeviceUID());
-	advData.setPartialServices(svcuuid);
-	advData.setName("SmartRing");
 	advData.setFlags(ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT);
+	advData.setPartialServices(svcuuid);
 	advData.setAppearance(0);
-	//padv->setScanResponseData(advData);
-	padv->setAdvertisementData(advData);
+	btSrv.enableBeacon(advData); // with the key written to BEACON_KEY, not broadcast until there is one
+	UpdateBeacon();
+
+	BLEAdvertisementData rspData;
+	rspData.setName("SmartRing");
+	rspData.setManufacturerData(GetDeviceUID());
+	padv->setScanResponseData(rspData);
 
 	// add the Service to the server
 	auto psvc = btSrv.ServiceCreate(svcuuid);
@@ -649,6 +712,11 @@ void cBluetooth::Init(){
 	// add callbacks on change
 	pchar->setCallbacks(&btcb_1c);
 
+	// BEACON_KEY the key of the status beacon, written by the bonded phone only and never readable
+	pchar = psvc->CharCreate(0xaf1du);
+	pchar->setProperties(PWO);
+	pchar->setPermissions(ESP_GATT_PERM_WRITE_ENCRYPTED);
+	pchar->setCallbacks(&btcb_1d);
 
 	// initialize Bt Server
 	btSrv.Init(&btDev);
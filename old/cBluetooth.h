@@ -21,11 +21,12 @@
 class cBluetooth {
 	cBtServer btSrv;
 	cBtDevice btDev;
-	bool bWasDisconnect;
 public:
 	cBluetooth();
 	~cBluetooth();
 	void Init();
+	// broadcast the current alarm and battery status, called by IsTimeToDestroy() as well
+	void UpdateBeacon();
 	bool IsTimeToDestroy();
 	bool IsClientConnected(){
 		return btSrv.getConnectedCount() > 0;
@@ -35,8 +36,8 @@ public:
 		return btSrv.getGattsIf() != -1;
 	}
 
-	bool IsNeedRecreation(){ // due to unknown reasons for difficulties to reconnect reported by Reza (not approved by tests), we need to recreate BT object after the user has disconnected
-		return bWasDisconnect;
+	bool IsNeedRecreation(){ // the server clears the connection state and advertises again after a disconnect, no rebuild is needed
+		return false;
 	}
 
 private:
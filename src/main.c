@@ -20,6 +20,9 @@
 #include "nvs_flash.h"
 #include "tcpip_adapter.h"
 #include "esp_smartconfig.h"
+#include "nvs.h"
+#include "driver/gpio.h"
+#include "provisioning.h"
 
 /* FreeRTOS event group to signal when we are connected & ready to make a request */
 static EventGroupHandle_t s_wifi_event_group;
@@ -31,15 +34,24 @@ static const int CONNECTED_BIT = BIT0;
 static const int ESPTOUCH_DONE_BIT = BIT1;
 static const char *TAG = "smartconfig_example";
 
-static void smartconfig_example_task(void * parm);
+/* holding the button at boot forces SmartConfig */
+#define PROV_BUTTON GPIO_NUM_14
+#define PROV_NVS_NAMESPACE "prov"
+
+/* reconnect on disconnection, off while the provisioning task decides what to do */
+static volatile bool s_reconnect = false;
+
+static void provisioning_task(void * parm);
 
 static void event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        xTaskCreate(smartconfig_example_task, "smartconfig_example_task", 4096, NULL, 3, NULL);
+        xTaskCreate(provisioning_task, "provisioning_task", 4096, NULL, 3, NULL);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        esp_wifi_connect();
+        if (s_reconnect) {
+            esp_wifi_connect();
+        }
         xEventGroupClearBits(s_wifi_event_group, CONNECTED_BIT);
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         xEventGroupSetBits(s_wifi_event_group, CONNECTED_BIT);
@@ -93,23 +105,123 @@ static void initialise_wifi(void)
     ESP_ERROR_CHECK( esp_wifi_start() );
 }
 
-static void smartconfig_example_task(void * parm)
+static void prov_load(prov_state_t *st)
+{
+    nvs_handle handle;
+    memset(st, 0, sizeof(*st));
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    nvs_get_u8(handle, "fail", &st->failures);
+    nvs_get_u8(handle, "prov_to", &st->prov_timeouts);
+    nvs_get_u32(handle, "prov_ms", &st->last_prov_ms);
+    nvs_close(handle);
+}
+
+static void prov_save(const prov_state_t *st)
+{
+    nvs_handle handle;
+    if (nvs_open(PROV_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Provisioning state is not saved");
+        return;
+    }
+    nvs_set_u8(handle, "fail", st->failures);
+    nvs_set_u8(handle, "prov_to", st->prov_timeouts);
+    nvs_set_u32(handle, "prov_ms", st->last_prov_ms);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/* how long the button is held at boot, up to limit_ms */
+static uint32_t button_held_ms(uint32_t limit_ms)
+{
+    uint32_t held = 0;
+    gpio_set_direction(PROV_BUTTON, GPIO_MODE_INPUT);
+    gpio_pulldown_en(PROV_BUTTON);
+    while (held < limit_ms && gpio_get_level(PROV_BUTTON)) {
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+        held += 50;
+    }
+    return held;
+}
+
+static bool has_credentials(void)
 {
-    EventBits_t uxBits;
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config) != ESP_OK) {
+        return false;
+    }
+    return wifi_config.sta.ssid[0] != 0;
+}
+
+static bool try_connect(uint32_t timeout_ms)
+{
+    xEventGroupClearBits(s_wifi_event_group, CONNECTED_BIT);
+    if (esp_wifi_connect() != ESP_OK) {
+        return false;
+    }
+    EventBits_t uxBits = xEventGroupWaitBits(s_wifi_event_group, CONNECTED_BIT, false, false, timeout_ms / portTICK_PERIOD_MS);
+    if (uxBits & CONNECTED_BIT) {
+        return true;
+    }
+    esp_wifi_disconnect();
+    return false;
+}
+
+/* runs ESP-Touch until the ack is sent or timeout, the duration is returned in duration_ms */
+static bool run_smartconfig(uint32_t timeout_ms, uint32_t *duration_ms)
+{
+    xEventGroupClearBits(s_wifi_event_group, ESPTOUCH_DONE_BIT);
     ESP_ERROR_CHECK( esp_smartconfig_set_type(SC_TYPE_ESPTOUCH) );
     smartconfig_start_config_t cfg = SMARTCONFIG_START_CONFIG_DEFAULT();
     ESP_ERROR_CHECK( esp_smartconfig_start(&cfg) );
+    TickType_t start = xTaskGetTickCount();
+    EventBits_t uxBits = xEventGroupWaitBits(s_wifi_event_group, ESPTOUCH_DONE_BIT, true, false, timeout_ms / portTICK_PERIOD_MS);
+    *duration_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    esp_smartconfig_stop();
+    if (uxBits & ESPTOUCH_DONE_BIT) {
+        ESP_LOGI(TAG, "smartconfig over");
+        return true;
+    }
+    ESP_LOGI(TAG, "smartconfig timeout");
+    esp_wifi_disconnect();
+    return false;
+}
+
+/* connects with the stored credentials, SmartConfig is started only when they are missing,
+   keep failing or the button is held at boot */
+static void provisioning_task(void * parm)
+{
+    prov_config_t cfg;
+    prov_state_t st;
+    prov_config_default(&cfg);
+    prov_load(&st);
+    uint32_t button_ms = button_held_ms(cfg.button_hold_ms);
+
     while (1) {
-        uxBits = xEventGroupWaitBits(s_wifi_event_group, CONNECTED_BIT | ESPTOUCH_DONE_BIT, true, false, portMAX_DELAY);
-        if(uxBits & CONNECTED_BIT) {
-            ESP_LOGI(TAG, "WiFi Connected to ap");
+        bool ok;
+        if (prov_decide(&cfg, &st, has_credentials(), button_ms) == PROV_ACTION_CONNECT) {
+            ok = try_connect(cfg.connect_timeout_ms);
+            ESP_LOGI(TAG, "Connection with stored credentials: %s", ok ? "ok" : "failed");
+            if (prov_on_connect_result(&st, ok)) {
+                prov_save(&st);
+            }
+        } else {
+            uint32_t duration_ms;
+            uint32_t timeout_ms = prov_timeout_ms(&cfg, &st);
+            ESP_LOGI(TAG, "Starting smartconfig, timeout %u ms", timeout_ms);
+            button_ms = 0;
+            ok = run_smartconfig(timeout_ms, &duration_ms);
+            prov_on_provision_result(&st, ok, duration_ms);
+            prov_save(&st);
         }
-        if(uxBits & ESPTOUCH_DONE_BIT) {
-            ESP_LOGI(TAG, "smartconfig over");
-            esp_smartconfig_stop();
-            vTaskDelete(NULL);
+        if (ok) {
+            ESP_LOGI(TAG, "WiFi Connected to ap");
+            break;
         }
     }
+    s_reconnect = true;
+    vTaskDelete(NULL);
 }
 
 void app_main()
@@ -0,0 +1,67 @@
+/* Provisioning decisions, see provisioning.h */
+
+#include "provisioning.h"
+
+#define PROV_TIMEOUT_FACTOR     3   /* timeout is this times the last provisioning duration */
+#define PROV_MAX_DOUBLING       4   /* timeout is doubled this many times at most */
+
+void prov_config_default(prov_config_t *cfg)
+{
+    cfg->max_failures = 3;
+    cfg->button_hold_ms = 3000;
+    cfg->connect_timeout_ms = 10000;
+    cfg->min_timeout_ms = 60000;
+    cfg->max_timeout_ms = 300000;
+}
+
+prov_action_t prov_decide(const prov_config_t *cfg, const prov_state_t *st, bool has_credentials, uint32_t button_held_ms)
+{
+    if (!has_credentials || button_held_ms >= cfg->button_hold_ms) {
+        return PROV_ACTION_PROVISION;
+    }
+    /* the stored network may be down for a while, so provisioning times out back to connecting */
+    if (st->failures >= cfg->max_failures) {
+        return PROV_ACTION_PROVISION;
+    }
+    return PROV_ACTION_CONNECT;
+}
+
+uint32_t prov_timeout_ms(const prov_config_t *cfg, const prov_state_t *st)
+{
+    uint32_t timeout = cfg->min_timeout_ms;
+    if (st->last_prov_ms && st->last_prov_ms * PROV_TIMEOUT_FACTOR > timeout) {
+        timeout = st->last_prov_ms * PROV_TIMEOUT_FACTOR;
+    }
+    uint8_t doubling = st->prov_timeouts < PROV_MAX_DOUBLING ? st->prov_timeouts : PROV_MAX_DOUBLING;
+    timeout <<= doubling;
+    return timeout < cfg->max_timeout_ms ? timeout : cfg->max_timeout_ms;
+}
+
+bool prov_on_connect_result(prov_state_t *st, bool ok)
+{
+    if (ok) {
+        bool changed = st->failures != 0;
+        st->failures = 0;
+        return changed;
+    }
+    if (st->failures < 0xff) {
+        st->failures++;
+    }
+    return true;
+}
+
+bool prov_on_provision_result(prov_state_t *st, bool ok, uint32_t duration_ms)
+{
+    if (ok) {
+        st->last_prov_ms = duration_ms;
+        st->prov_timeouts = 0;
+        st->failures = 0;
+    } else {
+        if (st->prov_timeouts < 0xff) {
+            st->prov_timeouts++;
+        }
+        /* give the stored credentials another full round of attempts */
+        st->failures = 0;
+    }
+    return true;
+}
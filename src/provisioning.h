@@ -0,0 +1,44 @@
+/* Provisioning decisions
+
+   Chooses between connecting with the stored credentials and starting
+   SmartConfig, and adapts the provisioning timeout. No ESP-IDF calls here,
+   the caller keeps prov_state_t in NVS and executes the decisions.
+*/
+
+#ifndef PROVISIONING_H_
+#define PROVISIONING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    PROV_ACTION_CONNECT,    /* connect with the stored credentials */
+    PROV_ACTION_PROVISION   /* start SmartConfig */
+} prov_action_t;
+
+typedef struct {
+    uint8_t max_failures;           /* failed connects in a row before provisioning */
+    uint32_t button_hold_ms;        /* button hold at boot that forces provisioning */
+    uint32_t connect_timeout_ms;    /* one connection attempt */
+    uint32_t min_timeout_ms;        /* provisioning timeout limits */
+    uint32_t max_timeout_ms;
+} prov_config_t;
+
+typedef struct {
+    uint8_t failures;       /* failed connects with the stored credentials in a row, since the last provisioning */
+    uint8_t prov_timeouts;  /* provisioning timeouts in a row */
+    uint32_t last_prov_ms;  /* duration of the last successful provisioning, 0 if unknown */
+} prov_state_t;
+
+void prov_config_default(prov_config_t *cfg);
+
+prov_action_t prov_decide(const prov_config_t *cfg, const prov_state_t *st, bool has_credentials, uint32_t button_held_ms);
+
+/* provisioning timeout: a few times the last provisioning duration, doubled after every timeout */
+uint32_t prov_timeout_ms(const prov_config_t *cfg, const prov_state_t *st);
+
+/* results, return true if the state has changed and should be saved */
+bool prov_on_connect_result(prov_state_t *st, bool ok);
+bool prov_on_provision_result(prov_state_t *st, bool ok, uint32_t duration_ms);
+
+#endif /* PROVISIONING_H_ */
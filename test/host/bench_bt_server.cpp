@@ -0,0 +1,147 @@
+/*
+ * bench_bt_server.cpp
+ *
+ *  cBtServer on the simulated stack: attribute reads and writes per second, long reads and prepared writes,
+ *  notification throughput for the MTU range, heap of the database and of the connections
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <esp_system.h>
+#include "bt_sim.h"
+#include "../../components/m_bt/cBtServer.h"
+#include "../../components/m_bt/BLE2902.h"
+
+#define ROUNDS		20000
+#define CLIENTS		4
+
+static double now(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, double sec, size_t ops){
+	printf("%-36s %8.1f us/op %12.0f ops/s\n", name, sec * 1e6 / ops, ops / sec);
+}
+
+int main(){
+	uint32_t heap0 = esp_get_free_heap_size();
+	cBtSim &sim = cBtSim::Get();
+	cBtDevice dev;
+	dev.Init("bench");
+	cBtServer srv;
+	srv.PersistBonds = false;
+	srv.MaxConnections = CLIENTS;
+	cBtService *pSvc = srv.ServiceCreate((uint16_t)0xafff);
+	cBtCharacteristic *pId = pSvc->CharCreate((uint16_t)0xaf01);
+	pId->setProperties(cBtCharacteristic::PROPERTY_READ);
+	pId->setValue("123456789");
+	cBtCharacteristic *pRecord = pSvc->CharCreate((uint16_t)0xaf02);
+	pRecord->setProperties(cBtCharacteristic::PROPERTY_READ | cBtCharacteristic::PROPERTY_WRITE);
+	pRecord->setMaxLength(512);
+	std::vector<uint8_t> record(300, 0x5a);
+	pRecord->setValue(record.data(), record.size());
+	cBtCharacteristic *pSensor = pSvc->CharCreate((uint16_t)0xaf03);
+	pSensor->setProperties(cBtCharacteristic::PROPERTY_NOTIFY);
+	pSensor->DescAdd(new BLE2902);
+	srv.Init(&dev);
+	srv.Start();
+	uint16_t hId = sim.FindChar((uint16_t)0xaf01), hRecord = sim.FindChar((uint16_t)0xaf02);
+	uint16_t hSensor = sim.FindChar((uint16_t)0xaf03);
+	uint32_t heapDb = esp_get_free_heap_size();
+	printf("database of %d attributes, heap %u bytes\n", (int)sim.attrs.size(), heap0 - heapDb);
+
+	cSimCentral c(1);
+	c.Connect();
+	std::vector<uint8_t> value, cmd(4, 1);
+	double t = now();
+	for(int i = 0; i < ROUNDS; i++)
+		c.Read(hId, value);
+	report("read 9 bytes", now() - t, ROUNDS);
+	t = now();
+	for(int i = 0; i < ROUNDS; i++)
+		c.Write(hRecord, cmd);
+	report("write 4 bytes", now() - t, ROUNDS);
+	pRecord->setValue(record.data(), record.size());
+	t = now();
+	for(int i = 0; i < ROUNDS / 10; i++)
+		c.ReadLong(hRecord, value);
+	report("long read 300 bytes, MTU 23", now() - t, ROUNDS / 10);
+	t = now();
+	for(int i = 0; i < ROUNDS / 10; i++)
+		c.WriteLong(hRecord, record);
+	report("prepared write 300 bytes, MTU 23", now() - t, ROUNDS / 10);
+	sBtStats stats;
+	srv.getStats(stats);
+	printf("server: %u reads, %u writes in %u ms, %u attr ops/s\n", stats.reads, stats.writes, stats.time,
+			stats.perSec(stats.reads + stats.writes));
+
+	// notifications: a value per connection event, the link is never the limit; the received values are
+	// counted and forgotten, the heap figures are the ones of the server
+	c.Subscribe(hSensor, BT_CCCD_NOTIFY);
+	size_t received;
+	uint16_t mtus[] = {23, 185, 247, 517};
+	for(uint16_t mtu : mtus){
+		c.ExchangeMtu(mtu);
+		std::vector<uint8_t> data(c.mtu - 3, 0xa5);
+		pSensor->setValue(data.data(), data.size());
+		received = 0;
+		srv.resetStats();
+		t = now();
+		for(int i = 0; i < ROUNDS; i++){
+			pSensor->notify();
+			sim.Step();
+			received += c.received.size();
+			c.received.clear();
+		}
+		double sec = now() - t;
+		srv.getStats(stats);
+		char name[40];
+		snprintf(name, sizeof name, "notify %d bytes, MTU %d", (int)data.size(), mtu);
+		report(name, sec, ROUNDS);
+		printf("%-36s %8.1f MB/s, %u received, %u dropped\n", "", stats.txBytes / sec / 1e6, (unsigned)received,
+				stats.txDropped);
+	}
+	// faster than the link: the queue coalesces the values, the sending stops by the congestion event
+	received = 0;
+	srv.resetStats();
+	t = now();
+	for(int i = 0; i < ROUNDS; i++){
+		pSensor->notify();
+		if(i % 32 == 31){
+			sim.Step();
+			received += c.received.size();
+			c.received.clear();
+		}
+	}
+	sim.Run();
+	received += c.received.size();
+	report("notify, 32 values per event", now() - t, ROUNDS);
+	srv.getStats(stats);
+	printf("%-36s %u sent, %u received, %u congestions, %u dropped\n", "", stats.notifications, (unsigned)received,
+			stats.congestions, stats.txDropped);
+
+	// heap of the connections with the subscription and a long read in progress
+	uint32_t heap1 = esp_get_free_heap_size();
+	std::vector<cSimCentral*> centrals;
+	for(uint16_t i = 2; i <= CLIENTS; i++){
+		cSimCentral *p = new cSimCentral(i);
+		p->Connect();
+		p->ExchangeMtu(185);
+		p->Subscribe(hSensor, BT_CCCD_NOTIFY);
+		p->ReadBlob(hRecord, 0, value);
+		centrals.push_back(p);
+	}
+	uint32_t heap2 = esp_get_free_heap_size();
+	printf("%d connections, heap %d bytes per connection\n", CLIENTS - 1, (int)(heap1 - heap2) / (CLIENTS - 1));
+	for(auto p : centrals){
+		p->Disconnect();
+		delete p;
+	}
+	srv.getStats(stats);
+	printf("heap: free %u, min free %u of %u\n", esp_get_free_heap_size(), stats.minFreeHeap, HOST_HEAP_SIZE);
+	return 0;
+}
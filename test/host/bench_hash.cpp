@@ -0,0 +1,94 @@
+/*
+ * bench_hash.cpp
+ *
+ *  Download hashing throughput: the former path of cHttpClient (SHA-1 of every 256 byte read,
+ *  hex by std::stringstream, base64 of the hex) against cHash with the same reads
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mbedtls/base64.h>
+#include "../../components/m_wifi/cHash.h"
+
+#define READ_LEN	256 // cHttpClient receive buffer
+#define BODY_LEN	(64 * 1024)
+#define ROUNDS		200
+
+static double now(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::string old_path(const std::vector<uint8_t> &body){
+	mbedtls_sha1_context sha;
+	mbedtls_sha1_init(&sha);
+	mbedtls_sha1_starts(&sha);
+	for(size_t i = 0; i < body.size(); i += READ_LEN)
+		mbedtls_sha1_update(&sha, &body[i], std::min((size_t)READ_LEN, body.size() - i));
+	unsigned char output[20], base64_out[64];
+	mbedtls_sha1_finish(&sha, output);
+	mbedtls_sha1_free(&sha);
+	std::stringstream ss;
+	ss << std::hex;
+	for(size_t i = 0; i < sizeof output; i++)
+		ss << std::setw(2) << std::setfill('0') << (int)output[i];
+	size_t out_len(0);
+	mbedtls_base64_encode(base64_out, sizeof base64_out, &out_len, (uint8_t*)ss.str().c_str(), ss.str().size());
+	base64_out[out_len] = 0;
+	return (char*)base64_out;
+}
+
+static std::string new_path(const std::vector<uint8_t> &body, eHashAlgo algo){
+	cHash hash;
+	hash.Start(algo);
+	for(size_t i = 0; i < body.size(); i += READ_LEN)
+		hash.Update(&body[i], std::min((size_t)READ_LEN, body.size() - i));
+	hash.Finish();
+	return hash.Format(eHashFormat::e_base64_hex);
+}
+
+static void report(const char *name, double sec, size_t bytes, size_t digests){
+	printf("%-28s %8.1f MB/s %10.0f digests/s\n", name, bytes / sec / 1e6, digests / sec);
+}
+
+int main(){
+	std::vector<uint8_t> body(BODY_LEN);
+	for(size_t i = 0; i < body.size(); i++)
+		body[i] = (uint8_t)(i * 31 + 7);
+	if(old_path(body) != new_path(body, eHashAlgo::e_sha1)){
+		printf("digests differ\n");
+		return 1;
+	}
+
+	printf("body %d bytes in %d byte reads, %d rounds\n", BODY_LEN, READ_LEN, ROUNDS);
+	double t = now();
+	for(int i = 0; i < ROUNDS; i++)
+		old_path(body);
+	report("old sha1+stringstream", now() - t, (size_t)BODY_LEN * ROUNDS, ROUNDS);
+	t = now();
+	for(int i = 0; i < ROUNDS; i++)
+		new_path(body, eHashAlgo::e_sha1);
+	report("cHash sha1", now() - t, (size_t)BODY_LEN * ROUNDS, ROUNDS);
+	t = now();
+	for(int i = 0; i < ROUNDS; i++)
+		new_path(body, eHashAlgo::e_sha256);
+	report("cHash sha256", now() - t, (size_t)BODY_LEN * ROUNDS, ROUNDS);
+
+	// digest of an empty body: the formatting cost only, it dominates for the small responses
+	std::vector<uint8_t> empty;
+	const int n = ROUNDS * 500;
+	t = now();
+	for(int i = 0; i < n; i++)
+		old_path(empty);
+	report("old format (empty body)", now() - t, 0, n);
+	t = now();
+	for(int i = 0; i < n; i++)
+		new_path(empty, eHashAlgo::e_sha1);
+	report("cHash format (empty body)", now() - t, 0, n);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * bench_uuid.cpp
+ *
+ *  UUID comparisons of the GATT dispatch: the former equals() (128 bit copies when the lengths differ)
+ *  against the normalized word compares and the hash lookup, run time parsing against the literals
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../../components/m_bt/BLEUUID.h"
+
+#define ROUNDS		200000
+
+static double now(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the former to128(): the short form is written into the base UUID
+static void old_to128(esp_bt_uuid_t &u){
+	static const uint8_t base[16] = {0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0, 0, 0, 0};
+	if(u.len == ESP_UUID_LEN_128)
+		return;
+	uint32_t v = u.len == ESP_UUID_LEN_16 ? u.uuid.uuid16 : u.uuid.uuid32;
+	memcpy(u.uuid.uuid128, base, 12);
+	u.uuid.uuid128[12] = v;
+	u.uuid.uuid128[13] = v >> 8;
+	u.uuid.uuid128[14] = v >> 16;
+	u.uuid.uuid128[15] = v >> 24;
+	u.len = ESP_UUID_LEN_128;
+}
+
+// the former equals(): copies of both UUIDs converted to 128 bits when the lengths differ
+static bool old_equals(BLEUUID a, BLEUUID b){
+	esp_bt_uuid_t x = *a.getNative(), y = *b.getNative();
+	if(x.len != y.len){
+		old_to128(x);
+		old_to128(y);
+		return memcmp(x.uuid.uuid128, y.uuid.uuid128, 16) == 0;
+	}
+	if(x.len == ESP_UUID_LEN_16)
+		return x.uuid.uuid16 == y.uuid.uuid16;
+	if(x.len == ESP_UUID_LEN_32)
+		return x.uuid.uuid32 == y.uuid.uuid32;
+	return memcmp(x.uuid.uuid128, y.uuid.uuid128, 16) == 0;
+}
+
+static void report(const char *name, double sec, size_t ops){
+	printf("%-36s %8.1f ns/op %12.0f ops/s\n", name, sec * 1e9 / ops, ops / sec);
+}
+
+int main(){
+	// the characteristics of a service: 16 bit ones registered in the 128 bit form and vendor UUIDs
+	std::vector<BLEUUID> chars;
+	for(uint16_t u = 0x2a19; u < 0x2a21; u++)
+		chars.push_back(BLEUUID((uint16_t)u).to128());
+	for(int i = 0; i < 8; i++){
+		char s[40];
+		snprintf(s, sizeof s, "beb5483e-36e1-4688-b7f5-ea07361b26%02x", i);
+		chars.push_back(BLEUUID(std::string(s)));
+	}
+	// the dispatch looks up the 16 bit UUIDs of the events
+	std::vector<BLEUUID> keys;
+	for(uint16_t u = 0x2a19; u < 0x2a21; u++)
+		keys.push_back(BLEUUID((uint16_t)u));
+	keys.push_back(chars.back());
+	std::unordered_map<BLEUUID, size_t, BLEUUIDHash> table;
+	for(size_t i = 0; i < chars.size(); i++)
+		table[chars[i]] = i;
+
+	size_t found = 0;
+	const size_t ops = (size_t)ROUNDS * keys.size();
+	printf("%d characteristics, %d keys, %d rounds\n", (int)chars.size(), (int)keys.size(), ROUNDS);
+	double t = now();
+	for(int r = 0; r < ROUNDS; r++)
+		for(auto &k : keys)
+			for(auto &c : chars)
+				if(old_equals(c, k)){
+					found++;
+					break;
+				}
+	report("old equals, linear search", now() - t, ops);
+	t = now();
+	for(int r = 0; r < ROUNDS; r++)
+		for(auto &k : keys)
+			for(auto &c : chars)
+				if(c == k){
+					found++;
+					break;
+				}
+	report("normalized equals, linear search", now() - t, ops);
+	t = now();
+	for(int r = 0; r < ROUNDS; r++)
+		for(auto &k : keys)
+			found += table.count(k);
+	report("hash lookup", now() - t, ops);
+	if(found != 3 * ops){
+		printf("lookups differ\n");
+		return 1;
+	}
+
+	// construction of the constant UUIDs
+	std::string canonical = "beb5483e-36e1-4688-b7f5-ea07361b26a8";
+	uint32_t sum = 0;
+	t = now();
+	for(int r = 0; r < ROUNDS; r++)
+		sum += BLEUUID(canonical).hash();
+	report("BLEUUID(std::string)", now() - t, ROUNDS);
+	t = now();
+	for(int r = 0; r < ROUNDS; r++)
+		sum -= BLEUUID("beb5483e-36e1-4688-b7f5-ea07361b26a8"_uuid).hash();
+	report("BLEUUID(_uuid literal)", now() - t, ROUNDS);
+	return sum != 0;
+}
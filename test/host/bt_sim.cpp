@@ -0,0 +1,854 @@
+/*
+ * bt_sim.cpp
+ *
+ *  Simulated Bluedroid stack: the GAP and GATT server API of the shim, the host cBtDevice and the central
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "bt_sim.h"
+#include "../../components/m_bt/cBtDevice.h"
+#include "../../components/m_bt/cBtServer.h"
+#include "../../components/m_bt/cBtScanner.h"
+
+#define RUN_MAX_ROUNDS		100000 // Run() of a server which never stops sending
+
+static const BLEUUID s_primaryUuid((uint16_t)ESP_GATT_UUID_PRI_SERVICE);
+static const BLEUUID s_charDeclUuid((uint16_t)ESP_GATT_UUID_CHAR_DECLARE);
+
+static void put_uuid(std::vector<uint8_t> &v, const esp_bt_uuid_t &uuid){
+	const uint8_t *p = uuid.len == ESP_UUID_LEN_16 ? (const uint8_t*)&uuid.uuid.uuid16 :
+			uuid.len == ESP_UUID_LEN_32 ? (const uint8_t*)&uuid.uuid.uuid32 : uuid.uuid.uuid128;
+	v.insert(v.end(), p, p + uuid.len);
+}
+
+static esp_bt_uuid_t make_uuid(const uint8_t *p, uint16_t len){
+	esp_bt_uuid_t uuid;
+	memset(&uuid, 0, sizeof uuid);
+	uuid.len = len;
+	memcpy(&uuid.uuid, p, len <= ESP_UUID_LEN_128 ? len : 0);
+	return uuid;
+}
+
+// ============================================== cBtSim ================================================
+
+cBtSim::cBtSim(){
+	Reset();
+}
+
+cBtSim& cBtSim::Get(){
+	static cBtSim sim;
+	return sim;
+}
+
+void cBtSim::Reset(){
+	attrs.clear();
+	bAdvertising = false;
+	memset(&advParams, 0, sizeof advParams);
+	advConfigs = 0;
+	advData.clear();
+	advStarts = 0;
+	connUpdates.clear();
+	AcceptConnParams = true;
+	bScanning = false;
+	memset(&scanParams, 0, sizeof scanParams);
+	scanDuration = 0;
+	scanStarts = 0;
+	CongestLimit = 10;
+	LocalMtu = ESP_GATT_MAX_MTU_SIZE;
+	sent = 0;
+	rejected = 0;
+	truncated = 0;
+	responses = 0;
+	strayResponses = 0;
+	handleErrors = 0;
+	gattsCb = nullptr;
+	gapCb = nullptr;
+	events.clear();
+	conns.clear();
+	rsps.clear();
+	pending.clear();
+	transId = 0;
+	nextHandle = SIM_FIRST_HANDLE;
+	svcEnd = 0;
+}
+
+sSimAttr* cBtSim::Attr(uint16_t handle){
+	for(auto &attr : attrs){
+		if(attr.handle == handle)
+			return &attr;
+	}
+	return nullptr;
+}
+
+uint16_t cBtSim::FindChar(const BLEUUID &uuid){
+	for(size_t i = 1; i < attrs.size(); i++){
+		if(attrs[i - 1].uuid == s_charDeclUuid && attrs[i].uuid == uuid)
+			return attrs[i].handle;
+	}
+	return 0;
+}
+
+uint16_t cBtSim::FindDesc(uint16_t charHandle, const BLEUUID &uuid){
+	for(size_t i = 0; i < attrs.size(); i++){
+		if(attrs[i].handle != charHandle)
+			continue;
+		// the descriptors follow the value until the next declaration
+		for(i++; i < attrs.size() && !(attrs[i].uuid == s_charDeclUuid) && !(attrs[i].uuid == s_primaryUuid); i++){
+			if(attrs[i].uuid == uuid)
+				return attrs[i].handle;
+		}
+		break;
+	}
+	return 0;
+}
+
+uint16_t cBtSim::addAttr(const BLEUUID &uuid, esp_gatt_perm_t perm, bool bStackValue, const uint8_t *value, size_t len){
+	if(nextHandle > svcEnd){
+		handleErrors++;
+		return 0;
+	}
+	sSimAttr attr;
+	attr.handle = nextHandle++;
+	attr.uuid = uuid;
+	attr.perm = perm;
+	attr.bStackValue = bStackValue;
+	if(value)
+		attr.value.assign(value, value + len);
+	attrs.push_back(attr);
+	return attr.handle;
+}
+
+void cBtSim::gatts(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param){
+	if(gattsCb)
+		gattsCb(event, SIM_GATTS_IF, &param);
+}
+
+void cBtSim::gap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t &param){
+	if(gapCb)
+		gapCb(event, &param);
+}
+
+void cBtSim::queueGatts(esp_gatts_cb_event_t event, const esp_ble_gatts_cb_param_t &param){
+	sEvent ev;
+	ev.bGap = false;
+	ev.event = event;
+	ev.gatts = param;
+	events.push_back(ev);
+}
+
+void cBtSim::queueGap(esp_gap_ble_cb_event_t event, const esp_ble_gap_cb_param_t &param){
+	sEvent ev;
+	ev.bGap = true;
+	ev.event = event;
+	ev.gap = param;
+	events.push_back(ev);
+}
+
+int cBtSim::Dispatch(){
+	int count = 0;
+	while(!events.empty()){
+		sEvent ev = events.front();
+		events.pop_front();
+		if(ev.bGap)
+			gap((esp_gap_ble_cb_event_t)ev.event, ev.gap);
+		else
+			gatts((esp_gatts_cb_event_t)ev.event, ev.gatts);
+		count++;
+	}
+	return count;
+}
+
+int cBtSim::Step(){
+	esp_ble_gatts_cb_param_t param;
+	for(auto &it : conns){
+		sConn &conn = it.second;
+		cSimCentral *pCentral = conn.pCentral;
+		for(auto &packet : conn.air){
+			pCentral->received.push_back(sSimValue{packet.handle, packet.bIndication, packet.data});
+			if(!packet.bIndication)
+				continue;
+			if(!pCentral->AutoConfirm){
+				pCentral->unconfirmed.push_back(packet.handle);
+				continue;
+			}
+			conn.indicating = false;
+			memset(&param, 0, sizeof param);
+			param.conf.status = ESP_GATT_OK;
+			param.conf.conn_id = it.first;
+			param.conf.handle = packet.handle;
+			queueGatts(ESP_GATTS_CONF_EVT, param);
+		}
+		conn.air.clear();
+		if(conn.congested){
+			conn.congested = false;
+			memset(&param, 0, sizeof param);
+			param.congest.conn_id = it.first;
+			param.congest.congested = false;
+			queueGatts(ESP_GATTS_CONGEST_EVT, param);
+		}
+	}
+	return Dispatch();
+}
+
+int cBtSim::Run(){
+	int count = Dispatch();
+	for(int round = 0; round < RUN_MAX_ROUNDS; round++){
+		bool bAir = false;
+		for(auto &it : conns)
+			bAir |= !it.second.air.empty() || it.second.congested;
+		if(!bAir && events.empty())
+			return count;
+		count += Step();
+	}
+	fprintf(stderr, "cBtSim::Run(): the server does not stop sending\n");
+	abort();
+}
+
+// ============================================== GATT server API ================================================
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback){
+	cBtSim::Get().gattsCb = callback;
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id){
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.reg.status = ESP_GATT_OK;
+	param.reg.app_id = app_id;
+	cBtSim::Get().gatts(ESP_GATTS_REG_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_unregister(esp_gatt_if_t gatts_if){
+	return gatts_if == SIM_GATTS_IF ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_ble_gatts_create_service(esp_gatt_if_t gatts_if, esp_gatt_srvc_id_t *service_id, uint16_t num_handle){
+	cBtSim &sim = cBtSim::Get();
+	std::vector<uint8_t> value;
+	put_uuid(value, service_id->id.uuid);
+	sim.svcEnd = sim.nextHandle + num_handle - 1;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.create.service_handle = sim.addAttr(s_primaryUuid, ESP_GATT_PERM_READ, true, value.data(), value.size());
+	param.create.status = param.create.service_handle ? ESP_GATT_OK : ESP_GATT_NO_RESOURCES;
+	param.create.service_id = *service_id;
+	sim.gatts(ESP_GATTS_CREATE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_add_char(uint16_t service_handle, esp_bt_uuid_t *char_uuid, esp_gatt_perm_t perm,
+		esp_gatt_char_prop_t property, esp_attr_value_t *char_val, esp_attr_control_t *control){
+	cBtSim &sim = cBtSim::Get();
+	// declaration: properties, value handle, UUID
+	std::vector<uint8_t> decl;
+	decl.push_back(property);
+	decl.push_back(sim.nextHandle + 1);
+	decl.push_back((sim.nextHandle + 1) >> 8);
+	put_uuid(decl, *char_uuid);
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	if(sim.addAttr(s_charDeclUuid, ESP_GATT_PERM_READ, true, decl.data(), decl.size())){
+		bool bAuto = control && control->auto_rsp == ESP_GATT_AUTO_RSP;
+		param.add_char.attr_handle = sim.addAttr(BLEUUID(*char_uuid), perm, bAuto,
+				char_val ? char_val->attr_value : nullptr, char_val ? char_val->attr_len : 0);
+	}
+	param.add_char.status = param.add_char.attr_handle ? ESP_GATT_OK : ESP_GATT_NO_RESOURCES;
+	param.add_char.service_handle = service_handle;
+	param.add_char.char_uuid = *char_uuid;
+	sim.gatts(ESP_GATTS_ADD_CHAR_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_add_char_descr(uint16_t service_handle, esp_bt_uuid_t *descr_uuid, esp_gatt_perm_t perm,
+		esp_attr_value_t *char_descr_val, esp_attr_control_t *control){
+	cBtSim &sim = cBtSim::Get();
+	bool bAuto = control && control->auto_rsp == ESP_GATT_AUTO_RSP;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.add_char_descr.attr_handle = sim.addAttr(BLEUUID(*descr_uuid), perm, bAuto,
+			char_descr_val ? char_descr_val->attr_value : nullptr, char_descr_val ? char_descr_val->attr_len : 0);
+	param.add_char_descr.status = param.add_char_descr.attr_handle ? ESP_GATT_OK : ESP_GATT_NO_RESOURCES;
+	param.add_char_descr.service_handle = service_handle;
+	param.add_char_descr.descr_uuid = *descr_uuid;
+	sim.gatts(ESP_GATTS_ADD_CHAR_DESCR_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db, esp_gatt_if_t gatts_if,
+		uint8_t max_nb_attr, uint8_t srvc_inst_id){
+	cBtSim &sim = cBtSim::Get();
+	if(!max_nb_attr || gatts_if != SIM_GATTS_IF)
+		return ESP_ERR_INVALID_ARG;
+	sim.svcEnd = sim.nextHandle + max_nb_attr - 1;
+	std::vector<uint16_t> handles;
+	for(int i = 0; i < max_nb_attr; i++){
+		const esp_attr_desc_t &desc = gatts_attr_db[i].att_desc;
+		BLEUUID uuid(make_uuid(desc.uuid_p, desc.uuid_length));
+		std::vector<uint8_t> value;
+		if(desc.value)
+			value.assign(desc.value, desc.value + desc.length);
+		bool bStack = gatts_attr_db[i].attr_control.auto_rsp == ESP_GATT_AUTO_RSP;
+		if(uuid == s_primaryUuid){
+			bStack = true;
+		}else if(uuid == s_charDeclUuid && i + 1 < max_nb_attr){
+			// the stack declares the characteristic of the next entry
+			const esp_attr_desc_t &next = gatts_attr_db[i + 1].att_desc;
+			value.resize(1);
+			value.push_back(sim.nextHandle + 1);
+			value.push_back((sim.nextHandle + 1) >> 8);
+			value.insert(value.end(), next.uuid_p, next.uuid_p + next.uuid_length);
+			bStack = true;
+		}
+		handles.push_back(sim.addAttr(uuid, desc.perm, bStack, value.data(), value.size()));
+	}
+	const esp_attr_desc_t &svc = gatts_attr_db[0].att_desc;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.add_attr_tab.status = std::count(handles.begin(), handles.end(), 0) ? ESP_GATT_NO_RESOURCES : ESP_GATT_OK;
+	param.add_attr_tab.svc_uuid = make_uuid(svc.value, svc.length);
+	param.add_attr_tab.svc_inst_id = srvc_inst_id;
+	param.add_attr_tab.num_handle = max_nb_attr;
+	param.add_attr_tab.handles = handles.data();
+	sim.gatts(ESP_GATTS_CREAT_ATTR_TAB_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle){
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.start.status = cBtSim::Get().Attr(service_handle) ? ESP_GATT_OK : ESP_GATT_NOT_FOUND;
+	param.start.service_handle = service_handle;
+	cBtSim::Get().gatts(ESP_GATTS_START_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+		uint16_t value_len, uint8_t *value, bool need_confirm){
+	cBtSim &sim = cBtSim::Get();
+	auto it = sim.conns.find(conn_id);
+	if(it == sim.conns.end()){
+		sim.rejected++;
+		return ESP_ERR_INVALID_STATE;
+	}
+	cBtSim::sConn &conn = it->second;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.conf.conn_id = conn_id;
+	param.conf.handle = attr_handle;
+	// the call only posts the value to the stack, it reports the failures by the confirmation status
+	if(conn.congested || (need_confirm && conn.indicating)){
+		// congested or one indication at a time
+		sim.rejected++;
+		param.conf.status = conn.congested ? ESP_GATT_CONGESTED : ESP_GATT_BUSY;
+		sim.queueGatts(ESP_GATTS_CONF_EVT, param);
+		return ESP_OK;
+	}
+	size_t maxLen = conn.pCentral->mtu - 3;
+	if(value_len > maxLen){
+		sim.truncated++;
+		value_len = maxLen;
+	}
+	conn.air.push_back(cBtSim::sPacket{attr_handle, need_confirm, std::vector<uint8_t>(value, value + value_len)});
+	sim.sent++;
+	if(need_confirm){
+		conn.indicating = true;
+	}else{
+		// the notification is confirmed when the stack has taken it
+		param.conf.status = ESP_GATT_OK;
+		sim.queueGatts(ESP_GATTS_CONF_EVT, param);
+	}
+	if(conn.air.size() >= sim.CongestLimit){
+		conn.congested = true;
+		memset(&param, 0, sizeof param);
+		param.congest.conn_id = conn_id;
+		param.congest.congested = true;
+		sim.queueGatts(ESP_GATTS_CONGEST_EVT, param);
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id, uint32_t trans_id,
+		esp_gatt_status_t status, esp_gatt_rsp_t *rsp){
+	cBtSim &sim = cBtSim::Get();
+	auto it = sim.pending.find(trans_id);
+	if(it == sim.pending.end()){
+		sim.strayResponses++;
+		return ESP_OK;
+	}
+	sim.pending.erase(it);
+	sim.responses++;
+	cBtSim::sResponse &r = sim.rsps[trans_id];
+	r.status = status;
+	r.value.clear();
+	if(rsp)
+		r.value.assign(rsp->attr_value.value, rsp->attr_value.value + rsp->attr_value.len);
+	return ESP_OK;
+}
+
+// ============================================== GAP API ================================================
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback){
+	cBtSim::Get().gapCb = callback;
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name){
+	return strlen(name) <= 32 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data){
+	cBtSim &sim = cBtSim::Get();
+	sim.advConfigs++;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.adv_data_cmpl.status = ESP_BT_STATUS_SUCCESS;
+	sim.queueGap(adv_data->set_scan_rsp ? ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT : ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data, uint32_t raw_data_len){
+	if(raw_data_len > ESP_BLE_ADV_DATA_LEN_MAX)
+		return ESP_ERR_INVALID_ARG;
+	cBtSim &sim = cBtSim::Get();
+	sim.advConfigs++;
+	sim.advData.assign(raw_data, raw_data + raw_data_len);
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	sim.queueGap(ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data, uint32_t raw_data_len){
+	if(raw_data_len > ESP_BLE_ADV_DATA_LEN_MAX)
+		return ESP_ERR_INVALID_ARG;
+	cBtSim &sim = cBtSim::Get();
+	sim.advConfigs++;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	sim.queueGap(ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params){
+	cBtSim &sim = cBtSim::Get();
+	sim.bAdvertising = true;
+	sim.advParams = *adv_params;
+	sim.advStarts++;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	sim.queueGap(ESP_GAP_BLE_ADV_START_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_advertising(void){
+	cBtSim &sim = cBtSim::Get();
+	sim.bAdvertising = false;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	sim.queueGap(ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+bool cBtSim::Advertise(const esp_bd_addr_t bda, int rssi, const std::vector<uint8_t> &adv, const std::vector<uint8_t> &rsp){
+	if(!bScanning || adv.size() > ESP_BLE_ADV_DATA_LEN_MAX || rsp.size() > ESP_BLE_SCAN_RSP_DATA_LEN_MAX)
+		return false;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.scan_rst.search_evt = ESP_GAP_SEARCH_INQ_RES_EVT;
+	memcpy(param.scan_rst.bda, bda, sizeof(esp_bd_addr_t));
+	param.scan_rst.ble_addr_type = BLE_ADDR_TYPE_PUBLIC;
+	param.scan_rst.ble_evt_type = ESP_BLE_EVT_CONN_ADV;
+	param.scan_rst.rssi = rssi;
+	// the passive scan gets no scan response
+	size_t rspLen = scanParams.scan_type == BLE_SCAN_TYPE_ACTIVE ? rsp.size() : 0;
+	memcpy(param.scan_rst.ble_adv, adv.data(), adv.size());
+	memcpy(param.scan_rst.ble_adv + adv.size(), rsp.data(), rspLen);
+	param.scan_rst.adv_data_len = adv.size();
+	param.scan_rst.scan_rsp_len = rspLen;
+	queueGap(ESP_GAP_BLE_SCAN_RESULT_EVT, param);
+	return true;
+}
+
+void cBtSim::ScanEnd(){
+	if(!bScanning)
+		return;
+	bScanning = false;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.scan_rst.search_evt = ESP_GAP_SEARCH_INQ_CMPL_EVT;
+	queueGap(ESP_GAP_BLE_SCAN_RESULT_EVT, param);
+}
+
+esp_err_t esp_ble_gap_set_scan_params(esp_ble_scan_params_t *scan_params){
+	cBtSim &sim = cBtSim::Get();
+	sim.scanParams = *scan_params;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.scan_param_cmpl.status = scan_params->scan_window <= scan_params->scan_interval ?
+			ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL;
+	sim.queueGap(ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_scanning(uint32_t duration){
+	cBtSim &sim = cBtSim::Get();
+	sim.bScanning = true;
+	sim.scanDuration = duration;
+	sim.scanStarts++;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.scan_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+	sim.queueGap(ESP_GAP_BLE_SCAN_START_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_scanning(void){
+	cBtSim &sim = cBtSim::Get();
+	sim.bScanning = false;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.scan_stop_cmpl.status = ESP_BT_STATUS_SUCCESS;
+	sim.queueGap(ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params){
+	cBtSim &sim = cBtSim::Get();
+	sim.connUpdates.push_back(*params);
+	bool bKnown = false;
+	for(auto &it : sim.conns)
+		bKnown |= memcmp(it.second.pCentral->bda, params->bda, sizeof(esp_bd_addr_t)) == 0;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.update_conn_params.status = bKnown && sim.AcceptConnParams ? ESP_BT_STATUS_SUCCESS : ESP_BT_STATUS_FAIL;
+	memcpy(param.update_conn_params.bda, params->bda, sizeof(esp_bd_addr_t));
+	param.update_conn_params.min_int = params->min_int;
+	param.update_conn_params.max_int = params->max_int;
+	param.update_conn_params.latency = params->latency;
+	param.update_conn_params.conn_int = params->max_int;
+	param.update_conn_params.timeout = params->timeout;
+	sim.queueGap(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, param);
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept){
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_set_encryption(esp_bd_addr_t bd_addr, esp_ble_sec_act_t sec_act){
+	return ESP_OK;
+}
+
+int esp_ble_get_bond_device_num(void){
+	return 0;
+}
+
+esp_err_t esp_ble_get_bond_device_list(int *dev_num, esp_ble_bond_dev_t *dev_list){
+	*dev_num = 0;
+	return ESP_OK;
+}
+
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr){
+	return ESP_OK;
+}
+
+// ============================================== cBtDevice ================================================
+// The host device: the callbacks go to the simulated stack, there is no GATT client in the host build.
+
+cBtDevice* cBtDevice::pActiveInst(nullptr);
+
+cBtDevice::cBtDevice() : pServer(nullptr), pClient(nullptr), pScanner(nullptr) {
+	pActiveInst = this;
+}
+
+cBtDevice::~cBtDevice() {
+	pActiveInst = nullptr;
+	Deinit();
+}
+
+void cBtDevice::gattClientEventHandler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param){
+}
+
+void cBtDevice::gattServerEventHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param){
+	if(pServer)
+		pServer->handleGATTServerEvent(event, gatts_if, param);
+}
+
+void cBtDevice::gapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param){
+	if(event == ESP_GAP_BLE_SEC_REQ_EVT)
+		esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+	if(pServer)
+		pServer->handleGAPEvent(event, param);
+	if(pScanner)
+		pScanner->handleGAPEvent(event, param);
+}
+
+void cBtDevice::Init(const char *deviceName){
+	esp_ble_gap_register_callback(gapEventHandlerStub);
+	esp_ble_gatts_register_callback(gattServerEventHandlerStub);
+	esp_ble_gap_set_device_name(deviceName);
+	cBtSim::Get().LocalMtu = ESP_GATT_MAX_MTU_SIZE;
+}
+
+void cBtDevice::Deinit(){
+	esp_ble_gap_register_callback(nullptr);
+	esp_ble_gatts_register_callback(nullptr);
+}
+
+// ============================================== cSimCentral ================================================
+
+cSimCentral::cSimCentral(uint16_t _connId):connId(_connId), mtu(ESP_GATT_DEF_BLE_MTU_SIZE), bConnected(false),
+		bEncrypted(false), AutoConfirm(true){
+	uint8_t addr[ESP_BD_ADDR_LEN] = {0xc0, 0x11, 0x22, 0x33, (uint8_t)(_connId >> 8), (uint8_t)_connId};
+	memcpy(bda, addr, sizeof bda);
+}
+
+cSimCentral::~cSimCentral(){
+	// the radio is off, nothing is reported to the server which may be destroyed already
+	cBtSim::Get().conns.erase(connId);
+}
+
+void cSimCentral::Connect(){
+	cBtSim &sim = cBtSim::Get();
+	sim.Dispatch();
+	sim.conns[connId] = cBtSim::sConn{this, {}, false, false};
+	bConnected = true;
+	bEncrypted = false;
+	mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+	unconfirmed.clear();
+	sim.bAdvertising = false; // the connection ends the advertising
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.connect.conn_id = connId;
+	memcpy(param.connect.remote_bda, bda, sizeof bda);
+	sim.gatts(ESP_GATTS_CONNECT_EVT, param);
+	sim.Dispatch();
+}
+
+void cSimCentral::Disconnect(esp_gatt_conn_reason_t reason){
+	cBtSim &sim = cBtSim::Get();
+	sim.Dispatch();
+	sim.conns.erase(connId);
+	bConnected = false;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.disconnect.conn_id = connId;
+	memcpy(param.disconnect.remote_bda, bda, sizeof bda);
+	param.disconnect.reason = reason;
+	sim.gatts(ESP_GATTS_DISCONNECT_EVT, param);
+	sim.Dispatch();
+}
+
+void cSimCentral::Encrypt(bool bSuccess){
+	cBtSim &sim = cBtSim::Get();
+	sim.Dispatch();
+	bEncrypted = bSuccess;
+	esp_ble_gap_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	memcpy(param.ble_security.auth_cmpl.bd_addr, bda, sizeof bda);
+	param.ble_security.auth_cmpl.key_present = bSuccess;
+	param.ble_security.auth_cmpl.success = bSuccess;
+	param.ble_security.auth_cmpl.fail_reason = bSuccess ? 0 : 0x55;
+	sim.gap(ESP_GAP_BLE_AUTH_CMPL_EVT, param);
+	sim.Dispatch();
+}
+
+uint16_t cSimCentral::ExchangeMtu(uint16_t clientMtu){
+	cBtSim &sim = cBtSim::Get();
+	sim.Dispatch();
+	mtu = std::max<uint16_t>(ESP_GATT_DEF_BLE_MTU_SIZE, std::min(clientMtu, sim.LocalMtu));
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.mtu.conn_id = connId;
+	param.mtu.mtu = mtu;
+	sim.gatts(ESP_GATTS_MTU_EVT, param);
+	sim.Dispatch();
+	return mtu;
+}
+
+// the permission checks of the stack, the server does not get the requests it refuses
+esp_gatt_status_t cSimCentral::access(uint16_t handle, bool bWrite){
+	sSimAttr *pAttr = cBtSim::Get().Attr(handle);
+	if(!bConnected)
+		return ESP_GATT_ERROR;
+	if(!pAttr)
+		return ESP_GATT_INVALID_HANDLE;
+	esp_gatt_perm_t allowed = bWrite ? ESP_GATT_PERM_WRITE | ESP_GATT_PERM_WRITE_ENCRYPTED | ESP_GATT_PERM_WRITE_ENC_MITM :
+			ESP_GATT_PERM_READ | ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_READ_ENC_MITM;
+	esp_gatt_perm_t encrypted = bWrite ? ESP_GATT_PERM_WRITE_ENCRYPTED | ESP_GATT_PERM_WRITE_ENC_MITM :
+			ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_READ_ENC_MITM;
+	if(!(pAttr->perm & allowed))
+		return bWrite ? ESP_GATT_WRITE_NOT_PERMIT : ESP_GATT_READ_NOT_PERMIT;
+	if((pAttr->perm & encrypted) && !bEncrypted)
+		return ESP_GATT_INSUF_AUTHENTICATION;
+	return ESP_GATT_OK;
+}
+
+esp_gatt_status_t cSimCentral::request(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param, bool bRsp,
+		std::vector<uint8_t> *pValue){
+	cBtSim &sim = cBtSim::Get();
+	sim.Dispatch();
+	uint32_t trans = ++sim.transId;
+	switch(event){
+	case ESP_GATTS_READ_EVT:
+		param.read.conn_id = connId;
+		param.read.trans_id = trans;
+		memcpy(param.read.bda, bda, sizeof bda);
+		break;
+	case ESP_GATTS_WRITE_EVT:
+		param.write.conn_id = connId;
+		param.write.trans_id = trans;
+		memcpy(param.write.bda, bda, sizeof bda);
+		break;
+	default:
+		param.exec_write.conn_id = connId;
+		param.exec_write.trans_id = trans;
+		memcpy(param.exec_write.bda, bda, sizeof bda);
+		break;
+	}
+	if(bRsp)
+		sim.pending[trans] = true;
+	sim.gatts(event, param);
+	sim.Dispatch();
+	if(!bRsp)
+		return ESP_GATT_OK;
+	auto it = sim.rsps.find(trans);
+	if(it == sim.rsps.end()){
+		sim.pending.erase(trans); // a late response is a stray one
+		return ESP_GATT_ERROR;
+	}
+	esp_gatt_status_t status = it->second.status;
+	if(pValue)
+		pValue->swap(it->second.value);
+	sim.rsps.erase(it);
+	return status;
+}
+
+esp_gatt_status_t cSimCentral::read(uint16_t handle, uint16_t offset, bool bBlob, std::vector<uint8_t> &value){
+	value.clear();
+	esp_gatt_status_t status = access(handle, false);
+	if(status != ESP_GATT_OK)
+		return status;
+	sSimAttr *pAttr = cBtSim::Get().Attr(handle);
+	if(pAttr->bStackValue){
+		if(offset > pAttr->value.size())
+			return ESP_GATT_INVALID_OFFSET;
+		value.assign(pAttr->value.begin() + offset, pAttr->value.begin() + std::min<size_t>(pAttr->value.size(), offset + mtu - 1));
+		return ESP_GATT_OK;
+	}
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.read.handle = handle;
+	param.read.offset = offset;
+	param.read.is_long = bBlob;
+	param.read.need_rsp = true;
+	status = request(ESP_GATTS_READ_EVT, param, true, &value);
+	if(value.size() > (size_t)mtu - 1)
+		value.resize(mtu - 1); // the stack sends what fits
+	return status;
+}
+
+esp_gatt_status_t cSimCentral::Read(uint16_t handle, std::vector<uint8_t> &value){
+	return read(handle, 0, false, value);
+}
+
+esp_gatt_status_t cSimCentral::ReadBlob(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value){
+	return read(handle, offset, true, value);
+}
+
+esp_gatt_status_t cSimCentral::ReadLong(uint16_t handle, std::vector<uint8_t> &value){
+	std::vector<uint8_t> part;
+	esp_gatt_status_t status = Read(handle, part);
+	value = part;
+	while(status == ESP_GATT_OK && part.size() == (size_t)mtu - 1){
+		status = ReadBlob(handle, value.size(), part);
+		value.insert(value.end(), part.begin(), part.end());
+	}
+	return status;
+}
+
+esp_gatt_status_t cSimCentral::Write(uint16_t handle, const std::vector<uint8_t> &value, bool bRsp){
+	if(value.size() > (size_t)mtu - 3)
+		return ESP_GATT_INVALID_ATTR_LEN; // does not fit the PDU
+	esp_gatt_status_t status = access(handle, true);
+	if(status != ESP_GATT_OK)
+		return status;
+	std::vector<uint8_t> data(value);
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.write.handle = handle;
+	param.write.need_rsp = bRsp;
+	param.write.len = data.size();
+	param.write.value = data.data();
+	return request(ESP_GATTS_WRITE_EVT, param, bRsp, nullptr);
+}
+
+esp_gatt_status_t cSimCentral::PrepareWrite(uint16_t handle, uint16_t offset, const uint8_t *data, size_t len){
+	if(len > (size_t)mtu - 5)
+		return ESP_GATT_INVALID_ATTR_LEN;
+	esp_gatt_status_t status = access(handle, true);
+	if(status != ESP_GATT_OK)
+		return status;
+	std::vector<uint8_t> part(data, data + len), echo;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.write.handle = handle;
+	param.write.offset = offset;
+	param.write.need_rsp = true;
+	param.write.is_prep = true;
+	param.write.len = part.size();
+	param.write.value = part.data();
+	status = request(ESP_GATTS_WRITE_EVT, param, true, &echo);
+	// the response repeats the part, the client checks it
+	if(status == ESP_GATT_OK && echo != part)
+		return ESP_GATT_ERROR;
+	return status;
+}
+
+esp_gatt_status_t cSimCentral::ExecuteWrite(bool bExec){
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.exec_write.exec_write_flag = bExec ? ESP_GATT_PREP_WRITE_EXEC : ESP_GATT_PREP_WRITE_CANCEL;
+	return request(ESP_GATTS_EXEC_WRITE_EVT, param, true, nullptr);
+}
+
+esp_gatt_status_t cSimCentral::WriteLong(uint16_t handle, const std::vector<uint8_t> &value){
+	size_t part = mtu - 5;
+	for(size_t offset = 0; offset < value.size(); offset += part){
+		esp_gatt_status_t status = PrepareWrite(handle, offset, value.data() + offset, std::min(part, value.size() - offset));
+		if(status != ESP_GATT_OK){
+			ExecuteWrite(false);
+			return status;
+		}
+	}
+	return ExecuteWrite(true);
+}
+
+esp_gatt_status_t cSimCentral::Subscribe(uint16_t charHandle, uint16_t bits){
+	uint16_t cccd = cBtSim::Get().FindDesc(charHandle, BLEUUID((uint16_t)ESP_GATT_UUID_CHAR_CLIENT_CONFIG));
+	if(!cccd)
+		return ESP_GATT_NOT_FOUND;
+	return Write(cccd, {(uint8_t)bits, (uint8_t)(bits >> 8)});
+}
+
+bool cSimCentral::Confirm(){
+	cBtSim &sim = cBtSim::Get();
+	auto it = sim.conns.find(connId);
+	if(unconfirmed.empty() || it == sim.conns.end())
+		return false;
+	it->second.indicating = false;
+	esp_ble_gatts_cb_param_t param;
+	memset(&param, 0, sizeof param);
+	param.conf.status = ESP_GATT_OK;
+	param.conf.conn_id = connId;
+	param.conf.handle = unconfirmed.front();
+	unconfirmed.pop_front();
+	sim.queueGatts(ESP_GATTS_CONF_EVT, param);
+	sim.Dispatch();
+	return true;
+}
@@ -0,0 +1,178 @@
+/*
+ * bt_sim.h
+ *
+ *  Simulated Bluedroid stack of the host build of cBtServer and cBtScanner, a scriptable central connected to it
+ */
+
+#ifndef TEST_HOST_BT_SIM_H_
+#define TEST_HOST_BT_SIM_H_
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <vector>
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
+#include "../../components/m_bt/BLEUUID.h"
+
+#define SIM_GATTS_IF		3 // interface of the registered application
+#define SIM_FIRST_HANDLE	0x28 // the GAP and GATT services of the stack are before
+
+// attribute of the simulated database
+struct sSimAttr{
+	uint16_t handle;
+	BLEUUID uuid;
+	esp_gatt_perm_t perm;
+	bool bStackValue; // declarations, the stack answers the reads with the value
+	std::vector<uint8_t> value;
+};
+
+// notification or indication received by the central
+struct sSimValue{
+	uint16_t handle;
+	bool bIndication;
+	std::vector<uint8_t> data;
+};
+
+class cSimCentral;
+
+// The stack: the setup calls (registration, services, attributes) answer at once, the server waits for
+// them in semaphores. The other events are queued and delivered by Dispatch() or Run() like by the BTC task,
+// so the server gets them without its locks taken.
+class cBtSim{
+public:
+	static cBtSim& Get();
+	// forget the database, the connections and the counters
+	void Reset();
+
+	std::vector<sSimAttr> attrs; // the database built by the services, by the handle order
+	sSimAttr* Attr(uint16_t handle);
+	// value handle of the characteristic, 0 if there is none
+	uint16_t FindChar(const BLEUUID &uuid);
+	// handle of the descriptor of the characteristic (its value handle), 0 if there is none
+	uint16_t FindDesc(uint16_t charHandle, const BLEUUID &uuid);
+
+	// GAP state and the requests of the server
+	bool bAdvertising;
+	esp_ble_adv_params_t advParams;
+	int advConfigs; // esp_ble_gap_config_adv_data calls
+	std::vector<uint8_t> advData; // the last raw advertisement data
+	int advStarts;
+	std::vector<esp_ble_conn_update_params_t> connUpdates;
+	bool AcceptConnParams; // the central accepts the requested parameters, default true
+	// scanner requests
+	bool bScanning;
+	esp_ble_scan_params_t scanParams;
+	uint32_t scanDuration; // seconds of the last start, 0 - until stopped
+	int scanStarts;
+	// received advertisement (and the scan response of the active scan), ignored if not scanning;
+	// returns true if the scan result is queued
+	bool Advertise(const esp_bd_addr_t bda, int rssi, const std::vector<uint8_t> &adv,
+			const std::vector<uint8_t> &rsp = std::vector<uint8_t>());
+	// the scan duration is over
+	void ScanEnd();
+
+	// link model: the packets of a connection wait for the next connection event, the stack reports
+	// the congestion when CongestLimit packets are waiting, default 10
+	size_t CongestLimit;
+	uint16_t LocalMtu; // set by cBtDevice::Init(), default ESP_GATT_MAX_MTU_SIZE
+
+	// counters
+	uint32_t sent; // notifications and indications accepted by esp_ble_gatts_send_indicate
+	uint32_t rejected; // refused: no connection, congested or an indication is not confirmed yet
+	uint32_t truncated; // longer than MTU-3, cut like by the stack
+	uint32_t responses;
+	uint32_t strayResponses; // for no request or a second one for the same request
+	uint32_t handleErrors; // attributes which exceeded the handles of their service
+
+	// deliver the queued events, returns their number
+	int Dispatch();
+	// deliver the events and the packets until nothing is left, the confirmations of AutoConfirm centrals
+	// included; returns the number of the events
+	int Run();
+	// one connection event: the waiting packets are received, then the events are delivered
+	int Step();
+
+	// implementation of the API
+	esp_gatts_cb_t gattsCb;
+	esp_gap_ble_cb_t gapCb;
+	struct sEvent{
+		bool bGap;
+		int event;
+		esp_ble_gatts_cb_param_t gatts;
+		esp_ble_gap_cb_param_t gap;
+	};
+	std::deque<sEvent> events;
+	struct sPacket{
+		uint16_t handle;
+		bool bIndication;
+		std::vector<uint8_t> data;
+	};
+	struct sConn{
+		cSimCentral *pCentral;
+		std::deque<sPacket> air;
+		bool congested;
+		bool indicating; // an indication is not confirmed yet
+	};
+	std::map<uint16_t, sConn> conns;
+	struct sResponse{
+		esp_gatt_status_t status;
+		std::vector<uint8_t> value;
+	};
+	std::map<uint32_t, sResponse> rsps; // by the transaction
+	std::map<uint32_t, bool> pending; // requests waiting for the response
+	uint32_t transId;
+	uint16_t nextHandle;
+	uint16_t svcEnd; // the last handle of the service being created
+	void gatts(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param);
+	void gap(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t &param);
+	void queueGatts(esp_gatts_cb_event_t event, const esp_ble_gatts_cb_param_t &param);
+	void queueGap(esp_gap_ble_cb_event_t event, const esp_ble_gap_cb_param_t &param);
+	uint16_t addAttr(const BLEUUID &uuid, esp_gatt_perm_t perm, bool bStackValue, const uint8_t *value, size_t len);
+
+private:
+	cBtSim();
+};
+
+// Client of the simulated server. The requests are delivered to the server at once (with the events queued
+// before them) and return the status of its response, ESP_GATT_ERROR if it did not respond.
+class cSimCentral{
+public:
+	uint16_t connId;
+	esp_bd_addr_t bda;
+	uint16_t mtu;
+	bool bConnected;
+	bool bEncrypted;
+	bool AutoConfirm; // indications are confirmed by cBtSim::Step(), default true
+	std::deque<uint16_t> unconfirmed; // handles of the received indications without the confirmation
+	std::vector<sSimValue> received;
+
+	cSimCentral(uint16_t connId);
+	~cSimCentral();
+	void Connect();
+	void Disconnect(esp_gatt_conn_reason_t reason = ESP_GATT_CONN_TERMINATE_PEER_USER);
+	// pairing or encryption by the bonded keys, ESP_GAP_BLE_AUTH_CMPL_EVT
+	void Encrypt(bool bSuccess = true);
+	// returns the negotiated MTU
+	uint16_t ExchangeMtu(uint16_t clientMtu);
+	esp_gatt_status_t Read(uint16_t handle, std::vector<uint8_t> &value);
+	esp_gatt_status_t ReadBlob(uint16_t handle, uint16_t offset, std::vector<uint8_t> &value);
+	// read and the blobs until a part shorter than MTU-1
+	esp_gatt_status_t ReadLong(uint16_t handle, std::vector<uint8_t> &value);
+	esp_gatt_status_t Write(uint16_t handle, const std::vector<uint8_t> &value, bool bRsp = true);
+	esp_gatt_status_t PrepareWrite(uint16_t handle, uint16_t offset, const uint8_t *data, size_t len);
+	esp_gatt_status_t ExecuteWrite(bool bExec = true);
+	// prepared writes of MTU-5 bytes and the execution, cancelled if a part fails
+	esp_gatt_status_t WriteLong(uint16_t handle, const std::vector<uint8_t> &value);
+	// BT_CCCD_xxx bits to the CCCD of the characteristic
+	esp_gatt_status_t Subscribe(uint16_t charHandle, uint16_t bits);
+	// confirm the oldest unconfirmed indication
+	bool Confirm();
+
+private:
+	esp_gatt_status_t request(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t &param, bool bRsp, std::vector<uint8_t> *pValue);
+	esp_gatt_status_t access(uint16_t handle, bool bWrite);
+	esp_gatt_status_t read(uint16_t handle, uint16_t offset, bool bBlob, std::vector<uint8_t> &value);
+};
+
+#endif /* TEST_HOST_BT_SIM_H_ */
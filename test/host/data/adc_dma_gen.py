@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+#
+# adc_dma_gen.py
+#
+#  Sample files of the I2S ADC DMA for test_adc_demux: 16 bit little endian words as i2s_read() returns them,
+#  channel in bits 12..15, every two words in the reversed order. Run from this directory to regenerate.
+#
+
+import math
+import random
+import struct
+
+
+def write(name, samples):
+	# the DMA stores the second sample of the pair first
+	words = []
+	for i in range(0, len(samples) - 1, 2):
+		words += [samples[i + 1], samples[i]]
+	with open(name, 'wb') as f:
+		f.write(struct.pack('<%dH' % len(words), *words))
+
+
+def word(ch, value):
+	return (ch << 12) | max(0, min(4095, int(round(value))))
+
+
+random.seed(3)
+rate = 16000 / 3 # per channel
+
+# air quality (ch 0), PIR (ch 3) and battery (ch 6) at 16 kHz: the pattern takes effect after 6 samples
+# of the first channel, the PIR swings by 50 Hz mains pickup and a motion at the half
+samples = [word(0, 1800 + random.gauss(0, 4)) for _ in range(6)]
+for n in range(1000):
+	t = n / rate
+	pir = 2048 + 30 * math.sin(2 * math.pi * 50 * t) + (400 if n >= 500 else 0)
+	samples += [word(0, 1800 + random.gauss(0, 4)), word(3, pir + random.gauss(0, 3)),
+			word(6, 2600 + random.gauss(0, 2))]
+write('adc_dma_3ch.bin', samples)
+
+# one channel ramp: the order of the samples is visible
+write('adc_dma_ramp.bin', [word(3, n % 4096) for n in range(4096)])
@@ -0,0 +1,12 @@
+/*
+ * esp_bt.h
+ *
+ *  Host shim: the controller API is not used by the host built components, the simulated stack is always enabled
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_BT_H_
+#define TEST_HOST_SHIM_ESP_BT_H_
+
+#include "esp_bt_defs.h"
+
+#endif /* TEST_HOST_SHIM_ESP_BT_H_ */
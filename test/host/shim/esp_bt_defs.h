@@ -0,0 +1,44 @@
+/*
+ * esp_bt_defs.h
+ *
+ *  Host shim: the Bluetooth types of ESP-IDF v3.3 the components use
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_BT_DEFS_H_
+#define TEST_HOST_SHIM_ESP_BT_DEFS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define ESP_UUID_LEN_16		2
+#define ESP_UUID_LEN_32		4
+#define ESP_UUID_LEN_128	16
+
+typedef struct {
+	uint16_t len;
+	union {
+		uint16_t uuid16;
+		uint32_t uuid32;
+		uint8_t uuid128[ESP_UUID_LEN_128];
+	} uuid;
+} __attribute__((packed)) esp_bt_uuid_t;
+
+#define ESP_BD_ADDR_LEN		6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum {
+	BLE_ADDR_TYPE_PUBLIC = 0x00,
+	BLE_ADDR_TYPE_RANDOM = 0x01,
+	BLE_ADDR_TYPE_RPA_PUBLIC = 0x02,
+	BLE_ADDR_TYPE_RPA_RANDOM = 0x03,
+} esp_ble_addr_type_t;
+
+typedef uint8_t esp_ble_key_mask_t;
+
+typedef enum {
+	ESP_BT_STATUS_SUCCESS = 0,
+	ESP_BT_STATUS_FAIL,
+} esp_bt_status_t;
+
+#endif /* TEST_HOST_SHIM_ESP_BT_DEFS_H_ */
@@ -0,0 +1,12 @@
+/*
+ * esp_bt_main.h
+ *
+ *  Host shim: the Bluedroid control API is not used by the host built components
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_BT_MAIN_H_
+#define TEST_HOST_SHIM_ESP_BT_MAIN_H_
+
+#include "esp_err.h"
+
+#endif /* TEST_HOST_SHIM_ESP_BT_MAIN_H_ */
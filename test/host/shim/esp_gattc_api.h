@@ -0,0 +1,24 @@
+/*
+ * esp_gattc_api.h
+ *
+ *  Host shim: the GATT client types cBtDevice.h refers to, the client is not in the host build
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_GATTC_API_H_
+#define TEST_HOST_SHIM_ESP_GATTC_API_H_
+
+#include "esp_bt_defs.h"
+#include "esp_gatt_defs.h"
+
+typedef enum {
+	ESP_GATTC_REG_EVT = 0,
+} esp_gattc_cb_event_t;
+
+typedef union {
+	struct gattc_reg_evt_param {
+		esp_gatt_status_t status;
+		uint16_t app_id;
+	} reg;
+} esp_ble_gattc_cb_param_t;
+
+#endif /* TEST_HOST_SHIM_ESP_GATTC_API_H_ */
@@ -0,0 +1,26 @@
+/*
+ * esp_log.h
+ *
+ *  Host shim: ESP_LOGx print to stderr if the level is enabled by HOST_LOG=<1..5> (default off)
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_LOG_H_
+#define TEST_HOST_SHIM_ESP_LOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void host_log(int level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ESP_LOGE(tag, format, ...) host_log(1, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log(2, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log(3, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) host_log(4, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) host_log(5, tag, format, ##__VA_ARGS__)
+
+#endif /* TEST_HOST_SHIM_ESP_LOG_H_ */
@@ -0,0 +1,26 @@
+/*
+ * esp_system.h
+ *
+ *  Host shim: the heap counters, the heap in use by the process is taken from HOST_HEAP_SIZE (host.cpp)
+ */
+
+#ifndef TEST_HOST_SHIM_ESP_SYSTEM_H_
+#define TEST_HOST_SHIM_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define HOST_HEAP_SIZE		(300 * 1024) // free heap of the application after the start
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_HOST_SHIM_ESP_SYSTEM_H_ */
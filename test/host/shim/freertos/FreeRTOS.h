@@ -0,0 +1,25 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Host shim: the FreeRTOS types and constants the components use, one tick is 1 ms
+ */
+
+#ifndef TEST_HOST_SHIM_FREERTOS_H_
+#define TEST_HOST_SHIM_FREERTOS_H_
+
+#include <stdint.h>
+#include <assert.h> // by FreeRTOSConfig.h in ESP-IDF, the components rely on it
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portTICK_PERIOD_MS	1
+#define portMAX_DELAY		((TickType_t)0xffffffff)
+
+#define pdFALSE				0
+#define pdTRUE				1
+#define pdFAIL				pdFALSE
+#define pdPASS				pdTRUE
+
+#endif /* TEST_HOST_SHIM_FREERTOS_H_ */
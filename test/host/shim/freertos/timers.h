@@ -0,0 +1,27 @@
+/*
+ * timers.h
+ *
+ *  Host shim: FreeRTOS software timers, run by host_timers_run() of the test at cBaseTask::GetTickCount() (timers.cpp)
+ */
+
+#ifndef TEST_HOST_SHIM_FREERTOS_TIMERS_H_
+#define TEST_HOST_SHIM_FREERTOS_TIMERS_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sHostTimer* TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t autoReload, void *timerId,
+		TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void* pvTimerGetTimerID(TimerHandle_t timer);
+
+// test control, not in the application: call the callbacks of the expired timers, returns their number
+int host_timers_run();
+
+#endif /* TEST_HOST_SHIM_FREERTOS_TIMERS_H_ */
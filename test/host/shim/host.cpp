@@ -0,0 +1,50 @@
+/*
+ * host.cpp
+ *
+ *  Host shim: logging and the heap counters
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include "esp_log.h"
+#include "esp_system.h"
+
+static int log_level(){
+	static int level = -1;
+	if(level < 0){
+		const char *env = getenv("HOST_LOG");
+		level = env ? atoi(env) : 0;
+	}
+	return level;
+}
+
+void host_log(int level, const char *tag, const char *format, ...){
+	static const char letters[] = "NEWIDV";
+	if(level > log_level())
+		return;
+	va_list args;
+	va_start(args, format);
+	fprintf(stderr, "%c (%s) ", letters[level], tag);
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+	va_end(args);
+}
+
+// the heap allocated since the first call is taken from HOST_HEAP_SIZE, the minimum is sampled by the calls
+static uint32_t min_free_heap = HOST_HEAP_SIZE;
+
+uint32_t esp_get_free_heap_size(void){
+	static const size_t start = mallinfo2().uordblks;
+	size_t used = mallinfo2().uordblks;
+	uint32_t left = used > start + HOST_HEAP_SIZE ? 0 : HOST_HEAP_SIZE - (uint32_t)(used > start ? used - start : 0);
+	if(left < min_free_heap)
+		min_free_heap = left;
+	return left;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void){
+	esp_get_free_heap_size();
+	return min_free_heap;
+}
@@ -0,0 +1,69 @@
+/*
+ * cBaseTask.h
+ *
+ *  Host shim of the application task and lock classes, implemented by pthreads in task.cpp
+ */
+
+#ifndef TEST_HOST_SHIM_CBASETASK_H_
+#define TEST_HOST_SHIM_CBASETASK_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+class cBaseTask {
+public:
+	cBaseTask();
+	virtual ~cBaseTask();
+	// milliseconds since the start, host_tick_advance() moves it forward
+	static uint32_t GetTickCount();
+	static void Reboot();
+
+protected:
+	void TaskCreate(const char *name, int prio = 5, int stack = 4096);
+	// from the task itself it does not return
+	void TaskDelete();
+	bool IsTaskExists();
+	virtual void TaskHandler() = 0;
+
+private:
+	pthread_t m_thread;
+	bool m_bExists;
+	static void* entry(void *arg);
+};
+
+// not recursive, as a FreeRTOS mutex; locking it twice from one thread aborts the test
+class cMutex {
+	pthread_mutex_t m_mutex;
+	pthread_t m_owner;
+	bool m_bOwned;
+public:
+	cMutex();
+	~cMutex();
+	void Lock();
+	void Unlock();
+};
+
+class cAutoLock {
+	cMutex &m_mutex;
+public:
+	cAutoLock(cMutex &mutex):m_mutex(mutex){m_mutex.Lock();}
+	~cAutoLock(){m_mutex.Unlock();}
+};
+
+// binary semaphore: Lock() takes it, Unlock() gives it, Wait() waits until it is given
+class cSemaphore {
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+	bool m_bTaken;
+public:
+	cSemaphore(const char *name = nullptr);
+	~cSemaphore();
+	bool Lock(uint32_t ticks = 0xffffffff);
+	void Unlock();
+	void Wait();
+};
+
+// test control, not in the application
+void host_tick_advance(uint32_t ms);
+
+#endif /* TEST_HOST_SHIM_CBASETASK_H_ */
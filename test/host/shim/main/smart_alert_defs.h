@@ -0,0 +1,15 @@
+/*
+ * smart_alert_defs.h
+ *
+ *  Host shim: the definitions of the application the components use
+ */
+
+#ifndef TEST_HOST_SHIM_SMART_ALERT_DEFS_H_
+#define TEST_HOST_SHIM_SMART_ALERT_DEFS_H_
+
+#include "esp_log.h"
+
+// time stamped message of the application log
+#define TS_PRINT(msg)	host_log(3, "TS", "%u %s", cBaseTask::GetTickCount(), msg)
+
+#endif /* TEST_HOST_SHIM_SMART_ALERT_DEFS_H_ */
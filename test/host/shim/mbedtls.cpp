@@ -0,0 +1,221 @@
+/*
+ * mbedtls.cpp
+ *
+ *  Host shim: plain SHA-1, SHA-256 and base64, the software path of the hash stage
+ */
+
+#include <string.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/base64.h"
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+static uint32_t get_be32(const unsigned char *p){
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void put_be32(uint32_t v, unsigned char *p){
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+// common block buffering of both algorithms
+template<typename tCtx, void (*tProcess)(tCtx*, const unsigned char*)>
+static void hash_update(tCtx *ctx, const unsigned char *input, size_t ilen){
+	size_t fill = ctx->total[0] & 0x3f;
+	ctx->total[0] += (uint32_t)ilen;
+	if(ctx->total[0] < (uint32_t)ilen)
+		ctx->total[1]++;
+	ctx->total[1] += (uint32_t)((uint64_t)ilen >> 32);
+	if(fill && ilen >= 64 - fill){
+		memcpy(ctx->buffer + fill, input, 64 - fill);
+		tProcess(ctx, ctx->buffer);
+		input += 64 - fill;
+		ilen -= 64 - fill;
+		fill = 0;
+	}
+	while(ilen >= 64){
+		tProcess(ctx, input);
+		input += 64;
+		ilen -= 64;
+	}
+	if(ilen)
+		memcpy(ctx->buffer + fill, input, ilen);
+}
+
+template<typename tCtx, void (*tProcess)(tCtx*, const unsigned char*)>
+static void hash_pad(tCtx *ctx){
+	uint32_t high = (ctx->total[0] >> 29) | (ctx->total[1] << 3);
+	uint32_t low = ctx->total[0] << 3;
+	size_t fill = ctx->total[0] & 0x3f;
+	ctx->buffer[fill++] = 0x80;
+	if(fill > 56){
+		memset(ctx->buffer + fill, 0, 64 - fill);
+		tProcess(ctx, ctx->buffer);
+		fill = 0;
+	}
+	memset(ctx->buffer + fill, 0, 56 - fill);
+	put_be32(high, ctx->buffer + 56);
+	put_be32(low, ctx->buffer + 60);
+	tProcess(ctx, ctx->buffer);
+}
+
+static void sha1_process(mbedtls_sha1_context *ctx, const unsigned char *data){
+	uint32_t w[80];
+	for(int i = 0; i < 16; i++)
+		w[i] = get_be32(data + 4 * i);
+	for(int i = 16; i < 80; i++)
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3], e = ctx->state[4];
+	for(int i = 0; i < 80; i++){
+		uint32_t f, k;
+		if(i < 20){
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		}else if(i < 40){
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		}else if(i < 60){
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		}else{
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		uint32_t t = ROL(a, 5) + f + e + k + w[i];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+	ctx->state[4] += e;
+}
+
+void mbedtls_sha1_init(mbedtls_sha1_context *ctx){
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha1_free(mbedtls_sha1_context *ctx){
+	if(ctx)
+		memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha1_starts(mbedtls_sha1_context *ctx){
+	static const uint32_t init[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+	ctx->total[0] = ctx->total[1] = 0;
+	memcpy(ctx->state, init, sizeof init);
+}
+
+void mbedtls_sha1_update(mbedtls_sha1_context *ctx, const unsigned char *input, size_t ilen){
+	hash_update<mbedtls_sha1_context, sha1_process>(ctx, input, ilen);
+}
+
+void mbedtls_sha1_finish(mbedtls_sha1_context *ctx, unsigned char output[20]){
+	hash_pad<mbedtls_sha1_context, sha1_process>(ctx);
+	for(int i = 0; i < 5; i++)
+		put_be32(ctx->state[i], output + 4 * i);
+}
+
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void sha256_process(mbedtls_sha256_context *ctx, const unsigned char *data){
+	uint32_t w[64];
+	for(int i = 0; i < 16; i++)
+		w[i] = get_be32(data + 4 * i);
+	for(int i = 16; i < 64; i++){
+		uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+	uint32_t s[8];
+	memcpy(s, ctx->state, sizeof s);
+	for(int i = 0; i < 64; i++){
+		uint32_t S1 = ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25);
+		uint32_t ch = (s[4] & s[5]) ^ (~s[4] & s[6]);
+		uint32_t t1 = s[7] + S1 + ch + K256[i] + w[i];
+		uint32_t S0 = ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22);
+		uint32_t maj = (s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]);
+		memmove(s + 1, s, 7 * sizeof(uint32_t));
+		s[4] += t1;
+		s[0] = t1 + S0 + maj;
+	}
+	for(int i = 0; i < 8; i++)
+		ctx->state[i] += s[i];
+}
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx){
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx){
+	if(ctx)
+		memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224){
+	static const uint32_t init256[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+	static const uint32_t init224[8] = {0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+			0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4};
+	ctx->total[0] = ctx->total[1] = 0;
+	memcpy(ctx->state, is224 ? init224 : init256, sizeof init256);
+	ctx->is224 = is224;
+}
+
+void mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen){
+	hash_update<mbedtls_sha256_context, sha256_process>(ctx, input, ilen);
+}
+
+void mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]){
+	hash_pad<mbedtls_sha256_context, sha256_process>(ctx);
+	for(int i = 0; i < (ctx->is224 ? 7 : 8); i++)
+		put_be32(ctx->state[i], output + 4 * i);
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen){
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t n = (slen + 2) / 3 * 4;
+	if(!dst || dlen < n + 1){
+		*olen = n + 1;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+	unsigned char *p = dst;
+	size_t i = 0;
+	for(; i + 3 <= slen; i += 3){
+		uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+		*p++ = digits[(v >> 18) & 0x3f];
+		*p++ = digits[(v >> 12) & 0x3f];
+		*p++ = digits[(v >> 6) & 0x3f];
+		*p++ = digits[v & 0x3f];
+	}
+	if(i < slen){
+		uint32_t v = src[i] << 16;
+		if(i + 1 < slen)
+			v |= src[i + 1] << 8;
+		*p++ = digits[(v >> 18) & 0x3f];
+		*p++ = digits[(v >> 12) & 0x3f];
+		*p++ = i + 1 < slen ? digits[(v >> 6) & 0x3f] : '=';
+		*p++ = '=';
+	}
+	*p = 0;
+	*olen = p - dst;
+	return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * base64.h
+ *
+ *  Host shim: mbedtls 2.x base64 API, portable implementation in mbedtls.cpp
+ */
+
+#ifndef TEST_HOST_SHIM_MBEDTLS_BASE64_H_
+#define TEST_HOST_SHIM_MBEDTLS_BASE64_H_
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL	-0x002A
+
+// dlen must hold the terminating zero as well, *olen is the length without it
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+
+#endif /* TEST_HOST_SHIM_MBEDTLS_BASE64_H_ */
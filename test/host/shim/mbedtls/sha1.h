@@ -0,0 +1,25 @@
+/*
+ * sha1.h
+ *
+ *  Host shim: mbedtls 2.x SHA-1 API, portable implementation in mbedtls.cpp
+ */
+
+#ifndef TEST_HOST_SHIM_MBEDTLS_SHA1_H_
+#define TEST_HOST_SHIM_MBEDTLS_SHA1_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct{
+	uint32_t total[2];
+	uint32_t state[5];
+	unsigned char buffer[64];
+} mbedtls_sha1_context;
+
+void mbedtls_sha1_init(mbedtls_sha1_context *ctx);
+void mbedtls_sha1_free(mbedtls_sha1_context *ctx);
+void mbedtls_sha1_starts(mbedtls_sha1_context *ctx);
+void mbedtls_sha1_update(mbedtls_sha1_context *ctx, const unsigned char *input, size_t ilen);
+void mbedtls_sha1_finish(mbedtls_sha1_context *ctx, unsigned char output[20]);
+
+#endif /* TEST_HOST_SHIM_MBEDTLS_SHA1_H_ */
@@ -0,0 +1,26 @@
+/*
+ * sha256.h
+ *
+ *  Host shim: mbedtls 2.x SHA-256 API, portable implementation in mbedtls.cpp
+ */
+
+#ifndef TEST_HOST_SHIM_MBEDTLS_SHA256_H_
+#define TEST_HOST_SHIM_MBEDTLS_SHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct{
+	uint32_t total[2];
+	uint32_t state[8];
+	unsigned char buffer[64];
+	int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+void mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+void mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]);
+
+#endif /* TEST_HOST_SHIM_MBEDTLS_SHA256_H_ */
@@ -0,0 +1,70 @@
+/*
+ * nvs.h
+ *
+ *  Host shim: NVS key-value API over an in-memory map, optionally persisted to a file (nvs_host.cpp)
+ */
+
+#ifndef TEST_HOST_SHIM_NVS_H_
+#define TEST_HOST_SHIM_NVS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define ESP_ERR_NVS_BASE				0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED		(ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND			(ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_TYPE_MISMATCH		(ESP_ERR_NVS_BASE + 0x03)
+#define ESP_ERR_NVS_READ_ONLY			(ESP_ERR_NVS_BASE + 0x04)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE	(ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_NAME		(ESP_ERR_NVS_BASE + 0x06)
+#define ESP_ERR_NVS_INVALID_HANDLE		(ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_KEY_TOO_LONG		(ESP_ERR_NVS_BASE + 0x09)
+#define ESP_ERR_NVS_INVALID_LENGTH		(ESP_ERR_NVS_BASE + 0x0c)
+
+#define NVS_KEY_NAME_MAX_SIZE	16
+#define NVS_BLOB_MAX_SIZE		1984 // a page minus the overhead, as on the target
+
+typedef uint32_t nvs_handle;
+
+typedef enum{
+	NVS_READONLY,
+	NVS_READWRITE
+} nvs_open_mode;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle);
+void nvs_close(nvs_handle handle);
+esp_err_t nvs_commit(nvs_handle handle);
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key);
+esp_err_t nvs_erase_all(nvs_handle handle);
+esp_err_t nvs_set_u8(nvs_handle handle, const char *key, uint8_t value);
+esp_err_t nvs_get_u8(nvs_handle handle, const char *key, uint8_t *out_value);
+esp_err_t nvs_set_u32(nvs_handle handle, const char *key, uint32_t value);
+esp_err_t nvs_get_u32(nvs_handle handle, const char *key, uint32_t *out_value);
+esp_err_t nvs_set_str(nvs_handle handle, const char *key, const char *value);
+esp_err_t nvs_get_str(nvs_handle handle, const char *key, char *out_value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length);
+
+// test control, not in ESP-IDF
+// keep the storage in the file, it is loaded now and written on every commit; nullptr - memory only
+void nvs_host_set_file(const char *path);
+// drop everything in memory (power loss without the file)
+void nvs_host_reset();
+// the next `count` writes succeed, the following ones fail with ESP_ERR_NVS_NOT_ENOUGH_SPACE; -1 - no limit
+void nvs_host_fail_after(int count);
+// commits since nvs_host_reset(), the flash writes of the device
+size_t nvs_host_commits();
+// number of keys of the namespace and bytes of their values
+size_t nvs_host_keys(const char *name);
+size_t nvs_host_bytes(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_HOST_SHIM_NVS_H_ */
@@ -0,0 +1,22 @@
+/*
+ * nvs_flash.h
+ *
+ *  Host shim: NVS partition initialization
+ */
+
+#ifndef TEST_HOST_SHIM_NVS_FLASH_H_
+#define TEST_HOST_SHIM_NVS_FLASH_H_
+
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t nvs_flash_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEST_HOST_SHIM_NVS_FLASH_H_ */
@@ -0,0 +1,242 @@
+/*
+ * nvs_host.cpp
+ *
+ *  Host shim: NVS storage, namespace -> key -> typed value
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "nvs_flash.h"
+
+namespace {
+
+enum eType{e_u8 = 1, e_u32, e_str, e_blob};
+
+struct sValue{
+	int type;
+	std::vector<uint8_t> data;
+};
+
+typedef std::map<std::string, sValue> tSpace;
+
+std::mutex lock;
+std::map<std::string, tSpace> spaces;
+std::vector<std::string> handles; // handle - 1 -> namespace
+std::string file;
+int writes_left = -1;
+size_t commits = 0;
+
+// one record: namespace\0 key\0 type, length (4 bytes LE), data
+void save_file(){
+	if(file.empty())
+		return;
+	FILE *f = fopen(file.c_str(), "wb");
+	if(!f)
+		return;
+	for(auto &s : spaces){
+		for(auto &k : s.second){
+			uint32_t len = k.second.data.size();
+			uint8_t hdr[5] = {(uint8_t)k.second.type, (uint8_t)len, (uint8_t)(len >> 8), (uint8_t)(len >> 16), (uint8_t)(len >> 24)};
+			fwrite(s.first.c_str(), 1, s.first.size() + 1, f);
+			fwrite(k.first.c_str(), 1, k.first.size() + 1, f);
+			fwrite(hdr, 1, sizeof hdr, f);
+			fwrite(k.second.data.data(), 1, len, f);
+		}
+	}
+	fclose(f);
+}
+
+bool read_cstr(FILE *f, std::string &s){
+	s.clear();
+	int c;
+	while((c = fgetc(f)) > 0)
+		s += (char)c;
+	return c == 0;
+}
+
+void load_file(){
+	spaces.clear();
+	FILE *f = fopen(file.c_str(), "rb");
+	if(!f)
+		return;
+	std::string ns, key;
+	uint8_t hdr[5];
+	while(read_cstr(f, ns) && read_cstr(f, key) && fread(hdr, 1, sizeof hdr, f) == sizeof hdr){
+		sValue &v = spaces[ns][key];
+		v.type = hdr[0];
+		v.data.resize(hdr[1] | (hdr[2] << 8) | (hdr[3] << 16) | ((uint32_t)hdr[4] << 24));
+		if(fread(v.data.data(), 1, v.data.size(), f) != v.data.size())
+			break;
+	}
+	fclose(f);
+}
+
+tSpace* space(nvs_handle handle){
+	if(handle < 1 || handle > handles.size())
+		return nullptr;
+	return &spaces[handles[handle - 1]];
+}
+
+esp_err_t set(nvs_handle handle, const char *key, int type, const void *data, size_t len){
+	std::lock_guard<std::mutex> guard(lock);
+	tSpace *s = space(handle);
+	if(!s)
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	if(strlen(key) >= NVS_KEY_NAME_MAX_SIZE)
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	if(type == e_blob && len > NVS_BLOB_MAX_SIZE)
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	if(writes_left == 0)
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	if(writes_left > 0)
+		writes_left--;
+	sValue &v = (*s)[key];
+	v.type = type;
+	v.data.assign((const uint8_t*)data, (const uint8_t*)data + len);
+	return ESP_OK;
+}
+
+esp_err_t get(nvs_handle handle, const char *key, int type, void *out, size_t *length){
+	std::lock_guard<std::mutex> guard(lock);
+	tSpace *s = space(handle);
+	if(!s)
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	auto it = s->find(key);
+	if(it == s->end())
+		return ESP_ERR_NVS_NOT_FOUND;
+	if(it->second.type != type)
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	size_t len = it->second.data.size();
+	if(out){
+		if(*length < len)
+			return ESP_ERR_NVS_INVALID_LENGTH;
+		memcpy(out, it->second.data.data(), len);
+	}
+	*length = len;
+	return ESP_OK;
+}
+
+}
+
+esp_err_t nvs_flash_init(void){
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle){
+	std::lock_guard<std::mutex> guard(lock);
+	if(strlen(name) >= NVS_KEY_NAME_MAX_SIZE)
+		return ESP_ERR_NVS_INVALID_NAME;
+	if(open_mode == NVS_READONLY && !spaces.count(name))
+		return ESP_ERR_NVS_NOT_FOUND;
+	handles.push_back(name);
+	*out_handle = handles.size();
+	return ESP_OK;
+}
+
+void nvs_close(nvs_handle handle){
+}
+
+esp_err_t nvs_commit(nvs_handle handle){
+	std::lock_guard<std::mutex> guard(lock);
+	if(!space(handle))
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	commits++;
+	save_file();
+	return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key){
+	std::lock_guard<std::mutex> guard(lock);
+	tSpace *s = space(handle);
+	if(!s)
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	return s->erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle handle){
+	std::lock_guard<std::mutex> guard(lock);
+	tSpace *s = space(handle);
+	if(!s)
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	s->clear();
+	return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle handle, const char *key, uint8_t value){
+	return set(handle, key, e_u8, &value, sizeof value);
+}
+
+esp_err_t nvs_get_u8(nvs_handle handle, const char *key, uint8_t *out_value){
+	size_t len = sizeof *out_value;
+	return get(handle, key, e_u8, out_value, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle handle, const char *key, uint32_t value){
+	return set(handle, key, e_u32, &value, sizeof value);
+}
+
+esp_err_t nvs_get_u32(nvs_handle handle, const char *key, uint32_t *out_value){
+	size_t len = sizeof *out_value;
+	return get(handle, key, e_u32, out_value, &len);
+}
+
+esp_err_t nvs_set_str(nvs_handle handle, const char *key, const char *value){
+	return set(handle, key, e_str, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle handle, const char *key, char *out_value, size_t *length){
+	return get(handle, key, e_str, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length){
+	return set(handle, key, e_blob, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length){
+	return get(handle, key, e_blob, out_value, length);
+}
+
+void nvs_host_set_file(const char *path){
+	std::lock_guard<std::mutex> guard(lock);
+	file = path ? path : "";
+	if(path)
+		load_file();
+}
+
+void nvs_host_reset(){
+	std::lock_guard<std::mutex> guard(lock);
+	spaces.clear();
+	writes_left = -1;
+	commits = 0;
+}
+
+void nvs_host_fail_after(int count){
+	std::lock_guard<std::mutex> guard(lock);
+	writes_left = count;
+}
+
+size_t nvs_host_commits(){
+	std::lock_guard<std::mutex> guard(lock);
+	return commits;
+}
+
+size_t nvs_host_keys(const char *name){
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = spaces.find(name);
+	return it == spaces.end() ? 0 : it->second.size();
+}
+
+size_t nvs_host_bytes(const char *name){
+	std::lock_guard<std::mutex> guard(lock);
+	auto it = spaces.find(name);
+	size_t res = 0;
+	if(it != spaces.end()){
+		for(auto &k : it->second)
+			res += k.second.data.size();
+	}
+	return res;
+}
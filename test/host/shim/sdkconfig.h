@@ -0,0 +1,12 @@
+/*
+ * sdkconfig.h
+ *
+ *  Host shim: the options of the project sdkconfig the components depend on
+ */
+
+#ifndef TEST_HOST_SHIM_SDKCONFIG_H_
+#define TEST_HOST_SHIM_SDKCONFIG_H_
+
+#define CONFIG_BT_ENABLED 1
+
+#endif /* TEST_HOST_SHIM_SDKCONFIG_H_ */
@@ -0,0 +1,140 @@
+/*
+ * task.cpp
+ *
+ *  Host shim: cBaseTask, cMutex and cSemaphore over pthreads
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include "cBaseTask.h"
+
+static std::atomic<uint32_t> tick_offset(0);
+
+static uint32_t now_ms(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+static void deadline(timespec &ts, uint32_t ms){
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += ms / 1000;
+	ts.tv_nsec += (ms % 1000) * 1000000l;
+	if(ts.tv_nsec >= 1000000000l){
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000l;
+	}
+}
+
+void host_tick_advance(uint32_t ms){
+	tick_offset += ms;
+}
+
+uint32_t cBaseTask::GetTickCount(){
+	static const uint32_t start = now_ms();
+	return now_ms() - start + tick_offset;
+}
+
+void cBaseTask::Reboot(){
+	fprintf(stderr, "cBaseTask::Reboot()\n");
+	abort();
+}
+
+cBaseTask::cBaseTask():m_thread(), m_bExists(false){
+}
+
+cBaseTask::~cBaseTask(){
+}
+
+void* cBaseTask::entry(void *arg){
+	cBaseTask *task = (cBaseTask*)arg;
+	task->TaskHandler();
+	task->m_bExists = false;
+	return nullptr;
+}
+
+void cBaseTask::TaskCreate(const char *name, int prio, int stack){
+	if(m_bExists)
+		return;
+	m_bExists = true;
+	if(pthread_create(&m_thread, nullptr, entry, this)){
+		m_bExists = false;
+		return;
+	}
+	pthread_detach(m_thread);
+}
+
+void cBaseTask::TaskDelete(){
+	if(!m_bExists)
+		return;
+	m_bExists = false;
+	if(pthread_equal(pthread_self(), m_thread))
+		pthread_exit(nullptr);
+	pthread_cancel(m_thread);
+}
+
+bool cBaseTask::IsTaskExists(){
+	return m_bExists;
+}
+
+cMutex::cMutex():m_owner(), m_bOwned(false){
+	pthread_mutex_init(&m_mutex, nullptr);
+}
+
+cMutex::~cMutex(){
+	pthread_mutex_destroy(&m_mutex);
+}
+
+void cMutex::Lock(){
+	if(m_bOwned && pthread_equal(m_owner, pthread_self())){
+		fprintf(stderr, "cMutex %p is locked twice by one thread\n", this);
+		abort();
+	}
+	pthread_mutex_lock(&m_mutex);
+	m_owner = pthread_self();
+	m_bOwned = true;
+}
+
+void cMutex::Unlock(){
+	m_bOwned = false;
+	pthread_mutex_unlock(&m_mutex);
+}
+
+cSemaphore::cSemaphore(const char *name):m_bTaken(false){
+	pthread_mutex_init(&m_mutex, nullptr);
+	pthread_cond_init(&m_cond, nullptr);
+}
+
+cSemaphore::~cSemaphore(){
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool cSemaphore::Lock(uint32_t ticks){
+	timespec ts;
+	deadline(ts, ticks == 0xffffffff ? 0 : ticks);
+	pthread_mutex_lock(&m_mutex);
+	int rc = 0;
+	while(m_bTaken && rc == 0)
+		rc = ticks == 0xffffffff ? pthread_cond_wait(&m_cond, &m_mutex) : pthread_cond_timedwait(&m_cond, &m_mutex, &ts);
+	bool res = !m_bTaken;
+	m_bTaken = true;
+	pthread_mutex_unlock(&m_mutex);
+	return res;
+}
+
+void cSemaphore::Unlock(){
+	pthread_mutex_lock(&m_mutex);
+	m_bTaken = false;
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void cSemaphore::Wait(){
+	pthread_mutex_lock(&m_mutex);
+	while(m_bTaken)
+		pthread_cond_wait(&m_cond, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,82 @@
+/*
+ * timers.cpp
+ *
+ *  Host shim: FreeRTOS software timers, the test runs the expired ones by host_timers_run()
+ */
+
+#include <list>
+#include <algorithm>
+#include "freertos/timers.h"
+#include "cBaseTask.h"
+
+struct sHostTimer{
+	TickType_t period;
+	bool bAutoReload;
+	bool bActive;
+	uint32_t expiry;
+	void *id;
+	TimerCallbackFunction_t callback;
+};
+
+static std::list<sHostTimer*> timers;
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t autoReload, void *timerId,
+		TimerCallbackFunction_t callback){
+	if(!period || !callback)
+		return nullptr;
+	sHostTimer *timer = new sHostTimer{period, autoReload != pdFALSE, false, 0, timerId, callback};
+	timers.push_back(timer);
+	return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait){
+	timer->bActive = true;
+	timer->expiry = cBaseTask::GetTickCount() + timer->period;
+	return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait){
+	timer->bActive = false;
+	return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait){
+	if(!period)
+		return pdFAIL;
+	timer->period = period;
+	return xTimerStart(timer, wait); // as in FreeRTOS, a dormant timer is started
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t wait){
+	timers.remove(timer);
+	delete timer;
+	return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer){
+	return timer->bActive ? pdTRUE : pdFALSE;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer){
+	return timer->id;
+}
+
+int host_timers_run(){
+	int count = 0;
+	uint32_t now = cBaseTask::GetTickCount();
+	// the callbacks may stop, delete or create timers
+	std::list<sHostTimer*> due(timers);
+	for(sHostTimer *timer : due){
+		// the missed periods are called one by one, like by the timer task after a long block
+		while(std::find(timers.begin(), timers.end(), timer) != timers.end() && timer->bActive &&
+				(int32_t)(now - timer->expiry) >= 0){
+			if(timer->bAutoReload)
+				timer->expiry += timer->period;
+			else
+				timer->bActive = false;
+			timer->callback(timer);
+			count++;
+		}
+	}
+	return count;
+}
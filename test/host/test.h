@@ -0,0 +1,61 @@
+/*
+ * test.h
+ *
+ *  Minimal test runner of the host tests: TEST() registers a case, CHECK*() report the failures
+ */
+
+#ifndef TEST_HOST_TEST_H_
+#define TEST_HOST_TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef void (*tTestFunc)();
+
+struct sTestCase{
+	const char *name;
+	tTestFunc func;
+	sTestCase *next;
+	sTestCase(const char *_name, tTestFunc _func);
+};
+
+// failed checks of the current case
+extern int test_failures;
+
+#define TEST(name) \
+	static void name(); \
+	static sTestCase name##_case(#name, name); \
+	static void name()
+
+#define CHECK(cond) do{ \
+		if(!(cond)){ \
+			printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			test_failures++; \
+		} \
+	}while(0)
+
+#define CHECK_EQ(a, b) do{ \
+		long long a_ = (long long)(a), b_ = (long long)(b); \
+		if(a_ != b_){ \
+			printf("  %s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+			test_failures++; \
+		} \
+	}while(0)
+
+#define CHECK_STR(a, b) do{ \
+		std::string a_(a), b_(b); \
+		if(a_ != b_){ \
+			printf("  %s:%d: CHECK_STR(%s, %s) failed: \"%s\" != \"%s\"\n", __FILE__, __LINE__, #a, #b, a_.c_str(), b_.c_str()); \
+			test_failures++; \
+		} \
+	}while(0)
+
+#define CHECK_MEM(a, b, len) do{ \
+		if(memcmp((a), (b), (len))){ \
+			printf("  %s:%d: CHECK_MEM(%s, %s) failed\n", __FILE__, __LINE__, #a, #b); \
+			test_failures++; \
+		} \
+	}while(0)
+
+#endif /* TEST_HOST_TEST_H_ */
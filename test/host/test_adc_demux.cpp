@@ -0,0 +1,194 @@
+/*
+ * test_adc_demux.cpp
+ *
+ *  cAdcDemux over the DMA sample files of data/ (adc_dma_gen.py): frames of every channel, the order
+ *  of the swapped pairs, reads split anywhere, words of the unknown channels, frame statistics
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "../../components/m_adc/cAdcDemux.h"
+
+#define FILE_3CH	"data/adc_dma_3ch.bin" // channels 0, 3, 6; 1006, 1000 and 1000 samples
+#define FILE_RAMP	"data/adc_dma_ramp.bin" // channel 3, values 0..4095
+
+// i2s_read() buffer of the file, little endian words
+static std::vector<uint16_t> load(const char *name){
+	std::vector<uint16_t> words;
+	FILE *f = fopen(name, "rb");
+	if(!f)
+		return words;
+	uint8_t b[2];
+	while(fread(b, 1, 2, f) == 2)
+		words.push_back(b[0] | (b[1] << 8));
+	fclose(f);
+	return words;
+}
+
+class cFrameLog: public cAdcFrameCallbacks{
+public:
+	std::vector<std::vector<uint16_t> > frames[ADC_DEMUX_MAX_CH];
+
+	void OnFrame(int channel, const uint16_t *samples, size_t count){
+		frames[channel].push_back(std::vector<uint16_t>(samples, samples + count));
+	}
+	size_t Count()const{
+		size_t n = 0;
+		for(auto &f : frames)
+			n += f.size();
+		return n;
+	}
+	uint16_t Mean(int channel, size_t i)const{
+		sAdcFrameStats stats;
+		cAdcDemux::Stats(frames[channel][i].data(), frames[channel][i].size(), stats);
+		return stats.mean;
+	}
+};
+
+// the pairs are put back in order, the samples of the channel one after another
+static std::vector<uint16_t> reference(const std::vector<uint16_t> &words, int channel){
+	std::vector<uint16_t> values;
+	for(size_t i = 0; i + 1 < words.size(); i += 2){
+		uint16_t pair[2] = {words[i + 1], words[i]};
+		for(uint16_t w : pair){
+			if(ADC_DMA_CHANNEL(w) == channel)
+				values.push_back(ADC_DMA_VALUE(w));
+		}
+	}
+	return values;
+}
+
+TEST(files){
+	CHECK_EQ(load(FILE_3CH).size(), 3006);
+	CHECK_EQ(load(FILE_RAMP).size(), 4096);
+}
+
+TEST(three_channels){
+	std::vector<uint16_t> words = load(FILE_3CH);
+	cAdcDemux demux;
+	cFrameLog log;
+	demux.Configure((1 << 0) | (1 << 3) | (1 << 6), 32);
+	demux.SetCallbacks(&log);
+	CHECK_EQ(demux.Feed(words.data(), words.size()), 93);
+	CHECK_EQ(demux.Unknown(), 0);
+	CHECK_EQ(log.frames[0].size(), 31);
+	CHECK_EQ(log.frames[3].size(), 31);
+	CHECK_EQ(log.frames[6].size(), 31);
+	for(int ch : {0, 3, 6}){
+		std::vector<uint16_t> ref = reference(words, ch);
+		for(size_t i = 0; i < log.frames[ch].size(); i++){
+			CHECK_EQ(log.frames[ch][i].size(), 32);
+			CHECK(std::equal(log.frames[ch][i].begin(), log.frames[ch][i].end(), ref.begin() + i * 32));
+		}
+	}
+	// the levels of the sensors
+	for(size_t i = 0; i < 31; i++){
+		CHECK(log.Mean(0, i) >= 1795 && log.Mean(0, i) <= 1805);
+		CHECK(log.Mean(6, i) >= 2597 && log.Mean(6, i) <= 2603);
+	}
+	// the motion starts at the sample 500 of the PIR, in the frame 15
+	for(size_t i = 0; i < 15; i++)
+		CHECK(log.Mean(3, i) >= 2010 && log.Mean(3, i) <= 2086);
+	CHECK(log.Mean(3, 15) > 2100 && log.Mean(3, 15) < 2350);
+	for(size_t i = 16; i < 31; i++)
+		CHECK(log.Mean(3, i) >= 2410 && log.Mean(3, i) <= 2486);
+	sAdcFrameStats stats;
+	cAdcDemux::Stats(log.frames[3][5].data(), 32, stats);
+	// the mains pickup
+	CHECK(stats.max - stats.min > 30);
+}
+
+// i2s_read() returns the buffers of any length, a pair may be split between them
+TEST(split_reads){
+	std::vector<uint16_t> words = load(FILE_3CH);
+	cFrameLog whole;
+	cAdcDemux demux;
+	demux.Configure((1 << 0) | (1 << 3) | (1 << 6), 32);
+	demux.SetCallbacks(&whole);
+	demux.Feed(words.data(), words.size());
+	for(size_t chunk : {1, 3, 7, 64, 255}){
+		cFrameLog log;
+		demux.Configure((1 << 0) | (1 << 3) | (1 << 6), 32);
+		demux.SetCallbacks(&log);
+		size_t frames = 0;
+		for(size_t i = 0; i < words.size(); i += chunk)
+			frames += demux.Feed(words.data() + i, std::min(chunk, words.size() - i));
+		CHECK_EQ(frames, 93);
+		for(int ch : {0, 3, 6})
+			CHECK(log.frames[ch] == whole.frames[ch]);
+	}
+}
+
+TEST(sample_order){
+	std::vector<uint16_t> words = load(FILE_RAMP);
+	cAdcDemux demux;
+	cFrameLog log;
+	demux.Configure(1 << 3, 16);
+	demux.SetCallbacks(&log);
+	CHECK_EQ(demux.Feed(words.data(), words.size()), 256);
+	for(size_t i = 0; i < log.frames[3].size(); i++){
+		for(size_t j = 0; j < 16; j++)
+			CHECK_EQ(log.frames[3][i][j], i * 16 + j);
+	}
+	// as stored by the DMA
+	cFrameLog raw;
+	demux.SwapPairs = false;
+	demux.Configure(1 << 3, 16);
+	demux.SetCallbacks(&raw);
+	demux.Feed(words.data(), 16);
+	CHECK_EQ(raw.frames[3].size(), 1);
+	CHECK_EQ(raw.frames[3][0][0], 1);
+	CHECK_EQ(raw.frames[3][0][1], 0);
+}
+
+TEST(unknown_channels){
+	std::vector<uint16_t> words = load(FILE_3CH);
+	cAdcDemux demux;
+	cFrameLog log;
+	demux.Configure((1 << 0) | (1 << 3), 32);
+	demux.SetCallbacks(&log);
+	CHECK_EQ(demux.Feed(words.data(), words.size()), 62);
+	CHECK_EQ(demux.Unknown(), 1000);
+	CHECK(log.frames[6].empty());
+	// the tag of ADC2 or a broken word
+	demux.Reset();
+	uint16_t bad[] = {0x9001, 0xf123};
+	CHECK_EQ(demux.Feed(bad, 2), 0);
+	CHECK_EQ(demux.Unknown(), 2);
+}
+
+TEST(reset){
+	std::vector<uint16_t> words = load(FILE_RAMP);
+	cAdcDemux demux;
+	cFrameLog log;
+	demux.Configure(1 << 3, 16);
+	demux.SetCallbacks(&log);
+	// half a frame and half a pair are dropped
+	CHECK_EQ(demux.Feed(words.data(), 9), 0);
+	demux.Reset();
+	CHECK_EQ(demux.Feed(words.data() + 32, 16), 1);
+	CHECK_EQ(log.frames[3][0][0], 32);
+	CHECK_EQ(log.frames[3][0][15], 47);
+	// one sample frames
+	demux.Configure(1 << 3, 0);
+	CHECK_EQ(demux.Feed(words.data(), 4), 4);
+	CHECK_EQ(log.Count(), 5);
+}
+
+TEST(stats){
+	sAdcFrameStats stats;
+	const uint16_t s[] = {10, 4095, 0, 11};
+	cAdcDemux::Stats(s, 4, stats);
+	CHECK_EQ(stats.min, 0);
+	CHECK_EQ(stats.max, 4095);
+	CHECK_EQ(stats.mean, 1029);
+	cAdcDemux::Stats(s, 0, stats);
+	CHECK_EQ(stats.min, 0);
+	CHECK_EQ(stats.max, 0);
+	CHECK_EQ(stats.mean, 0);
+	const uint16_t r[] = {1, 2};
+	cAdcDemux::Stats(r, 2, stats);
+	CHECK_EQ(stats.mean, 2);
+}
@@ -0,0 +1,167 @@
+/*
+ * test_bt_beacon.cpp
+ *
+ *  cBtBeacon: payload format and MAC, rate limits, no broadcast without a key, key and sequence across reboots
+ */
+
+#include <string.h>
+#include <nvs.h>
+#include "test.h"
+#include "../../components/m_bt/cBtBeacon.h"
+
+#define BEACON_NS	"btbeacon"
+
+static const uint8_t key[] = "0123456789abcdef";
+
+static void fresh_nvs(){
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+}
+
+TEST(round_trip){
+	sBtBeaconState st = {BT_BEACON_ALARM | BT_BEACON_SMOKE, 50, 0x12345678}, out;
+	uint8_t payload[BT_BEACON_LEN];
+	cBtBeacon::Encode(st, key, 16, payload);
+	CHECK_EQ(payload[0], 0xff);
+	CHECK_EQ(payload[2], BT_BEACON_VERSION);
+	CHECK_EQ(payload[5], 0x78);
+	CHECK_EQ(payload[8], 0x12);
+	CHECK(cBtBeacon::Decode(payload, sizeof payload, key, 16, out));
+	CHECK_EQ(out.flags, st.flags);
+	CHECK_EQ(out.battery, 50);
+	CHECK_EQ(out.seq, 0x12345678);
+}
+
+TEST(forged){
+	sBtBeaconState st = {0, 100, 7}, out;
+	uint8_t payload[BT_BEACON_LEN];
+	cBtBeacon::Encode(st, key, 16, payload);
+	// another key
+	CHECK(!cBtBeacon::Decode(payload, sizeof payload, key, 15, out));
+	// every changed byte is noticed
+	for(size_t i = 0; i < BT_BEACON_LEN; i++){
+		payload[i] ^= 0x01;
+		CHECK(!cBtBeacon::Decode(payload, sizeof payload, key, 16, out));
+		payload[i] ^= 0x01;
+	}
+	CHECK(!cBtBeacon::Decode(payload, sizeof payload - 1, key, 16, out));
+	CHECK(cBtBeacon::Decode(payload, sizeof payload, key, 16, out));
+}
+
+TEST(no_key){
+	cBtBeacon b;
+	uint8_t payload[BT_BEACON_LEN];
+	CHECK(!b.HasKey());
+	CHECK(!b.Poll(0, payload));
+	CHECK(!b.Poll(100000, payload));
+	CHECK_EQ(b.Seq(), 0);
+	b.SetKey(key, 16);
+	CHECK(b.Poll(100000, payload));
+	// removed: the broadcast stops, a new key starts it at once
+	b.SetKey(key, 0);
+	CHECK(!b.HasKey());
+	CHECK(!b.Poll(200000, payload));
+	b.SetKey(key, 16);
+	CHECK(b.Poll(200001, payload));
+	CHECK_EQ(b.Seq(), 2);
+}
+
+TEST(rate){
+	cBtBeacon b;
+	b.SetKey(key, 16);
+	uint8_t payload[BT_BEACON_LEN];
+	CHECK(b.Poll(1000, payload));
+	CHECK(!b.Poll(1100, payload));
+	// the changes are collected during MinPeriodMs
+	b.SetState(BT_BEACON_ALARM, 100);
+	CHECK(!b.Poll(1499, payload));
+	b.SetState(BT_BEACON_ALARM | BT_BEACON_MOTION, 100);
+	CHECK(b.Poll(1500, payload));
+	sBtBeaconState st;
+	CHECK(cBtBeacon::Decode(payload, sizeof payload, key, 16, st));
+	CHECK_EQ(st.flags, BT_BEACON_ALARM | BT_BEACON_MOTION);
+	CHECK_EQ(st.seq, 2);
+	// the same state is not a change
+	b.SetState(BT_BEACON_ALARM | BT_BEACON_MOTION, 100);
+	CHECK(!b.Poll(2500, payload));
+	// refreshed without a change
+	CHECK(b.Poll(11500, payload));
+	CHECK_EQ(b.Seq(), 3);
+}
+
+TEST(long_key){
+	uint8_t longer[40];
+	memset(longer, 0x55, sizeof longer);
+	cBtBeacon b;
+	b.SetKey(longer, sizeof longer);
+	uint8_t payload[BT_BEACON_LEN];
+	CHECK(b.Poll(0, payload));
+	sBtBeaconState st;
+	CHECK(cBtBeacon::Decode(payload, sizeof payload, longer, BT_BEACON_KEY_MAX, st));
+}
+
+TEST(key_saved){
+	fresh_nvs();
+	{
+		cBtBeacon b;
+		CHECK(b.Open());
+		CHECK(!b.HasKey());
+		b.SetKey(key, 16);
+	}
+	uint8_t payload[BT_BEACON_LEN];
+	sBtBeaconState st;
+	{
+		// after the reboot
+		cBtBeacon b;
+		CHECK(b.Open());
+		CHECK(b.HasKey());
+		CHECK(b.Poll(0, payload));
+		CHECK(cBtBeacon::Decode(payload, sizeof payload, key, 16, st));
+		b.SetKey(key, 0);
+	}
+	cBtBeacon b;
+	b.Open();
+	CHECK(!b.HasKey());
+	CHECK(!b.Poll(0, payload));
+	// the sequence is kept without the key
+	b.SetKey(key, 16);
+	CHECK(b.Poll(0, payload));
+	CHECK(b.Seq() > st.seq);
+}
+
+TEST(sequence_across_reboots){
+	fresh_nvs();
+	uint8_t payload[BT_BEACON_LEN];
+	uint32_t last = 0;
+	for(int boot = 0; boot < 5; boot++){
+		cBtBeacon b;
+		b.Open();
+		b.SetKey(key, 16);
+		// a different number of payloads in every boot, a block and more in the last one
+		int count = boot == 4 ? BT_BEACON_SEQ_BLOCK + 10 : boot * 7 + 1;
+		for(int i = 0; i < count; i++){
+			CHECK(b.Poll(i * b.RefreshMs, payload));
+			CHECK(b.Seq() > last);
+			last = b.Seq();
+		}
+	}
+}
+
+TEST(sequence_writes){
+	fresh_nvs();
+	cBtBeacon b;
+	b.Open();
+	b.SetKey(key, 16);
+	size_t commits = nvs_host_commits();
+	uint8_t payload[BT_BEACON_LEN];
+	for(int i = 0; i < 3 * BT_BEACON_SEQ_BLOCK; i++)
+		b.Poll(i * b.RefreshMs, payload);
+	// a flash write per block, not per payload
+	CHECK_EQ(nvs_host_commits() - commits, 3);
+	CHECK_EQ(nvs_host_keys(BEACON_NS), 2);
+	// the writes fail: the payloads go on
+	nvs_host_fail_after(0);
+	CHECK(b.Poll(3 * BT_BEACON_SEQ_BLOCK * b.RefreshMs, payload));
+	CHECK_EQ(b.Seq(), 3 * BT_BEACON_SEQ_BLOCK + 1);
+	nvs_host_reset();
+}
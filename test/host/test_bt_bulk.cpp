@@ -0,0 +1,360 @@
+/*
+ * test_bt_bulk.cpp
+ *
+ *  cBtBulkSender / cBtBulkReceiver over a simulated lossy link: lost, damaged and late packets, lost acks, resume, dead link
+ */
+
+#include <vector>
+#include "test.h"
+#include "../../components/m_bt/cBtBulk.h"
+
+#define STEP_MS		8	// connection interval, the packets of one interval are delivered in the next one
+
+// objects in memory: obj 1 is the source, received data go to the buffer
+class cMemObjects : public cBtBulkCallbacks{
+public:
+	std::vector<uint8_t> src, dst;
+	uint32_t resume = 0;		// Open() reports this offset as already received
+	uint32_t failWriteAt = 0xffffffff;
+	int done = 0;
+	bool bOk = false;
+
+	uint32_t GetSize(uint8_t obj){return obj == 1 ? src.size() : 0;}
+	size_t Read(uint8_t obj, uint32_t offset, uint8_t *pBuf, size_t len){
+		if(obj != 1 || offset + len > src.size())
+			return 0;
+		memcpy(pBuf, src.data() + offset, len);
+		return len;
+	}
+	bool Open(uint8_t obj, uint32_t total, uint32_t &offset){
+		dst.resize(total);
+		offset = resume;
+		return true;
+	}
+	bool Write(uint8_t obj, uint32_t offset, const uint8_t *pData, size_t len){
+		if(offset + len > failWriteAt)
+			return false;
+		memcpy(dst.data() + offset, pData, len);
+		return true;
+	}
+	void Done(uint8_t obj, bool _bOk){done++; bOk = _bOk;}
+};
+
+// deterministic random numbers of the link
+class cRandom{
+public:
+	explicit cRandom(uint32_t seed):m_state(seed ? seed : 1){}
+	uint32_t Next(){
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+	// true with the probability of percent
+	bool Chance(int percent){return (int)(Next() % 100) < percent;}
+private:
+	uint32_t m_state;
+};
+
+struct sLink{
+	int lossPct = 0;		// data packet lost
+	int corruptPct = 0;		// data packet damaged (the CRC fails)
+	int ackLossPct = 0;		// ack lost
+	int perStep = 6;		// packets per connection interval
+	uint32_t seed = 1;
+};
+
+struct sResult{
+	bool bOk;
+	uint32_t timeMs;
+	int packets;			// data packets sent including the resent ones
+	int acks;
+};
+
+static std::vector<uint8_t> pattern(size_t len){
+	std::vector<uint8_t> v(len);
+	for(size_t i = 0; i < len; i++)
+		v[i] = (uint8_t)(i ^ (i >> 8) ^ 0x5a);
+	return v;
+}
+
+// transfer of obj 1 from offset like cBtBulkService does: the packets are sent while the window allows,
+// the acks come back in the next interval, Tick() runs every interval
+static sResult transfer(cMemObjects &objs, const sLink &link, uint16_t chunk, uint8_t window,
+		uint32_t maxMs = 600000, uint8_t ackEvery = 0){
+	cRandom rnd(link.seed);
+	cBtBulkSender tx;
+	cBtBulkReceiver rx;
+	rx.AckEvery = ackEvery;
+	uint32_t total = objs.GetSize(1);
+	uint32_t offset = 0;
+	objs.Open(1, total, offset);
+	rx.Start(&objs, 1, total, offset, chunk, window);
+	tx.Start(&objs, 1, total, offset, chunk, window, 0);
+	sResult res = {false, 0, 0, 0};
+	std::vector<std::vector<uint8_t> > inFlight;
+	std::vector<uint32_t> acks;
+	std::vector<uint8_t> pkt;
+	for(uint32_t now = 0; now < maxMs; now += STEP_MS){
+		// delivery of the previous interval: late packets arrive after a go back too
+		for(auto &p : inFlight){
+			if(rx.OnPacket(p.data(), p.size()) && !rnd.Chance(link.ackLossPct))
+				acks.push_back(rx.Offset());
+		}
+		inFlight.clear();
+		if(!rx.Busy())
+			break;
+		for(uint32_t a : acks){
+			tx.OnAck(a, now);
+			res.acks++;
+		}
+		acks.clear();
+		if(tx.Complete() && rx.Complete()){
+			res.bOk = true;
+			res.timeMs = now;
+			break;
+		}
+		if(!tx.Tick(now))
+			break;
+		for(int i = 0; i < link.perStep && tx.Next(now, pkt); i++){
+			res.packets++;
+			if(rnd.Chance(link.lossPct))
+				continue;
+			if(rnd.Chance(link.corruptPct))
+				pkt[BT_BULK_SEQ_LEN + rnd.Next() % (pkt.size() - BT_BULK_OVERHEAD + 1)] ^= 1 << (rnd.Next() % 8);
+			inFlight.push_back(pkt);
+		}
+	}
+	return res;
+}
+
+TEST(ctrl_frames){
+	sBtBulkCtrl ctrl{eBtBulkOp::e_put, 3, 0, 8, 240, 0x12345678, 0x9abcdef0};
+	std::vector<uint8_t> frame;
+	ctrl.Encode(frame);
+	CHECK_EQ(frame.size(), BT_BULK_CTRL_LEN);
+	CHECK_EQ(frame[4], 240);
+	CHECK_EQ(frame[6], 0x78);
+	CHECK_EQ(frame[13], 0x9a);
+	sBtBulkCtrl dec;
+	CHECK(dec.Decode(frame.data(), frame.size()));
+	CHECK(dec.op == eBtBulkOp::e_put);
+	CHECK_EQ(dec.obj, 3);
+	CHECK_EQ(dec.window, 8);
+	CHECK_EQ(dec.chunk, 240);
+	CHECK_EQ(dec.total, 0x12345678);
+	CHECK_EQ(dec.offset, 0x9abcdef0);
+	CHECK(!dec.Decode(frame.data(), frame.size() - 1));
+	frame[0] = 0;
+	CHECK(!dec.Decode(frame.data(), frame.size()));
+	frame[0] = (uint8_t)eBtBulkOp::e_abort + 1;
+	CHECK(!dec.Decode(frame.data(), frame.size()));
+}
+
+TEST(crc){
+	// the check value of CRC-16/CCITT-FALSE
+	CHECK_EQ(BtBulkCrc16((const uint8_t*)"123456789", 9), 0x29b1);
+	CHECK_EQ(BtBulkCrc16(nullptr, 0), 0xffff);
+	// it can be continued
+	CHECK_EQ(BtBulkCrc16((const uint8_t*)"6789", 4, BtBulkCrc16((const uint8_t*)"12345", 5)), 0x29b1);
+}
+
+TEST(clean_link){
+	cMemObjects objs;
+	objs.src = pattern(10000);
+	sLink link;
+	sResult res = transfer(objs, link, 240, 8);
+	CHECK(res.bOk);
+	CHECK(objs.dst == objs.src);
+	// nothing is sent twice, an ack per half window
+	CHECK_EQ(res.packets, (10000 + 239) / 240);
+	CHECK_EQ(res.acks, (10000 + 239) / 240 / 4 + 1);
+}
+
+TEST(lossy_links){
+	int losses[] = {1, 5, 10, 25};
+	for(int loss : losses){
+		for(uint32_t seed = 1; seed <= 20; seed++){
+			cMemObjects objs;
+			objs.src = pattern(20000 + seed * 17);
+			sLink link;
+			link.lossPct = loss;
+			link.corruptPct = loss / 2;
+			link.ackLossPct = loss;
+			link.seed = seed;
+			sResult res = transfer(objs, link, 182, 8);
+			CHECK(res.bOk);
+			CHECK(objs.dst == objs.src);
+			// the go back costs at most a window per lost packet
+			int min = (objs.src.size() + 181) / 182;
+			CHECK(res.packets >= min);
+			CHECK(res.packets < min * (100 + loss * 3 * 8) / 100);
+		}
+	}
+}
+
+TEST(lossy_small_mtu){
+	// the default MTU: 16 data bytes per packet, window of 1 and 4
+	for(uint8_t window = 1; window <= 4; window += 3){
+		for(uint32_t seed = 1; seed <= 10; seed++){
+			cMemObjects objs;
+			objs.src = pattern(3000);
+			sLink link;
+			link.lossPct = 10;
+			link.ackLossPct = 10;
+			link.seed = seed;
+			sResult res = transfer(objs, link, 16, window);
+			CHECK(res.bOk);
+			CHECK(objs.dst == objs.src);
+		}
+	}
+}
+
+TEST(lost_acks_only){
+	// every data packet arrives but most acks are lost: the timeout resends, the receiver repeats its ack
+	cMemObjects objs;
+	objs.src = pattern(5000);
+	sLink link;
+	link.ackLossPct = 60;
+	link.seed = 7;
+	sResult res = transfer(objs, link, 200, 8);
+	CHECK(res.bOk);
+	CHECK(objs.dst == objs.src);
+}
+
+TEST(resume){
+	cMemObjects objs;
+	objs.src = pattern(9000);
+	objs.dst = objs.src; // the first part is there from the interrupted transfer
+	objs.resume = 4000;
+	std::vector<uint8_t> expect = objs.src;
+	for(size_t i = 4000; i < objs.src.size(); i++)
+		objs.src[i] = expect[i];
+	sLink link;
+	link.lossPct = 5;
+	sResult res = transfer(objs, link, 100, 8);
+	CHECK(res.bOk);
+	CHECK(objs.dst == expect);
+	CHECK(res.packets >= 50);
+	CHECK(res.packets < 90);
+}
+
+TEST(dead_link){
+	cMemObjects objs;
+	objs.src = pattern(5000);
+	sLink link;
+	link.lossPct = 100;
+	sResult res = transfer(objs, link, 100, 8);
+	CHECK(!res.bOk);
+	// the window is resent MaxRetries times after the timeout
+	CHECK_EQ(res.packets, 8 * 6);
+
+	cBtBulkSender tx;
+	tx.Start(&objs, 1, 5000, 0, 100, 8, 0);
+	CHECK(tx.Tick(999));
+	for(uint32_t t = 1000; t <= 5000; t += 1000)
+		CHECK(tx.Tick(t));
+	CHECK(!tx.Tick(6000));
+	CHECK(!tx.Busy());
+}
+
+TEST(write_error){
+	cMemObjects objs;
+	objs.src = pattern(5000);
+	objs.failWriteAt = 2500;
+	sLink link;
+	sResult res = transfer(objs, link, 100, 8);
+	CHECK(!res.bOk);
+
+	cBtBulkReceiver rx;
+	rx.Start(&objs, 1, 5000, 0, 100, 8);
+	cBtBulkSender tx;
+	tx.Start(&objs, 1, 5000, 0, 100, 8, 0);
+	std::vector<uint8_t> pkt;
+	for(int i = 0; i < 26 && rx.Busy(); i++){
+		if(!tx.Next(0, pkt)){
+			tx.OnAck(rx.Offset(), 0);
+			tx.Next(0, pkt);
+		}
+		rx.OnPacket(pkt.data(), pkt.size());
+	}
+	CHECK(rx.Failed());
+	CHECK(!rx.Busy());
+	CHECK_EQ(rx.Offset(), 2500);
+}
+
+TEST(receiver_rejects){
+	cMemObjects objs;
+	objs.src = pattern(1000);
+	objs.dst.resize(1000);
+	cBtBulkSender tx;
+	tx.Start(&objs, 1, 1000, 0, 100, 8, 0);
+	std::vector<std::vector<uint8_t> > pkts(4);
+	for(auto &p : pkts)
+		CHECK(tx.Next(0, p));
+	cBtBulkReceiver rx;
+	rx.AckEvery = 4;
+	rx.Start(&objs, 1, 1000, 0, 100, 8);
+	CHECK(!rx.OnPacket(pkts[0].data(), pkts[0].size()));
+	// a gap: one repeated ack, the rest of the window is dropped silently
+	CHECK(rx.OnPacket(pkts[2].data(), pkts[2].size()));
+	CHECK(!rx.OnPacket(pkts[3].data(), pkts[3].size()));
+	CHECK_EQ(rx.Offset(), 100);
+	// the first ack of the transfer looks like progress, the sender goes back after the timeout
+	tx.OnAck(100, 0);
+	CHECK_EQ(tx.Sent(), 400);
+	CHECK(tx.Tick(1000));
+	CHECK_EQ(tx.Sent(), 100);
+	std::vector<uint8_t> p;
+	CHECK(tx.Next(1000, p));
+	CHECK(p == pkts[1]);
+	CHECK(!rx.OnPacket(p.data(), p.size()));
+	CHECK_EQ(rx.Offset(), 200);
+	// the repeated ack of the same offset makes it go back at once
+	CHECK(rx.OnPacket(pkts[3].data(), pkts[3].size()));
+	tx.OnAck(200, 1000);
+	tx.OnAck(200, 1000);
+	CHECK_EQ(tx.Sent(), 200);
+	// the resent window is answered again when the repeated ack was lost
+	CHECK(rx.OnPacket(pkts[1].data(), pkts[1].size()));
+	CHECK(!rx.OnPacket(pkts[2].data(), pkts[2].size() - 1));
+	CHECK_EQ(rx.Offset(), 200);
+	// damaged, too short and a wrong length with the right CRC
+	std::vector<std::vector<uint8_t> > bad(3, pkts[1]);
+	bad[0][5] ^= 0x10;
+	bad[1].resize(BT_BULK_OVERHEAD - 1);
+	bad[2].resize(BT_BULK_SEQ_LEN + 50);
+	uint16_t crc = BtBulkCrc16(bad[2].data(), bad[2].size());
+	bad[2].push_back(crc & 0xff);
+	bad[2].push_back(crc >> 8);
+	for(size_t i = 0; i < bad.size(); i++){
+		cBtBulkReceiver rx2;
+		rx2.Start(&objs, 1, 1000, 0, 100, 8);
+		CHECK(!rx2.OnPacket(pkts[0].data(), pkts[0].size()));
+		CHECK_EQ(rx2.OnPacket(bad[i].data(), bad[i].size()), i != 1);
+		CHECK_EQ(rx2.Offset(), 100);
+	}
+	// an old ack doesn't move the sender, neither does the ack of data never sent
+	tx.OnAck(0, 1000);
+	CHECK_EQ(tx.Acked(), 200);
+	tx.OnAck(500, 1000);
+	CHECK_EQ(tx.Acked(), 200);
+	// the receiver is ahead of the sender after the go back
+	CHECK(tx.Tick(2000));
+	CHECK_EQ(tx.Sent(), 200);
+	tx.OnAck(400, 2000);
+	CHECK_EQ(tx.Acked(), 400);
+	CHECK_EQ(tx.Sent(), 400);
+}
+
+TEST(sequence_wraps){
+	// more than 65536 packets
+	cMemObjects objs;
+	objs.src = pattern(70000);
+	sLink link;
+	link.lossPct = 2;
+	link.perStep = 40;
+	sResult res = transfer(objs, link, 1, 32, 6000000);
+	CHECK(res.bOk);
+	CHECK(objs.dst == objs.src);
+}
@@ -0,0 +1,176 @@
+/*
+ * test_bt_char_value.cpp
+ *
+ *  cBtCharValue: capacity, truncation, long reads in ATT_READ_BLOB parts, prepared writes, versions
+ */
+
+#include <vector>
+#include "test.h"
+#include "../../components/m_bt/cBtCharValue.h"
+
+static std::vector<uint8_t> pattern(size_t len){
+	std::vector<uint8_t> v(len);
+	for(size_t i = 0; i < len; i++)
+		v[i] = (uint8_t)(i * 13 + 1);
+	return v;
+}
+
+// the client reads the value like the server answers READ and READ_BLOB: MTU-1 bytes from the offset
+static std::vector<uint8_t> long_read(const cBtCharValue &value, size_t mtu, int &requests){
+	std::vector<uint8_t> out;
+	std::vector<uint8_t> part(mtu - 1);
+	requests = 0;
+	for(;;){
+		size_t len;
+		CHECK(value.read(out.size(), mtu - 1, part.data(), len) == eBtValueResult::e_ok);
+		requests++;
+		out.insert(out.end(), part.begin(), part.begin() + len);
+		if(len < mtu - 1)
+			break;
+	}
+	return out;
+}
+
+TEST(capacity){
+	cBtCharValue value;
+	CHECK_EQ(value.getMaxLength(), BT_VALUE_MAX_LEN);
+	CHECK(value.getData() == nullptr);
+	value.setMaxLength(0);
+	CHECK_EQ(value.getMaxLength(), 1);
+	value.setMaxLength(BT_VALUE_MAX_LEN + 1);
+	CHECK_EQ(value.getMaxLength(), BT_VALUE_MAX_LEN);
+	// not allocated before the first value
+	value.setMaxLength(20);
+	CHECK(value.getData() == nullptr);
+	std::vector<uint8_t> v = pattern(20);
+	CHECK(value.setValue(v.data(), v.size()));
+	CHECK_MEM(value.getData(), v.data(), 20);
+	// the value is kept while it fits
+	value.setMaxLength(30);
+	CHECK_EQ(value.getLength(), 20);
+	CHECK_MEM(value.getData(), v.data(), 20);
+	value.setMaxLength(8);
+	CHECK_EQ(value.getLength(), 8);
+	CHECK_MEM(value.getData(), v.data(), 8);
+}
+
+TEST(truncation){
+	cBtCharValue value;
+	value.setMaxLength(10);
+	std::vector<uint8_t> v = pattern(15);
+	CHECK(!value.setValue(v.data(), v.size()));
+	CHECK_EQ(value.getLength(), 10);
+	CHECK_MEM(value.getData(), v.data(), 10);
+	CHECK(value.setValue(v.data(), 0));
+	CHECK_EQ(value.getLength(), 0);
+}
+
+TEST(no_realloc){
+	// the updates use the buffer allocated once
+	cBtCharValue value;
+	std::vector<uint8_t> v = pattern(BT_VALUE_MAX_LEN);
+	value.setValue(v.data(), 1);
+	const uint8_t *pData = value.getData();
+	for(size_t len = 0; len <= BT_VALUE_MAX_LEN; len += 37){
+		value.setValue(v.data(), len);
+		CHECK(value.getData() == pData);
+	}
+}
+
+TEST(read_offsets){
+	cBtCharValue value;
+	std::vector<uint8_t> v = pattern(50);
+	value.setValue(v.data(), v.size());
+	uint8_t buf[64];
+	size_t len = 99;
+	CHECK(value.read(0, 22, buf, len) == eBtValueResult::e_ok);
+	CHECK_EQ(len, 22);
+	CHECK_MEM(buf, v.data(), 22);
+	CHECK(value.read(44, 22, buf, len) == eBtValueResult::e_ok);
+	CHECK_EQ(len, 6);
+	CHECK_MEM(buf, v.data() + 44, 6);
+	// the offset equal to the length is valid and gives nothing
+	CHECK(value.read(50, 22, buf, len) == eBtValueResult::e_ok);
+	CHECK_EQ(len, 0);
+	CHECK(value.read(51, 22, buf, len) == eBtValueResult::e_invalid_offset);
+	CHECK_EQ(len, 0);
+	// the empty value
+	cBtCharValue empty;
+	CHECK(empty.read(0, 22, buf, len) == eBtValueResult::e_ok);
+	CHECK_EQ(len, 0);
+}
+
+TEST(long_read){
+	size_t mtus[] = {23, 185, 517};
+	size_t lens[] = {0, 21, 22, 23, 100, 512, BT_VALUE_MAX_LEN};
+	for(size_t mtu : mtus){
+		for(size_t len : lens){
+			cBtCharValue value;
+			std::vector<uint8_t> v = pattern(len);
+			value.setValue(v.data(), v.size());
+			int requests;
+			CHECK(long_read(value, mtu, requests) == v);
+			// the last part is shorter than MTU-1, an exact multiple needs one empty read
+			CHECK_EQ(requests, len / (mtu - 1) + 1);
+		}
+	}
+}
+
+TEST(prepared_write){
+	// PREP_WRITE parts of MTU-5 bytes and EXEC_WRITE like the client of the 23 byte MTU
+	cBtCharValue prep;
+	std::vector<uint8_t> v = pattern(100);
+	for(size_t offset = 0; offset < v.size(); offset += 18){
+		size_t len = v.size() - offset < 18 ? v.size() - offset : 18;
+		CHECK(prep.append(offset, v.data() + offset, len) == eBtValueResult::e_ok);
+	}
+	CHECK_EQ(prep.getLength(), 100);
+	cBtCharValue value;
+	value.setValue(prep.getData(), prep.getLength());
+	CHECK_MEM(value.getData(), v.data(), 100);
+}
+
+TEST(prepared_write_errors){
+	cBtCharValue prep;
+	prep.setMaxLength(30);
+	std::vector<uint8_t> v = pattern(40);
+	CHECK(prep.append(0, v.data(), 18) == eBtValueResult::e_ok);
+	// a gap or a repeated part
+	CHECK(prep.append(20, v.data(), 5) == eBtValueResult::e_invalid_offset);
+	CHECK(prep.append(0, v.data(), 5) == eBtValueResult::e_invalid_offset);
+	// over the capacity, the value is not changed
+	CHECK(prep.append(18, v.data() + 18, 13) == eBtValueResult::e_invalid_len);
+	CHECK_EQ(prep.getLength(), 18);
+	CHECK(prep.append(18, v.data() + 18, 12) == eBtValueResult::e_ok);
+	CHECK_EQ(prep.getLength(), 30);
+	// the next write starts again
+	prep.clear();
+	CHECK(prep.append(0, v.data(), 5) == eBtValueResult::e_ok);
+}
+
+TEST(versions){
+	cBtCharValue value;
+	std::vector<uint8_t> v = pattern(10);
+	uint32_t ver = value.getVersion();
+	value.setValue(v.data(), v.size());
+	CHECK(value.getVersion() != ver);
+	ver = value.getVersion();
+	// the same content is a new version too, a long read must restart
+	value.setValue(v.data(), v.size());
+	CHECK(value.getVersion() != ver);
+	ver = value.getVersion();
+	value.setMaxLength(value.getMaxLength());
+	CHECK_EQ(value.getVersion(), ver);
+	value.append(10, v.data(), 1);
+	CHECK(value.getVersion() != ver);
+	ver = value.getVersion();
+	value.clear();
+	CHECK(value.getVersion() != ver);
+	// failed accesses don't change it
+	ver = value.getVersion();
+	uint8_t buf[4];
+	size_t len;
+	value.read(5, 4, buf, len);
+	value.append(3, v.data(), 1);
+	CHECK_EQ(value.getVersion(), ver);
+}
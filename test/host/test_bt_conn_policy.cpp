@@ -0,0 +1,180 @@
+/*
+ * test_bt_conn_policy.cpp
+ *
+ *  cBtConnPolicy polled like the cBtServer policy timer: parameter requests around the activity, rejects, advertising intervals
+ */
+
+#include <string>
+#include "test.h"
+#include "../../components/m_bt/cBtConnPolicy.h"
+
+#define PERIOD_MS	500 // cBtServer policy timer
+
+// polls from..to (exclusive) with the timer period, the answers are given by bOk;
+// returns the requests: 'f' - fast, 'i' - idle
+static std::string run(cBtConnPolicy &policy, uint32_t from, uint32_t to, bool bOk = true){
+	std::string requests;
+	sBtConnParams params;
+	for(uint32_t t = from; t != to; t += PERIOD_MS){
+		if(policy.Poll(t, params)){
+			requests += params.min_int == policy.Fast.min_int ? 'f' : 'i';
+			policy.OnUpdate(bOk, t + 100);
+		}
+	}
+	return requests;
+}
+
+TEST(defaults){
+	cBtConnPolicy policy;
+	// the supervision timeout (10 ms) covers two skipped event series (1.25 ms units)
+	CHECK(policy.Idle.timeout * 10 > (1 + policy.Idle.latency) * policy.Idle.max_int * 125 / 100 * 2);
+	CHECK(policy.Fast.timeout * 10 > (1 + policy.Fast.latency) * policy.Fast.max_int * 125 / 100 * 2);
+	CHECK(policy.Fast.min_int >= 6);
+	CHECK(policy.Fast.max_int < policy.Idle.min_int);
+	// nothing is requested without a connection
+	CHECK_STR(run(policy, 0, 20000), "");
+}
+
+TEST(connect_then_idle){
+	cBtConnPolicy policy;
+	policy.OnConnect(100000);
+	// fast for the discovery at once, idle after IdleDelayMs
+	sBtConnParams params;
+	CHECK(policy.Poll(100000, params));
+	CHECK_EQ(params.max_int, policy.Fast.max_int);
+	policy.OnUpdate(true, 100050);
+	CHECK_STR(run(policy, 100500, 105000), "");
+	CHECK(policy.Poll(105000, params));
+	CHECK_EQ(params.max_int, policy.Idle.max_int);
+	CHECK_EQ(params.latency, policy.Idle.latency);
+	policy.OnUpdate(true, 105050);
+	CHECK_STR(run(policy, 105500, 200000), "");
+}
+
+TEST(activity){
+	cBtConnPolicy policy;
+	policy.OnConnect(0);
+	CHECK_STR(run(policy, 0, 10000), "fi");
+	// a bulk transfer from 10 s to 30 s with the calibration overlapping it
+	policy.SetActive(BT_LINK_BULK, true, 10000);
+	CHECK_STR(run(policy, 10000, 20000), "f");
+	policy.SetActive(BT_LINK_CALIBRATION, true, 20000);
+	policy.SetActive(BT_LINK_BULK, false, 30000);
+	CHECK_EQ(policy.Active(), BT_LINK_CALIBRATION);
+	CHECK_STR(run(policy, 20000, 40000), "");
+	policy.SetActive(BT_LINK_CALIBRATION, false, 40000);
+	CHECK_EQ(policy.Active(), 0);
+	sBtConnParams params;
+	CHECK(!policy.Poll(44500, params));
+	CHECK(policy.Poll(45000, params));
+	CHECK_EQ(params.min_int, policy.Idle.min_int);
+}
+
+TEST(request_interval){
+	// a short activity burst doesn't make a request storm
+	cBtConnPolicy policy;
+	policy.IdleDelayMs = 0;
+	policy.OnConnect(0);
+	std::string requests;
+	sBtConnParams params;
+	for(uint32_t t = 0; t < 10000; t += 100){
+		policy.SetActive(BT_LINK_BULK, (t / 100) % 2 == 0, t);
+		if(policy.Poll(t, params)){
+			requests += params.min_int == policy.Fast.min_int ? 'f' : 'i';
+			policy.OnUpdate(true, t);
+		}
+	}
+	CHECK_EQ(requests.size(), 10000 / policy.RequestIntervalMs);
+}
+
+TEST(rejects){
+	cBtConnPolicy policy;
+	policy.OnConnect(0);
+	// the central refuses the fast parameters: 3 attempts, then it keeps its own
+	CHECK_STR(run(policy, 0, 4500, false), "fff");
+	CHECK_STR(run(policy, 4500, 5000, false), "");
+	// the idle parameters are a new request
+	CHECK_STR(run(policy, 5000, 10000, true), "i");
+	// the fast ones are tried again at the next activity
+	policy.SetActive(BT_LINK_BULK, true, 10000);
+	CHECK_STR(run(policy, 10000, 12000, true), "f");
+}
+
+TEST(no_answer){
+	cBtConnPolicy policy;
+	policy.OnConnect(0);
+	policy.SetActive(BT_LINK_BULK, true, 0);
+	sBtConnParams params;
+	CHECK(policy.Poll(0, params));
+	// the request without the answer is repeated after the timeout only, it is given up after MaxRejects
+	std::string requests;
+	for(uint32_t t = PERIOD_MS; t < 100000; t += PERIOD_MS){
+		if(policy.Poll(t, params))
+			requests += params.min_int == policy.Fast.min_int ? 'f' : 'i';
+		if(t == 20000 || t == 40500)
+			CHECK_STR(requests, t == 20000 ? "" : "f");
+	}
+	CHECK_STR(requests, "ff");
+	// the idle parameters are requested after the activity
+	policy.SetActive(BT_LINK_BULK, false, 100000);
+	CHECK_STR(run(policy, 100000, 110000), "i");
+}
+
+TEST(central_update){
+	// the update initiated by the central doesn't count as the answer
+	cBtConnPolicy policy;
+	policy.OnConnect(0);
+	policy.OnUpdate(false, 10);
+	policy.OnUpdate(false, 20);
+	policy.OnUpdate(false, 30);
+	CHECK_STR(run(policy, 0, 1000), "f");
+}
+
+TEST(disconnect){
+	cBtConnPolicy policy;
+	policy.OnConnect(0);
+	CHECK_STR(run(policy, 0, 10000), "fi");
+	// the second client connects and leaves, the first one stays
+	policy.OnConnect(10000);
+	policy.OnDisconnect(12000, false);
+	CHECK_STR(run(policy, 10000, 20000), "");
+	policy.OnDisconnect(20000, true);
+	CHECK_STR(run(policy, 20000, 30000), "");
+	// the new connection starts with the fast parameters again
+	policy.OnConnect(30000);
+	CHECK_STR(run(policy, 30000, 40000), "fi");
+}
+
+TEST(tick_overflow){
+	cBtConnPolicy policy;
+	uint32_t start = 0xffffffffu - 2999;
+	policy.OnConnect(start);
+	CHECK_STR(run(policy, start, start + 10000), "fi");
+	policy.SetActive(BT_LINK_BULK, true, start + 10000);
+	policy.SetActive(BT_LINK_BULK, false, start + 11000);
+	CHECK_STR(run(policy, start + 10000, start + 20000), "fi");
+}
+
+TEST(advertising){
+	cBtConnPolicy policy;
+	uint16_t min, max;
+	// fast after boot, reported once
+	CHECK(policy.AdvInterval(0, min, max));
+	CHECK_EQ(min, policy.AdvFastMin);
+	CHECK_EQ(max, policy.AdvFastMax);
+	CHECK(!policy.AdvInterval(PERIOD_MS, min, max));
+	CHECK(!policy.AdvInterval(policy.AdvFastMs - 1, min, max));
+	CHECK(policy.AdvInterval(policy.AdvFastMs, min, max));
+	CHECK_EQ(min, policy.AdvSlowMin);
+	CHECK_EQ(max, policy.AdvSlowMax);
+	CHECK(!policy.AdvInterval(100000, min, max));
+	// the button press
+	policy.KickAdvertising(200000);
+	CHECK(policy.AdvInterval(200000, min, max));
+	CHECK_EQ(min, policy.AdvFastMin);
+	CHECK(!policy.AdvInterval(229500, min, max));
+	CHECK(policy.AdvInterval(230000, min, max));
+	// the slow interval is 1022.5..1285 ms (0.625 ms units)
+	CHECK_EQ(policy.AdvSlowMin * 625, 1022500);
+	CHECK_EQ(policy.AdvSlowMax * 625, 1285000);
+}
@@ -0,0 +1,182 @@
+/*
+ * test_bt_fragmenter.cpp
+ *
+ *  cBtFragmenter / cBtReassembler: round trips for the MTU range, sequence wrap, lost and repeated frames, credits
+ */
+
+#include <vector>
+#include "test.h"
+#include "../../components/m_bt/cBtFragmenter.h"
+
+static std::vector<uint8_t> pattern(size_t len){
+	std::vector<uint8_t> v(len);
+	for(size_t i = 0; i < len; i++)
+		v[i] = (uint8_t)(i * 7 + (i >> 8));
+	return v;
+}
+
+// all frames of the value for the ATT MTU
+static std::vector<std::vector<uint8_t> > split(const std::vector<uint8_t> &value, size_t mtu){
+	cBtFragmenter frag;
+	frag.Start(value.data(), value.size());
+	std::vector<std::vector<uint8_t> > frames;
+	std::vector<uint8_t> frame;
+	while(frag.Next(mtu - 3, frame)){
+		CHECK(frame.size() <= mtu - 3);
+		frames.push_back(frame);
+	}
+	CHECK(!frag.Busy());
+	return frames;
+}
+
+static eBtFragResult feed_all(cBtReassembler &rx, const std::vector<std::vector<uint8_t> > &frames){
+	eBtFragResult res = eBtFragResult::e_error;
+	for(auto &f : frames)
+		res = rx.Feed(f.data(), f.size());
+	return res;
+}
+
+TEST(round_trip){
+	size_t mtus[] = {23, 24, 50, 185, 247, 517};
+	size_t lens[] = {0, 1, 17, 20, 21, 100, 244, 512, 4096};
+	for(size_t mtu : mtus){
+		for(size_t len : lens){
+			std::vector<uint8_t> value = pattern(len);
+			std::vector<std::vector<uint8_t> > frames = split(value, mtu);
+			// first frame: header and length, the others: header
+			size_t expect = len + 2 <= mtu - 4 ? 1 : 1 + (len - (mtu - 6) + mtu - 5) / (mtu - 4);
+			CHECK_EQ(frames.size(), expect);
+			cBtReassembler rx;
+			CHECK(feed_all(rx, frames) == eBtFragResult::e_done);
+			CHECK(rx.Data() == value);
+		}
+	}
+}
+
+TEST(headers){
+	std::vector<std::vector<uint8_t> > frames = split(pattern(40), 23);
+	CHECK_EQ(frames.size(), 3);
+	CHECK_EQ(frames[0][0], BT_FRAG_FIRST);
+	CHECK_EQ(frames[0][1], 40);
+	CHECK_EQ(frames[0][2], 0);
+	CHECK_EQ(frames[1][0], 1);
+	CHECK_EQ(frames[2][0], BT_FRAG_LAST | 2);
+	// a short value is one frame
+	frames = split(pattern(3), 23);
+	CHECK_EQ(frames.size(), 1);
+	CHECK_EQ(frames[0][0], BT_FRAG_FIRST | BT_FRAG_LAST);
+}
+
+TEST(sequence_wraps){
+	// more than 64 frames
+	std::vector<uint8_t> value = pattern(3000);
+	std::vector<std::vector<uint8_t> > frames = split(value, 23);
+	CHECK(frames.size() > 2 * 64);
+	CHECK_EQ(frames[64][0], 0);
+	cBtReassembler rx;
+	rx.MaxLen = 4096;
+	CHECK(feed_all(rx, frames) == eBtFragResult::e_done);
+	CHECK(rx.Data() == value);
+}
+
+TEST(lost_frame){
+	std::vector<std::vector<uint8_t> > frames = split(pattern(100), 23);
+	for(size_t lost = 0; lost < frames.size(); lost++){
+		cBtReassembler rx;
+		eBtFragResult res = eBtFragResult::e_more;
+		bool bError = false;
+		for(size_t i = 0; i < frames.size(); i++){
+			if(i == lost)
+				continue;
+			res = rx.Feed(frames[i].data(), frames[i].size());
+			bError |= res == eBtFragResult::e_error;
+		}
+		// the lost last frame is noticed only by the next value (or a timeout of the caller)
+		CHECK(bError || lost == frames.size() - 1);
+		CHECK(res != eBtFragResult::e_done);
+		// the next value is received again
+		CHECK(feed_all(rx, frames) == eBtFragResult::e_done);
+	}
+}
+
+TEST(repeated_frame){
+	std::vector<std::vector<uint8_t> > frames = split(pattern(60), 23);
+	cBtReassembler rx;
+	CHECK(rx.Feed(frames[0].data(), frames[0].size()) == eBtFragResult::e_more);
+	CHECK(rx.Feed(frames[1].data(), frames[1].size()) == eBtFragResult::e_more);
+	CHECK(rx.Feed(frames[1].data(), frames[1].size()) == eBtFragResult::e_error);
+}
+
+TEST(restart){
+	// the sender gives up the value and starts another one
+	std::vector<std::vector<uint8_t> > a = split(pattern(100), 23), b = split(pattern(30), 23);
+	cBtReassembler rx;
+	rx.Feed(a[0].data(), a[0].size());
+	rx.Feed(a[1].data(), a[1].size());
+	CHECK(feed_all(rx, b) == eBtFragResult::e_done);
+	CHECK(rx.Data() == pattern(30));
+}
+
+TEST(malformed){
+	cBtReassembler rx;
+	rx.MaxLen = 50;
+	std::vector<std::vector<uint8_t> > frames = split(pattern(51), 185);
+	CHECK(rx.Feed(frames[0].data(), frames[0].size()) == eBtFragResult::e_error);
+	uint8_t empty[1];
+	CHECK(rx.Feed(empty, 0) == eBtFragResult::e_error);
+	uint8_t short_first[] = {BT_FRAG_FIRST, 5};
+	CHECK(rx.Feed(short_first, sizeof short_first) == eBtFragResult::e_error);
+	uint8_t bad_seq[] = {BT_FRAG_FIRST | 3, 1, 0, 0xaa};
+	CHECK(rx.Feed(bad_seq, sizeof bad_seq) == eBtFragResult::e_error);
+	// more data than announced
+	uint8_t too_much[] = {BT_FRAG_FIRST, 1, 0, 0xaa, 0xbb};
+	CHECK(rx.Feed(too_much, sizeof too_much) == eBtFragResult::e_error);
+	// less data than announced
+	uint8_t too_little[] = {BT_FRAG_FIRST | BT_FRAG_LAST, 3, 0, 0xaa};
+	CHECK(rx.Feed(too_little, sizeof too_little) == eBtFragResult::e_error);
+	// middle frame without the first one
+	uint8_t middle[] = {1, 0xaa};
+	CHECK(rx.Feed(middle, sizeof middle) == eBtFragResult::e_error);
+}
+
+TEST(credits){
+	std::vector<uint8_t> value = pattern(100);
+	cBtFragmenter frag;
+	frag.EnableCredits(true);
+	frag.Start(value.data(), value.size());
+	std::vector<uint8_t> frame;
+	CHECK(!frag.Next(20, frame));
+	CHECK(frag.Busy());
+	cBtReassembler rx;
+	eBtFragResult res = eBtFragResult::e_more;
+	int frames = 0;
+	while(frag.Busy()){
+		frag.AddCredits(2);
+		while(frag.Next(20, frame)){
+			res = rx.Feed(frame.data(), frame.size());
+			frames++;
+		}
+		CHECK_EQ(frag.Credits(), frag.Busy() ? 0 : frames % 2);
+	}
+	CHECK(res == eBtFragResult::e_done);
+	CHECK(rx.Data() == value);
+	frag.AddCredits(1000);
+	CHECK_EQ(frag.Credits(), 0xff);
+	frag.EnableCredits(false);
+	CHECK_EQ(frag.Credits(), 0);
+}
+
+TEST(limits){
+	cBtFragmenter frag;
+	std::vector<uint8_t> frame;
+	std::vector<uint8_t> value = pattern(10);
+	frag.Start(value.data(), value.size());
+	CHECK(!frag.Next(BT_FRAG_MIN_PAYLOAD - 1, frame));
+	CHECK(frag.Next(BT_FRAG_MIN_PAYLOAD, frame));
+	CHECK_EQ(frame.size(), BT_FRAG_MIN_PAYLOAD);
+	CHECK_EQ(frag.Remaining(), 9);
+	// the length field is 16 bit
+	std::vector<uint8_t> huge = pattern(0x10005);
+	frag.Start(huge.data(), huge.size());
+	CHECK_EQ(frag.Remaining(), 0xffff);
+}
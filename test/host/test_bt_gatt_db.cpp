@@ -0,0 +1,302 @@
+/*
+ * test_bt_gatt_db.cpp
+ *
+ *  cBtGattDb: lookups, read planning and the read multiple split, cache record with the Database Hash;
+ *  cBtGattCache: the least recently used peers are dropped over the limit
+ */
+
+#include <string.h>
+#include <nvs.h>
+#include "test.h"
+#include "../../components/m_bt/cBtGattDb.h"
+#include "../../components/m_bt/cBtGattCache.h"
+
+#define CACHE_NS	"btgattc"
+
+static const uint8_t hash[BT_GATT_HASH_LEN] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+static sBtGattChar chr(uint16_t svc, uint16_t uuid, uint16_t handle, uint16_t len = 0){
+	sBtGattChar c;
+	c.svc = BLEUUID(svc);
+	c.uuid = BLEUUID(uuid);
+	c.handle = handle;
+	c.cccd = 0;
+	c.props = 0x02;
+	c.len = len;
+	return c;
+}
+
+// a sensor service of 12 characteristics and the GATT service
+static void fill(cBtGattDb &db){
+	db.Clear();
+	for(uint16_t i = 0; i < 12; i++)
+		db.Add(chr(0xafff, 0xaf01 + i, 40 - 2 * i, 4));
+	db.Add(chr(0x1801, 0x2a05, 3));
+	db.Add(chr(0x1801, 0x2b2a, 6, BT_GATT_HASH_LEN));
+}
+
+static void fresh_nvs(){
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+}
+
+static void addr(uint8_t n, esp_bd_addr_t bda){
+	const esp_bd_addr_t base = {0xa4, 0xcf, 0x12, 0x00, 0x00, 0x00};
+	memcpy(bda, base, sizeof base);
+	bda[5] = n;
+}
+
+TEST(find){
+	cBtGattDb db;
+	fill(db);
+	CHECK_EQ(db.Chars().size(), 14);
+	// sorted by handle
+	for(size_t i = 1; i < db.Chars().size(); i++)
+		CHECK(db.Chars()[i - 1].handle < db.Chars()[i].handle);
+	sBtGattChar *p = db.Find(BLEUUID((uint16_t)0xafff), BLEUUID((uint16_t)0xaf03));
+	CHECK(p != nullptr);
+	CHECK_EQ(p->handle, 36);
+	CHECK(db.FindByHandle(36) == p);
+	CHECK(db.FindByHandle(37) == nullptr);
+	CHECK(db.Find(BLEUUID((uint16_t)0x1801), BLEUUID((uint16_t)0xaf03)) == nullptr);
+	CHECK_EQ(db.ServiceChangedHandle(), 3);
+	CHECK_EQ(db.HashHandle(), 6);
+	// the same handle is replaced
+	db.Add(chr(0xafff, 0xaf77, 36));
+	CHECK_EQ(db.Chars().size(), 14);
+	CHECK(db.FindByHandle(36)->uuid == BLEUUID((uint16_t)0xaf77));
+	db.Clear();
+	CHECK(db.Empty());
+	CHECK_EQ(db.HashHandle(), 0);
+}
+
+TEST(lengths){
+	cBtGattDb db;
+	fill(db);
+	CHECK(!db.SetLength(40, 4));
+	CHECK(db.SetLength(40, 8));
+	CHECK_EQ(db.FindByHandle(40)->len, 8);
+	CHECK(!db.SetLength(41, 8));
+	CHECK(!db.SetLength(40, 0x10000));
+}
+
+TEST(plan_reads){
+	cBtGattDb db;
+	fill(db);
+	std::vector<std::vector<uint16_t> > reads;
+	uint16_t handles[12];
+	for(int i = 0; i < 12; i++)
+		handles[i] = 40 - 2 * i;
+	// MTU 247: limited by the handles of one request
+	db.PlanReads(handles, 12, 246, reads);
+	CHECK_EQ(reads.size(), 2);
+	CHECK_EQ(reads[0].size(), BT_GATT_MULTI_MAX);
+	CHECK_EQ(reads[1].size(), 2);
+	CHECK_EQ(reads[0][0], 40);
+	CHECK_EQ(reads[1][1], 18);
+	// MTU 23: 22 bytes of the payload are 5 values
+	db.PlanReads(handles, 12, 22, reads);
+	CHECK_EQ(reads.size(), 3);
+	CHECK_EQ(reads[0].size(), 5);
+	CHECK_EQ(reads[2].size(), 2);
+	// unknown, unlisted and too long values are read alone, the batch goes on
+	db.SetLength(36, 0);
+	db.SetLength(34, 30);
+	uint16_t mixed[] = {40, 38, 36, 34, 99, 32};
+	db.PlanReads(mixed, 6, 22, reads);
+	CHECK_EQ(reads.size(), 4);
+	CHECK_EQ(reads[0].size(), 1);
+	CHECK_EQ(reads[0][0], 36);
+	CHECK_EQ(reads[1][0], 34);
+	CHECK_EQ(reads[2][0], 99);
+	CHECK_EQ(reads[3].size(), 3);
+	CHECK_EQ(reads[3][2], 32);
+}
+
+TEST(split_multiple){
+	cBtGattDb db;
+	fill(db);
+	db.SetLength(38, 2);
+	uint16_t handles[] = {40, 38, 36};
+	std::vector<uint16_t> lens;
+	CHECK(db.SplitMultiple(handles, 3, 10, lens));
+	CHECK_EQ(lens.size(), 3);
+	CHECK_EQ(lens[1], 2);
+	// a value of a changed length
+	CHECK(!db.SplitMultiple(handles, 3, 11, lens));
+	db.SetLength(36, 0);
+	CHECK(!db.SplitMultiple(handles, 3, 6, lens));
+}
+
+TEST(db_hash){
+	cBtGattDb db;
+	CHECK(db.Hash().empty());
+	CHECK(!db.HashMatches(hash, sizeof hash));
+	db.SetHash(hash, sizeof hash);
+	CHECK_EQ(db.Hash().size(), BT_GATT_HASH_LEN);
+	CHECK(db.HashMatches(hash, sizeof hash));
+	CHECK(!db.HashMatches(hash, sizeof hash - 1));
+	uint8_t other[BT_GATT_HASH_LEN];
+	memcpy(other, hash, sizeof other);
+	other[15] ^= 0x80;
+	CHECK(!db.HashMatches(other, sizeof other));
+	// not a hash: forgotten
+	db.SetHash(hash, 4);
+	CHECK(db.Hash().empty());
+}
+
+TEST(record){
+	cBtGattDb db, out;
+	fill(db);
+	db.FindByHandle(40)->cccd = 41;
+	std::vector<uint8_t> data;
+	cBtGattDb::Encode(db, data);
+	CHECK(cBtGattDb::Decode(data, out));
+	CHECK_EQ(out.Chars().size(), db.Chars().size());
+	CHECK(out.Hash().empty());
+	for(size_t i = 0; i < db.Chars().size(); i++){
+		const sBtGattChar &a = db.Chars()[i], &b = out.Chars()[i];
+		CHECK(a.svc == b.svc);
+		CHECK(a.uuid == b.uuid);
+		CHECK_EQ(a.handle, b.handle);
+		CHECK_EQ(a.cccd, b.cccd);
+		CHECK_EQ(a.props, b.props);
+		CHECK_EQ(a.len, b.len);
+	}
+	db.SetHash(hash, sizeof hash);
+	cBtGattDb::Encode(db, data);
+	CHECK(cBtGattDb::Decode(data, out));
+	CHECK(out.HashMatches(hash, sizeof hash));
+	CHECK_EQ(out.Chars().size(), 14);
+	// a record without the hash removes the former one
+	cBtGattDb empty;
+	cBtGattDb::Encode(empty, data);
+	CHECK(cBtGattDb::Decode(data, out));
+	CHECK(out.Empty());
+	CHECK(out.Hash().empty());
+}
+
+TEST(bad_record){
+	cBtGattDb db, out;
+	fill(db);
+	db.SetHash(hash, sizeof hash);
+	std::vector<uint8_t> data;
+	cBtGattDb::Encode(db, data);
+	// the former version without the hash is discovered again
+	std::vector<uint8_t> bad(data.begin(), data.end() - 1 - BT_GATT_HASH_LEN);
+	bad[0] = 1;
+	CHECK(!cBtGattDb::Decode(bad, out));
+	bad = data;
+	bad.pop_back();
+	CHECK(!cBtGattDb::Decode(bad, out));
+	bad = data;
+	bad.push_back(0);
+	CHECK(!cBtGattDb::Decode(bad, out));
+	// a hash of another length
+	bad.assign(data.begin(), data.end() - 8);
+	bad[bad.size() - 9] = 8;
+	CHECK(!cBtGattDb::Decode(bad, out));
+	bad.assign(data.begin(), data.begin() + 2);
+	CHECK(!cBtGattDb::Decode(bad, out));
+	// the failed decode keeps the database
+	CHECK(out.Empty());
+	CHECK(cBtGattDb::Decode(data, out));
+	CHECK(!cBtGattDb::Decode(bad, out));
+	CHECK_EQ(out.Chars().size(), 14);
+}
+
+TEST(cache){
+	fresh_nvs();
+	cBtGattDb db, out;
+	fill(db);
+	db.SetHash(hash, sizeof hash);
+	esp_bd_addr_t a, b;
+	addr(1, a);
+	addr(2, b);
+	{
+		cBtGattCache cache;
+		CHECK_EQ(cache.Count(), 0);
+		CHECK(!cache.Load(a, out));
+		CHECK(cache.Save(a, db));
+		CHECK_EQ(cache.Count(), 1);
+	}
+	// after the reboot
+	cBtGattCache cache;
+	CHECK_EQ(cache.Count(), 1);
+	CHECK(cache.Load(a, out));
+	CHECK(out.HashMatches(hash, sizeof hash));
+	CHECK(!cache.Load(b, out));
+	CHECK(cache.Save(b, db));
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 3);
+	CHECK(cache.Erase(a));
+	CHECK_EQ(cache.Count(), 1);
+	CHECK(!cache.Load(a, out));
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 2);
+	cache.EraseAll();
+	CHECK_EQ(cache.Count(), 0);
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 0);
+}
+
+TEST(cache_lru){
+	fresh_nvs();
+	cBtGattDb db, out;
+	fill(db);
+	cBtGattCache cache;
+	esp_bd_addr_t bda;
+	for(uint8_t i = 0; i < BT_GATT_CACHE_MAX_PEERS; i++){
+		addr(i, bda);
+		CHECK(cache.Save(bda, db));
+	}
+	CHECK_EQ(cache.Count(), BT_GATT_CACHE_MAX_PEERS);
+	// the first one is used again, the second one is the oldest now
+	addr(0, bda);
+	CHECK(cache.Load(bda, out));
+	addr(100, bda);
+	CHECK(cache.Save(bda, db));
+	CHECK_EQ(cache.Count(), BT_GATT_CACHE_MAX_PEERS);
+	CHECK_EQ(nvs_host_keys(CACHE_NS), BT_GATT_CACHE_MAX_PEERS + 1);
+	addr(1, bda);
+	CHECK(!cache.Load(bda, out));
+	addr(0, bda);
+	CHECK(cache.Load(bda, out));
+	// many peers: the flash use is limited
+	size_t bytes = nvs_host_bytes(CACHE_NS);
+	for(uint8_t i = 0; i < 50; i++){
+		addr(200 + i, bda);
+		CHECK(cache.Save(bda, db));
+	}
+	CHECK_EQ(cache.Count(), BT_GATT_CACHE_MAX_PEERS);
+	CHECK_EQ(nvs_host_bytes(CACHE_NS), bytes);
+	// the order is kept across reboots
+	cBtGattCache again;
+	addr(242, bda);
+	CHECK(again.Load(bda, out));
+	addr(1, bda);
+	CHECK(again.Save(bda, db));
+	CHECK_EQ(again.Count(), BT_GATT_CACHE_MAX_PEERS);
+	addr(243, bda);
+	CHECK(!again.Load(bda, out));
+	addr(242, bda);
+	CHECK(again.Load(bda, out));
+}
+
+TEST(cache_load_writes){
+	fresh_nvs();
+	cBtGattDb db, out;
+	fill(db);
+	cBtGattCache cache;
+	esp_bd_addr_t a, b;
+	addr(1, a);
+	addr(2, b);
+	cache.Save(a, db);
+	cache.Save(b, db);
+	// the reconnection to the last peer does not write the flash
+	size_t commits = nvs_host_commits();
+	CHECK(cache.Load(b, out));
+	CHECK(cache.Load(b, out));
+	CHECK_EQ(nvs_host_commits(), commits);
+	CHECK(cache.Load(a, out));
+	CHECK_EQ(nvs_host_commits(), commits + 1);
+	CHECK(cache.Load(a, out));
+	CHECK_EQ(nvs_host_commits(), commits + 1);
+}
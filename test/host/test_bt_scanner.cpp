@@ -0,0 +1,346 @@
+/*
+ * test_bt_scanner.cpp
+ *
+ *  cBtScanTable: AD parsing, reports of the new and changed devices, RSSI average, eviction and expiry;
+ *  cBtScanner on the simulated stack: the lost devices are reported by the timer without any scan result
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <set>
+#include <vector>
+#include <freertos/timers.h>
+#include "test.h"
+#include "bt_sim.h"
+#include "../../components/m_bt/cBtScanner.h"
+
+static const std::vector<uint8_t> advTag = {0x02, 0x01, 0x06, 0x05, 0xff, 0x59, 0x00, 0x01, 0x02};
+static const std::vector<uint8_t> advTag2 = {0x02, 0x01, 0x06, 0x05, 0xff, 0x59, 0x00, 0x01, 0x03};
+static const std::vector<uint8_t> rspName = {0x04, 0x09, 't', 'a', 'g'};
+
+static void addr(uint32_t n, uint8_t *bda){
+	const uint8_t base[6] = {0xc4, 0x7c, 0x8d, 0, 0, 0};
+	memcpy(bda, base, sizeof base);
+	bda[3] = n >> 16;
+	bda[4] = n >> 8;
+	bda[5] = n;
+}
+
+static eBtScanReport feed(cBtScanTable &tab, uint32_t n, int rssi, const std::vector<uint8_t> &data, uint32_t now,
+		bool bScanRsp = false){
+	uint8_t bda[6];
+	addr(n, bda);
+	return tab.Feed(bda, BLE_ADDR_TYPE_PUBLIC, rssi, data.data(), data.size(), bScanRsp, now);
+}
+
+static const sBtScanDevice* find(cBtScanTable &tab, uint32_t n){
+	uint8_t bda[6];
+	addr(n, bda);
+	return tab.Find(bda);
+}
+
+TEST(adv_iter){
+	const uint8_t data[] = {0x02, 0x01, 0x06, 0x03, 0x03, 0xaa, 0xfe, 0x01, 0x09, 0x00, 0x00};
+	cBtAdvIter it(data, sizeof data);
+	uint8_t type;
+	const uint8_t *value;
+	size_t len;
+	CHECK(it.Next(type, value, len));
+	CHECK_EQ(type, 0x01);
+	CHECK_EQ(len, 1);
+	CHECK_EQ(value[0], 0x06);
+	CHECK(it.Next(type, value, len));
+	CHECK_EQ(type, 0x03);
+	CHECK_EQ(len, 2);
+	// the empty name, then the padding ends it
+	CHECK(it.Next(type, value, len));
+	CHECK_EQ(type, 0x09);
+	CHECK_EQ(len, 0);
+	CHECK(!it.Next(type, value, len));
+	CHECK(!it.Next(type, value, len));
+	CHECK(cBtAdvIter::Find(data, sizeof data, 0x03, value, len));
+	CHECK_EQ(value[1], 0xfe);
+	CHECK(!cBtAdvIter::Find(data, sizeof data, 0xff, value, len));
+	// a field over the end
+	const uint8_t cut[] = {0x02, 0x01, 0x06, 0x05, 0xff, 0x59};
+	CHECK(!cBtAdvIter::Find(cut, sizeof cut, 0xff, value, len));
+	CHECK(cBtAdvIter::Find(cut, sizeof cut, 0x01, value, len));
+}
+
+TEST(reports){
+	cBtScanTable tab;
+	CHECK(feed(tab, 1, -70, advTag, 0) == eBtScanReport::e_new);
+	CHECK(feed(tab, 1, -70, advTag, 100) == eBtScanReport::e_none);
+	CHECK(feed(tab, 1, -71, advTag2, 200) == eBtScanReport::e_changed);
+	CHECK(feed(tab, 1, -70, advTag2, 300) == eBtScanReport::e_none);
+	// the scan response is compared with the former one, not with the advertisement
+	CHECK(feed(tab, 1, -70, rspName, 400, true) == eBtScanReport::e_changed);
+	CHECK(feed(tab, 1, -70, advTag2, 500) == eBtScanReport::e_none);
+	CHECK(feed(tab, 1, -70, rspName, 600, true) == eBtScanReport::e_none);
+	const sBtScanDevice *p = find(tab, 1);
+	CHECK(p != nullptr);
+	CHECK_EQ(p->count, 7);
+	CHECK_EQ(p->firstSeen, 0);
+	CHECK_EQ(p->lastSeen, 600);
+	CHECK_EQ(tab.Count(), 1);
+	// too weak
+	CHECK(feed(tab, 2, -101, advTag, 700) == eBtScanReport::e_none);
+	CHECK(find(tab, 2) == nullptr);
+	CHECK(feed(tab, 2, -100, advTag, 700) == eBtScanReport::e_new);
+	CHECK_EQ(tab.Count(), 2);
+}
+
+TEST(rssi){
+	cBtScanTable tab;
+	feed(tab, 1, -70, advTag, 0);
+	CHECK_EQ(find(tab, 1)->Rssi(), -70);
+	// one strong packet moves the average by a quarter, not reported yet
+	CHECK(feed(tab, 1, -50, advTag, 10) == eBtScanReport::e_none);
+	CHECK_EQ(find(tab, 1)->Rssi(), -65);
+	CHECK(feed(tab, 1, -50, advTag, 20) == eBtScanReport::e_rssi);
+	int reported = find(tab, 1)->rssiReported;
+	CHECK(reported >= -62 && reported <= -60);
+	CHECK(feed(tab, 1, -50, advTag, 30) == eBtScanReport::e_none);
+	// the noise around the average is not reported
+	for(int i = 0; i < 100; i++)
+		CHECK(feed(tab, 1, i & 1 ? -48 : -52, advTag, 40 + i) != eBtScanReport::e_rssi || i < 4);
+	CHECK_EQ(find(tab, 1)->Rssi(), -50);
+}
+
+TEST(expire){
+	cBtScanTable tab;
+	tab.TimeoutMs = 1000;
+	for(uint32_t i = 0; i < 10; i++)
+		feed(tab, i, -60, advTag, i * 100);
+	sBtScanDevice lost;
+	CHECK(!tab.Expire(1000, lost));
+	CHECK(tab.Expire(1001, lost));
+	CHECK_EQ(lost.bda[5], 0);
+	CHECK(!tab.Expire(1001, lost));
+	// seen again: kept
+	feed(tab, 1, -60, advTag, 1050);
+	int count = 0;
+	while(tab.Expire(1550, lost)){
+		CHECK(lost.bda[5] >= 2 && lost.bda[5] <= 5);
+		count++;
+	}
+	CHECK_EQ(count, 4);
+	CHECK_EQ(tab.Count(), 5);
+	CHECK(find(tab, 1) != nullptr);
+	CHECK(find(tab, 6) != nullptr);
+	CHECK(find(tab, 5) == nullptr);
+	// lost devices are new again
+	CHECK(feed(tab, 5, -60, advTag, 1600) == eBtScanReport::e_new);
+}
+
+TEST(full){
+	cBtScanTable tab;
+	size_t max = BT_SCAN_TABLE_SIZE * 3 / 4;
+	for(uint32_t i = 0; i < max; i++)
+		CHECK(feed(tab, i, -60, advTag, 1000 + i) == eBtScanReport::e_new);
+	CHECK_EQ(tab.Count(), max);
+	// device 0 is seen again, device 1 is the oldest now
+	feed(tab, 0, -60, advTag, 2000);
+	CHECK(feed(tab, 500, -60, advTag, 2001) == eBtScanReport::e_new);
+	CHECK_EQ(tab.Count(), max);
+	CHECK(find(tab, 1) == nullptr);
+	CHECK(find(tab, 0) != nullptr);
+	CHECK(find(tab, 500) != nullptr);
+	// a crowd keeps the table bounded
+	for(uint32_t i = 1000; i < 2000; i++)
+		feed(tab, i, -60, advTag, 3000 + i);
+	CHECK_EQ(tab.Count(), max);
+	for(uint32_t i = 2000 - max; i < 2000; i++)
+		CHECK(find(tab, i) != nullptr);
+	size_t used = 0;
+	for(size_t i = 0; i < BT_SCAN_TABLE_SIZE; i++)
+		used += tab.At(i) != nullptr;
+	CHECK_EQ(used, max);
+	tab.Clear();
+	CHECK_EQ(tab.Count(), 0);
+	CHECK(find(tab, 1999) == nullptr);
+}
+
+// the removals in the middle of the probe sequences keep the other devices reachable
+TEST(collisions){
+	cBtScanTable tab;
+	tab.TimeoutMs = 0;
+	srand(7);
+	std::set<uint32_t> present;
+	uint32_t now = 0;
+	for(int round = 0; round < 2000; round++){
+		uint32_t n = rand() & 0xfffff;
+		if(tab.Count() < 40 && !present.count(n)){
+			CHECK(feed(tab, n, -60, advTag, now) == eBtScanReport::e_new);
+			present.insert(n);
+		}
+		// about every third round the oldest one of the same time goes
+		if(round % 3 == 2){
+			now++;
+			sBtScanDevice lost;
+			if(tab.Expire(now, lost)){
+				uint32_t m = (lost.bda[3] << 16) | (lost.bda[4] << 8) | lost.bda[5];
+				CHECK_EQ(present.erase(m), 1);
+			}
+			// the others of the former times are touched, only one is removed per round
+			for(uint32_t m : present)
+				feed(tab, m, -60, advTag, now);
+		}
+		CHECK_EQ(tab.Count(), present.size());
+	}
+	for(uint32_t m : present)
+		CHECK(find(tab, m) != nullptr);
+}
+
+// ============================================== cBtScanner ================================================
+
+class cScanLog: public cBtScanCallbacks{
+public:
+	std::vector<eBtScanReport> reports;
+	std::vector<int> lost; // the last address byte
+	int ends;
+
+	cScanLog():ends(0){}
+	void OnDevice(const sBtScanDevice &dev, eBtScanReport reason, const uint8_t *data, size_t len, bool bScanRsp){
+		reports.push_back(reason);
+	}
+	void OnLost(const sBtScanDevice &dev){
+		lost.push_back(dev.bda[5]);
+	}
+	void OnScanEnd(){
+		ends++;
+	}
+};
+
+struct sScanner{
+	cBtDevice dev;
+	cBtScanner scan;
+	cScanLog log;
+
+	sScanner(){
+		cBtSim::Get().Reset();
+		dev.Init("sim");
+		scan.Init(&dev);
+		scan.setCallbacks(&log);
+		scan.getTable().TimeoutMs = 5000;
+	}
+};
+
+static void advertise(uint32_t n, int rssi = -60, const std::vector<uint8_t> &adv = advTag,
+		const std::vector<uint8_t> &rsp = std::vector<uint8_t>()){
+	uint8_t bda[6];
+	addr(n, bda);
+	cBtSim::Get().Advertise(bda, rssi, adv, rsp);
+	cBtSim::Get().Run();
+}
+
+// ms without any scan result, the timers run every 100 ms
+static void quiet(uint32_t ms){
+	for(uint32_t t = 0; t < ms; t += 100){
+		host_tick_advance(100);
+		host_timers_run();
+	}
+}
+
+TEST(scan_start){
+	sScanner s;
+	cBtSim &sim = cBtSim::Get();
+	s.scan.Active = true;
+	CHECK(s.scan.Start(30));
+	CHECK(s.scan.IsScanning());
+	sim.Run();
+	CHECK(sim.bScanning);
+	CHECK_EQ(sim.scanDuration, 30);
+	CHECK_EQ(sim.scanParams.scan_type, BLE_SCAN_TYPE_ACTIVE);
+	CHECK_EQ(sim.scanParams.scan_interval, 160);
+	CHECK_EQ(sim.scanParams.scan_window, 32);
+	advertise(1, -60, advTag, rspName);
+	advertise(1, -60, advTag, rspName);
+	CHECK_EQ(s.log.reports.size(), 2);
+	CHECK(s.log.reports[0] == eBtScanReport::e_new);
+	CHECK(s.log.reports[1] == eBtScanReport::e_changed);
+	std::vector<sBtScanDevice> devices;
+	s.scan.getDevices(devices);
+	CHECK_EQ(devices.size(), 1);
+	CHECK_EQ(devices[0].count, 4);
+	sim.ScanEnd();
+	sim.Run();
+	CHECK_EQ(s.log.ends, 1);
+	CHECK(!s.scan.IsScanning());
+}
+
+TEST(lost_without_results){
+	sScanner s;
+	s.scan.Start();
+	cBtSim::Get().Run();
+	advertise(1);
+	advertise(2);
+	quiet(3000);
+	advertise(2);
+	// nothing is received any more, the timer reports them
+	quiet(2000);
+	CHECK_EQ(s.log.lost.size(), 0);
+	quiet(1100);
+	CHECK(s.log.lost == std::vector<int>({1}));
+	quiet(3000);
+	CHECK(s.log.lost == std::vector<int>({1, 2}));
+	std::vector<sBtScanDevice> devices;
+	s.scan.getDevices(devices);
+	CHECK(devices.empty());
+}
+
+TEST(kept_while_stopped){
+	sScanner s;
+	cBtSim &sim = cBtSim::Get();
+	s.scan.Start();
+	sim.Run();
+	advertise(1);
+	s.scan.Stop();
+	sim.Run();
+	CHECK(!s.scan.IsScanning());
+	// not heard because nobody listens
+	quiet(20000);
+	CHECK_EQ(s.log.lost.size(), 0);
+	s.scan.Start();
+	sim.Run();
+	advertise(1);
+	CHECK_EQ(s.log.lost.size(), 0);
+	// checked every second
+	quiet(6000);
+	CHECK_EQ(s.log.lost.size(), 1);
+}
+
+TEST(scan_end){
+	sScanner s;
+	cBtSim &sim = cBtSim::Get();
+	s.scan.Start(10);
+	sim.Run();
+	advertise(1);
+	quiet(2000);
+	advertise(2);
+	quiet(4100);
+	CHECK_EQ(s.log.lost.size(), 1);
+	// the end reports the lost ones at once, the timer stops
+	host_tick_advance(1000);
+	sim.ScanEnd();
+	sim.Run();
+	CHECK_EQ(s.log.ends, 1);
+	CHECK_EQ(s.log.lost.size(), 2);
+	advertise(3);
+	quiet(20000);
+	CHECK_EQ(s.log.lost.size(), 2);
+	CHECK_EQ(s.log.reports.size(), 2);
+}
+
+TEST(deinit){
+	cBtSim &sim = cBtSim::Get();
+	{
+		sScanner s;
+		s.scan.Start();
+		sim.Run();
+		advertise(1);
+	}
+	// the timer is deleted with the scanner
+	host_tick_advance(10000);
+	CHECK_EQ(host_timers_run(), 0);
+}
@@ -0,0 +1,587 @@
+/*
+ * test_bt_server.cpp
+ *
+ *  cBtServer with its services on the simulated stack, scripted centrals: database, MTU, reads, long reads,
+ *  prepared writes, permissions, notifications, indications, congestion, disconnects, bonds
+ */
+
+#include <string>
+#include <vector>
+#include <nvs.h>
+#include <freertos/timers.h>
+#include "test.h"
+#include "bt_sim.h"
+#include "../../components/m_bt/cBtServer.h"
+#include "../../components/m_bt/BLE2902.h"
+
+#define PROP_READ		cBtCharacteristic::PROPERTY_READ
+#define PROP_WRITE		cBtCharacteristic::PROPERTY_WRITE
+#define PROP_NOTIFY		cBtCharacteristic::PROPERTY_NOTIFY
+#define PROP_INDICATE	cBtCharacteristic::PROPERTY_INDICATE
+
+class cWriteCounter: public cBtCharCallbacks{
+public:
+	int writes = 0;
+	std::string last;
+	void AftereWrite(cBtCharacteristic *pCaller) override{
+		writes++;
+		last = pCaller->getValue();
+	}
+};
+
+static std::vector<uint8_t> pattern(size_t len, uint8_t seed = 0){
+	std::vector<uint8_t> v(len);
+	for(size_t i = 0; i < len; i++)
+		v[i] = (uint8_t)(i * 13 + seed);
+	return v;
+}
+
+static std::vector<uint8_t> bytes(const std::string &s){
+	return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+// the service of the device: identity, command, a long record, a sensor, alarms and a secret
+struct sDevice{
+	cBtDevice dev;
+	cBtServer srv;
+	cWriteCounter cmdWrites, recordWrites;
+	cBtCharacteristic *pId, *pCmd, *pRecord, *pSensor, *pAlarm, *pSecret;
+	uint16_t hId, hCmd, hRecord, hSensor, hAlarm, hSecret;
+
+	sDevice(bool bBatch = true, int maxConnections = 1, bool bBonds = false){
+		cBtSim::Get().Reset();
+		dev.Init("sim");
+		srv.BatchCreate = bBatch;
+		srv.MaxConnections = maxConnections;
+		srv.PersistBonds = bBonds;
+		cBtService *pSvc = srv.ServiceCreate((uint16_t)0xafff);
+		pId = pSvc->CharCreate((uint16_t)0xaf01);
+		pId->setProperties(PROP_READ);
+		pId->setValue("123456789");
+		pCmd = pSvc->CharCreate((uint16_t)0xaf02);
+		pCmd->setProperties(PROP_WRITE);
+		pCmd->setCallbacks(&cmdWrites);
+		pRecord = pSvc->CharCreate((uint16_t)0xaf03);
+		pRecord->setProperties(PROP_READ | PROP_WRITE);
+		pRecord->setMaxLength(512);
+		std::vector<uint8_t> rec = pattern(300);
+		pRecord->setValue(rec.data(), rec.size());
+		pRecord->setCallbacks(&recordWrites);
+		pSensor = pSvc->CharCreate((uint16_t)0xaf04);
+		pSensor->setProperties(PROP_READ | PROP_NOTIFY);
+		pSensor->DescAdd(new BLE2902);
+		pAlarm = pSvc->CharCreate((uint16_t)0xaf05);
+		pAlarm->setProperties(PROP_INDICATE);
+		pAlarm->DescAdd(new BLE2902);
+		pSecret = pSvc->CharCreate((uint16_t)0xaf06);
+		pSecret->setProperties(PROP_READ | PROP_WRITE);
+		pSecret->setPermissions(ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_WRITE_ENCRYPTED);
+		pSecret->setValue("key");
+		srv.Init(&dev);
+		srv.Start();
+		cBtSim &sim = cBtSim::Get();
+		hId = sim.FindChar((uint16_t)0xaf01);
+		hCmd = sim.FindChar((uint16_t)0xaf02);
+		hRecord = sim.FindChar((uint16_t)0xaf03);
+		hSensor = sim.FindChar((uint16_t)0xaf04);
+		hAlarm = sim.FindChar((uint16_t)0xaf05);
+		hSecret = sim.FindChar((uint16_t)0xaf06);
+	}
+};
+
+// the database as the central discovers it: handle, UUID and the declaration values
+static std::string dump_db(){
+	std::string s;
+	char line[80];
+	for(auto &attr : cBtSim::Get().attrs){
+		snprintf(line, sizeof line, "%04x %s perm %x:", attr.handle, attr.uuid.toString().c_str(), attr.perm);
+		s += line;
+		for(size_t i = 0; attr.bStackValue && i < attr.value.size(); i++){
+			snprintf(line, sizeof line, " %02x", attr.value[i]);
+			s += line;
+		}
+		s += "\n";
+	}
+	return s;
+}
+
+// the beacon in the advertised data, false if there is none or it is forged
+static bool advertised_beacon(const uint8_t *key, size_t keyLen, sBtBeaconState &st){
+	const std::vector<uint8_t> &adv = cBtSim::Get().advData;
+	for(size_t pos = 0; pos + 1 < adv.size() && adv[pos]; pos += adv[pos] + 1){
+		if(adv[pos + 1] == ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE)
+			return cBtBeacon::Decode(&adv[pos + 2], adv[pos] - 1, key, keyLen, st);
+	}
+	return false;
+}
+
+static sSimValue last_value(cSimCentral &c){
+	return c.received.empty() ? sSimValue{0, false, {}} : c.received.back();
+}
+
+TEST(database){
+	sDevice d;
+	cBtSim &sim = cBtSim::Get();
+	CHECK_EQ(sim.handleErrors, 0);
+	// service, 6 characteristics, 2 CCCDs
+	CHECK_EQ(sim.attrs.size(), 1 + 6 * 2 + 2);
+	CHECK_EQ(sim.attrs[0].handle, SIM_FIRST_HANDLE);
+	CHECK(sim.attrs[0].value == std::vector<uint8_t>({0xff, 0xaf}));
+	CHECK_EQ(d.hId, SIM_FIRST_HANDLE + 2);
+	// declaration: properties, value handle, UUID
+	CHECK(sim.Attr(d.hId - 1)->value == std::vector<uint8_t>({ESP_GATT_CHAR_PROP_BIT_READ, (uint8_t)d.hId, 0, 0x01, 0xaf}));
+	// the permissions follow the properties
+	CHECK_EQ(sim.Attr(d.hId)->perm, ESP_GATT_PERM_READ);
+	CHECK_EQ(sim.Attr(d.hCmd)->perm, ESP_GATT_PERM_WRITE);
+	CHECK_EQ(sim.Attr(d.hRecord)->perm, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE);
+	CHECK_EQ(sim.Attr(d.hAlarm)->perm, 0);
+	uint16_t cccd = sim.FindDesc(d.hSensor, (uint16_t)0x2902);
+	CHECK_EQ(cccd, d.hSensor + 1);
+	CHECK_EQ(sim.Attr(cccd)->perm, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE);
+	CHECK_EQ(sim.FindDesc(d.hId, (uint16_t)0x2902), 0);
+	// the advertising is started by the registration
+	CHECK(sim.bAdvertising);
+	CHECK_EQ(sim.advParams.adv_type, ADV_TYPE_IND);
+}
+
+TEST(database_per_attribute){
+	// the fallback creation calls: the same database
+	std::string batch;
+	{
+		sDevice d;
+		batch = dump_db();
+	}
+	sDevice d(false);
+	CHECK_EQ(cBtSim::Get().handleErrors, 0);
+	CHECK_STR(dump_db(), batch);
+	cSimCentral c(1);
+	c.Connect();
+	std::vector<uint8_t> value;
+	CHECK_EQ(c.Read(d.hId, value), ESP_GATT_OK);
+	CHECK(value == bytes("123456789"));
+}
+
+TEST(database_descriptors){
+	// the handles of the per attribute creation are counted with the descriptors
+	cBtSim &sim = cBtSim::Get();
+	sim.Reset();
+	cBtDevice dev;
+	dev.Init("sim");
+	cBtServer srv;
+	srv.BatchCreate = false;
+	srv.PersistBonds = false;
+	cBtService *pSvc = srv.ServiceCreate((uint16_t)0xafff);
+	for(uint16_t i = 0; i < 3; i++){
+		cBtCharacteristic *pChar = pSvc->CharCreate((uint16_t)(0xaf10 + i));
+		pChar->setProperties(PROP_READ | PROP_NOTIFY);
+		pChar->DescAdd(new BLE2902);
+		pChar->DescCreate((uint16_t)0x2901)->setValue("sensor");
+	}
+	srv.Init(&dev);
+	srv.Start();
+	CHECK_EQ(sim.handleErrors, 0);
+	CHECK_EQ(sim.attrs.size(), 1 + 3 * 4);
+	uint16_t h = sim.FindChar((uint16_t)0xaf12);
+	CHECK(h != 0);
+	CHECK_EQ(sim.FindDesc(h, (uint16_t)0x2901), h + 2);
+}
+
+TEST(mtu_and_read){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	CHECK(!cBtSim::Get().bAdvertising);
+	CHECK_EQ(d.srv.getConnectedCount(), 1);
+	CHECK_EQ(d.srv.getMtu(1), 23);
+	std::vector<uint8_t> value;
+	CHECK_EQ(c.Read(d.hId, value), ESP_GATT_OK);
+	CHECK(value == bytes("123456789"));
+	CHECK_EQ(c.ExchangeMtu(185), 185);
+	CHECK_EQ(d.srv.getMtu(1), 185);
+	CHECK_EQ(c.ExchangeMtu(1000), ESP_GATT_MAX_MTU_SIZE);
+	CHECK_EQ(d.srv.getMtu(1), ESP_GATT_MAX_MTU_SIZE);
+	// the stack answers the unknown handles and the declarations itself
+	CHECK_EQ(c.Read(0x1000, value), ESP_GATT_INVALID_HANDLE);
+	CHECK_EQ(c.Read(d.hId - 1, value), ESP_GATT_OK);
+	CHECK_EQ(value.size(), 5);
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.reads, 1);
+	CHECK_EQ(stats.connects, 1);
+	CHECK_EQ(cBtSim::Get().strayResponses, 0);
+}
+
+TEST(long_read){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	std::vector<uint8_t> value;
+	// 300 bytes at MTU 23: a read and 13 blobs of 22 bytes
+	uint32_t before = cBtSim::Get().responses;
+	CHECK_EQ(c.ReadLong(d.hRecord, value), ESP_GATT_OK);
+	CHECK(value == pattern(300));
+	CHECK_EQ(cBtSim::Get().responses - before, 14);
+	c.ExchangeMtu(185);
+	CHECK_EQ(c.ReadLong(d.hRecord, value), ESP_GATT_OK);
+	CHECK(value == pattern(300));
+	// the value is changed between the parts: the client reads it again
+	CHECK_EQ(c.Read(d.hRecord, value), ESP_GATT_OK);
+	std::vector<uint8_t> other = pattern(300, 1);
+	d.pRecord->setValue(other.data(), other.size());
+	CHECK_EQ(c.ReadBlob(d.hRecord, 184, value), ESP_GATT_ERROR);
+	CHECK_EQ(c.ReadLong(d.hRecord, value), ESP_GATT_OK);
+	CHECK(value == other);
+	CHECK_EQ(c.ReadBlob(d.hRecord, 301, value), ESP_GATT_INVALID_OFFSET);
+	CHECK_EQ(cBtSim::Get().strayResponses, 0);
+}
+
+TEST(prepared_write){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	std::vector<uint8_t> rec = pattern(200, 7);
+	CHECK_EQ(c.WriteLong(d.hRecord, rec), ESP_GATT_OK);
+	CHECK(std::vector<uint8_t>(d.pRecord->getData(), d.pRecord->getData() + d.pRecord->getLength()) == rec);
+	CHECK_EQ(d.recordWrites.writes, 1); // by the execution only
+	// cancelled
+	CHECK_EQ(c.PrepareWrite(d.hRecord, 0, rec.data(), 18), ESP_GATT_OK);
+	CHECK_EQ(c.ExecuteWrite(false), ESP_GATT_OK);
+	CHECK_EQ(d.recordWrites.writes, 1);
+	CHECK_EQ(d.pRecord->getLength(), 200);
+	// longer than the value may be
+	std::vector<uint8_t> big = pattern(513);
+	CHECK_EQ(c.WriteLong(d.hRecord, big), ESP_GATT_INVALID_ATTR_LEN);
+	CHECK_EQ(d.pRecord->getLength(), 200);
+	// prepared writes of two characteristics at once are not supported
+	CHECK_EQ(c.PrepareWrite(d.hRecord, 0, rec.data(), 18), ESP_GATT_OK);
+	CHECK_EQ(c.PrepareWrite(d.hCmd, 0, rec.data(), 18), ESP_GATT_PREPARE_Q_FULL);
+	CHECK_EQ(c.ExecuteWrite(true), ESP_GATT_OK);
+	CHECK_EQ(d.pRecord->getLength(), 18);
+	CHECK_EQ(d.cmdWrites.writes, 0);
+	// the clients have their own prepared writes
+	cSimCentral c2(2);
+	d.srv.MaxConnections = 2;
+	c2.Connect();
+	CHECK_EQ(c.PrepareWrite(d.hRecord, 0, rec.data(), 10), ESP_GATT_OK);
+	CHECK_EQ(c2.PrepareWrite(d.hCmd, 0, rec.data(), 4), ESP_GATT_OK);
+	CHECK_EQ(c2.ExecuteWrite(true), ESP_GATT_OK);
+	CHECK_EQ(c.ExecuteWrite(true), ESP_GATT_OK);
+	CHECK_EQ(d.cmdWrites.writes, 1);
+	CHECK_EQ(d.pCmd->getLength(), 4);
+	CHECK_EQ(d.pRecord->getLength(), 10);
+	CHECK_EQ(cBtSim::Get().strayResponses, 0);
+}
+
+TEST(write){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	CHECK_EQ(c.Write(d.hCmd, bytes("reboot")), ESP_GATT_OK);
+	CHECK_EQ(d.cmdWrites.writes, 1);
+	CHECK_STR(d.cmdWrites.last, "reboot");
+	// write command: no response
+	uint32_t rsps = cBtSim::Get().responses;
+	CHECK_EQ(c.Write(d.hRecord, bytes("x"), false), ESP_GATT_OK);
+	CHECK_EQ(cBtSim::Get().responses, rsps);
+	CHECK_EQ(d.recordWrites.writes, 1);
+	CHECK_EQ(cBtSim::Get().strayResponses, 0);
+}
+
+TEST(permissions){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	std::vector<uint8_t> value;
+	CHECK_EQ(c.Read(d.hCmd, value), ESP_GATT_READ_NOT_PERMIT);
+	CHECK_EQ(c.Write(d.hId, bytes("x")), ESP_GATT_WRITE_NOT_PERMIT);
+	CHECK_EQ(c.Read(d.hAlarm, value), ESP_GATT_READ_NOT_PERMIT);
+	CHECK_EQ(c.Read(d.hSecret, value), ESP_GATT_INSUF_AUTHENTICATION);
+	CHECK_EQ(c.Write(d.hSecret, bytes("x")), ESP_GATT_INSUF_AUTHENTICATION);
+	c.Encrypt();
+	CHECK_EQ(c.Read(d.hSecret, value), ESP_GATT_OK);
+	CHECK(value == bytes("key"));
+	// none of the refused requests reached the server
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.reads, 1);
+	CHECK_EQ(stats.writes, 0);
+	CHECK_EQ(d.cmdWrites.writes, 0);
+}
+
+TEST(notifications){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	d.pSensor->setValue("21.5");
+	d.pSensor->notify();
+	cBtSim::Get().Run();
+	CHECK(c.received.empty()); // not subscribed
+	CHECK_EQ(c.Subscribe(d.hSensor, BT_CCCD_NOTIFY), ESP_GATT_OK);
+	std::vector<uint8_t> value;
+	CHECK_EQ(c.Read(cBtSim::Get().FindDesc(d.hSensor, (uint16_t)0x2902), value), ESP_GATT_OK);
+	CHECK(value == std::vector<uint8_t>({1, 0}));
+	d.pSensor->notify();
+	cBtSim::Get().Run();
+	CHECK_EQ(c.received.size(), 1);
+	CHECK_EQ(last_value(c).handle, d.hSensor);
+	CHECK(!last_value(c).bIndication);
+	CHECK(last_value(c).data == bytes("21.5"));
+	// the value longer than MTU-3 is truncated
+	std::vector<uint8_t> longer = pattern(40);
+	d.pSensor->setValue(longer.data(), longer.size());
+	d.pSensor->notify();
+	cBtSim::Get().Run();
+	CHECK_EQ(last_value(c).data.size(), 20);
+	CHECK_EQ(cBtSim::Get().truncated, 0); // by the server, not the stack
+	c.ExchangeMtu(100);
+	d.pSensor->notify();
+	cBtSim::Get().Run();
+	CHECK(last_value(c).data == longer);
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.notifications, 3);
+	CHECK_EQ(stats.txBytes, 4 + 20 + 40);
+	// unsubscribed
+	CHECK_EQ(c.Subscribe(d.hSensor, 0), ESP_GATT_OK);
+	d.pSensor->notify();
+	cBtSim::Get().Run();
+	CHECK_EQ(c.received.size(), 3);
+}
+
+TEST(congestion){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	c.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	cBtSim &sim = cBtSim::Get();
+	// faster than the link: the stack takes CongestLimit packets, the newest value waits in the queue
+	for(int i = 0; i < 30; i++){
+		d.pSensor->setValue(std::to_string(i));
+		d.pSensor->notify();
+		sim.Dispatch();
+	}
+	CHECK(c.received.empty());
+	sim.Run();
+	CHECK_EQ(c.received.size(), sim.CongestLimit + 1);
+	CHECK(last_value(c).data == bytes("29"));
+	CHECK_EQ(sim.rejected, 0);
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.congestions, 1);
+	CHECK_EQ(stats.txDropped, 0);
+	CHECK_EQ(stats.notifications, sim.CongestLimit + 1);
+}
+
+TEST(indications){
+	sDevice d;
+	cSimCentral c(1);
+	c.Connect();
+	c.AutoConfirm = false;
+	CHECK_EQ(c.Subscribe(d.hAlarm, BT_CCCD_INDICATE), ESP_GATT_OK);
+	cBtSim &sim = cBtSim::Get();
+	// one indication waits for the confirmation, a newer value replaces the queued one
+	for(int i = 0; i < 3; i++){
+		d.pAlarm->setValue("alarm " + std::to_string(i));
+		d.pAlarm->indicate();
+	}
+	sim.Run();
+	CHECK_EQ(c.received.size(), 1);
+	CHECK(last_value(c).bIndication);
+	CHECK(last_value(c).data == bytes("alarm 0"));
+	CHECK(c.Confirm());
+	sim.Run();
+	CHECK_EQ(c.received.size(), 2);
+	CHECK(last_value(c).data == bytes("alarm 2"));
+	CHECK(c.Confirm());
+	CHECK(!c.Confirm());
+	CHECK_EQ(sim.rejected, 0);
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.indications, 2);
+	CHECK_EQ(stats.confirmations, 2);
+	// not subscribed for the notifications
+	d.pSensor->notify();
+	sim.Run();
+	CHECK_EQ(c.received.size(), 2);
+}
+
+TEST(disconnect){
+	sDevice d;
+	cBtSim &sim = cBtSim::Get();
+	cSimCentral c(1);
+	c.Connect();
+	c.ExchangeMtu(247);
+	c.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	c.AutoConfirm = false;
+	c.Subscribe(d.hAlarm, BT_CCCD_INDICATE);
+	d.pAlarm->indicate();
+	sim.Run();
+	c.Disconnect();
+	CHECK(sim.bAdvertising);
+	CHECK_EQ(d.srv.getConnectedCount(), 0);
+	d.pSensor->notify();
+	d.pAlarm->indicate();
+	sim.Run();
+	CHECK_EQ(sim.rejected, 0);
+	// a new connection starts without the state of the previous one
+	c.received.clear();
+	c.Connect();
+	CHECK_EQ(d.srv.getMtu(1), 23);
+	d.pSensor->notify();
+	d.pAlarm->indicate();
+	sim.Run();
+	CHECK(c.received.empty());
+	sBtStats stats;
+	d.srv.getStats(stats);
+	CHECK_EQ(stats.disconnects, 1);
+	CHECK_EQ(stats.connects, 2);
+}
+
+TEST(two_clients){
+	sDevice d(true, 2);
+	cBtSim &sim = cBtSim::Get();
+	cSimCentral a(1), b(2);
+	a.Connect();
+	CHECK(sim.bAdvertising); // room for one more
+	b.Connect();
+	CHECK(!sim.bAdvertising);
+	a.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	b.ExchangeMtu(50);
+	b.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	std::vector<uint8_t> value = pattern(40);
+	d.pSensor->setValue(value.data(), value.size());
+	d.pSensor->notify();
+	sim.Run();
+	// every client gets what its MTU allows
+	CHECK_EQ(last_value(a).data.size(), 20);
+	CHECK(last_value(b).data == value);
+	a.Disconnect();
+	CHECK(sim.bAdvertising);
+	d.pSensor->notify();
+	sim.Run();
+	CHECK_EQ(a.received.size(), 1);
+	CHECK_EQ(b.received.size(), 2);
+}
+
+TEST(beacon_key){
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+	const uint8_t key[] = "beacon secret";
+	sBtBeaconState st;
+	uint32_t seq;
+	{
+		sDevice d;
+		cBtSim &sim = cBtSim::Get();
+		BLEAdvertisementData adv;
+		adv.setFlags(ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT);
+		// no key yet: the advertising goes without the beacon
+		CHECK(d.srv.enableBeacon(adv));
+		sim.Run();
+		CHECK(!sim.advData.empty());
+		CHECK(!advertised_beacon(key, sizeof key, st));
+		// all clients connected: no beacon, no advertising
+		cSimCentral c(1);
+		c.Connect();
+		CHECK(!sim.bAdvertising);
+		d.srv.setBeaconKey(key, sizeof key);
+		sim.Run();
+		CHECK(advertised_beacon(key, sizeof key, st));
+		CHECK(sim.bAdvertising);
+		CHECK_EQ(sim.advParams.adv_type, ADV_TYPE_NONCONN_IND);
+		d.srv.setBeaconKey(key, 0);
+		sim.Run();
+		CHECK(!advertised_beacon(key, sizeof key, st));
+		CHECK(!sim.bAdvertising);
+		d.srv.setBeaconKey(key, sizeof key);
+		sim.Run();
+		CHECK(advertised_beacon(key, sizeof key, st));
+		seq = st.seq;
+	}
+	// after the reboot the saved key is used and the sequence goes on
+	sDevice d;
+	BLEAdvertisementData adv;
+	CHECK(d.srv.enableBeacon(adv));
+	cBtSim::Get().Run();
+	CHECK(advertised_beacon(key, sizeof key, st));
+	CHECK(st.seq > seq);
+	nvs_host_reset();
+}
+
+TEST(bond_restores_subscriptions){
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+	sDevice d(true, 1, true);
+	cBtSim &sim = cBtSim::Get();
+	cSimCentral c(1);
+	c.Connect();
+	c.Encrypt();
+	c.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	c.Disconnect();
+	// the bonded client is encrypted by the stored keys and does not subscribe again
+	c.Connect();
+	c.Encrypt();
+	d.pSensor->setValue("1");
+	d.pSensor->notify();
+	sim.Run();
+	CHECK_EQ(c.received.size(), 1);
+	// without the encryption it is a stranger
+	c.Disconnect();
+	c.Connect();
+	d.pSensor->notify();
+	sim.Run();
+	CHECK_EQ(c.received.size(), 1);
+	nvs_host_reset();
+}
+
+// the policy timer after the delay of the bond saves and the events it causes (connection parameters)
+static void settle(cBtServer &srv){
+	for(int i = 0; i < 2; i++){
+		host_tick_advance(srv.BondSaveDelayMs);
+		host_timers_run();
+		cBtSim::Get().Run();
+	}
+}
+
+TEST(bond_saved_later){
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+	sDevice d(true, 1, true);
+	cSimCentral c(1);
+	c.Connect();
+	c.Encrypt();
+	settle(d.srv);
+	size_t commits = nvs_host_commits();
+	// the BT events do not write the flash, the changes are saved together
+	c.ExchangeMtu(185);
+	c.Subscribe(d.hSensor, BT_CCCD_NOTIFY);
+	c.Subscribe(d.hAlarm, BT_CCCD_INDICATE);
+	CHECK_EQ(nvs_host_commits(), commits);
+	host_tick_advance(d.srv.BondSaveDelayMs - 1);
+	host_timers_run();
+	CHECK_EQ(nvs_host_commits(), commits);
+	host_tick_advance(500);
+	host_timers_run();
+	CHECK_EQ(nvs_host_commits(), commits + 1);
+	host_tick_advance(10000);
+	host_timers_run();
+	CHECK_EQ(nvs_host_commits(), commits + 1);
+	// the pending change is saved at the disconnection, nothing if there is none
+	c.Subscribe(d.hAlarm, 0);
+	c.Disconnect();
+	CHECK_EQ(nvs_host_commits(), commits + 2);
+	c.Connect();
+	c.Encrypt();
+	settle(d.srv);
+	commits = nvs_host_commits();
+	c.Disconnect();
+	CHECK_EQ(nvs_host_commits(), commits);
+	// the saved state is the last one
+	c.Connect();
+	c.Encrypt();
+	d.pSensor->notify();
+	d.pAlarm->indicate();
+	cBtSim::Get().Run();
+	CHECK_EQ(c.received.size(), 1);
+	CHECK(!last_value(c).bIndication);
+	nvs_host_reset();
+}
@@ -0,0 +1,271 @@
+/*
+ * test_bt_tx_queue.cpp
+ *
+ *  cBtTxQueue pumped like cBtServer::txPump() against a simulated stack: CONF events after a configurable delay,
+ *  the CONF events of the notifications, congestion, coalescing, overflow and the confirmation timeout
+ */
+
+#include <vector>
+#include "test.h"
+#include "../../components/m_bt/cBtTxQueue.h"
+
+#define H_TEMP		0x2a	// notified sensor value
+#define H_ALARM		0x2e	// indicated alarm
+#define H_STATUS	0x31	// notified and indicated
+
+// the stack: the indication is confirmed by the client after confDelayMs, a notification gets its CONF event at once
+class cSimStack{
+public:
+	uint32_t confDelayMs = 60;
+	bool bLoseConf = false;		// the client doesn't confirm
+	bool bCongested = false;
+	int sendErrors = 0;			// the next sends fail
+	struct sEvent{uint32_t t; uint16_t handle;};
+	std::vector<sEvent> events;		// CONF events not delivered yet
+	std::vector<sBtTxItem> air;		// everything sent
+	std::vector<uint32_t> indTimes;	// when the indications were sent
+
+	// cBtServer::txPump()
+	void Pump(cBtTxQueue &q, uint32_t now){
+		const sBtTxItem *pItem;
+		while((pItem = q.Next(bCongested)) != nullptr){
+			bool bOk = sendErrors == 0;
+			if(bOk){
+				air.push_back(*pItem);
+				if(pItem->bIndicate){
+					indTimes.push_back(now);
+					if(!bLoseConf)
+						events.push_back(sEvent{now + confDelayMs, pItem->handle});
+				}else
+					events.push_back(sEvent{now, pItem->handle});
+			}else
+				sendErrors--;
+			q.Sent(bOk, now);
+		}
+	}
+	// ESP_GATTS_CONF_EVT up to now, returns the confirmed indications
+	int Deliver(cBtTxQueue &q, uint32_t now){
+		int confirmed = 0;
+		while(!events.empty() && events.front().t <= now){
+			uint16_t handle = events.front().handle;
+			events.erase(events.begin());
+			if(q.OnConfirm(handle)){
+				confirmed++;
+				Pump(q, now);
+			}
+		}
+		return confirmed;
+	}
+};
+
+static void push(cBtTxQueue &q, uint16_t handle, bool bIndicate, uint8_t value){
+	q.Push(handle, bIndicate, &value, 1);
+}
+
+TEST(push_does_not_wait){
+	// the alarm path queues 5 indications at once, none of them waits for the confirmation
+	cBtTxQueue q;
+	cSimStack stack;
+	for(uint8_t i = 0; i < 5; i++){
+		CHECK(q.Push(H_ALARM + i, true, &i, 1));
+		stack.Pump(q, 0);
+	}
+	CHECK_EQ(stack.air.size(), 1);
+	CHECK(q.Waiting());
+	CHECK_EQ(q.Size(), 4);
+	// one indication per confirmation
+	uint32_t t = 0;
+	for(; t <= 1000 && (q.Size() || q.Waiting()); t += 5)
+		stack.Deliver(q, t);
+	CHECK_EQ(stack.air.size(), 5);
+	for(size_t i = 1; i < stack.indTimes.size(); i++)
+		CHECK_EQ(stack.indTimes[i] - stack.indTimes[i - 1], 60);
+}
+
+TEST(conf_delay){
+	// the indication rate follows the round trip of the client
+	uint32_t delays[] = {8, 30, 100, 400};
+	for(uint32_t delay : delays){
+		cBtTxQueue q;
+		q.MaxItems = 64;
+		cSimStack stack;
+		stack.confDelayMs = delay;
+		for(uint8_t i = 0; i < 20; i++)
+			push(q, H_ALARM + i, true, i);
+		stack.Pump(q, 0);
+		uint32_t t = 0;
+		for(; q.Size() || q.Waiting(); t++)
+			stack.Deliver(q, t);
+		CHECK_EQ(stack.air.size(), 20);
+		CHECK_EQ(t - 1, 20 * delay);
+	}
+}
+
+TEST(notifications_pass){
+	// the sensor keeps notifying while the alarm waits for the slow client
+	cBtTxQueue q;
+	cSimStack stack;
+	stack.confDelayMs = 500;
+	push(q, H_ALARM, true, 1);
+	stack.Pump(q, 0);
+	push(q, H_ALARM + 1, true, 2);
+	int notified = 0;
+	for(uint32_t t = 0; t < 500; t += 100){
+		push(q, H_TEMP, false, t / 100);
+		stack.Pump(q, t);
+		stack.Deliver(q, t);
+		notified++;
+	}
+	// the CONF events of the notifications don't release the indication
+	CHECK(q.Waiting());
+	CHECK_EQ(q.Size(), 1);
+	CHECK_EQ(stack.air.size(), 1 + notified);
+	stack.Deliver(q, 500);
+	CHECK_EQ(stack.air.size(), 2 + notified);
+	CHECK(stack.air.back().bIndicate);
+}
+
+TEST(same_handle_notify_and_indicate){
+	// the CONF of a notification of the indicated characteristic is not its confirmation
+	cBtTxQueue q;
+	cSimStack stack;
+	stack.confDelayMs = 100;
+	push(q, H_STATUS, true, 1);
+	push(q, H_STATUS, false, 2);
+	push(q, H_STATUS, true, 3); // coalesced with the first one
+	CHECK_EQ(q.Coalesced(), 1);
+	stack.Pump(q, 0);
+	CHECK_EQ(stack.air.size(), 2);
+	CHECK_EQ(stack.air[0].data[0], 3);
+	push(q, H_STATUS, true, 4);
+	stack.Pump(q, 10);
+	CHECK_EQ(stack.Deliver(q, 10), 0);
+	CHECK(q.Waiting());
+	CHECK_EQ(stack.Deliver(q, 100), 1);
+	CHECK_EQ(stack.air.size(), 3);
+	CHECK_EQ(stack.air[2].data[0], 4);
+}
+
+TEST(coalescing){
+	// a fast sensor behind a congested link: only the latest value is sent
+	cBtTxQueue q;
+	cSimStack stack;
+	stack.bCongested = true;
+	for(uint8_t v = 0; v < 50; v++){
+		push(q, H_TEMP, false, v);
+		push(q, H_TEMP + 1, false, v + 100);
+		stack.Pump(q, v);
+	}
+	CHECK_EQ(q.Size(), 2);
+	CHECK_EQ(q.Coalesced(), 98);
+	CHECK_EQ(q.Dropped(), 0);
+	stack.bCongested = false;
+	stack.Pump(q, 50);
+	CHECK_EQ(stack.air.size(), 2);
+	CHECK_EQ(stack.air[0].data[0], 49);
+	CHECK_EQ(stack.air[1].data[0], 149);
+	// the value being sent is not changed by a new one
+	push(q, H_ALARM, true, 1);
+	stack.Pump(q, 60);
+	push(q, H_ALARM, true, 2);
+	CHECK_EQ(q.Size(), 1);
+	stack.Deliver(q, 120);
+	CHECK_EQ(stack.air.size(), 4);
+	CHECK_EQ(stack.air[3].data[0], 2);
+}
+
+TEST(overflow_drop_oldest){
+	cBtTxQueue q;
+	q.MaxItems = 4;
+	cSimStack stack;
+	stack.bCongested = true;
+	push(q, H_ALARM, true, 1);
+	for(uint8_t i = 0; i < 5; i++)
+		push(q, H_TEMP + i, false, i);
+	// the oldest notifications are dropped, the indication is kept
+	CHECK_EQ(q.Size(), 4);
+	CHECK_EQ(q.Dropped(), 2);
+	stack.bCongested = false;
+	stack.Pump(q, 0);
+	CHECK_EQ(stack.air.size(), 4);
+	CHECK(stack.air[0].bIndicate);
+	CHECK_EQ(stack.air[1].handle, H_TEMP + 2);
+	// only indications: the oldest one goes
+	cBtTxQueue ind;
+	ind.MaxItems = 2;
+	for(uint8_t i = 0; i < 3; i++)
+		push(ind, H_ALARM + i, true, i);
+	CHECK_EQ(ind.Dropped(), 1);
+	CHECK_EQ(ind.Next(false)->handle, H_ALARM + 1);
+}
+
+TEST(overflow_drop_new){
+	cBtTxQueue q;
+	q.MaxItems = 2;
+	q.Overflow = eBtTxOverflow::e_drop_new;
+	uint8_t v = 0;
+	CHECK(q.Push(H_TEMP, false, &v, 1));
+	CHECK(q.Push(H_ALARM, true, &v, 1));
+	CHECK(!q.Push(H_TEMP + 1, false, &v, 1));
+	CHECK(q.Push(H_TEMP, false, &v, 1)); // the update of a queued value fits
+	CHECK_EQ(q.Dropped(), 1);
+	q.MaxItems = 0;
+	q.Clear();
+	CHECK(!q.Push(H_TEMP, false, &v, 1));
+}
+
+TEST(lost_confirmation){
+	cBtTxQueue q;
+	q.ConfTimeoutMs = 1000;
+	cSimStack stack;
+	stack.bLoseConf = true;
+	push(q, H_ALARM, true, 1);
+	push(q, H_ALARM + 1, true, 2);
+	stack.Pump(q, 0);
+	CHECK(!q.Tick(999));
+	// the policy timer drops it and sends the next one
+	CHECK(q.Tick(1000));
+	CHECK(!q.Waiting());
+	CHECK_EQ(q.Dropped(), 1);
+	stack.bLoseConf = false;
+	stack.Pump(q, 1000);
+	CHECK_EQ(stack.air.size(), 2);
+	CHECK_EQ(stack.Deliver(q, 1060), 1);
+	CHECK(!q.Tick(5000));
+	// a late confirmation of nothing is ignored
+	CHECK(!q.OnConfirm(H_ALARM));
+}
+
+TEST(send_errors){
+	cBtTxQueue q;
+	cSimStack stack;
+	stack.sendErrors = 2;
+	push(q, H_ALARM, true, 1);
+	push(q, H_TEMP, false, 2);
+	push(q, H_TEMP + 1, false, 3);
+	stack.Pump(q, 0);
+	// the failed ones are dropped, the indication is not waited for
+	CHECK_EQ(q.Dropped(), 2);
+	CHECK_EQ(stack.air.size(), 1);
+	CHECK(!q.Waiting());
+	CHECK_EQ(q.Size(), 0);
+}
+
+TEST(clear){
+	cBtTxQueue q;
+	cSimStack stack;
+	push(q, H_ALARM, true, 1);
+	push(q, H_ALARM + 1, true, 2);
+	push(q, H_TEMP, false, 3);
+	stack.Pump(q, 0);
+	q.Clear();
+	CHECK_EQ(q.Size(), 0);
+	CHECK(!q.Waiting());
+	CHECK(q.Next(false) == nullptr);
+	// the CONF events of the previous connection are ignored
+	CHECK_EQ(stack.Deliver(q, 1000), 0);
+	push(q, H_ALARM, true, 4);
+	stack.events.clear();
+	stack.Pump(q, 1000);
+	CHECK_EQ(stack.Deliver(q, 1060), 1);
+}
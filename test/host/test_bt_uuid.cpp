@@ -0,0 +1,144 @@
+/*
+ * test_bt_uuid.cpp
+ *
+ *  BLEUUIDLiteral / BLEUUID: compile time parsing, equality and hash across the lengths, native and string forms
+ */
+
+#include <string>
+#include <unordered_map>
+#include "test.h"
+#include "../../components/m_bt/BLEUUID.h"
+
+// parsed by the compiler
+static_assert("180d"_uuid.isShort(), "16 bit literal");
+static_assert("180d"_uuid.shortValue() == 0x180d, "16 bit value");
+static_assert("0000180d"_uuid == "180d"_uuid, "32 bit form of a 16 bit UUID");
+static_assert("0000180d-0000-1000-8000-00805f9b34fb"_uuid == "180d"_uuid, "128 bit form of a 16 bit UUID");
+static_assert("0000180D-0000-1000-8000-00805F9B34FB"_uuid == BLEUUIDLiteral(0x180d), "upper case");
+static_assert(!"beb5483e-36e1-4688-b7f5-ea07361b26a8"_uuid.isShort(), "vendor UUID");
+static_assert("beb5483e-36e1-4688-b7f5-ea07361b26a8"_uuid.hi() == 0xbeb5483e36e14688ULL, "high word");
+static_assert("beb5483e-36e1-4688-b7f5-ea07361b26a8"_uuid.lo() == 0xb7f5ea07361b26a8ULL, "low word");
+static_assert("12345678"_uuid.shortValue() == 0x12345678, "32 bit value");
+static_assert("180d"_uuid.hash() == "0000180d-0000-1000-8000-00805f9b34fb"_uuid.hash(), "hash of the forms");
+
+#define VENDOR	"beb5483e-36e1-4688-b7f5-ea07361b26a8"
+
+TEST(forms_equal){
+	BLEUUID u16((uint16_t)0x180d);
+	BLEUUID u32((uint32_t)0x180d);
+	BLEUUID u128(std::string("0000180d-0000-1000-8000-00805f9b34fb"));
+	BLEUUID lit("180d"_uuid);
+	CHECK(u16 == u32);
+	CHECK(u16 == u128);
+	CHECK(u32 == u128);
+	CHECK(lit == u128);
+	CHECK_EQ(u16.bitSize(), 16);
+	CHECK_EQ(u32.bitSize(), 32);
+	CHECK_EQ(u128.bitSize(), 128);
+	CHECK_EQ(u16.hash(), u128.hash());
+	CHECK_EQ(u32.hash(), u128.hash());
+	CHECK_EQ(lit.hash(), "180d"_uuid.hash());
+	CHECK(!(u16 == BLEUUID((uint16_t)0x180a)));
+	CHECK(!(u16 == BLEUUID(std::string(VENDOR))));
+}
+
+TEST(vendor){
+	BLEUUID a(std::string(VENDOR));
+	BLEUUID b(VENDOR ""_uuid);
+	CHECK(a == b);
+	CHECK_EQ(a.hash(), b.hash());
+	CHECK_STR(a.toString(), VENDOR);
+	CHECK_STR(b.toString(), VENDOR);
+	// one bit in every byte
+	for(int i = 0; i < 16; i++){
+		uint8_t raw[16];
+		a.get128(raw);
+		raw[i] ^= 1;
+		BLEUUID c(raw, 16, false);
+		CHECK(!(a == c));
+	}
+}
+
+TEST(native){
+	esp_bt_uuid_t n = "2902"_uuid.toNative();
+	CHECK_EQ(n.len, ESP_UUID_LEN_16);
+	CHECK_EQ(n.uuid.uuid16, 0x2902);
+	n = "12345678"_uuid.toNative();
+	CHECK_EQ(n.len, ESP_UUID_LEN_32);
+	CHECK_EQ(n.uuid.uuid32, 0x12345678);
+	n = (VENDOR ""_uuid).toNative();
+	CHECK_EQ(n.len, ESP_UUID_LEN_128);
+	CHECK_EQ(n.uuid.uuid128[0], 0xa8);
+	CHECK_EQ(n.uuid.uuid128[15], 0xbe);
+	CHECK(BLEUUID(n) == BLEUUID(std::string(VENDOR)));
+	// from the service id of the GATT events
+	esp_gatt_srvc_id_t id;
+	memset(&id, 0, sizeof id);
+	id.id.uuid = "180f"_uuid.toNative();
+	CHECK(BLEUUID(id) == BLEUUID((uint16_t)0x180f));
+}
+
+TEST(to128){
+	BLEUUID u((uint16_t)0x2a37);
+	uint8_t expect[16];
+	u.get128(expect);
+	CHECK_EQ(expect[12], 0x37);
+	CHECK_EQ(expect[13], 0x2a);
+	CHECK_EQ(expect[0], 0xfb);
+	BLEUUID full = u.to128();
+	CHECK_EQ(full.bitSize(), 128);
+	CHECK_MEM(full.getNative()->uuid.uuid128, expect, 16);
+	CHECK(full == BLEUUID((uint16_t)0x2a37));
+	CHECK_STR(full.toString(), "00002a37-0000-1000-8000-00805f9b34fb");
+	BLEUUID u32((uint32_t)0x12345678);
+	CHECK_STR(u32.to128().toString(), "12345678-0000-1000-8000-00805f9b34fb");
+}
+
+TEST(raw_bytes){
+	uint8_t msb[16] = {0xbe, 0xb5, 0x48, 0x3e, 0x36, 0xe1, 0x46, 0x88, 0xb7, 0xf5, 0xea, 0x07, 0x36, 0x1b, 0x26, 0xa8};
+	uint8_t lsb[16];
+	for(int i = 0; i < 16; i++)
+		lsb[i] = msb[15 - i];
+	CHECK(BLEUUID(msb, 16, true) == BLEUUID(lsb, 16, false));
+	CHECK_STR(BLEUUID(msb, 16, true).toString(), VENDOR);
+	CHECK_EQ(BLEUUID(msb, 15, true).bitSize(), 0);
+	// binary strings are LSB first
+	CHECK(BLEUUID(std::string("\x0d\x18", 2)) == BLEUUID((uint16_t)0x180d));
+	CHECK(BLEUUID(std::string("\x78\x56\x34\x12", 4)) == BLEUUID((uint32_t)0x12345678));
+	// bytes with the high bit set
+	CHECK(BLEUUID(std::string("\x90\xfe", 2)) == BLEUUID((uint16_t)0xfe90));
+	CHECK(BLEUUID(std::string("\x80\x81\x82\x83", 4)) == BLEUUID((uint32_t)0x83828180));
+	CHECK(BLEUUID(std::string((const char*)msb, 16)) == BLEUUID(msb, 16, true));
+}
+
+TEST(unset){
+	BLEUUID none;
+	CHECK(!(none == none));
+	CHECK(!(none == BLEUUID((uint16_t)0)));
+	CHECK_EQ(none.hash(), 0);
+	CHECK_EQ(none.bitSize(), 0);
+	CHECK(none.getNative() == nullptr);
+	CHECK_STR(none.toString(), "<NULL>");
+	BLEUUID bad(std::string("180d"));
+	CHECK_EQ(bad.bitSize(), 32); // 4 bytes are a binary 32 bit UUID, not hex
+	BLEUUID wrong(std::string("180"));
+	CHECK(wrong.getNative() == nullptr);
+}
+
+TEST(hash_table){
+	// lookups find the UUID in any form
+	std::unordered_map<BLEUUID, int, BLEUUIDHash> table;
+	table[BLEUUID((uint16_t)0x180d)] = 1;
+	table[BLEUUID(std::string(VENDOR))] = 2;
+	table[BLEUUID((uint32_t)0x12345678)] = 3;
+	CHECK_EQ(table.size(), 3);
+	CHECK_EQ(table[BLEUUID(std::string("0000180d-0000-1000-8000-00805f9b34fb"))], 1);
+	CHECK_EQ(table[BLEUUID(VENDOR ""_uuid)], 2);
+	CHECK_EQ(table["12345678"_uuid], 3);
+	CHECK_EQ(table.size(), 3);
+	// 16 bit UUIDs spread over the buckets
+	std::unordered_map<uint32_t, int> hashes;
+	for(uint32_t u = 0x2a00; u < 0x2b00; u++)
+		hashes[BLEUUID((uint16_t)u).hash() & 0xff]++;
+	CHECK(hashes.size() > 128);
+}
@@ -0,0 +1,130 @@
+/*
+ * test_connectivity_core.cpp
+ *
+ *  cConnectivityCore fed by a fake event source: state sequences, state bits, link quality hysteresis
+ */
+
+#include <vector>
+#include "test.h"
+#include "../../components/m_wifi/cConnectivityCore.h"
+
+// feeds the events, returns the number of reported changes
+static int feed(cConnectivityCore &core, const std::vector<eConnEvent> &events){
+	int changes = 0;
+	for(auto ev : events)
+		changes += core.Process(ev);
+	return changes;
+}
+
+TEST(normal_connection){
+	cConnectivityCore core;
+	CHECK(core.State() == eConnState::e_down);
+	CHECK_EQ(core.Bits(), CONN_BIT_DOWN);
+	CHECK(core.Process(eConnEvent::e_start));
+	CHECK_EQ(core.Bits(), CONN_BIT_CONNECTING);
+	CHECK(core.Process(eConnEvent::e_link_up));
+	CHECK_EQ(core.Bits(), CONN_BIT_LINK);
+	CHECK(core.Process(eConnEvent::e_got_ip));
+	CHECK(core.State() == eConnState::e_online);
+	CHECK(core.PrevState() == eConnState::e_link_up);
+	CHECK_EQ(core.Bits(), CONN_BIT_LINK | CONN_BIT_ONLINE);
+	// repeated events are not reported
+	CHECK(!core.Process(eConnEvent::e_got_ip));
+	CHECK(!core.Process(eConnEvent::e_link_up));
+	CHECK(core.State() == eConnState::e_online);
+}
+
+TEST(lost_ip_and_link){
+	cConnectivityCore core;
+	feed(core, {eConnEvent::e_start, eConnEvent::e_link_up, eConnEvent::e_got_ip});
+	CHECK(core.Process(eConnEvent::e_lost_ip));
+	CHECK(core.State() == eConnState::e_link_up);
+	CHECK(core.Process(eConnEvent::e_got_ip));
+	CHECK(core.Process(eConnEvent::e_link_lost));
+	CHECK(core.State() == eConnState::e_connecting);
+	CHECK(!core.Process(eConnEvent::e_lost_ip));
+	CHECK_EQ(feed(core, {eConnEvent::e_link_up, eConnEvent::e_got_ip}), 2);
+	CHECK(core.Process(eConnEvent::e_down));
+	CHECK_EQ(core.Bits(), CONN_BIT_DOWN);
+	// late events of the stopped connection are ignored
+	CHECK_EQ(feed(core, {eConnEvent::e_got_ip, eConnEvent::e_link_lost, eConnEvent::e_lost_ip}), 0);
+	CHECK(core.State() == eConnState::e_down);
+}
+
+TEST(failed_is_sticky){
+	cConnectivityCore core;
+	CHECK(core.Process(eConnEvent::e_fail));
+	CHECK_EQ(core.Bits(), CONN_BIT_DOWN | CONN_BIT_FAILED);
+	CHECK_EQ(feed(core, {eConnEvent::e_down, eConnEvent::e_got_ip, eConnEvent::e_link_lost}), 0);
+	// only a new start leaves it
+	CHECK(core.Process(eConnEvent::e_start));
+	CHECK(core.State() == eConnState::e_connecting);
+}
+
+TEST(bits_exclusive){
+	// every state has its bits, waiting for ONLINE | DOWN never blocks forever
+	eConnState states[] = {eConnState::e_down, eConnState::e_connecting, eConnState::e_link_up, eConnState::e_online, eConnState::e_failed};
+	for(auto s : states){
+		uint32_t bits = cConnectivityCore::StateBits(s);
+		CHECK(bits != 0);
+		CHECK_EQ(bits & ~CONN_BITS_ALL, 0);
+		CHECK_EQ(!!(bits & CONN_BIT_CONNECTING) + !!(bits & CONN_BIT_LINK) + !!(bits & CONN_BIT_DOWN), 1);
+	}
+}
+
+TEST(rssi_levels){
+	CHECK(cConnectivityCore::RssiLevel(-40) == eLinkQuality::e_good);
+	CHECK(cConnectivityCore::RssiLevel(-60) == eLinkQuality::e_good);
+	CHECK(cConnectivityCore::RssiLevel(-61) == eLinkQuality::e_fair);
+	CHECK(cConnectivityCore::RssiLevel(-75) == eLinkQuality::e_poor);
+	CHECK(cConnectivityCore::RssiLevel(-81) == eLinkQuality::e_bad);
+}
+
+TEST(quality_only_with_link){
+	cConnectivityCore core;
+	CHECK(!core.Process(eConnEvent::e_rssi, -50));
+	CHECK(core.Quality() == eLinkQuality::e_none);
+	feed(core, {eConnEvent::e_start, eConnEvent::e_link_up});
+	CHECK(core.Process(eConnEvent::e_rssi, -50));
+	CHECK(core.Quality() == eLinkQuality::e_good);
+	CHECK_EQ(core.Rssi(), -50);
+	CHECK(core.Process(eConnEvent::e_got_ip)); // the state changes, the quality is kept
+	CHECK(core.Quality() == eLinkQuality::e_good);
+	core.Process(eConnEvent::e_link_lost);
+	CHECK(core.Quality() == eLinkQuality::e_none);
+	CHECK_EQ(core.Rssi(), 0);
+}
+
+TEST(quality_hysteresis){
+	cConnectivityCore core;
+	feed(core, {eConnEvent::e_start, eConnEvent::e_link_up, eConnEvent::e_got_ip});
+	// recorded RSSI trace around the -70 dB border
+	int trace[] = {-68, -71, -69, -72, -74, -71, -69, -67, -66, -72, -74};
+	eLinkQuality expect[] = {eLinkQuality::e_fair, eLinkQuality::e_fair, eLinkQuality::e_fair, eLinkQuality::e_fair,
+			eLinkQuality::e_poor, eLinkQuality::e_poor, eLinkQuality::e_poor, eLinkQuality::e_fair,
+			eLinkQuality::e_fair, eLinkQuality::e_fair, eLinkQuality::e_poor};
+	int changes = 0;
+	for(size_t i = 0; i < sizeof trace / sizeof trace[0]; i++){
+		changes += core.Process(eConnEvent::e_rssi, trace[i]);
+		CHECK(core.Quality() == expect[i]);
+	}
+	CHECK_EQ(changes, 4);
+	// without the hysteresis every crossing is reported
+	cConnectivityCore raw;
+	raw.QualityHysteresisDb = 0;
+	feed(raw, {eConnEvent::e_start, eConnEvent::e_link_up});
+	changes = 0;
+	for(int rssi : trace)
+		changes += raw.Process(eConnEvent::e_rssi, rssi);
+	CHECK_EQ(changes, 6);
+}
+
+TEST(quality_jumps_levels){
+	cConnectivityCore core;
+	feed(core, {eConnEvent::e_start, eConnEvent::e_link_up});
+	core.Process(eConnEvent::e_rssi, -50);
+	CHECK(core.Process(eConnEvent::e_rssi, -90));
+	CHECK(core.Quality() == eLinkQuality::e_bad);
+	CHECK(core.Process(eConnEvent::e_rssi, -55));
+	CHECK(core.Quality() == eLinkQuality::e_good);
+}
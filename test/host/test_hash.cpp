@@ -0,0 +1,105 @@
+/*
+ * test_hash.cpp
+ *
+ *  cHash: digests of the known vectors in every format, block buffering of any read size
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../../components/m_wifi/cHash.h"
+#include "../../main/common/fnv1a.h"
+
+static std::string digest(eHashAlgo algo, const std::string &data, eHashFormat fmt, size_t piece){
+	cHash h;
+	h.Start(algo);
+	for(size_t i = 0; i < data.size(); i += piece)
+		h.Update((const uint8_t*)data.data() + i, std::min(piece, data.size() - i));
+	h.Finish();
+	return h.Format(fmt);
+}
+
+TEST(known_vectors){
+	CHECK_STR(digest(eHashAlgo::e_sha1, "abc", eHashFormat::e_hex, 256),
+			"a9993e364706816aba3e25717850c26c9cd0d89d");
+	CHECK_STR(digest(eHashAlgo::e_sha256, "abc", eHashFormat::e_hex, 256),
+			"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	CHECK_STR(digest(eHashAlgo::e_sha1, "", eHashFormat::e_hex, 256),
+			"da39a3ee5e6b4b0d3255bfef95601890afd80709");
+	std::string million(1000000, 'a');
+	CHECK_STR(digest(eHashAlgo::e_sha256, million, eHashFormat::e_hex, 1500),
+			"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(formats){
+	CHECK_STR(digest(eHashAlgo::e_sha1, "abc", eHashFormat::e_base64, 256), "qZk+NkcGgWq6PiVxeFDCbJzQ2J0=");
+	// the server format is base64 of the hex string
+	CHECK_STR(digest(eHashAlgo::e_sha1, "abc", eHashFormat::e_base64_hex, 256),
+			"YTk5OTNlMzY0NzA2ODE2YWJhM2UyNTcxNzg1MGMyNmM5Y2QwZDg5ZA==");
+	CHECK_EQ(digest(eHashAlgo::e_sha256, "abc", eHashFormat::e_raw, 256).size(), 32);
+	cHash h;
+	CHECK_STR(h.Format(eHashFormat::e_hex), ""); // not finished
+}
+
+// the result must not depend on how the data is split by the network reads
+TEST(read_sizes){
+	std::string data;
+	for(int i = 0; i < 10000; i++)
+		data += (char)(i * 7 + (i >> 8));
+	std::string ref = digest(eHashAlgo::e_sha256, data, eHashFormat::e_hex, data.size());
+	static const size_t pieces[] = {1, 3, 63, 64, 65, 256, 1023, 1024, 1025, 4096};
+	for(size_t p : pieces)
+		CHECK_STR(digest(eHashAlgo::e_sha256, data, eHashFormat::e_hex, p), ref);
+	// unaligned large input takes the copying path
+	cHash h(eHashAlgo::e_sha256);
+	h.Start();
+	h.Update((const uint8_t*)data.data() + 1, 1);
+	h.Update((const uint8_t*)data.data() + 2, data.size() - 2);
+	h.Finish();
+	cHash ref2(eHashAlgo::e_sha256);
+	ref2.Start();
+	ref2.Update((const uint8_t*)data.data() + 1, data.size() - 1);
+	ref2.Finish();
+	CHECK_MEM(h.Digest(), ref2.Digest(), 32);
+}
+
+TEST(restart_and_cancel){
+	cHash h;
+	h.Start(eHashAlgo::e_sha256);
+	h.Update((const uint8_t*)"garbage", 7);
+	h.Cancel();
+	CHECK(!h.IsStarted());
+	CHECK(!h.Finish());
+	h.Start(eHashAlgo::e_sha1);
+	h.Update((const uint8_t*)"abc", 3);
+	CHECK(h.Finish());
+	CHECK_EQ(h.DigestLen(), 20);
+	CHECK_STR(h.Format(eHashFormat::e_hex), "a9993e364706816aba3e25717850c26c9cd0d89d");
+}
+
+TEST(base64_any_length){
+	CHECK_STR(cHash::ToBase64((const uint8_t*)"", 0), "");
+	CHECK_STR(cHash::ToBase64((const uint8_t*)"f", 1), "Zg==");
+	CHECK_STR(cHash::ToBase64((const uint8_t*)"fo", 2), "Zm8=");
+	CHECK_STR(cHash::ToBase64((const uint8_t*)"foo", 3), "Zm9v");
+	// longer than any digest
+	std::string in(1000, 'x');
+	std::string out = cHash::ToBase64((const uint8_t*)in.data(), in.size());
+	CHECK_EQ(out.size(), 1336);
+	CHECK_STR(out.substr(0, 8), "eHh4eHh4");
+	CHECK_STR(out.substr(out.size() - 4), "eA==");
+}
+
+TEST(hex){
+	static const uint8_t data[] = {0x00, 0x0f, 0xa5, 0xff};
+	CHECK_STR(cHash::ToHex(data, sizeof data), "000fa5ff");
+	CHECK_STR(cHash::ToHex(data, 0), "");
+}
+
+TEST(fnv1a){
+	CHECK_EQ(fnv1a("", 0), 0x811c9dc5);
+	CHECK_EQ(fnv1a("a", 1), 0xe40c292c);
+	CHECK_EQ(fnv1a("foobar", 6), 0xbf9cf968);
+	// continued over the pieces
+	CHECK_EQ(fnv1a("bar", 3, fnv1a("foo", 3)), 0xbf9cf968);
+}
@@ -0,0 +1,325 @@
+/*
+ * test_http_cache.cpp
+ *
+ *  cHttpCache against a stand-in server, stored by cHttpCacheFlashStore in the file backed NVS shim
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include <nvs.h>
+#include "test.h"
+#include "../../components/m_wifi/cHttpCache.h"
+
+#define NVS_FILE	"build/test_http_cache.nvs"
+#define CACHE_NS	"httpcache"
+
+// stand-in of the HTTP server: documents with the validators, answers the conditional requests like cHttpClient gets them
+class cTestServer{
+public:
+	struct sDoc{
+		std::string body;
+		std::string etag;
+		std::string last_modified;
+		bool chunked;
+		bool close_delimited; // neither Content-Length nor chunked
+		size_t cut; // bytes missing at the end (connection lost)
+	};
+	std::map<std::string, sDoc> docs;
+	size_t transferred; // response bytes of all requests
+
+	cTestServer():transferred(0){}
+
+	sDoc& Put(const std::string &url, const std::string &body, const std::string &etag, const std::string &last_modified = ""){
+		sDoc &d = docs[url];
+		d.body = body;
+		d.etag = etag;
+		d.last_modified = last_modified;
+		d.chunked = false;
+		d.close_delimited = false;
+		d.cut = 0;
+		return d;
+	}
+
+	void Get(const std::string &url, const std::string &request_headers, std::string &headers, std::vector<uint8_t> &body){
+		body.clear();
+		auto it = docs.find(url);
+		if(it == docs.end()){
+			headers = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+			transferred += headers.size();
+			return;
+		}
+		sDoc &d = it->second;
+		std::string validators;
+		if(d.etag.length())
+			validators += "ETag: " + d.etag + "\r\n";
+		if(d.last_modified.length())
+			validators += "Last-Modified: " + d.last_modified + "\r\n";
+		std::string inm = cHttpCache::GetHeader("GET / HTTP/1.1\r\n" + request_headers, "If-None-Match");
+		std::string ims = cHttpCache::GetHeader("GET / HTTP/1.1\r\n" + request_headers, "If-Modified-Since");
+		if((inm.length() && inm == d.etag) || (!inm.length() && ims.length() && ims == d.last_modified)){
+			headers = "HTTP/1.1 304 Not Modified\r\n" + validators + "\r\n";
+			transferred += headers.size();
+			return;
+		}
+		std::string payload = d.body;
+		headers = "HTTP/1.1 200 OK\r\n" + validators;
+		if(d.chunked){
+			char len[16];
+			snprintf(len, sizeof len, "%zx\r\n", d.body.size());
+			payload = len + d.body + "\r\n0\r\n\r\n";
+			headers += "Transfer-Encoding: chunked\r\n";
+		}else if(!d.close_delimited){
+			headers += "Content-Length: " + std::to_string(d.body.size()) + "\r\n";
+		}
+		headers += "\r\n";
+		payload.resize(payload.size() - std::min(d.cut, payload.size()));
+		body.assign(payload.begin(), payload.end());
+		transferred += headers.size() + body.size();
+	}
+};
+
+// HttpGet() with the cache as cHttpClient does it, returns the status code
+static int get(cHttpCache &cache, cTestServer &server, const std::string &url, std::vector<uint8_t> &body){
+	std::string headers;
+	server.Get(url, cache.ConditionalHeaders(url), headers, body);
+	int code = cHttpCache::GetStatusCode(headers);
+	if(code == 304)
+		return cache.Load(url, body) ? 304 : 0;
+	cache.Store(url, headers, body);
+	return code;
+}
+
+static std::string str(const std::vector<uint8_t> &v){
+	return std::string(v.begin(), v.end());
+}
+
+static void fresh_nvs(){
+	remove(NVS_FILE);
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+	nvs_host_set_file(NVS_FILE);
+}
+
+TEST(etag_revalidation){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	cTestServer server;
+	std::string doc(1500, 'c');
+	server.Put("http://cfg/a.json", doc, "\"v1\"");
+	std::vector<uint8_t> body;
+	CHECK_EQ(get(cache, server, "http://cfg/a.json", body), 200);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/a.json"), "If-None-Match: \"v1\"");
+	size_t first = server.transferred;
+	body.clear();
+	CHECK_EQ(get(cache, server, "http://cfg/a.json", body), 304);
+	CHECK_STR(str(body), doc);
+	// the poll costs the headers only
+	CHECK(server.transferred - first < 100);
+
+	// changed on the server: downloaded and replaced
+	server.Put("http://cfg/a.json", "new", "\"v2\"");
+	CHECK_EQ(get(cache, server, "http://cfg/a.json", body), 200);
+	CHECK_EQ(get(cache, server, "http://cfg/a.json", body), 304);
+	CHECK_STR(str(body), "new");
+}
+
+TEST(last_modified_revalidation){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	cTestServer server;
+	server.Put("http://cfg/b", "bbb", "", "Mon, 19 Oct 2026 10:00:00 GMT");
+	std::vector<uint8_t> body;
+	CHECK_EQ(get(cache, server, "http://cfg/b", body), 200);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/b"), "If-Modified-Since: Mon, 19 Oct 2026 10:00:00 GMT");
+	CHECK_EQ(get(cache, server, "http://cfg/b", body), 304);
+	CHECK_STR(str(body), "bbb");
+}
+
+TEST(not_cacheable){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	cTestServer server;
+	std::vector<uint8_t> body;
+	server.Put("http://cfg/novalidator", "x", "");
+	get(cache, server, "http://cfg/novalidator", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/novalidator"), "");
+	get(cache, server, "http://cfg/missing", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/missing"), "");
+	// larger than the budget
+	server.Put("http://cfg/big", std::string(5000, 'b'), "\"big\"");
+	get(cache, server, "http://cfg/big", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/big"), "");
+	CHECK_EQ(cache.UsedBytes(), 0);
+}
+
+TEST(incomplete_body){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	cTestServer server;
+	std::vector<uint8_t> body;
+	// connection lost before Content-Length bytes
+	server.Put("http://cfg/cut", "0123456789", "\"c\"").cut = 3;
+	get(cache, server, "http://cfg/cut", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/cut"), "");
+	// chunked without the last chunk
+	cTestServer::sDoc &d = server.Put("http://cfg/chunk", "0123456789", "\"ch\"");
+	d.chunked = true;
+	d.cut = 2;
+	get(cache, server, "http://cfg/chunk", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/chunk"), "");
+	d.cut = 0;
+	get(cache, server, "http://cfg/chunk", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/chunk"), "If-None-Match: \"ch\"");
+	// ended by the close only, can't be verified
+	server.Put("http://cfg/close", "abc", "\"cl\"").close_delimited = true;
+	get(cache, server, "http://cfg/close", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/close"), "");
+
+	// the complete entry is dropped by an incomplete new version, it is outdated
+	server.Put("http://cfg/cut", "0123456789", "\"c\"");
+	get(cache, server, "http://cfg/cut", body);
+	CHECK(cache.ConditionalHeaders("http://cfg/cut").length());
+	server.Put("http://cfg/cut", "abcdefghij", "\"c2\"").cut = 1;
+	get(cache, server, "http://cfg/cut", body);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/cut"), "");
+}
+
+TEST(is_complete){
+	std::vector<uint8_t> body(5, 'x');
+	CHECK(cHttpCache::IsComplete("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n", body));
+	CHECK(!cHttpCache::IsComplete("HTTP/1.1 200 OK\r\nContent-Length: 6\r\n", body));
+	CHECK(!cHttpCache::IsComplete("HTTP/1.1 200 OK\r\nContent-Length: 5x\r\n", body));
+	CHECK(!cHttpCache::IsComplete("HTTP/1.1 200 OK\r\n", body));
+	std::string chunked = "5\r\nxxxxx\r\n0\r\n\r\n";
+	std::vector<uint8_t> cbody(chunked.begin(), chunked.end());
+	CHECK(cHttpCache::IsComplete("HTTP/1.1 200 OK\r\ntransfer-encoding: Chunked\r\nContent-Length: 5\r\n", cbody));
+	cbody.pop_back();
+	CHECK(!cHttpCache::IsComplete("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n", cbody));
+}
+
+TEST(lru_eviction){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store, 3000, 8);
+	cTestServer server;
+	std::vector<uint8_t> body;
+	for(int i = 0; i < 3; i++)
+		server.Put("http://cfg/" + std::to_string(i), std::string(1200, 'a' + i), "\"" + std::to_string(i) + "\"");
+	get(cache, server, "http://cfg/0", body);
+	get(cache, server, "http://cfg/1", body);
+	get(cache, server, "http://cfg/0", body); // 1 is the least recently used now
+	get(cache, server, "http://cfg/2", body);
+	get(cache, server, "http://cfg/2", body);
+	CHECK(cache.UsedBytes() <= 3000);
+	CHECK(cache.ConditionalHeaders("http://cfg/0").length());
+	CHECK(cache.ConditionalHeaders("http://cfg/2").length());
+	// 3 entries don't fit
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/1"), "");
+}
+
+TEST(max_entries_fit_the_index){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	{
+		cHttpCache cache(store, 64 * 1024, 1000); // limited to MAX_ENTRIES
+		cTestServer server;
+		std::vector<uint8_t> body;
+		for(int i = 0; i < cHttpCache::MAX_ENTRIES + 5; i++){
+			std::string url = "http://cfg/" + std::to_string(i);
+			server.Put(url, "d", "\"e\"");
+			get(cache, server, url, body);
+		}
+	}
+	// the index is read back completely
+	cHttpCache cache(store, 64 * 1024, 1000);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/4"), "");
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/5"), "If-None-Match: \"e\"");
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/" + std::to_string(cHttpCache::MAX_ENTRIES + 4)), "If-None-Match: \"e\"");
+}
+
+TEST(persisted_in_the_file){
+	fresh_nvs();
+	cTestServer server;
+	server.Put("http://cfg/p", std::string(2500, 'p'), "\"p\"");
+	std::vector<uint8_t> body;
+	{
+		cHttpCacheFlashStore store(CACHE_NS);
+		cHttpCache cache(store);
+		get(cache, server, "http://cfg/p", body);
+	}
+	// reboot
+	nvs_host_set_file(nullptr);
+	nvs_host_reset();
+	nvs_host_set_file(NVS_FILE);
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	body.clear();
+	CHECK_EQ(get(cache, server, "http://cfg/p", body), 304);
+	CHECK_STR(str(body), std::string(2500, 'p'));
+}
+
+TEST(failed_save_leaves_no_chunks){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store, 16 * 1024);
+	cTestServer server;
+	std::vector<uint8_t> body;
+	server.Put("http://cfg/small", "s", "\"s\"");
+	get(cache, server, "http://cfg/small", body);
+	size_t keys = nvs_host_keys(CACHE_NS); // the entry and the index, 2 keys each
+
+	// 3 chunks and the header, the flash gets full at every step (the index is not written then as well)
+	server.Put("http://cfg/big", std::string(5000, 'b'), "\"b\"");
+	for(int ok = 0; ok < 4; ok++){
+		nvs_host_fail_after(ok);
+		get(cache, server, "http://cfg/big", body);
+		nvs_host_fail_after(-1);
+		CHECK(nvs_host_keys(CACHE_NS) <= keys);
+		CHECK_STR(cache.ConditionalHeaders("http://cfg/big"), "");
+	}
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/small"), "If-None-Match: \"s\"");
+	// nothing of the big one is left behind
+	server.Put("http://cfg/small2", "s2", "\"s2\"");
+	get(cache, server, "http://cfg/small2", body);
+	CHECK_EQ(nvs_host_keys(CACHE_NS), keys + 2);
+	get(cache, server, "http://cfg/big", body);
+	CHECK_EQ(nvs_host_keys(CACHE_NS), keys + 6);
+}
+
+TEST(lost_index_drops_the_entries){
+	fresh_nvs();
+	cTestServer server;
+	server.Put("http://cfg/o", "o", "\"o\"");
+	std::vector<uint8_t> body;
+	{
+		cHttpCacheFlashStore store(CACHE_NS);
+		cHttpCache cache(store);
+		get(cache, server, "http://cfg/o", body);
+		store.Erase("index");
+	}
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 2);
+	cHttpCacheFlashStore store(CACHE_NS);
+	cHttpCache cache(store);
+	CHECK_STR(cache.ConditionalHeaders("http://cfg/o"), "");
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 0);
+}
+
+TEST(store_shrinking_value){
+	fresh_nvs();
+	cHttpCacheFlashStore store(CACHE_NS);
+	std::vector<uint8_t> v(5000, 1), r;
+	CHECK(store.Save("k", v));
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 4);
+	v.assign(10, 2);
+	CHECK(store.Save("k", v));
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 2);
+	CHECK(store.Load("k", r));
+	CHECK(r == v);
+	CHECK(store.Erase("k"));
+	CHECK_EQ(nvs_host_keys(CACHE_NS), 0);
+}
@@ -0,0 +1,35 @@
+/*
+ * test_main.cpp
+ *
+ *  Runs the registered cases, `<test> name` runs one of them; the exit code is the number of failed cases
+ */
+
+#include "test.h"
+
+static sTestCase *cases = nullptr;
+int test_failures = 0;
+
+sTestCase::sTestCase(const char *_name, tTestFunc _func):name(_name), func(_func), next(nullptr){
+	// keep the order of the definition
+	sTestCase **pp = &cases;
+	while(*pp)
+		pp = &(*pp)->next;
+	*pp = this;
+}
+
+int main(int argc, char **argv){
+	int failed = 0, run = 0;
+	for(sTestCase *c = cases; c; c = c->next){
+		if(argc > 1 && strcmp(argv[1], c->name))
+			continue;
+		test_failures = 0;
+		c->func();
+		run++;
+		if(test_failures){
+			printf("FAIL %s\n", c->name);
+			failed++;
+		}
+	}
+	printf("%s: %d of %d cases passed\n", argv[0], run - failed, run);
+	return failed;
+}
@@ -0,0 +1,121 @@
+/*
+ * test_provisioning.cpp
+ *
+ *  provisioning.c decisions replayed like provisioning_task() in main.c: connect attempts, SmartConfig rounds, timeouts
+ */
+
+#include <string>
+#include "test.h"
+extern "C" {
+#include "../../src/provisioning.h"
+}
+
+// one step of provisioning_task(), returns 'c' or 'p' for the chosen action
+static char step(const prov_config_t &cfg, prov_state_t &st, bool has_credentials, uint32_t button_ms, bool ok, uint32_t duration_ms = 20000){
+	if(prov_decide(&cfg, &st, has_credentials, button_ms) == PROV_ACTION_CONNECT){
+		prov_on_connect_result(&st, ok);
+		return 'c';
+	}
+	prov_on_provision_result(&st, ok, duration_ms);
+	return 'p';
+}
+
+static prov_state_t fresh(){
+	prov_state_t st;
+	memset(&st, 0, sizeof st);
+	return st;
+}
+
+TEST(no_credentials){
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	CHECK(prov_decide(&cfg, &st, false, 0) == PROV_ACTION_PROVISION);
+	CHECK(step(cfg, st, false, 0, true) == 'p');
+	CHECK_EQ(st.last_prov_ms, 20000);
+	CHECK(prov_decide(&cfg, &st, true, 0) == PROV_ACTION_CONNECT);
+}
+
+TEST(button_forces){
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	CHECK(prov_decide(&cfg, &st, true, 2999) == PROV_ACTION_CONNECT);
+	CHECK(prov_decide(&cfg, &st, true, 3000) == PROV_ACTION_PROVISION);
+}
+
+TEST(connect_first){
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	// the AP is back after two failures, SmartConfig is not started
+	std::string trace;
+	trace += step(cfg, st, true, 0, false);
+	trace += step(cfg, st, true, 0, false);
+	trace += step(cfg, st, true, 0, true);
+	CHECK_STR(trace, "ccc");
+	CHECK_EQ(st.failures, 0);
+	CHECK(!prov_on_connect_result(&st, true)); // nothing to save
+}
+
+TEST(rounds_while_ap_down){
+	// the stored AP is down and nobody provisions: every round has the same connect attempts
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	std::string trace;
+	for(int i = 0; i < 16; i++)
+		trace += step(cfg, st, true, 0, false);
+	CHECK_STR(trace, "cccpcccpcccpcccp");
+}
+
+TEST(long_outage){
+	// the counters saturate after a long outage, the rounds must go on
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	cfg.max_failures = 4;
+	prov_state_t st = fresh();
+	std::string trace;
+	for(int i = 0; i < 2000; i++)
+		trace += step(cfg, st, true, 0, false);
+	CHECK_STR(trace.substr(trace.size() - 10), "ccccpccccp");
+	CHECK_EQ(st.prov_timeouts, 0xff);
+	// the AP is back
+	step(cfg, st, true, 0, true);
+	CHECK(prov_decide(&cfg, &st, true, 0) == PROV_ACTION_CONNECT);
+}
+
+TEST(provisioned_after_round){
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	std::string trace;
+	for(int i = 0; i < 3; i++)
+		trace += step(cfg, st, true, 0, false);
+	trace += step(cfg, st, true, 0, true, 45000);
+	CHECK_STR(trace, "cccp");
+	CHECK_EQ(st.failures, 0);
+	CHECK_EQ(st.prov_timeouts, 0);
+	CHECK_EQ(st.last_prov_ms, 45000);
+}
+
+TEST(timeout_adapts){
+	prov_config_t cfg;
+	prov_config_default(&cfg);
+	prov_state_t st = fresh();
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 60000);
+	// a slow user: 3 times the last duration
+	st.last_prov_ms = 30000;
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 90000);
+	// doubled after every timeout up to the limit
+	st.prov_timeouts = 1;
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 180000);
+	st.prov_timeouts = 2;
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 300000);
+	st.prov_timeouts = 0xff;
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 300000);
+	// a quick user does not shorten it below the minimum
+	st.prov_timeouts = 0;
+	st.last_prov_ms = 5000;
+	CHECK_EQ(prov_timeout_ms(&cfg, &st), 60000);
+}
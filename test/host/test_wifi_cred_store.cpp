@@ -0,0 +1,222 @@
+/*
+ * test_wifi_cred_store.cpp
+ *
+ *  cWiFiCredStore: AP ranking on recorded scan results, connection history, roaming decisions, stored list
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../../components/m_wifi/cWiFiCredStore.h"
+
+static sWiFiScanItem ap(const char *ssid, uint8_t last, uint8_t channel, int8_t rssi){
+	sWiFiScanItem item;
+	item.ssid = ssid;
+	uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, last};
+	memcpy(item.bssid, bssid, 6);
+	item.channel = channel;
+	item.rssi = rssi;
+	return item;
+}
+
+// scan at home: two APs of the mesh, the neighbours and the phone hotspot
+static std::vector<sWiFiScanItem> home_scan(){
+	return {
+		ap("neighbour", 1, 1, -48),
+		ap("home", 2, 6, -71),
+		ap("home", 3, 11, -63),
+		ap("hotspot", 4, 6, -58),
+		ap("guest", 5, 1, -92),
+	};
+}
+
+static void store3(cWiFiCredStore &store){
+	CHECK(store.Add("home", "password1"));
+	CHECK(store.Add("hotspot", "password2"));
+	CHECK(store.Add("guest", ""));
+}
+
+TEST(add_remove){
+	cWiFiCredStore store;
+	store.MaxCount = 2;
+	CHECK(!store.Add("x", "short ssid"));
+	CHECK(!store.Add(std::string(33, 's'), ""));
+	CHECK(!store.Add("home", std::string(65, 'p')));
+	CHECK(store.Add("home", "a"));
+	CHECK(store.Add("office", "b"));
+	CHECK(!store.Add("third", "c"));
+	CHECK(store.Add("home", "a")); // update is allowed when full
+	CHECK_EQ(store.Count(), 2);
+	CHECK(store.Remove("home"));
+	CHECK(!store.Remove("home"));
+	CHECK_EQ(store.Find("office"), 0);
+	CHECK_EQ(store.Find("home"), -1);
+}
+
+TEST(best_by_rssi){
+	cWiFiCredStore store;
+	store3(store);
+	sWiFiSelection sel;
+	CHECK(store.SelectBest(home_scan(), sel));
+	CHECK_STR(sel.ssid, "hotspot");
+	CHECK_EQ(sel.rssi, -58);
+	CHECK_EQ(sel.channel, 6);
+	CHECK_EQ(sel.bssid[5], 4);
+	// nothing known or all too weak
+	cWiFiCredStore other;
+	other.Add("office", "x");
+	CHECK(!other.SelectBest(home_scan(), sel));
+	other.Add("guest", "");
+	CHECK(!other.SelectBest(home_scan(), sel));
+	other.MinRssi = -95;
+	CHECK(other.SelectBest(home_scan(), sel));
+}
+
+TEST(history_ranking){
+	cWiFiCredStore store;
+	store3(store);
+	// home has connected reliably, the hotspot mostly failed
+	for(int i = 0; i < 20; i++)
+		store.OnResult(0, true);
+	for(int i = 0; i < 6; i++)
+		store.OnResult(1, i == 2);
+	sWiFiSelection sel;
+	CHECK(store.SelectBest(home_scan(), sel));
+	CHECK_STR(sel.ssid, "home");
+	CHECK_EQ(sel.bssid[5], 3); // the stronger AP of the network
+	CHECK_EQ(store.Score(0, -63), -63 + 10 * 20 / 22);
+	// the streak penalty is limited
+	CHECK_EQ(store.Get(1).fail_streak, 3);
+	for(int i = 0; i < 10; i++)
+		store.OnResult(1, false);
+	CHECK_EQ(store.Score(1, -58), -58 + 10 * (1 - 15) / 18 - 6 * 4);
+}
+
+TEST(failed_ap_skipped_in_same_scan){
+	// cWiFiDevice takes the next best AP of the same scan after a failure
+	cWiFiCredStore store;
+	store3(store);
+	sWiFiSelection sel;
+	store.SelectBest(home_scan(), sel);
+	CHECK_STR(sel.ssid, "hotspot");
+	store.OnResult(sel.ssid, false);
+	store.OnResult(sel.ssid, false);
+	CHECK(store.SelectBest(home_scan(), sel));
+	CHECK_STR(sel.ssid, "home");
+}
+
+TEST(password_change_resets){
+	cWiFiCredStore store;
+	store3(store);
+	store.OnResult(0, true);
+	store.OnResult(0, false);
+	store.Add("home", "password1");
+	CHECK_EQ(store.Get(0).fail_count, 1);
+	store.Add("home", "new password");
+	CHECK_EQ(store.Get(0).fail_count, 0);
+	CHECK_EQ(store.Get(0).fail_streak, 0);
+	CHECK_EQ(store.Get(0).ok_count, 1);
+}
+
+TEST(save_rarely){
+	cWiFiCredStore store;
+	store3(store);
+	int saves = 0;
+	for(int i = 0; i < 64; i++)
+		saves += store.OnResult(0, true);
+	CHECK_EQ(saves, 8 + 7);
+	CHECK(store.OnResult(0, false));
+	CHECK(store.OnResult(0, true)); // the streak is over
+	CHECK(store.OnResult(1, false)); // failures are saved always
+	CHECK(!store.OnResult(-1, true));
+	CHECK(!store.OnResult(3, true));
+}
+
+TEST(result_by_ssid){
+	// the device keeps the SSID of the current network, the list may change meanwhile
+	cWiFiCredStore store;
+	store3(store);
+	sWiFiSelection sel;
+	store.SelectBest(home_scan(), sel);
+	CHECK_STR(sel.ssid, "hotspot");
+	CHECK(store.Remove("home"));
+	CHECK(store.OnResult(sel.ssid, false));
+	CHECK_EQ(store.Get(store.Find("hotspot")).fail_streak, 1);
+	CHECK_EQ(store.Get(store.Find("guest")).fail_streak, 0);
+	CHECK(store.Remove("hotspot"));
+	CHECK(!store.OnResult(sel.ssid, true));
+}
+
+TEST(counter_overflow){
+	cWiFiCredStore store;
+	store3(store);
+	std::vector<uint8_t> data;
+	store.Serialize(data);
+	// ok_count 0xffff, fail_count 0x100 of home
+	data[2 + 1 + 4 + 1 + 9] = 0xff;
+	data[2 + 1 + 4 + 1 + 9 + 1] = 0xff;
+	data[2 + 1 + 4 + 1 + 9 + 3] = 0x01;
+	CHECK(store.Deserialize(data));
+	CHECK_EQ(store.Get(0).ok_count, 0xffff);
+	store.OnResult(0, true);
+	CHECK_EQ(store.Get(0).ok_count, 0x7fff + 1);
+	CHECK_EQ(store.Get(0).fail_count, 0x80);
+}
+
+TEST(serialize){
+	cWiFiCredStore store;
+	store3(store);
+	store.OnResult(0, true);
+	store.OnResult(2, false);
+	std::vector<uint8_t> data;
+	store.Serialize(data);
+	cWiFiCredStore copy;
+	CHECK(copy.Deserialize(data));
+	CHECK_EQ(copy.Count(), 3);
+	CHECK_STR(copy.Get(1).pass, "password2");
+	CHECK_EQ(copy.Get(0).ok_count, 1);
+	CHECK_EQ(copy.Get(2).fail_streak, 1);
+	// truncated or foreign data clears the list
+	for(size_t len = 0; len < data.size(); len++){
+		std::vector<uint8_t> part(data.begin(), data.begin() + len);
+		CHECK(!copy.Deserialize(part));
+		CHECK_EQ(copy.Count(), 0);
+	}
+	data[0] = 7;
+	CHECK(!copy.Deserialize(data));
+}
+
+TEST(roam_scan_interval){
+	cWiFiCredStore store;
+	CHECK(!store.NeedRoamScan(-60, 0));
+	CHECK(store.NeedRoamScan(-80, 1000));
+	CHECK(!store.NeedRoamScan(-80, 30000));
+	CHECK(!store.NeedRoamScan(-80, 60999));
+	CHECK(store.NeedRoamScan(-80, 61000));
+	// tick overflow
+	CHECK(store.NeedRoamScan(-80, 0xfffffff0u));
+	CHECK(!store.NeedRoamScan(-80, 100));
+	CHECK(store.NeedRoamScan(-80, 60000));
+}
+
+TEST(should_roam){
+	cWiFiCredStore store;
+	store3(store);
+	std::vector<sWiFiScanItem> scan = home_scan();
+	uint8_t cur[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 2}; // the weak home AP
+	sWiFiSelection sel;
+	CHECK(!store.ShouldRoam(-70, cur, scan, sel)); // the signal is fine
+	CHECK(store.ShouldRoam(-78, cur, scan, sel));
+	CHECK_STR(sel.ssid, "hotspot");
+	// a failing network is not a candidate
+	store.OnResult(1, false);
+	CHECK(store.ShouldRoam(-78, cur, scan, sel));
+	CHECK_EQ(sel.bssid[5], 3);
+	// the margin: -63 is not 8 dB better than -70
+	store.RoamRssi = -60;
+	CHECK(!store.ShouldRoam(-70, cur, scan, sel));
+	CHECK(store.ShouldRoam(-71, cur, scan, sel));
+	// the current AP itself is not a candidate
+	uint8_t cur3[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 3};
+	CHECK(!store.ShouldRoam(-76, cur3, {ap("home", 3, 11, -40)}, sel));
+}
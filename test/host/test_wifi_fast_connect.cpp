@@ -0,0 +1,204 @@
+/*
+ * test_wifi_fast_connect.cpp
+ *
+ *  cWiFiFastConnect driven by a simulated event source: plan, association, lease, renewal at T1, fallback
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../../components/m_wifi/cWiFiFastConnect.h"
+
+static const uint8_t BSSID[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+static const uint8_t BSSID2[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x61};
+#define IP		0x0a01a8c0u // 192.168.1.10
+#define GW		0x0101a8c0u
+#define MASK	0x00ffffffu
+#define DNS		0x08080808u
+#define T0		1800000000u // some time() after the clock is set
+
+// the owner of cWiFiFastConnect as cWiFiDevice drives it, the record is kept in "flash" between the boots
+struct sSimDevice{
+	std::vector<uint8_t> flash;
+	bool dhcp_started; // DHCP client is running
+
+	sSimDevice():dhcp_started(false){}
+
+	// boot, plan and a successful association; leaseSec is offered if DHCP runs
+	eWiFiConnectMode Boot(cWiFiFastConnect &fc, uint32_t now, uint32_t leaseSec, uint8_t channel = 6, const uint8_t *bssid = BSSID){
+		fc.Deserialize(flash);
+		eWiFiConnectMode mode = fc.Plan("home", now);
+		dhcp_started = fc.NeedDhcp();
+		fc.OnConnected(channel, bssid);
+		if(fc.OnGotIp(IP, GW, MASK, DNS, dhcp_started ? leaseSec : 0, now))
+			fc.Serialize(flash);
+		Renew(fc, now, leaseSec);
+		return mode;
+	}
+	// cWiFiDevice::Handler()
+	void Renew(cWiFiFastConnect &fc, uint32_t now, uint32_t leaseSec){
+		if(!fc.NeedRenew(now))
+			return;
+		fc.OnRenew();
+		dhcp_started = true;
+		// the server acknowledges the same address
+		if(fc.OnGotIp(IP, GW, MASK, DNS, leaseSec, now))
+			fc.Serialize(flash);
+	}
+};
+
+TEST(first_connect_is_full){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	CHECK(dev.Boot(fc, T0, 86400) == eWiFiConnectMode::e_full);
+	CHECK(dev.dhcp_started);
+	CHECK_EQ(dev.flash.size(), 36);
+	cWiFiFastConnect fc2;
+	CHECK(fc2.Deserialize(dev.flash));
+	CHECK_EQ(fc2.Radio().channel, 6);
+	CHECK_EQ(fc2.IpInfo().ip, IP);
+	CHECK_EQ(fc2.IpInfo().lease_sec, 86400);
+	CHECK_EQ(fc2.IpInfo().saved_t, T0);
+}
+
+TEST(reuse_until_t1){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600); // T1 is 30 min
+	cWiFiFastConnect a;
+	CHECK(dev.Boot(a, T0 + 1799, 3600) == eWiFiConnectMode::e_fast);
+	CHECK(!dev.dhcp_started);
+	cWiFiFastConnect b;
+	CHECK(dev.Boot(b, T0 + 1800, 3600) == eWiFiConnectMode::e_fast_dhcp);
+	CHECK(dev.dhcp_started);
+}
+
+TEST(long_lease_capped){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 7 * 86400);
+	cWiFiFastConnect a;
+	CHECK(dev.Boot(a, T0 + 12 * 3600 - 1, 7 * 86400) == eWiFiConnectMode::e_fast);
+	cWiFiFastConnect b;
+	CHECK(dev.Boot(b, T0 + 12 * 3600, 7 * 86400) == eWiFiConnectMode::e_fast_dhcp);
+	// the limit is configurable
+	cWiFiFastConnect c;
+	c.LeaseValidSec = 3600;
+	dev.Boot(c, T0, 7 * 86400);
+	cWiFiFastConnect d;
+	d.LeaseValidSec = 3600;
+	CHECK(dev.Boot(d, T0 + 3600, 7 * 86400) == eWiFiConnectMode::e_fast_dhcp);
+}
+
+TEST(unknown_lease){
+	// a lease without option 51 is reused for LeaseValidSec
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 0);
+	cWiFiFastConnect a;
+	CHECK(dev.Boot(a, T0 + 12 * 3600 - 1, 0) == eWiFiConnectMode::e_fast);
+	cWiFiFastConnect b;
+	CHECK(dev.Boot(b, T0 + 12 * 3600, 0) == eWiFiConnectMode::e_fast_dhcp);
+}
+
+TEST(renew_while_connected){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600);
+	cWiFiFastConnect a;
+	CHECK(dev.Boot(a, T0 + 1000, 3600) == eWiFiConnectMode::e_fast);
+	CHECK(!dev.dhcp_started);
+	// the connection lasts past T1 of the cached lease
+	dev.Renew(a, T0 + 1799, 3600);
+	CHECK(!dev.dhcp_started);
+	dev.Renew(a, T0 + 1800, 3600);
+	CHECK(dev.dhcp_started);
+	CHECK(a.NeedDhcp());
+	CHECK(!a.NeedRenew(T0 + 5000));
+	// the renewed lease is saved and reused by the next boot
+	cWiFiFastConnect b;
+	CHECK(dev.Boot(b, T0 + 3000, 3600) == eWiFiConnectMode::e_fast);
+	CHECK_EQ(b.IpInfo().saved_t, T0 + 1800);
+}
+
+TEST(young_lease_not_rewritten){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600);
+	std::vector<uint8_t> saved = dev.flash;
+	// DHCP again (the fast connect was forced off by another AP) within a quarter of the lease
+	cWiFiFastConnect a;
+	a.Deserialize(dev.flash);
+	a.Plan("home", T0 + 100);
+	a.OnRenew();
+	a.OnConnected(6, BSSID);
+	CHECK(!a.OnGotIp(IP, GW, MASK, DNS, 3600, T0 + 100));
+	// a changed lease time is saved
+	CHECK(a.OnGotIp(IP, GW, MASK, DNS, 7200, T0 + 200));
+	CHECK(saved == dev.flash);
+}
+
+TEST(clock_not_set){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600);
+	cWiFiFastConnect a;
+	CHECK(dev.Boot(a, 1000, 3600) == eWiFiConnectMode::e_fast_dhcp);
+}
+
+TEST(other_ap_drops_lease){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600);
+	cWiFiFastConnect a;
+	a.Deserialize(dev.flash);
+	CHECK(a.Plan("home", T0 + 10) == eWiFiConnectMode::e_fast);
+	a.OnConnected(11, BSSID2);
+	CHECK_EQ(a.Radio().ip, 0);
+	CHECK_EQ(a.Radio().lease_sec, 0);
+	CHECK_EQ(a.Radio().channel, 11);
+	// another SSID is not planned fast
+	cWiFiFastConnect b;
+	b.Deserialize(dev.flash);
+	CHECK(b.Plan("office", T0 + 10) == eWiFiConnectMode::e_full);
+}
+
+TEST(fallback){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	dev.Boot(fc, T0, 3600);
+	cWiFiFastConnect a;
+	a.FastTryCount = 2;
+	a.Deserialize(dev.flash);
+	CHECK(a.Plan("home", T0 + 10) == eWiFiConnectMode::e_fast);
+	CHECK(a.OnDisconnected(1, 5) == eWiFiFastAction::e_retry);
+	CHECK(a.OnDisconnected(2, 5) == eWiFiFastAction::e_fallback_full);
+	CHECK(a.Mode() == eWiFiConnectMode::e_full);
+	CHECK(a.NeedDhcp());
+	CHECK(a.OnDisconnected(6, 5) == eWiFiFastAction::e_give_up);
+}
+
+TEST(static_ip){
+	sSimDevice dev;
+	cWiFiFastConnect fc;
+	fc.SetStaticIp(0x6401a8c0u, GW, MASK, DNS);
+	dev.Boot(fc, T0, 3600);
+	CHECK_EQ(fc.Radio().ip, 0);
+	cWiFiFastConnect a;
+	a.SetStaticIp(0x6401a8c0u, GW, MASK, DNS);
+	CHECK(dev.Boot(a, T0 + 100000, 3600) == eWiFiConnectMode::e_fast);
+	CHECK(!dev.dhcp_started);
+	CHECK(!a.NeedRenew(T0 + 1000000));
+	CHECK_EQ(a.IpInfo().ip, 0x6401a8c0u);
+}
+
+TEST(malformed_record){
+	cWiFiFastConnect fc;
+	std::vector<uint8_t> data(32, 0);
+	data[0] = 1; // the record without the lease time
+	CHECK(!fc.Deserialize(data));
+	data.assign(36, 0);
+	data[0] = 2;
+	CHECK(!fc.Deserialize(data)); // channel 0
+	CHECK(fc.Plan("home", T0) == eWiFiConnectMode::e_full);
+}
@@ -0,0 +1,129 @@
+/*
+ * test_wifi_power_policy.cpp
+ *
+ *  cWiFiPowerPolicy replayed on the event traces: idle downgrade, traffic and alarm wakeups, tick overflow
+ */
+
+#include <string>
+#include <vector>
+#include "test.h"
+#include "../../components/m_wifi/cWiFiPowerPolicy.h"
+
+#define PERIOD_MS	1000 // cWiFiDevice timer
+
+// trace entry: 't' - traffic, 'a' - alarm at the time
+struct sTraceEvent{
+	uint32_t t;
+	char what;
+};
+
+// replays the trace like cWiFiDevice does: Notify*() at the events and Update() by the timer,
+// returns the applied profile at every timer tick
+static std::vector<eWiFiPowerSave> replay(cWiFiPowerPolicy &policy, uint32_t start, uint32_t duration, const std::vector<sTraceEvent> &trace){
+	std::vector<eWiFiPowerSave> applied;
+	policy.Reset(start);
+	eWiFiPowerSave ps = policy.Profile();
+	size_t ev = 0;
+	for(uint32_t t = 0; t <= duration; t += PERIOD_MS){
+		for(; ev < trace.size() && trace[ev].t <= t; ev++){
+			uint32_t now = start + trace[ev].t;
+			if(trace[ev].what == 'a' ? policy.OnAlarm(now) : policy.OnTraffic(now))
+				ps = policy.Profile();
+		}
+		if(policy.Update(start + t))
+			ps = policy.Profile();
+		applied.push_back(ps);
+	}
+	return applied;
+}
+
+static cWiFiPowerPolicy enabled(){
+	cWiFiPowerPolicy policy;
+	policy.bEnabled = true;
+	return policy;
+}
+
+TEST(disabled_keeps_active){
+	cWiFiPowerPolicy policy;
+	policy.ActiveProfile = eWiFiPowerSave::e_min_modem;
+	std::vector<eWiFiPowerSave> applied = replay(policy, 0, 60000, {});
+	for(auto ps : applied)
+		CHECK(ps == eWiFiPowerSave::e_min_modem);
+	CHECK_EQ(policy.SwitchCount(), 0);
+}
+
+TEST(idle_downgrade){
+	cWiFiPowerPolicy policy = enabled();
+	std::vector<eWiFiPowerSave> applied = replay(policy, 0, 10000, {});
+	CHECK(applied[4] == eWiFiPowerSave::e_none);
+	CHECK(applied[5] == eWiFiPowerSave::e_max_modem);
+	CHECK(applied[10] == eWiFiPowerSave::e_max_modem);
+	CHECK_EQ(policy.SwitchCount(), 1);
+}
+
+TEST(traffic_wakes_at_once){
+	cWiFiPowerPolicy policy = enabled();
+	policy.Reset(0);
+	CHECK(policy.Update(5000));
+	CHECK(policy.Profile() == eWiFiPowerSave::e_max_modem);
+	// the first transfer switches back without waiting for the timer
+	CHECK(policy.OnTraffic(7300));
+	CHECK(policy.Profile() == eWiFiPowerSave::e_none);
+	// the following chunks don't change anything
+	CHECK(!policy.OnTraffic(7310));
+	CHECK(!policy.Update(12309));
+	CHECK(policy.Update(12310));
+}
+
+TEST(periodic_traffic_trace){
+	// a sensor report every 30 s, the transfer lasts 2 s
+	cWiFiPowerPolicy policy = enabled();
+	std::vector<sTraceEvent> trace;
+	for(uint32_t t = 30000; t < 300000; t += 30000){
+		trace.push_back({t, 't'});
+		trace.push_back({t + 1000, 't'});
+		trace.push_back({t + 2000, 't'});
+	}
+	std::vector<eWiFiPowerSave> applied = replay(policy, 0, 300000, trace);
+	size_t idle = 0;
+	for(auto ps : applied)
+		idle += ps == eWiFiPowerSave::e_max_modem;
+	// awake for the transfer and IdleTimeoutMs after it
+	CHECK_EQ(idle, applied.size() - 5 - 9 * 7);
+	CHECK_EQ(policy.SwitchCount(), 1 + 2 * 9);
+	CHECK(applied[31] == eWiFiPowerSave::e_none);
+	CHECK(applied[37] == eWiFiPowerSave::e_max_modem);
+}
+
+TEST(alarm_hold){
+	cWiFiPowerPolicy policy = enabled();
+	std::vector<eWiFiPowerSave> applied = replay(policy, 0, 120000, {{10000, 'a'}});
+	CHECK(applied[9] == eWiFiPowerSave::e_max_modem);
+	CHECK(applied[10] == eWiFiPowerSave::e_none);
+	// full power for AlarmHoldMs although there is no traffic
+	CHECK(applied[69] == eWiFiPowerSave::e_none);
+	CHECK(applied[70] == eWiFiPowerSave::e_max_modem);
+	CHECK_EQ(policy.SwitchCount(), 3);
+}
+
+TEST(tick_overflow){
+	cWiFiPowerPolicy policy = enabled();
+	uint32_t start = 0xffffffffu - 2500;
+	std::vector<eWiFiPowerSave> applied = replay(policy, start, 10000, {{2000, 't'}});
+	CHECK(applied[6] == eWiFiPowerSave::e_none);
+	CHECK(applied[7] == eWiFiPowerSave::e_max_modem);
+}
+
+TEST(profiles_configurable){
+	cWiFiPowerPolicy policy = enabled();
+	policy.ActiveProfile = eWiFiPowerSave::e_min_modem;
+	policy.IdleProfile = eWiFiPowerSave::e_min_modem;
+	std::vector<eWiFiPowerSave> applied = replay(policy, 0, 20000, {});
+	CHECK(applied.back() == eWiFiPowerSave::e_min_modem);
+	CHECK_EQ(policy.SwitchCount(), 0);
+	policy.IdleProfile = eWiFiPowerSave::e_max_modem;
+	policy.IdleTimeoutMs = 2000;
+	applied = replay(policy, 0, 20000, {});
+	CHECK(applied[1] == eWiFiPowerSave::e_min_modem);
+	CHECK(applied[2] == eWiFiPowerSave::e_max_modem);
+}